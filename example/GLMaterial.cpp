@@ -416,7 +416,7 @@ public:
          
          GLuint programID = glCreateProgram();
          
-         glAttachShader(programID, ((i & 0x4) && TSShape::smUseHardwareSkinning && !TSShape::smUseComputeSkinning) ? mSkinnedVertexFunction : mBasicVertexFunction);
+         glAttachShader(programID, ((i & 0x4) && TSShape::useHardwareSkinning() && !TSShape::smUseComputeSkinning) ? mSkinnedVertexFunction : mBasicVertexFunction);
          glAttachShader(programID, mFragmentFunction);
          
          glLinkProgram(programID);
@@ -552,7 +552,7 @@ bool GLTSMaterialInstance::init(TSMaterialManager* mgr, const GFXVertexFormat *f
    
    GLTSMaterialManager* mmgr = (GLTSMaterialManager*)mgr;
    TSGLPipelineCollection* collection = mmgr->mPipelines["standard_fragment"];
-   mPipeline = collection->resolvePipeline(*fmt, !TSShape::smUseHardwareSkinning);
+   mPipeline = collection->resolvePipeline(*fmt, !TSShape::useHardwareSkinning());
    
    return mTexture != 0;
 }
@@ -649,7 +649,7 @@ void GLTSMaterialInstance::activate(const TSSceneRenderState *sceneState, TSRend
    {
       
    }
-   else if (TSShape::smUseHardwareSkinning)
+   else if (TSShape::useHardwareSkinning())
    {
       glBindBuffer(GL_UNIFORM_BUFFER, mPipeline->ubo_nodes);
       GLRenderer* renderer = ((GLRenderer*)(AppState::getInstance()->mRenderer));
@@ -63,7 +63,7 @@ void GLTSMeshRenderer::prepare(TSMesh *mesh, TSMeshInstanceRenderData *meshRende
   GLTSMeshInstanceRenderData *renderData = (GLTSMeshInstanceRenderData*)meshRenderData;
   
    // Load buffer to mesh data if we're using HW skinning
-   if (TSShape::smUseHardwareSkinning)
+   if (TSShape::useHardwareSkinning())
    {
       if (mVB == 0 || mNumVerts != mesh->mNumVerts)
       {
@@ -92,7 +92,7 @@ void GLTSMeshRenderer::prepare(TSMesh *mesh, TSMeshInstanceRenderData *meshRende
   if (renderData)
   {
      // First, ensure the buffer is valid
-     if (TSShape::smUseHardwareSkinning && !TSShape::smUseComputeSkinning)
+     if (TSShape::useHardwareSkinning() && !TSShape::smUseComputeSkinning)
      {
         renderData->mVB = mVB;
         renderData->mVBOffset = 0;
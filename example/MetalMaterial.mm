@@ -238,14 +238,14 @@ public:
       {
          GFXGenVertexFormat(fmt, i);
          printf("MTL GEN VARIANT %u\n", i);
-         MTLVertexDescriptor *vertexDescriptor = GFXToMetalVertexDescriptor(fmt, ((i & 0x4) && TSShape::smUseHardwareSkinning && !TSShape::smUseComputeSkinning) ? mSkinnedVertexFunction : mBasicVertexFunction);
+         MTLVertexDescriptor *vertexDescriptor = GFXToMetalVertexDescriptor(fmt, ((i & 0x4) && TSShape::useHardwareSkinning() && !TSShape::smUseComputeSkinning) ? mSkinnedVertexFunction : mBasicVertexFunction);
          NSError* err = nil;
          
          MTLRenderPipelineDescriptor *pipelineDescriptor = [[MTLRenderPipelineDescriptor alloc] init];
          pipelineDescriptor.colorAttachments[0].pixelFormat = colorFormat;
          pipelineDescriptor.colorAttachments[0].blendingEnabled = NO;
          pipelineDescriptor.depthAttachmentPixelFormat = MTLPixelFormatDepth32Float;
-         pipelineDescriptor.vertexFunction = ((i & 0x4) && TSShape::smUseHardwareSkinning && !TSShape::smUseComputeSkinning) ? mSkinnedVertexFunction : mBasicVertexFunction;
+         pipelineDescriptor.vertexFunction = ((i & 0x4) && TSShape::useHardwareSkinning() && !TSShape::smUseComputeSkinning) ? mSkinnedVertexFunction : mBasicVertexFunction;
          pipelineDescriptor.vertexDescriptor = vertexDescriptor;
          pipelineDescriptor.fragmentFunction = mFragmentFunction;
          
@@ -364,7 +364,7 @@ bool MetalTSMaterialInstance::init(TSMaterialManager* mgr, const GFXVertexFormat
    
    MetalTSMaterialManager* mmgr = (MetalTSMaterialManager*)mgr;
    TSMetalPipelineCollection* collection = mmgr->mPipelines["standard_fragment"];
-   mPipeline = collection->resolvePipeline(*fmt, !TSShape::smUseHardwareSkinning);
+   mPipeline = collection->resolvePipeline(*fmt, !TSShape::useHardwareSkinning());
    assert(mPipeline);
    
    return mTexture != 0;
@@ -432,7 +432,7 @@ void MetalTSMaterialInstance::activate(const TSSceneRenderState *sceneState, TSR
    {
       
    }
-   else if (TSShape::smUseHardwareSkinning)
+   else if (TSShape::useHardwareSkinning())
    {
       MetalRenderer* renderer = ((MetalRenderer*)(AppState::getInstance()->mRenderer));
       if (renderInst->mNumNodeTransforms == 0)
@@ -66,7 +66,7 @@ void MetalTSMeshRenderer::prepare(TSMesh *mesh, TSMeshInstanceRenderData *meshRe
   MetalTSMeshInstanceRenderData *renderData = (MetalTSMeshInstanceRenderData*)meshRenderData;
   
    // Load buffer to mesh data if we're using HW skinning
-   if (TSShape::smUseHardwareSkinning)
+   if (TSShape::useHardwareSkinning())
    {
       if (mVB == 0 || mNumVerts != mesh->mNumVerts)
       {
@@ -96,7 +96,7 @@ void MetalTSMeshRenderer::prepare(TSMesh *mesh, TSMeshInstanceRenderData *meshRe
   if (renderData)
   {
      // First, ensure the buffer is valid
-     if (TSShape::smUseHardwareSkinning && !TSShape::smUseComputeSkinning)
+     if (TSShape::useHardwareSkinning() && !TSShape::smUseComputeSkinning)
      {
         renderData->mVB = mVB;
         renderData->mVBOffset = 0;
@@ -112,7 +112,7 @@ void MetalTSMeshRenderer::prepare(TSMesh *mesh, TSMeshInstanceRenderData *meshRe
         
         if (vertexPtr)
         {
-           if (!TSShape::smUseHardwareSkinning)
+           if (!TSShape::useHardwareSkinning())
            {
               //dMemcpy( vertexPtr, mesh->mVertexData.address(), size );
            }
@@ -165,6 +165,10 @@ struct RayInfo : public Collision
    /// Distance along ray to contact point.
    F32 t; 
 
+   /// Weights of the second and third vertex of the triangle which was hit,
+   /// for casts which test triangles. The face member holds the triangle.
+   Point2F barycentric;
+
    /// Set the point of intersection according to t and the given ray.
    ///
    /// Several pieces of code will not use ray information but rather rely
@@ -184,6 +188,24 @@ struct RayInfo : public Collision
    void *userData;
 };
 
+/// A group of rays cast together, e.g. a shotgun spread or a fan of line of
+/// sight checks. The arrays belong to the caller and hold @a count entries.
+struct RayBatch
+{
+   const Point3F *start;
+   const Point3F *end;
+   U32 count;
+
+   /// Nearest hit of each ray, or NULL to only test whether rays are blocked.
+   /// Only entries with their @a hit flag set are written.
+   RayInfo *results;
+
+   /// Set to 1 for each ray which hits something and 0 otherwise
+   U8 *hit;
+
+   RayBatch() : start( NULL ), end( NULL ), count( 0 ), results( NULL ), hit( NULL ) {}
+};
+
 END_NS
 
 #endif // _COLLISION_H_
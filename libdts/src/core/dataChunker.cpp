@@ -73,6 +73,8 @@ void *DataChunker::alloc(S32 size)
 
 DataChunker::DataBlock::DataBlock(S32 size)
 {
+   prev = next = NULL;
+   curIndex = 0;
    data = new U8[size];
 }
 
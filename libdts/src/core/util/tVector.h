@@ -187,6 +187,9 @@ class Vector
    ///
    void merge( const T *addr, U32 count );
 
+   /// Exchanges the contents of the two vectors without copying elements.
+   void swap( Vector &p );
+
    /// @}
 };
 
@@ -763,6 +766,21 @@ template<class T> inline void Vector<T>::merge( const Vector &p )
    mElementCount = newSize;
 }
 
+template<class T> inline void Vector<T>::swap( Vector &p )
+{
+   const U32 elementCount = mElementCount;
+   const U32 arraySize = mArraySize;
+   T *array = mArray;
+
+   mElementCount = p.mElementCount;
+   mArraySize = p.mArraySize;
+   mArray = p.mArray;
+
+   p.mElementCount = elementCount;
+   p.mArraySize = arraySize;
+   p.mArray = array;
+}
+
 template<class T> inline void Vector<T>::merge( const T *addr, U32 count )
 {
    const U32 oldSize = mElementCount;
@@ -37,7 +37,12 @@ void init(U32 opts)
    
    Processor::init();
    
-   Math::init(((opts >> 16) & 0xFFFF));
+   // Until CPUID detection worked the math library always stayed on its C
+   // and plain assembly versions. Its SSE and 3DNow matrix routines are
+   // still opt in: pass the wanted flags with DTS_CPU_FLAG to install them.
+   // The mesh intrinsics below don't depend on this.
+   const U32 mathProperties = (opts >> 16) & 0xFFFF;
+   Math::init(mathProperties ? mathProperties : CPU_PROP_C);
 
    Platform::setMathControlStateKnown();
    
@@ -32,6 +32,9 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 BEGIN_NS(DTShapeInit)
 
+/// Initializes the library. CPU features are detected at startup and the
+/// mesh intrinsics use the best available, but the math library extensions
+/// are only installed for CPU_PROP_ flags passed in with DTS_CPU_FLAG().
 void init(U32 opts=0);
 void shutdown();
 
@@ -0,0 +1,88 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "math/mDualQuat.h"
+#include "math/mMatrix.h"
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+DualQuatF& DualQuatF::set( const MatrixF &mat )
+{
+   const F32 *m = mat;
+
+   // Remove any scale from the rotation columns
+   Point3F col0( m[0], m[4], m[8] );
+   Point3F col1( m[1], m[5], m[9] );
+   Point3F col2( m[2], m[6], m[10] );
+   col0.normalizeSafe();
+   col1.normalizeSafe();
+   col2.normalizeSafe();
+
+   const F32 r00 = col0.x, r10 = col0.y, r20 = col0.z;
+   const F32 r01 = col1.x, r11 = col1.y, r21 = col1.z;
+   const F32 r02 = col2.x, r12 = col2.y, r22 = col2.z;
+
+   const F32 trace = r00 + r11 + r22;
+   if ( trace > 0.0f )
+   {
+      const F32 s = mSqrt( trace + 1.0f ) * 2.0f;
+      real.set( ( r21 - r12 ) / s, ( r02 - r20 ) / s, ( r10 - r01 ) / s, 0.25f * s );
+   }
+   else if ( r00 > r11 && r00 > r22 )
+   {
+      const F32 s = mSqrt( 1.0f + r00 - r11 - r22 ) * 2.0f;
+      real.set( 0.25f * s, ( r01 + r10 ) / s, ( r02 + r20 ) / s, ( r21 - r12 ) / s );
+   }
+   else if ( r11 > r22 )
+   {
+      const F32 s = mSqrt( 1.0f + r11 - r00 - r22 ) * 2.0f;
+      real.set( ( r01 + r10 ) / s, 0.25f * s, ( r12 + r21 ) / s, ( r02 - r20 ) / s );
+   }
+   else
+   {
+      const F32 s = mSqrt( 1.0f + r22 - r00 - r11 ) * 2.0f;
+      real.set( ( r02 + r20 ) / s, ( r12 + r21 ) / s, 0.25f * s, ( r10 - r01 ) / s );
+   }
+
+   // Guard against drift from a not quite orthogonal matrix
+   const F32 len = mSqrt( real.x * real.x + real.y * real.y + real.z * real.z + real.w * real.w );
+   real.x /= len; real.y /= len; real.z /= len; real.w /= len;
+
+   // dual = 0.5 * t * real
+   const F32 tx = m[3], ty = m[7], tz = m[11];
+   dual.set(  0.5f * (  tx * real.w + ty * real.z - tz * real.y ),
+              0.5f * ( -tx * real.z + ty * real.w + tz * real.x ),
+              0.5f * (  tx * real.y - ty * real.x + tz * real.w ),
+             -0.5f * (  tx * real.x + ty * real.y + tz * real.z ) );
+
+   return *this;
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
@@ -0,0 +1,116 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _MDUALQUAT_H_
+#define _MDUALQUAT_H_
+
+#ifndef _MQUAT_H_
+#include "math/mQuat.h"
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+class MatrixF;
+
+//----------------------------------------------------------------------------
+// unit dual quaternion class:
+
+/// Rigid transform stored as a unit dual quaternion (8 floats).
+///
+/// Used for dual quaternion skinning. The rotation part follows the usual
+/// Hamilton convention so it maps directly onto shader code, and is
+/// independent of the conventions used by QuatF's own operators. Only the
+/// rotation and translation of a matrix are kept; any scale is discarded.
+class DualQuatF
+{
+public:
+   QuatF real;   ///< Rotation
+   QuatF dual;   ///< Translation, as 0.5 * t * real
+
+   DualQuatF() {} // no init constructor
+   DualQuatF( const MatrixF &m ) { set( m ); }
+
+   /// Set from the rotation and translation of a row-major MatrixF
+   DualQuatF& set( const MatrixF &m );
+   DualQuatF& identity();
+
+   /// Scale both parts so the rotation is of unit length
+   DualQuatF& normalize();
+
+   /// this * p -> d (rotate and translate)
+   void mulP( const Point3F &p, Point3F *d ) const;
+
+   /// this * v -> d (rotate only)
+   void mulV( const VectorF &v, Point3F *d ) const;
+};
+
+inline DualQuatF& DualQuatF::identity()
+{
+   real.set( 0.0f, 0.0f, 0.0f, 1.0f );
+   dual.set( 0.0f, 0.0f, 0.0f, 0.0f );
+   return *this;
+}
+
+inline DualQuatF& DualQuatF::normalize()
+{
+   const F32 len = mSqrt( real.x * real.x + real.y * real.y + real.z * real.z + real.w * real.w );
+   if ( len > 0.0f )
+   {
+      const F32 inv = 1.0f / len;
+      real.x *= inv; real.y *= inv; real.z *= inv; real.w *= inv;
+      dual.x *= inv; dual.y *= inv; dual.z *= inv; dual.w *= inv;
+   }
+   return *this;
+}
+
+inline void DualQuatF::mulV( const VectorF &v, Point3F *d ) const
+{
+   // v + 2 * cross(r, cross(r, v) + w * v)
+   const F32 cx = real.y * v.z - real.z * v.y + real.w * v.x;
+   const F32 cy = real.z * v.x - real.x * v.z + real.w * v.y;
+   const F32 cz = real.x * v.y - real.y * v.x + real.w * v.z;
+
+   d->x = v.x + 2.0f * ( real.y * cz - real.z * cy );
+   d->y = v.y + 2.0f * ( real.z * cx - real.x * cz );
+   d->z = v.z + 2.0f * ( real.x * cy - real.y * cx );
+}
+
+inline void DualQuatF::mulP( const Point3F &p, Point3F *d ) const
+{
+   mulV( p, d );
+
+   // translation = 2 * (real.w * dual - dual.w * real + cross(real, dual))
+   d->x += 2.0f * ( real.w * dual.x - dual.w * real.x + real.y * dual.z - real.z * dual.y );
+   d->y += 2.0f * ( real.w * dual.y - dual.w * real.y + real.z * dual.x - real.x * dual.z );
+   d->z += 2.0f * ( real.w * dual.z - dual.w * real.z + real.x * dual.y - real.y * dual.x );
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
+
+#endif // _MDUALQUAT_H_
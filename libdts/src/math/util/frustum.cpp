@@ -28,6 +28,11 @@
 #include "math/mSphere.h"
 #include "platform/profiler.h"
 
+#if defined(LIBDTSHAPE_CPU_X86_64) || (defined(LIBDTSHAPE_CPU_X86) && (defined(__SSE__) || _M_IX86_FP >= 1))
+#define FRUSTUM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
 //-----------------------------------------------------------------------------
 
 BEGIN_NS(DTShape)
@@ -593,4 +598,103 @@ void Frustum::tile( F32 *left, F32 *right, F32 *top, F32 *bottom, U32 numTiles,
 
 //-----------------------------------------------------------------------------
 
+void Frustum::cullBoxes( const FrustumCullBatch &batch, U32 *outVisible ) const
+{
+   PROFILE_SCOPE( Frustum_cullBoxes );
+
+   dMemset( outVisible, 0, ( ( batch.count + 31 ) / 32 ) * sizeof( U32 ) );
+
+   // PlaneF::whichSide() puts a box behind a plane once its nearest
+   // corner is this far in front of it
+   const F32 backDist = -0.005f;
+
+   const PlaneF *planes = getPlanes();
+   const U32 numPlanes = getNumPlanes();
+
+#ifdef FRUSTUM_USE_SSE
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 back = _mm_set1_ps( backDist );
+#endif
+
+   for ( S32 g = 0; g < batch.groups.size(); g++ )
+   {
+      const FrustumCullBatch::Group &group = batch.groups[g];
+      U32 outside = 0;
+
+#ifdef FRUSTUM_USE_SSE
+      const __m128 cx = _mm_loadu_ps( group.center[0] );
+      const __m128 cy = _mm_loadu_ps( group.center[1] );
+      const __m128 cz = _mm_loadu_ps( group.center[2] );
+      const __m128 hx = _mm_loadu_ps( group.halfSize[0] );
+      const __m128 hy = _mm_loadu_ps( group.halfSize[1] );
+      const __m128 hz = _mm_loadu_ps( group.halfSize[2] );
+
+      // Move the centers across and grow the extents by the absolute
+      // rotation, as MatrixF::mul( Box3F& ) does
+      __m128 wc[3], wh[3];
+      for ( U32 r = 0; r < 3; r++ )
+      {
+         const __m128 m0 = _mm_loadu_ps( group.transform[r*4+0] );
+         const __m128 m1 = _mm_loadu_ps( group.transform[r*4+1] );
+         const __m128 m2 = _mm_loadu_ps( group.transform[r*4+2] );
+         const __m128 m3 = _mm_loadu_ps( group.transform[r*4+3] );
+
+         wc[r] = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m0, cx ), _mm_mul_ps( m1, cy ) ),
+                             _mm_add_ps( _mm_mul_ps( m2, cz ), m3 ) );
+         wh[r] = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_max_ps( m0, _mm_sub_ps( zero, m0 ) ), hx ),
+                                         _mm_mul_ps( _mm_max_ps( m1, _mm_sub_ps( zero, m1 ) ), hy ) ),
+                             _mm_mul_ps( _mm_max_ps( m2, _mm_sub_ps( zero, m2 ) ), hz ) );
+      }
+
+      // A box is culled once its furthest corner along a plane normal is
+      // still behind that plane
+      __m128 culled = zero;
+      for ( U32 p = 0; p < numPlanes; p++ )
+      {
+         const PlaneF &plane = planes[p];
+         const __m128 dist = _mm_add_ps(
+            _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( plane.x ), wc[0] ), _mm_mul_ps( _mm_set1_ps( plane.y ), wc[1] ) ),
+                        _mm_add_ps( _mm_mul_ps( _mm_set1_ps( plane.z ), wc[2] ), _mm_set1_ps( plane.d ) ) ),
+            _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( mFabs( plane.x ) ), wh[0] ), _mm_mul_ps( _mm_set1_ps( mFabs( plane.y ) ), wh[1] ) ),
+                        _mm_mul_ps( _mm_set1_ps( mFabs( plane.z ) ), wh[2] ) ) );
+         culled = _mm_or_ps( culled, _mm_cmple_ps( dist, back ) );
+      }
+      outside = _mm_movemask_ps( culled );
+#else
+      for ( U32 lane = 0; lane < FrustumCullBatch::GroupSize; lane++ )
+      {
+         Point3F wc, wh;
+         for ( U32 r = 0; r < 3; r++ )
+         {
+            const F32 m0 = group.transform[r*4+0][lane];
+            const F32 m1 = group.transform[r*4+1][lane];
+            const F32 m2 = group.transform[r*4+2][lane];
+            wc[r] = m0 * group.center[0][lane] + m1 * group.center[1][lane] + m2 * group.center[2][lane] + group.transform[r*4+3][lane];
+            wh[r] = mFabs( m0 ) * group.halfSize[0][lane] + mFabs( m1 ) * group.halfSize[1][lane] + mFabs( m2 ) * group.halfSize[2][lane];
+         }
+
+         for ( U32 p = 0; p < numPlanes; p++ )
+         {
+            const PlaneF &plane = planes[p];
+            const F32 dist = plane.x * wc.x + plane.y * wc.y + plane.z * wc.z + plane.d +
+                             mFabs( plane.x ) * wh.x + mFabs( plane.y ) * wh.y + mFabs( plane.z ) * wh.z;
+            if ( dist <= backDist )
+            {
+               outside |= 1U << lane;
+               break;
+            }
+         }
+      }
+#endif
+
+      // Lanes past the end of the batch are left clear
+      const U32 first = g * FrustumCullBatch::GroupSize;
+      const U32 numLanes = getMin( batch.count - first, U32( FrustumCullBatch::GroupSize ) );
+      const U32 visible = ~outside & ( ( 1U << numLanes ) - 1 );
+      outVisible[ first / 32 ] |= visible << ( first % 32 );
+   }
+}
+
+//-----------------------------------------------------------------------------
+
 END_NS
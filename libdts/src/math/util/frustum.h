@@ -223,6 +223,61 @@ struct FrustumData : public PolyhedronData
 };
 
 
+/// A set of boxes to cull against a frustum in one go, see Frustum::cullBoxes.
+///
+/// Each box is kept in its own space along with the transform into the space
+/// of the frustum, so the transforms are done by the culling pass itself.
+/// Boxes are stored in groups of GroupSize in structure of arrays form so
+/// that a whole group is transformed and tested at once. Boxes from any number
+/// of shapes may share a batch; the index returned by push() is the bit which
+/// holds the result.
+struct FrustumCullBatch
+{
+   enum { GroupSize = 4 };
+
+   struct Group
+   {
+      F32 center[3][GroupSize];     ///< Box centers in box space
+      F32 halfSize[3][GroupSize];   ///< Half the box extents
+      F32 transform[12][GroupSize]; ///< Top three rows of each transform
+   };
+
+   Vector<Group> groups;
+   U32 count;
+
+   FrustumCullBatch() : count(0) {}
+
+   void clear() { groups.clear(); count = 0; }
+
+   /// Adds a box in the space given by @a transform, returning its index
+   U32 push( const Box3F &box, const MatrixF &transform );
+};
+
+inline U32 FrustumCullBatch::push( const Box3F &box, const MatrixF &transform )
+{
+   const U32 lane = count % GroupSize;
+   if ( lane == 0 )
+   {
+      groups.increment();
+      dMemset( &groups.last(), 0, sizeof( Group ) );
+   }
+
+   Group &group = groups.last();
+   const Point3F center = box.getCenter();
+   const Point3F halfSize = box.getExtents() * 0.5f;
+   for ( U32 i = 0; i < 3; i++ )
+   {
+      group.center[i][lane] = center[i];
+      group.halfSize[i][lane] = halfSize[i];
+   }
+
+   const F32 *m = transform;
+   for ( U32 i = 0; i < 12; i++ )
+      group.transform[i][lane] = m[i];
+
+   return count++;
+}
+
 /// This class implements a view frustum for use in culling scene objects and
 /// rendering the scene.
 ///
@@ -455,6 +510,12 @@ class Frustum : public PolyhedronImpl< FrustumData >
       /// Return true if the contents of the given sphere can be culled.
       bool isCulled( const SphereF& sphere ) const { return ( testPotentialIntersection( sphere ) == GeometryOutside ); }
 
+      /// Cull every box of @a batch, setting bit i of @a outVisible for each
+      /// box i which isn't culled. The boxes are transformed to axis aligned
+      /// boxes first, so the results match isCulled() on the transformed box.
+      /// @a outVisible must hold ( batch.count + 31 ) / 32 words.
+      void cullBoxes( const FrustumCullBatch &batch, U32 *outVisible ) const;
+
       /// @}
 
       /// @name Projection Type
@@ -163,6 +163,35 @@ public:
    static File *openFile(const String &file, File::AccessMode mode);
 };
 
+/// A whole file mapped into memory.
+///
+/// The pages are mapped copy-on-write, so the data may be modified in place
+/// without the changes ever reaching the file.
+class FileMapping
+{
+protected:
+   void *mData;
+   U32 mSize;
+   void *mHandle;    ///< platform specific mapping handle, if any
+
+   FileMapping(const FileMapping&);              ///< This is here to disable the copy constructor.
+   FileMapping& operator=(const FileMapping&);   ///< This is here to disable assignment.
+
+public:
+   FileMapping() : mData(NULL), mSize(0), mHandle(NULL) {;}
+   ~FileMapping() { close(); }
+
+   /// Maps @a filename. Returns false if the file can't be opened or is empty.
+   bool open(const char *filename);
+
+   /// Unmaps the file
+   void close();
+
+   bool isOpen() const { return mData != NULL; }
+   void *getData() const { return mData; }
+   U32 getSize() const { return mSize; }
+};
+
 END_NS
 
 #endif // _FILE_IO_H_
@@ -44,11 +44,17 @@ enum CPUFlags
    BIT_SSE3xt  = BIT(9),
    BIT_SSE4_1  = BIT(19),
    BIT_SSE4_2  = BIT(20),
+   BIT_FMA     = BIT(12),
+   BIT_AVX     = BIT(28),
+
+   // These are from the extended feature leaf (CPUID eax=7, ebx)
+   BIT_AVX2    = BIT(5),
+   BIT_AVX512F = BIT(16),
 };
 
 // fill the specified structure with information obtained from asm code
 void SetProcessorInfo(Platform::SystemInfo_struct::Processor& pInfo,
-   char* vendor, U32 processor, U32 properties, U32 properties2)
+   char* vendor, U32 processor, U32 properties, U32 properties2, U32 properties3)
 {
    Platform::SystemInfo.processor.properties |= (properties & BIT_FPU)   ? CPU_PROP_FPU : 0;
    Platform::SystemInfo.processor.properties |= (properties & BIT_RDTSC) ? CPU_PROP_RDTSC : 0;
@@ -260,6 +266,14 @@ void SetProcessorInfo(Platform::SystemInfo_struct::Processor& pInfo,
             }
          }
 
+   // AVX and later are reported the same way by every vendor. The caller is
+   // responsible for masking these off if the OS does not save the extended
+   // register state.
+   pInfo.properties |= (properties2 & BIT_AVX) ? CPU_PROP_AVX : 0;
+   pInfo.properties |= (properties2 & BIT_FMA) ? CPU_PROP_FMA : 0;
+   pInfo.properties |= (properties3 & BIT_AVX2) ? CPU_PROP_AVX2 : 0;
+   pInfo.properties |= (properties3 & BIT_AVX512F) ? CPU_PROP_AVX512F : 0;
+
    // Get multithreading caps.
 
    CPUInfo::EConfig config = CPUInfo::CPUCount( pInfo.numLogicalProcessors, pInfo.numAvailableCores, pInfo.numPhysicalProcessors );
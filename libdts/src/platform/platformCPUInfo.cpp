@@ -25,6 +25,16 @@
 #include <math.h>
 #include "core/log.h"
 
+#if defined(LIBDTSHAPE_CPU_X86) || defined(LIBDTSHAPE_CPU_X86_64)
+#  if defined(LIBDTSHAPE_COMPILER_GCC)
+#     include <cpuid.h>
+#     define LIBDTSHAPE_HAS_CPUID
+#  elif defined(LIBDTSHAPE_COMPILER_VISUALC)
+#     include <intrin.h>
+#     define LIBDTSHAPE_HAS_CPUID
+#  endif
+#endif
+
 //-----------------------------------------------------------------------------
 
 BEGIN_NS(DTShape)
@@ -34,7 +44,7 @@ BEGIN_NS(DTShape)
 Platform::SystemInfo_struct Platform::SystemInfo;
 
 extern void SetProcessorInfo(Platform::SystemInfo_struct::Processor& pInfo,
-   char* vendor, U32 processor, U32 properties, U32 properties2); // platform/platformCPU.cc
+   char* vendor, U32 processor, U32 properties, U32 properties2, U32 properties3); // platform/platformCPU.cc
 
 // asm cpu detection routine from platform code
 extern "C"
@@ -46,11 +56,96 @@ void detectX86CPUInfo(char *vendor, U32 *processor, U32 *properties);
 static U32 sTime[2];
 static char vendor[13] = {0,};
 static U32 properties = 0;
+static U32 properties2 = 0;
+static U32 properties3 = 0;
 static U32 processor  = 0;
 //U32 clockticks = 0;
 //U32 timeHi = 0;
 //U32 timeLo = 0;
 
+#if defined(LIBDTSHAPE_HAS_CPUID)
+
+static void cpuidQuery(U32 leaf, U32 subLeaf, U32 regs[4])
+{
+#if defined(LIBDTSHAPE_COMPILER_GCC)
+   __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#else
+   int info[4];
+   __cpuidex(info, leaf, subLeaf);
+   regs[0] = info[0]; regs[1] = info[1]; regs[2] = info[2]; regs[3] = info[3];
+#endif
+}
+
+static U64 readXCR0()
+{
+#if defined(LIBDTSHAPE_COMPILER_GCC)
+   U32 lo, hi;
+   // xgetbv, encoded so older assemblers accept it
+   __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a" (lo), "=d" (hi) : "c" (0));
+   return ((U64)hi << 32) | lo;
+#else
+   return _xgetbv(0);
+#endif
+}
+
+/// Compiler intrinsic replacement for the asm detectX86CPUInfo, which also
+/// returns the ECX feature flags and the extended (leaf 7) feature flags.
+///
+/// Extended register features are masked off unless the OS has enabled
+/// saving of the corresponding register state.
+static void detectX86CPUInfoEx(char *vendor, U32 *processor, U32 *properties, U32 *properties2, U32 *properties3)
+{
+   enum
+   {
+      ECX_OSXSAVE  = BIT(27),
+      ECX_AVX_MASK = BIT(12) | BIT(28), // FMA, AVX
+      EBX_AVX2     = BIT(5),
+      EBX_AVX512F  = BIT(16),
+
+      XCR0_YMM     = BIT(1) | BIT(2),
+      XCR0_ZMM     = BIT(5) | BIT(6) | BIT(7),
+   };
+
+   U32 regs[4];
+   cpuidQuery(0, 0, regs);
+
+   const U32 maxLeaf = regs[0];
+   dMemcpy(vendor + 0, &regs[1], 4);
+   dMemcpy(vendor + 4, &regs[3], 4);
+   dMemcpy(vendor + 8, &regs[2], 4);
+   vendor[12] = '\0';
+
+   if (maxLeaf < 1)
+      return;
+
+   cpuidQuery(1, 0, regs);
+   *processor = regs[0];
+   *properties = regs[3];
+   *properties2 = regs[2];
+
+   if (maxLeaf >= 7)
+   {
+      cpuidQuery(7, 0, regs);
+      *properties3 = regs[1];
+   }
+
+   U64 xcr0 = 0;
+   if (*properties2 & ECX_OSXSAVE)
+      xcr0 = readXCR0();
+
+   if ((xcr0 & XCR0_YMM) != XCR0_YMM)
+   {
+      *properties2 &= ~ECX_AVX_MASK;
+      *properties3 &= ~(EBX_AVX2 | EBX_AVX512F);
+   }
+   else if ((xcr0 & XCR0_ZMM) != XCR0_ZMM)
+   {
+      *properties3 &= ~EBX_AVX512F;
+   }
+}
+
+#endif
+
 void Processor::init()
 {
    // Reference:
@@ -63,12 +158,16 @@ void Processor::init()
    Platform::SystemInfo.processor.mhz  = 0;
    Platform::SystemInfo.processor.properties = CPU_PROP_C;
 
-   /*clockticks = */properties = processor = sTime[0] = 0;
+   /*clockticks = */properties = properties2 = properties3 = processor = sTime[0] = 0;
    dStrcpy(vendor, "");
 
+#if defined(LIBDTSHAPE_HAS_CPUID)
+   detectX86CPUInfoEx(vendor, &processor, &properties, &properties2, &properties3);
+#else
    //detectX86CPUInfo(vendor, &processor, &properties);
+#endif
    SetProcessorInfo(Platform::SystemInfo.processor,
-      vendor, processor, properties, 0);
+      vendor, processor, properties, properties2, properties3);
 
 #if 0
    //--------------------------------------
@@ -155,6 +254,16 @@ void Processor::init()
       Log::printf("   3DNow detected");
    if (Platform::SystemInfo.processor.properties & CPU_PROP_SSE)
       Log::printf("   SSE detected");
+   if (Platform::SystemInfo.processor.properties & CPU_PROP_SSE4_1)
+      Log::printf("   SSE4.1 detected");
+   if (Platform::SystemInfo.processor.properties & CPU_PROP_AVX)
+      Log::printf("   AVX detected");
+   if (Platform::SystemInfo.processor.properties & CPU_PROP_AVX2)
+      Log::printf("   AVX2 detected");
+   if (Platform::SystemInfo.processor.properties & CPU_PROP_FMA)
+      Log::printf("   FMA detected");
+   if (Platform::SystemInfo.processor.properties & CPU_PROP_AVX512F)
+      Log::printf("   AVX-512F detected");
    Log::printf(" ");
 }
 
@@ -0,0 +1,103 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _PLATFORMTHREADS_H_
+#define _PLATFORMTHREADS_H_
+
+#ifndef _PLATFORM_H_
+#include "platform/platform.h"
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+typedef void (*ThreadRunFunction)(void *data);
+
+/// A minimal OS thread.
+///
+/// The thread calls the run function with the supplied argument once start()
+/// is called. A started thread must be joined before it is destroyed.
+class Thread
+{
+public:
+   struct PlatformData;
+
+protected:
+   PlatformData *mData;
+   ThreadRunFunction mRunFunction;
+   void *mRunArg;
+   bool mRunning;
+
+   Thread(const Thread&);              ///< This is here to disable the copy constructor.
+   Thread& operator=(const Thread&);   ///< This is here to disable assignment.
+
+public:
+   Thread(ThreadRunFunction func, void *arg);
+   ~Thread();
+
+   /// Starts the thread
+   ///
+   /// @returns false if the thread could not be created.
+   bool start();
+
+   /// Waits for the run function to return
+   void join();
+
+   /// Returns true if the thread has been started and not yet joined
+   bool isRunning() const { return mRunning; }
+
+   /// Called on the new thread; do not call directly.
+   void run() { mRunFunction(mRunArg); }
+};
+
+/// A counting semaphore used to park worker threads.
+class Semaphore
+{
+public:
+   struct PlatformData;
+
+protected:
+   PlatformData *mData;
+
+   Semaphore(const Semaphore&);
+   Semaphore& operator=(const Semaphore&);
+
+public:
+   Semaphore(S32 initialCount = 0);
+   ~Semaphore();
+
+   /// Blocks until the count is positive, then decrements it
+   void acquire();
+
+   /// Increments the count by @a count, waking up to that many waiters
+   void release(S32 count = 1);
+};
+
+//-----------------------------------------------------------------------------
+
+END_NS
+
+#endif // _PLATFORMTHREADS_H_
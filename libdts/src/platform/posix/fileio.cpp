@@ -28,6 +28,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -420,6 +421,42 @@ File *File::openFile(const String &file, File::AccessMode mode)
    return NULL;
 }
 
+bool FileMapping::open(const char *filename)
+{
+   AssertFatal(NULL != filename, "FileMapping::open: NULL filename");
+
+   close();
+
+   int fd = x86UNIXOpen(filename, O_RDONLY);
+   if (fd == -1)
+      return false;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || st.st_size <= 0 || (U64)st.st_size > U32_MAX)
+   {
+      x86UNIXClose(fd);
+      return false;
+   }
+
+   // the mapping keeps its own reference to the file
+   void *data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   x86UNIXClose(fd);
+   if (data == MAP_FAILED)
+      return false;
+
+   mData = data;
+   mSize = (U32)st.st_size;
+   return true;
+}
+
+void FileMapping::close()
+{
+   if (mData)
+      munmap(mData, mSize);
+   mData = NULL;
+   mSize = 0;
+}
+
 bool Platform::createPath(const char * filename)
 {
    return false; // TODO
@@ -0,0 +1,125 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "libDTShapeConfig.h"
+#include "platform/platform.h"
+#include "platform/platformThreads.h"
+
+#include <pthread.h>
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+struct Thread::PlatformData
+{
+   pthread_t thread;
+};
+
+static void *_threadEntry( void *arg )
+{
+   reinterpret_cast<Thread*>(arg)->run();
+   return NULL;
+}
+
+Thread::Thread(ThreadRunFunction func, void *arg) :
+   mRunFunction(func),
+   mRunArg(arg),
+   mRunning(false)
+{
+   mData = new PlatformData;
+}
+
+Thread::~Thread()
+{
+   AssertFatal(!mRunning, "Thread::~Thread - thread must be joined before it is destroyed");
+   delete mData;
+}
+
+bool Thread::start()
+{
+   AssertFatal(!mRunning, "Thread::start - thread already running");
+   mRunning = pthread_create( &mData->thread, NULL, _threadEntry, this ) == 0;
+   return mRunning;
+}
+
+void Thread::join()
+{
+   if ( !mRunning )
+      return;
+
+   pthread_join( mData->thread, NULL );
+   mRunning = false;
+}
+
+//-----------------------------------------------------------------------------
+
+// Unnamed POSIX semaphores are not available on OSX, so build one from a
+// mutex and condition variable.
+struct Semaphore::PlatformData
+{
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   S32 count;
+};
+
+Semaphore::Semaphore(S32 initialCount)
+{
+   mData = new PlatformData;
+   pthread_mutex_init( &mData->mutex, NULL );
+   pthread_cond_init( &mData->cond, NULL );
+   mData->count = initialCount;
+}
+
+Semaphore::~Semaphore()
+{
+   pthread_cond_destroy( &mData->cond );
+   pthread_mutex_destroy( &mData->mutex );
+   delete mData;
+}
+
+void Semaphore::acquire()
+{
+   pthread_mutex_lock( &mData->mutex );
+   while ( mData->count <= 0 )
+      pthread_cond_wait( &mData->cond, &mData->mutex );
+   mData->count--;
+   pthread_mutex_unlock( &mData->mutex );
+}
+
+void Semaphore::release(S32 count)
+{
+   pthread_mutex_lock( &mData->mutex );
+   mData->count += count;
+   if ( count == 1 )
+      pthread_cond_signal( &mData->cond );
+   else
+      pthread_cond_broadcast( &mData->cond );
+   pthread_mutex_unlock( &mData->mutex );
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
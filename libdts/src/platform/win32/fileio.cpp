@@ -509,6 +509,68 @@ File *File::openFile(const String &file, File::AccessMode mode)
    return NULL;
 }
 
+bool FileMapping::open(const char *filename)
+{
+   AssertFatal(NULL != filename, "FileMapping::open: NULL filename");
+
+   close();
+
+   TempAlloc< TCHAR > fname( dStrlen( filename ) + 1 );
+
+#ifdef UNICODE
+   convertUTF8toUTF16( filename, (UTF16*)fname.ptr, fname.size );
+#else
+   dStrcpy(fname, filename);
+#endif
+   backslash( fname );
+
+   HANDLE file = CreateFile(fname,
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      NULL,
+      OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL,
+      NULL);
+   if (file == INVALID_HANDLE_VALUE)
+      return false;
+
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || size.QuadPart > U32_MAX)
+   {
+      CloseHandle(file);
+      return false;
+   }
+
+   // the mapping keeps its own reference to the file
+   HANDLE mapping = CreateFileMapping(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+   CloseHandle(file);
+   if (mapping == NULL)
+      return false;
+
+   void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+   if (data == NULL)
+   {
+      CloseHandle(mapping);
+      return false;
+   }
+
+   mData = data;
+   mSize = (U32)size.QuadPart;
+   mHandle = (void *)mapping;
+   return true;
+}
+
+void FileMapping::close()
+{
+   if (mData)
+      UnmapViewOfFile(mData);
+   if (mHandle)
+      CloseHandle((HANDLE)mHandle);
+   mData = NULL;
+   mSize = 0;
+   mHandle = NULL;
+}
+
 S32 Platform::compareFileTimes(const FileTime &a, const FileTime &b)
 {
    if(a.v2 > b.v2)
@@ -0,0 +1,113 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "libDTShapeConfig.h"
+#include "platform/platform.h"
+#include "platform/platformThreads.h"
+
+#include <windows.h>
+#include <process.h>
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+struct Thread::PlatformData
+{
+   HANDLE thread;
+};
+
+static unsigned __stdcall _threadEntry( void *arg )
+{
+   reinterpret_cast<Thread*>(arg)->run();
+   return 0;
+}
+
+Thread::Thread(ThreadRunFunction func, void *arg) :
+   mRunFunction(func),
+   mRunArg(arg),
+   mRunning(false)
+{
+   mData = new PlatformData;
+   mData->thread = NULL;
+}
+
+Thread::~Thread()
+{
+   AssertFatal(!mRunning, "Thread::~Thread - thread must be joined before it is destroyed");
+   delete mData;
+}
+
+bool Thread::start()
+{
+   AssertFatal(!mRunning, "Thread::start - thread already running");
+   mData->thread = (HANDLE)_beginthreadex( NULL, 0, _threadEntry, this, 0, NULL );
+   mRunning = mData->thread != NULL;
+   return mRunning;
+}
+
+void Thread::join()
+{
+   if ( !mRunning )
+      return;
+
+   WaitForSingleObject( mData->thread, INFINITE );
+   CloseHandle( mData->thread );
+   mData->thread = NULL;
+   mRunning = false;
+}
+
+//-----------------------------------------------------------------------------
+
+struct Semaphore::PlatformData
+{
+   HANDLE semaphore;
+};
+
+Semaphore::Semaphore(S32 initialCount)
+{
+   mData = new PlatformData;
+   mData->semaphore = CreateSemaphore( NULL, initialCount, 0x7fffffff, NULL );
+}
+
+Semaphore::~Semaphore()
+{
+   CloseHandle( mData->semaphore );
+   delete mData;
+}
+
+void Semaphore::acquire()
+{
+   WaitForSingleObject( mData->semaphore, INFINITE );
+}
+
+void Semaphore::release(S32 count)
+{
+   ReleaseSemaphore( mData->semaphore, count, NULL );
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
@@ -29,14 +29,38 @@ BEGIN_NS(DTShape)
 
 //-----------------------------------------------------------------------------
 
-#if defined(LIBDTSHAPE_CPU_X86)
+#if defined(LIBDTSHAPE_CPU_X86) || defined(LIBDTSHAPE_CPU_X86_64)
 # // x86 CPU family implementations
 extern void zero_vert_normal_bulk_SSE(const dsize_t count, U8 * __restrict const outPtr, const dsize_t outStride);
 extern void m_matF_x_BatchedVertWeightList_SSE(const MatrixF &mat, const dsize_t count, const TSSkinMesh::BatchData::BatchedVertWeight * __restrict batch, U8 * const __restrict outPtr, const dsize_t outStride);
+extern void m_matF_x_BatchedVertex4List_SSE(const MatrixF *matrices, const dsize_t count, const TSSkinMesh::BatchData::BatchedVertex4 * __restrict batch, U8 * const __restrict outPtr, const dsize_t outStride);
+extern void m_quat16_nlerp_BatchedKeyList_SSE(const dsize_t count, const Quat16 * __restrict keys1, const Quat16 * __restrict keys2, const dsize_t keyStride, const F32 t, QuatF * __restrict out);
+extern void m_quatF_point3F_x_matF_BatchedList_SSE(const dsize_t count, const QuatF * __restrict rots, const Point3F * __restrict trans, MatrixF * __restrict out);
+extern void m_matF_x_matF_NodeList_SSE(const dsize_t count, const S32 * __restrict nodes, const S32 * __restrict parents, const MatrixF * __restrict local, MatrixF * world);
 #if (_MSC_VER >= 1500)
 extern void m_matF_x_BatchedVertWeightList_SSE4(const MatrixF &mat, const dsize_t count, const TSSkinMesh::BatchData::BatchedVertWeight * __restrict batch, U8 * const __restrict outPtr, const dsize_t outStride);
 #endif
 #
+# // AVX2 and AVX-512 implementations are compiled per-function for their
+# // target, so the rest of the library keeps the baseline instruction set.
+#  if (defined(LIBDTSHAPE_COMPILER_GCC) && (LIBDTSHAPE_COMPILER_GCC >= 40900 || defined(__clang__))) || (_MSC_VER >= 1910)
+#     define LIBDTSHAPE_TS_AVX_INTRINSICS
+#     if defined(LIBDTSHAPE_COMPILER_GCC)
+#        define TS_TARGET_AVX __attribute__((target("avx")))
+#        define TS_TARGET_AVX2 __attribute__((target("avx2")))
+#        define TS_TARGET_AVX512 __attribute__((target("avx512f")))
+#     else
+#        define TS_TARGET_AVX
+#        define TS_TARGET_AVX2
+#        define TS_TARGET_AVX512
+#     endif
+extern void zero_vert_normal_bulk_AVX(const dsize_t count, U8 * __restrict const outPtr, const dsize_t outStride);
+extern void m_matF_x_BatchedVertWeightList_AVX2(const MatrixF &mat, const dsize_t count, const TSSkinMesh::BatchData::BatchedVertWeight * __restrict batch, U8 * const __restrict outPtr, const dsize_t outStride);
+extern void m_matF_x_SoAVertWeightBlocks_AVX2(const MatrixF *matrices, const dsize_t numBlocks, const TSSkinMesh::BatchData::SoAInfluence * __restrict influences, const S32 *blockStart, const F32 * __restrict inStreams, F32 * __restrict outStreams, const dsize_t streamSize);
+extern void m_quat16_nlerp_BatchedKeyList_AVX2(const dsize_t count, const Quat16 * __restrict keys1, const Quat16 * __restrict keys2, const dsize_t keyStride, const F32 t, QuatF * __restrict out);
+extern void m_matF_x_BatchedVertWeightList_AVX512(const MatrixF &mat, const dsize_t count, const TSSkinMesh::BatchData::BatchedVertWeight * __restrict batch, U8 * const __restrict outPtr, const dsize_t outStride);
+#  endif
+#
 #elif defined(LIBDTSHAPE_CPU_PPC)
 # // PPC CPU family implementations
 #  if defined(LIBDTSHAPE_OS_XENON)
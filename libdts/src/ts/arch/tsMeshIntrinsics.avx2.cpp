@@ -0,0 +1,348 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "ts/tsMesh.h"
+#include "ts/tsMeshIntrinsics.h"
+#include "ts/arch/tsMeshIntrinsics.arch.h"
+
+#if defined(LIBDTSHAPE_TS_AVX_INTRINSICS)
+#include <immintrin.h>
+
+// These kernels must match the C versions bit for bit, so the compiler must
+// not fuse the separate multiplies and adds below into FMA instructions.
+#if defined(LIBDTSHAPE_COMPILER_GCC) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+TS_TARGET_AVX2 void zero_vert_normal_bulk_AVX(const dsize_t count, U8 * __restrict const outPtr, const dsize_t outStride)
+{
+   char *outData = reinterpret_cast<char *>(outPtr);
+
+   // The first 32 bytes of a vertex are _vert, _tangentW, _normal and
+   // _tangent.x. Only the position and normal are cleared.
+   const __m256 vZero = _mm256_setzero_ps();
+
+   for(dsize_t i = 0; i < count; i++)
+   {
+      __m256 vData = _mm256_loadu_ps(reinterpret_cast<const F32 *>(outData));
+      vData = _mm256_blend_ps(vData, vZero, 0x77);
+      _mm256_storeu_ps(reinterpret_cast<F32 *>(outData), vData);
+
+      outData += outStride;
+   }
+
+   _mm256_zeroupper();
+}
+
+//------------------------------------------------------------------------------
+
+/// Accumulate a weighted position and normal into a vertex, leaving the
+/// 4th component of each (_tangentW and _tangent.x) untouched.
+static inline TS_TARGET_AVX2 void _accumulateVertAVX(TSMesh::__TSMeshVertexBase *outElem, __m128 pos, __m128 nrm)
+{
+   __m128 outPos = _mm_load_ps(outElem->_vert);
+   __m128 outNrm = _mm_load_ps(outElem->_normal);
+
+   _mm_store_ps(outElem->_vert, _mm_blend_ps(_mm_add_ps(outPos, pos), outPos, 0x8));
+   _mm_store_ps(outElem->_normal, _mm_blend_ps(_mm_add_ps(outNrm, nrm), outNrm, 0x8));
+}
+
+TS_TARGET_AVX2 void m_matF_x_BatchedVertWeightList_AVX2(const MatrixF &mat, 
+                                    const dsize_t count,
+                                    const TSSkinMesh::BatchData::BatchedVertWeight * __restrict batch,
+                                    U8 * const __restrict outPtr,
+                                    const dsize_t outStride)
+{
+   const char * __restrict iPtr = reinterpret_cast<const char *>(batch);
+   const dsize_t inStride = sizeof(TSSkinMesh::BatchData::BatchedVertWeight);
+
+   // Load matrix columns, duplicated into both 128-bit lanes so two
+   // batch elements are transformed at once
+   MatrixF transMat;
+   mat.transposeTo(transMat);
+
+   __m256 avxMat[4];
+   avxMat[0] = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&transMat[0]));
+   avxMat[1] = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&transMat[4]));
+   avxMat[2] = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&transMat[8]));
+   avxMat[3] = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&transMat[12]));
+
+   __m256 inPos, inNrm, weight;
+   __m256 tempPos, tempNrm;
+
+   dsize_t i = 0;
+   for(; i + 2 <= count; i += 2)
+   {
+      // Each element is {vert, weight, normal, vidx}, so two loads give
+      // {vert0, normal0} and {vert1, normal1} to be split into lanes
+      const __m256 elem0 = _mm256_loadu_ps(reinterpret_cast<const F32 *>(iPtr + inStride * i));
+      const __m256 elem1 = _mm256_loadu_ps(reinterpret_cast<const F32 *>(iPtr + inStride * (i + 1)));
+
+      _mm_prefetch(iPtr + inStride * (i + 32), _MM_HINT_T0);
+
+      inPos = _mm256_permute2f128_ps(elem0, elem1, 0x20);
+      inNrm = _mm256_permute2f128_ps(elem0, elem1, 0x31);
+      weight = _mm256_shuffle_ps(inPos, inPos, _MM_SHUFFLE(3, 3, 3, 3));
+
+      // Evaluated in the same order as MatrixF::mulP / mulV
+      tempPos = _mm256_mul_ps(_mm256_shuffle_ps(inPos, inPos, _MM_SHUFFLE(0, 0, 0, 0)), avxMat[0]);
+      tempNrm = _mm256_mul_ps(_mm256_shuffle_ps(inNrm, inNrm, _MM_SHUFFLE(0, 0, 0, 0)), avxMat[0]);
+
+      tempPos = _mm256_add_ps(tempPos, _mm256_mul_ps(_mm256_shuffle_ps(inPos, inPos, _MM_SHUFFLE(1, 1, 1, 1)), avxMat[1]));
+      tempNrm = _mm256_add_ps(tempNrm, _mm256_mul_ps(_mm256_shuffle_ps(inNrm, inNrm, _MM_SHUFFLE(1, 1, 1, 1)), avxMat[1]));
+
+      tempPos = _mm256_add_ps(tempPos, _mm256_mul_ps(_mm256_shuffle_ps(inPos, inPos, _MM_SHUFFLE(2, 2, 2, 2)), avxMat[2]));
+      tempNrm = _mm256_add_ps(tempNrm, _mm256_mul_ps(_mm256_shuffle_ps(inNrm, inNrm, _MM_SHUFFLE(2, 2, 2, 2)), avxMat[2]));
+
+      tempPos = _mm256_add_ps(tempPos, avxMat[3]);
+
+      tempPos = _mm256_mul_ps(tempPos, weight);
+      tempNrm = _mm256_mul_ps(tempNrm, weight);
+
+      // Accumulate one vertex at a time, since both elements may refer to
+      // the same output vertex
+      _accumulateVertAVX(reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + batch[i].vidx * outStride),
+         _mm256_castps256_ps128(tempPos), _mm256_castps256_ps128(tempNrm));
+      _accumulateVertAVX(reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + batch[i + 1].vidx * outStride),
+         _mm256_extractf128_ps(tempPos, 1), _mm256_extractf128_ps(tempNrm, 1));
+   }
+
+   // Odd element
+   if(i < count)
+   {
+      const TSSkinMesh::BatchData::BatchedVertWeight &inElem = batch[i];
+
+      const __m128 pos = _mm_load_ps(inElem.vert);
+      const __m128 nrm = _mm_load_ps(inElem.normal);
+      const __m128 w = _mm_shuffle_ps(pos, pos, _MM_SHUFFLE(3, 3, 3, 3));
+
+      __m128 outPos = _mm_mul_ps(_mm_shuffle_ps(pos, pos, _MM_SHUFFLE(0, 0, 0, 0)), _mm256_castps256_ps128(avxMat[0]));
+      __m128 outNrm = _mm_mul_ps(_mm_shuffle_ps(nrm, nrm, _MM_SHUFFLE(0, 0, 0, 0)), _mm256_castps256_ps128(avxMat[0]));
+
+      outPos = _mm_add_ps(outPos, _mm_mul_ps(_mm_shuffle_ps(pos, pos, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_castps256_ps128(avxMat[1])));
+      outNrm = _mm_add_ps(outNrm, _mm_mul_ps(_mm_shuffle_ps(nrm, nrm, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_castps256_ps128(avxMat[1])));
+
+      outPos = _mm_add_ps(outPos, _mm_mul_ps(_mm_shuffle_ps(pos, pos, _MM_SHUFFLE(2, 2, 2, 2)), _mm256_castps256_ps128(avxMat[2])));
+      outNrm = _mm_add_ps(outNrm, _mm_mul_ps(_mm_shuffle_ps(nrm, nrm, _MM_SHUFFLE(2, 2, 2, 2)), _mm256_castps256_ps128(avxMat[2])));
+
+      outPos = _mm_add_ps(outPos, _mm256_castps256_ps128(avxMat[3]));
+
+      _accumulateVertAVX(reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + inElem.vidx * outStride),
+         _mm_mul_ps(outPos, w), _mm_mul_ps(outNrm, w));
+   }
+
+   _mm256_zeroupper();
+}
+
+//------------------------------------------------------------------------------
+
+TS_TARGET_AVX2 void m_matF_x_SoAVertWeightBlocks_AVX2(const MatrixF *matrices,
+                                    const dsize_t numBlocks,
+                                    const TSSkinMesh::BatchData::SoAInfluence * __restrict influences,
+                                    const S32 *blockStart,
+                                    const F32 * __restrict inStreams,
+                                    F32 * __restrict outStreams,
+                                    const dsize_t streamSize)
+{
+   const F32 *matBase = *matrices;
+   const __m256 vZero = _mm256_setzero_ps();
+   const __m256i vNoBone = _mm256_set1_epi32(-1);
+
+   for(dsize_t block = 0; block < numBlocks; block++)
+   {
+      const dsize_t base = block * TSSkinMesh::BatchData::soaBlockSize;
+
+      const __m256 inPX = _mm256_loadu_ps(inStreams + base);
+      const __m256 inPY = _mm256_loadu_ps(inStreams + base + streamSize);
+      const __m256 inPZ = _mm256_loadu_ps(inStreams + base + streamSize * 2);
+      const __m256 inNX = _mm256_loadu_ps(inStreams + base + streamSize * 3);
+      const __m256 inNY = _mm256_loadu_ps(inStreams + base + streamSize * 4);
+      const __m256 inNZ = _mm256_loadu_ps(inStreams + base + streamSize * 5);
+
+      __m256 accPX = vZero, accPY = vZero, accPZ = vZero;
+      __m256 accNX = vZero, accNY = vZero, accNZ = vZero;
+
+      for(S32 i = blockStart[block]; i < blockStart[block + 1]; i++)
+      {
+         const TSSkinMesh::BatchData::SoAInfluence &influence = influences[i];
+
+         // Lanes without an influence are neither gathered nor accumulated
+         const __m256i bone = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(influence.bone));
+         const __m256 mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(bone, vNoBone));
+         const __m256i row = _mm256_slli_epi32(bone, 4);
+         const __m256 w = _mm256_loadu_ps(influence.weight);
+
+#define GATHER_MAT(idx) _mm256_mask_i32gather_ps(vZero, matBase + idx, row, mask, 4)
+         const __m256 m0 = GATHER_MAT(0), m1 = GATHER_MAT(1), m2  = GATHER_MAT(2),  m3  = GATHER_MAT(3);
+         const __m256 m4 = GATHER_MAT(4), m5 = GATHER_MAT(5), m6  = GATHER_MAT(6),  m7  = GATHER_MAT(7);
+         const __m256 m8 = GATHER_MAT(8), m9 = GATHER_MAT(9), m10 = GATHER_MAT(10), m11 = GATHER_MAT(11);
+#undef GATHER_MAT
+
+         // Same evaluation order as MatrixF::mulP / mulV
+         __m256 t;
+         t = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, inPX), _mm256_mul_ps(m1, inPY)), _mm256_mul_ps(m2, inPZ)), m3);
+         accPX = _mm256_blendv_ps(accPX, _mm256_add_ps(accPX, _mm256_mul_ps(t, w)), mask);
+         t = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m4, inPX), _mm256_mul_ps(m5, inPY)), _mm256_mul_ps(m6, inPZ)), m7);
+         accPY = _mm256_blendv_ps(accPY, _mm256_add_ps(accPY, _mm256_mul_ps(t, w)), mask);
+         t = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m8, inPX), _mm256_mul_ps(m9, inPY)), _mm256_mul_ps(m10, inPZ)), m11);
+         accPZ = _mm256_blendv_ps(accPZ, _mm256_add_ps(accPZ, _mm256_mul_ps(t, w)), mask);
+
+         t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, inNX), _mm256_mul_ps(m1, inNY)), _mm256_mul_ps(m2, inNZ));
+         accNX = _mm256_blendv_ps(accNX, _mm256_add_ps(accNX, _mm256_mul_ps(t, w)), mask);
+         t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m4, inNX), _mm256_mul_ps(m5, inNY)), _mm256_mul_ps(m6, inNZ));
+         accNY = _mm256_blendv_ps(accNY, _mm256_add_ps(accNY, _mm256_mul_ps(t, w)), mask);
+         t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m8, inNX), _mm256_mul_ps(m9, inNY)), _mm256_mul_ps(m10, inNZ));
+         accNZ = _mm256_blendv_ps(accNZ, _mm256_add_ps(accNZ, _mm256_mul_ps(t, w)), mask);
+      }
+
+      _mm256_storeu_ps(outStreams + base, accPX);
+      _mm256_storeu_ps(outStreams + base + streamSize, accPY);
+      _mm256_storeu_ps(outStreams + base + streamSize * 2, accPZ);
+      _mm256_storeu_ps(outStreams + base + streamSize * 3, accNX);
+      _mm256_storeu_ps(outStreams + base + streamSize * 4, accNY);
+      _mm256_storeu_ps(outStreams + base + streamSize * 5, accNZ);
+   }
+
+   _mm256_zeroupper();
+}
+
+//------------------------------------------------------------------------------
+
+// Loads a Quat16 key as x, y, z, w floats
+static TS_TARGET_AVX2 inline __m128 _loadQuat16(const Quat16 &key)
+{
+   const __m128i v = _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(&key)));
+   return _mm_cvtepi32_ps(v);
+}
+
+// Transposes four (x, y, z, w) rows in each 128 bit lane
+#define TS_TRANSPOSE4_LANES(r0, r1, r2, r3) \
+   { \
+      const __m256 t0 = _mm256_unpacklo_ps(r0, r1); \
+      const __m256 t1 = _mm256_unpacklo_ps(r2, r3); \
+      const __m256 t2 = _mm256_unpackhi_ps(r0, r1); \
+      const __m256 t3 = _mm256_unpackhi_ps(r2, r3); \
+      r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0)); \
+      r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2)); \
+      r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0)); \
+      r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2)); \
+   }
+
+// Loads 8 Quat16 keys keyStride apart as x, y, z and w vectors
+static TS_TARGET_AVX2 inline void _loadQuat16x8(const Quat16 * __restrict keys, const dsize_t keyStride,
+                                                __m256 &x, __m256 &y, __m256 &z, __m256 &w)
+{
+   const __m256 vScale = _mm256_set1_ps(F32(Quat16::MAX_VAL));
+
+   // Key k goes in the low lane, key k+4 in the high lane
+   x = _mm256_insertf128_ps(_mm256_castps128_ps256(_loadQuat16(keys[0])), _loadQuat16(keys[keyStride * 4]), 1);
+   y = _mm256_insertf128_ps(_mm256_castps128_ps256(_loadQuat16(keys[keyStride])), _loadQuat16(keys[keyStride * 5]), 1);
+   z = _mm256_insertf128_ps(_mm256_castps128_ps256(_loadQuat16(keys[keyStride * 2])), _loadQuat16(keys[keyStride * 6]), 1);
+   w = _mm256_insertf128_ps(_mm256_castps128_ps256(_loadQuat16(keys[keyStride * 3])), _loadQuat16(keys[keyStride * 7]), 1);
+   TS_TRANSPOSE4_LANES(x, y, z, w);
+
+   x = _mm256_div_ps(x, vScale);
+   y = _mm256_div_ps(y, vScale);
+   z = _mm256_div_ps(z, vScale);
+   w = _mm256_div_ps(w, vScale);
+}
+
+TS_TARGET_AVX2 void m_quat16_nlerp_BatchedKeyList_AVX2(const dsize_t count,
+                                                       const Quat16 * __restrict keys1,
+                                                       const Quat16 * __restrict keys2,
+                                                       const dsize_t keyStride,
+                                                       const F32 t,
+                                                       QuatF * __restrict out)
+{
+   const __m256 vT = _mm256_set1_ps(t);
+   const __m256 vZero = _mm256_setzero_ps();
+   const __m256 vSign = _mm256_set1_ps(-0.0f);
+   const __m256 vSplit = _mm256_set1_ps(0.857f);
+
+   dsize_t i = 0;
+   for(; i + 8 <= count; i += 8)
+   {
+      __m256 x1, y1, z1, w1, x2, y2, z2, w2;
+      _loadQuat16x8(keys1 + i * keyStride, keyStride, x1, y1, z1, w1);
+      _loadQuat16x8(keys2 + i * keyStride, keyStride, x2, y2, z2, w2);
+
+      // Flip the first quaternion if they are further than 90 degrees apart
+      const __m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x1, x2), _mm256_mul_ps(y1, y2)), _mm256_mul_ps(z1, z2)), _mm256_mul_ps(w1, w2));
+      const __m256 flip = _mm256_and_ps(_mm256_cmp_ps(dot, vZero, _CMP_LT_OQ), vSign);
+      x1 = _mm256_xor_ps(x1, flip);
+      y1 = _mm256_xor_ps(y1, flip);
+      z1 = _mm256_xor_ps(z1, flip);
+      w1 = _mm256_xor_ps(w1, flip);
+
+      x1 = _mm256_add_ps(x1, _mm256_mul_ps(vT, _mm256_sub_ps(x2, x1)));
+      y1 = _mm256_add_ps(y1, _mm256_mul_ps(vT, _mm256_sub_ps(y2, y1)));
+      z1 = _mm256_add_ps(z1, _mm256_mul_ps(vT, _mm256_sub_ps(z2, z1)));
+      w1 = _mm256_add_ps(w1, _mm256_mul_ps(vT, _mm256_sub_ps(w2, w1)));
+
+      // Same 1/sqrt polynomial as TSTransform::interpolate
+      const __m256 dist2 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x1, x1), _mm256_mul_ps(y1, y1)), _mm256_mul_ps(z1, z1)), _mm256_mul_ps(w1, w1));
+      const __m256 lo = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.699368f), dist2), _mm256_set1_ps(-1.819985f)), dist2), _mm256_set1_ps(2.126369f));
+      const __m256 hi = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.454012f), dist2), _mm256_set1_ps(-1.403517f)), dist2), _mm256_set1_ps(1.949542f));
+      const __m256 oneOverL = _mm256_blendv_ps(hi, lo, _mm256_cmp_ps(dist2, vSplit, _CMP_LT_OQ));
+
+      x1 = _mm256_mul_ps(x1, oneOverL);
+      y1 = _mm256_mul_ps(y1, oneOverL);
+      z1 = _mm256_mul_ps(z1, oneOverL);
+      w1 = _mm256_mul_ps(w1, oneOverL);
+
+      TS_TRANSPOSE4_LANES(x1, y1, z1, w1);
+      _mm_storeu_ps(&out[i].x, _mm256_castps256_ps128(x1));
+      _mm_storeu_ps(&out[i + 1].x, _mm256_castps256_ps128(y1));
+      _mm_storeu_ps(&out[i + 2].x, _mm256_castps256_ps128(z1));
+      _mm_storeu_ps(&out[i + 3].x, _mm256_castps256_ps128(w1));
+      _mm_storeu_ps(&out[i + 4].x, _mm256_extractf128_ps(x1, 1));
+      _mm_storeu_ps(&out[i + 5].x, _mm256_extractf128_ps(y1, 1));
+      _mm_storeu_ps(&out[i + 6].x, _mm256_extractf128_ps(z1, 1));
+      _mm_storeu_ps(&out[i + 7].x, _mm256_extractf128_ps(w1, 1));
+   }
+
+   _mm256_zeroupper();
+
+   QuatF q1, q2;
+   for(; i < count; i++)
+   {
+      keys1[i * keyStride].getQuatF(&q1);
+      keys2[i * keyStride].getQuatF(&q2);
+      TSTransform::interpolate(q1, q2, t, &out[i]);
+   }
+}
+
+#undef TS_TRANSPOSE4_LANES
+
+//-----------------------------------------------------------------------------
+
+END_NS
+
+#endif // LIBDTSHAPE_TS_AVX_INTRINSICS
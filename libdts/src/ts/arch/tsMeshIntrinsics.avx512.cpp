@@ -0,0 +1,128 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "ts/tsMesh.h"
+#include "ts/tsMeshIntrinsics.h"
+#include "ts/arch/tsMeshIntrinsics.arch.h"
+
+#if defined(LIBDTSHAPE_TS_AVX_INTRINSICS)
+#include <immintrin.h>
+
+// AVX-512F implies FMA, so make sure the compiler does not fuse the
+// multiplies and adds below; the result must match the C version exactly.
+#if defined(LIBDTSHAPE_COMPILER_GCC) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+/// Accumulate a weighted position and normal into a vertex, leaving the
+/// 4th component of each (_tangentW and _tangent.x) untouched.
+static inline TS_TARGET_AVX512 void _accumulateVertAVX512(TSMesh::__TSMeshVertexBase *outElem, __m128 pos, __m128 nrm)
+{
+   __m128 outPos = _mm_load_ps(outElem->_vert);
+   __m128 outNrm = _mm_load_ps(outElem->_normal);
+
+   _mm_store_ps(outElem->_vert, _mm_blend_ps(_mm_add_ps(outPos, pos), outPos, 0x8));
+   _mm_store_ps(outElem->_normal, _mm_blend_ps(_mm_add_ps(outNrm, nrm), outNrm, 0x8));
+}
+
+TS_TARGET_AVX512 void m_matF_x_BatchedVertWeightList_AVX512(const MatrixF &mat, 
+                                    const dsize_t count,
+                                    const TSSkinMesh::BatchData::BatchedVertWeight * __restrict batch,
+                                    U8 * const __restrict outPtr,
+                                    const dsize_t outStride)
+{
+   const char * __restrict iPtr = reinterpret_cast<const char *>(batch);
+   const dsize_t inStride = sizeof(TSSkinMesh::BatchData::BatchedVertWeight);
+
+   // Load matrix columns, duplicated into all four 128-bit lanes so four
+   // batch elements are transformed at once
+   MatrixF transMat;
+   mat.transposeTo(transMat);
+
+   __m512 zmmMat[4];
+   zmmMat[0] = _mm512_broadcast_f32x4(_mm_loadu_ps(&transMat[0]));
+   zmmMat[1] = _mm512_broadcast_f32x4(_mm_loadu_ps(&transMat[4]));
+   zmmMat[2] = _mm512_broadcast_f32x4(_mm_loadu_ps(&transMat[8]));
+   zmmMat[3] = _mm512_broadcast_f32x4(_mm_loadu_ps(&transMat[12]));
+
+   __m512 inPos, inNrm, weight;
+   __m512 tempPos, tempNrm;
+
+   dsize_t i = 0;
+   for(; i + 4 <= count; i += 4)
+   {
+      // Each load covers two {vert, weight, normal, vidx} elements
+      const __m512 elem01 = _mm512_loadu_ps(reinterpret_cast<const F32 *>(iPtr + inStride * i));
+      const __m512 elem23 = _mm512_loadu_ps(reinterpret_cast<const F32 *>(iPtr + inStride * (i + 2)));
+
+      _mm_prefetch(iPtr + inStride * (i + 32), _MM_HINT_T0);
+
+      inPos = _mm512_shuffle_f32x4(elem01, elem23, _MM_SHUFFLE(2, 0, 2, 0));
+      inNrm = _mm512_shuffle_f32x4(elem01, elem23, _MM_SHUFFLE(3, 1, 3, 1));
+      weight = _mm512_shuffle_ps(inPos, inPos, _MM_SHUFFLE(3, 3, 3, 3));
+
+      // Evaluated in the same order as MatrixF::mulP / mulV
+      tempPos = _mm512_mul_ps(_mm512_shuffle_ps(inPos, inPos, _MM_SHUFFLE(0, 0, 0, 0)), zmmMat[0]);
+      tempNrm = _mm512_mul_ps(_mm512_shuffle_ps(inNrm, inNrm, _MM_SHUFFLE(0, 0, 0, 0)), zmmMat[0]);
+
+      tempPos = _mm512_add_ps(tempPos, _mm512_mul_ps(_mm512_shuffle_ps(inPos, inPos, _MM_SHUFFLE(1, 1, 1, 1)), zmmMat[1]));
+      tempNrm = _mm512_add_ps(tempNrm, _mm512_mul_ps(_mm512_shuffle_ps(inNrm, inNrm, _MM_SHUFFLE(1, 1, 1, 1)), zmmMat[1]));
+
+      tempPos = _mm512_add_ps(tempPos, _mm512_mul_ps(_mm512_shuffle_ps(inPos, inPos, _MM_SHUFFLE(2, 2, 2, 2)), zmmMat[2]));
+      tempNrm = _mm512_add_ps(tempNrm, _mm512_mul_ps(_mm512_shuffle_ps(inNrm, inNrm, _MM_SHUFFLE(2, 2, 2, 2)), zmmMat[2]));
+
+      tempPos = _mm512_add_ps(tempPos, zmmMat[3]);
+
+      tempPos = _mm512_mul_ps(tempPos, weight);
+      tempNrm = _mm512_mul_ps(tempNrm, weight);
+
+      // Accumulate one vertex at a time, since elements may share a vertex
+      _accumulateVertAVX512(reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + batch[i].vidx * outStride),
+         _mm512_castps512_ps128(tempPos), _mm512_castps512_ps128(tempNrm));
+      _accumulateVertAVX512(reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + batch[i + 1].vidx * outStride),
+         _mm512_extractf32x4_ps(tempPos, 1), _mm512_extractf32x4_ps(tempNrm, 1));
+      _accumulateVertAVX512(reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + batch[i + 2].vidx * outStride),
+         _mm512_extractf32x4_ps(tempPos, 2), _mm512_extractf32x4_ps(tempNrm, 2));
+      _accumulateVertAVX512(reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + batch[i + 3].vidx * outStride),
+         _mm512_extractf32x4_ps(tempPos, 3), _mm512_extractf32x4_ps(tempNrm, 3));
+   }
+
+   _mm256_zeroupper();
+
+   // Remaining elements
+   if(i < count)
+      m_matF_x_BatchedVertWeightList_AVX2(mat, count - i, batch + i, outPtr, outStride);
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
+
+#endif // LIBDTSHAPE_TS_AVX_INTRINSICS
@@ -21,7 +21,7 @@
 //-----------------------------------------------------------------------------
 #include "ts/tsMesh.h"
 
-#if defined(LIBDTSHAPE_CPU_X86)
+#if defined(LIBDTSHAPE_CPU_X86) || defined(LIBDTSHAPE_CPU_X86_64)
 #include "ts/tsMeshIntrinsics.h"
 #include <xmmintrin.h>
 
@@ -34,11 +34,11 @@ BEGIN_NS(DTShape)
 void zero_vert_normal_bulk_SSE(const dsize_t count, U8 * __restrict const outPtr, const dsize_t outStride)
 {
    // A U8 * version of the in/out pointer
-   register char *outData = reinterpret_cast<char *>(outPtr);
+   char *outData = reinterpret_cast<char *>(outPtr);
    
-   register __m128 vPos;
-   register __m128 vNrm;
-   register __m128 vMask;
+   __m128 vPos;
+   __m128 vNrm;
+   __m128 vMask;
 
    const __m128 _point3f_zero_mask = { 0.0f, 0.0f, 0.0f, 1.0f };
    vMask = _mm_load_ps((const F32*)&_point3f_zero_mask);
@@ -47,7 +47,7 @@ void zero_vert_normal_bulk_SSE(const dsize_t count, U8 * __restrict const outPtr
    for(int i = 0; i < 8; i++)
       _mm_prefetch(reinterpret_cast<const char *>(outData +  outStride * i), _MM_HINT_T0);
 
-   for(int i = 0; i < count; i++)
+   for(dsize_t i = 0; i < count; i++)
    {
       TSMesh::__TSMeshVertexBase *curElem = reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outData);
 
@@ -88,7 +88,7 @@ void m_matF_x_BatchedVertWeightList_SSE(const MatrixF &mat,
    // Load matrix, transposed, into registers
    MatrixF transMat;
    mat.transposeTo(transMat);
-   register __m128 sseMat[4];
+   __m128 sseMat[4];
 
    sseMat[0] = _mm_loadu_ps(&transMat[0]);
    sseMat[1] = _mm_loadu_ps(&transMat[4]);
@@ -99,12 +99,12 @@ void m_matF_x_BatchedVertWeightList_SSE(const MatrixF &mat,
    const __m128 _w_mask = { 1.0f, 1.0f, 1.0f, 0.0f };
 
    // temp registers
-   register __m128 tempPos;
-   register __m128 tempNrm;
-   register __m128 scratch0;
-   register __m128 scratch1;
-   register __m128 inPos;
-   register __m128 inNrm;
+   __m128 tempPos;
+   __m128 tempNrm;
+   __m128 scratch0;
+   __m128 scratch1;
+   __m128 inPos;
+   __m128 inNrm;
 
    // pre-populate cache
    const TSSkinMesh::BatchData::BatchedVertWeight &firstElem = batch[0];
@@ -114,7 +114,7 @@ void m_matF_x_BatchedVertWeightList_SSE(const MatrixF &mat,
       _mm_prefetch(reinterpret_cast<const char *>(outPtr +  outStride * (i + firstElem.vidx)), _MM_HINT_T0);
    }
 
-   for(register int i = 0; i < count; i++)
+   for(dsize_t i = 0; i < count; i++)
    {
       const TSSkinMesh::BatchData::BatchedVertWeight &inElem = batch[i];
       TSMesh::__TSMeshVertexBase *outElem = reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + inElem.vidx * outStride);
@@ -186,6 +186,266 @@ void m_matF_x_BatchedVertWeightList_SSE(const MatrixF &mat,
    }
 }
 
+//------------------------------------------------------------------------------
+
+void m_matF_x_BatchedVertex4List_SSE(const MatrixF *matrices,
+                                    const dsize_t count,
+                                    const TSSkinMesh::BatchData::BatchedVertex4 * __restrict batch,
+                                    U8 * const __restrict outPtr,
+                                    const dsize_t outStride)
+{
+   const __m128 _w_one = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+   __m128 row0, row1, row2, row3;
+   __m128 weight, inPos, inNrm, tempPos, tempNrm;
+
+   for(dsize_t i = 0; i < count; i++)
+   {
+      const TSSkinMesh::BatchData::BatchedVertex4 &inElem = batch[i];
+      TSMesh::__TSMeshVertexBase *outElem = reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + inElem.vidx * outStride);
+
+      // prefetch the next element's output
+      _mm_prefetch(reinterpret_cast<const char *>(outPtr + inElem.vidx * outStride + outStride * 4), _MM_HINT_T0);
+
+      // Blend the top 3 rows of the influencing transforms
+      row0 = row1 = row2 = _mm_setzero_ps();
+      for(int k = 0; k < inElem.transformCount; k++)
+      {
+         const F32 *mat = matrices[inElem.transformIndex[k]];
+         weight = _mm_set1_ps(inElem.weight[k]);
+
+         row0 = _mm_add_ps(row0, _mm_mul_ps(_mm_loadu_ps(mat + 0), weight));
+         row1 = _mm_add_ps(row1, _mm_mul_ps(_mm_loadu_ps(mat + 4), weight));
+         row2 = _mm_add_ps(row2, _mm_mul_ps(_mm_loadu_ps(mat + 8), weight));
+      }
+
+      // Transpose into columns, row3 becomes the translation column
+      row3 = _w_one;
+      _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+      inPos = _mm_loadu_ps(inElem.vert);
+      inNrm = _mm_loadu_ps(inElem.normal);
+
+      tempPos = _mm_mul_ps(_mm_shuffle_ps(inPos, inPos, _MM_SHUFFLE(0, 0, 0, 0)), row0);
+      tempNrm = _mm_mul_ps(_mm_shuffle_ps(inNrm, inNrm, _MM_SHUFFLE(0, 0, 0, 0)), row0);
+
+      tempPos = _mm_add_ps(tempPos, _mm_mul_ps(_mm_shuffle_ps(inPos, inPos, _MM_SHUFFLE(1, 1, 1, 1)), row1));
+      tempNrm = _mm_add_ps(tempNrm, _mm_mul_ps(_mm_shuffle_ps(inNrm, inNrm, _MM_SHUFFLE(1, 1, 1, 1)), row1));
+
+      tempPos = _mm_add_ps(tempPos, _mm_mul_ps(_mm_shuffle_ps(inPos, inPos, _MM_SHUFFLE(2, 2, 2, 2)), row2));
+      tempNrm = _mm_add_ps(tempNrm, _mm_mul_ps(_mm_shuffle_ps(inNrm, inNrm, _MM_SHUFFLE(2, 2, 2, 2)), row2));
+
+      tempPos = _mm_add_ps(tempPos, row3);
+
+      // Write x, y and z only, leaving _tangentW and _tangent.x alone
+      _mm_storel_pi(reinterpret_cast<__m64 *>(&outElem->_vert.x), tempPos);
+      _mm_store_ss(&outElem->_vert.z, _mm_movehl_ps(tempPos, tempPos));
+      _mm_storel_pi(reinterpret_cast<__m64 *>(&outElem->_normal.x), tempNrm);
+      _mm_store_ss(&outElem->_normal.z, _mm_movehl_ps(tempNrm, tempNrm));
+   }
+}
+
+//------------------------------------------------------------------------------
+
+// Loads 4 Quat16 keys keyStride apart as x, y, z and w vectors
+static inline void _loadQuat16x4(const Quat16 * __restrict keys, const dsize_t keyStride,
+                                 __m128 &x, __m128 &y, __m128 &z, __m128 &w)
+{
+   const __m128 vScale = _mm_set_ps1(F32(Quat16::MAX_VAL));
+
+   const Quat16 &k0 = keys[0];
+   const Quat16 &k1 = keys[keyStride];
+   const Quat16 &k2 = keys[keyStride * 2];
+   const Quat16 &k3 = keys[keyStride * 3];
+   x = _mm_set_ps(F32(k3.x), F32(k2.x), F32(k1.x), F32(k0.x));
+   y = _mm_set_ps(F32(k3.y), F32(k2.y), F32(k1.y), F32(k0.y));
+   z = _mm_set_ps(F32(k3.z), F32(k2.z), F32(k1.z), F32(k0.z));
+   w = _mm_set_ps(F32(k3.w), F32(k2.w), F32(k1.w), F32(k0.w));
+
+   x = _mm_div_ps(x, vScale);
+   y = _mm_div_ps(y, vScale);
+   z = _mm_div_ps(z, vScale);
+   w = _mm_div_ps(w, vScale);
+}
+
+void m_quat16_nlerp_BatchedKeyList_SSE(const dsize_t count,
+                                       const Quat16 * __restrict keys1,
+                                       const Quat16 * __restrict keys2,
+                                       const dsize_t keyStride,
+                                       const F32 t,
+                                       QuatF * __restrict out)
+{
+   const __m128 vT = _mm_set_ps1(t);
+   const __m128 vZero = _mm_setzero_ps();
+   const __m128 vSign = _mm_set_ps1(-0.0f);
+   const __m128 vSplit = _mm_set_ps1(0.857f);
+
+   dsize_t i = 0;
+   for(; i + 4 <= count; i += 4)
+   {
+      __m128 x1, y1, z1, w1, x2, y2, z2, w2;
+      _loadQuat16x4(keys1 + i * keyStride, keyStride, x1, y1, z1, w1);
+      _loadQuat16x4(keys2 + i * keyStride, keyStride, x2, y2, z2, w2);
+
+      // Flip the first quaternion if they are further than 90 degrees apart
+      __m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x1, x2), _mm_mul_ps(y1, y2)), _mm_mul_ps(z1, z2)), _mm_mul_ps(w1, w2));
+      const __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, vZero), vSign);
+      x1 = _mm_xor_ps(x1, flip);
+      y1 = _mm_xor_ps(y1, flip);
+      z1 = _mm_xor_ps(z1, flip);
+      w1 = _mm_xor_ps(w1, flip);
+
+      x1 = _mm_add_ps(x1, _mm_mul_ps(vT, _mm_sub_ps(x2, x1)));
+      y1 = _mm_add_ps(y1, _mm_mul_ps(vT, _mm_sub_ps(y2, y1)));
+      z1 = _mm_add_ps(z1, _mm_mul_ps(vT, _mm_sub_ps(z2, z1)));
+      w1 = _mm_add_ps(w1, _mm_mul_ps(vT, _mm_sub_ps(w2, w1)));
+
+      // Same 1/sqrt polynomial as TSTransform::interpolate
+      const __m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x1, x1), _mm_mul_ps(y1, y1)), _mm_mul_ps(z1, z1)), _mm_mul_ps(w1, w1));
+      const __m128 lo = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set_ps1(0.699368f), dist2), _mm_set_ps1(-1.819985f)), dist2), _mm_set_ps1(2.126369f));
+      const __m128 hi = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set_ps1(0.454012f), dist2), _mm_set_ps1(-1.403517f)), dist2), _mm_set_ps1(1.949542f));
+      const __m128 useLo = _mm_cmplt_ps(dist2, vSplit);
+      const __m128 oneOverL = _mm_or_ps(_mm_and_ps(useLo, lo), _mm_andnot_ps(useLo, hi));
+
+      x1 = _mm_mul_ps(x1, oneOverL);
+      y1 = _mm_mul_ps(y1, oneOverL);
+      z1 = _mm_mul_ps(z1, oneOverL);
+      w1 = _mm_mul_ps(w1, oneOverL);
+
+      _MM_TRANSPOSE4_PS(x1, y1, z1, w1);
+      _mm_storeu_ps(&out[i].x, x1);
+      _mm_storeu_ps(&out[i + 1].x, y1);
+      _mm_storeu_ps(&out[i + 2].x, z1);
+      _mm_storeu_ps(&out[i + 3].x, w1);
+   }
+
+   QuatF q1, q2;
+   for(; i < count; i++)
+   {
+      keys1[i * keyStride].getQuatF(&q1);
+      keys2[i * keyStride].getQuatF(&q2);
+      TSTransform::interpolate(q1, q2, t, &out[i]);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+void m_quatF_point3F_x_matF_BatchedList_SSE(const dsize_t count,
+                                            const QuatF * __restrict rots,
+                                            const Point3F * __restrict trans,
+                                            MatrixF * __restrict out)
+{
+   const __m128 vOne = _mm_set_ps1(1.0f);
+   const __m128 vTwo = _mm_set_ps1(2.0f);
+   const __m128 vIdentityEpsilon = _mm_set_ps1(10E-20f);
+   const __m128 vRow3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+   dsize_t i = 0;
+   for(; i + 4 <= count; i += 4)
+   {
+      __m128 x = _mm_loadu_ps(&rots[i].x);
+      __m128 y = _mm_loadu_ps(&rots[i + 1].x);
+      __m128 z = _mm_loadu_ps(&rots[i + 2].x);
+      __m128 w = _mm_loadu_ps(&rots[i + 3].x);
+      _MM_TRANSPOSE4_PS(x, y, z, w);
+
+      // Same evaluation order as m_quatF_set_matF_C
+      const __m128 xs = _mm_mul_ps(x, vTwo);
+      const __m128 ys = _mm_mul_ps(y, vTwo);
+      const __m128 zs = _mm_mul_ps(z, vTwo);
+      const __m128 wx = _mm_mul_ps(w, xs);
+      const __m128 wy = _mm_mul_ps(w, ys);
+      const __m128 wz = _mm_mul_ps(w, zs);
+      const __m128 xx = _mm_mul_ps(x, xs);
+      const __m128 xy = _mm_mul_ps(x, ys);
+      const __m128 xz = _mm_mul_ps(x, zs);
+      const __m128 yy = _mm_mul_ps(y, ys);
+      const __m128 yz = _mm_mul_ps(y, zs);
+      const __m128 zz = _mm_mul_ps(z, zs);
+
+      // QuatF::setMatrix uses the identity for (near) zero rotation axes
+      const __m128 ident = _mm_cmplt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)), vIdentityEpsilon);
+      const __m128 identOne = _mm_and_ps(ident, vOne);
+
+      __m128 r0 = _mm_or_ps(identOne, _mm_andnot_ps(ident, _mm_sub_ps(vOne, _mm_add_ps(yy, zz))));
+      __m128 r1 = _mm_andnot_ps(ident, _mm_add_ps(xy, wz));
+      __m128 r2 = _mm_andnot_ps(ident, _mm_sub_ps(xz, wy));
+      __m128 r3 = _mm_set_ps(trans[i + 3].x, trans[i + 2].x, trans[i + 1].x, trans[i].x);
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(&((F32 *)out[i])[0], r0);
+      _mm_storeu_ps(&((F32 *)out[i + 1])[0], r1);
+      _mm_storeu_ps(&((F32 *)out[i + 2])[0], r2);
+      _mm_storeu_ps(&((F32 *)out[i + 3])[0], r3);
+
+      r0 = _mm_andnot_ps(ident, _mm_sub_ps(xy, wz));
+      r1 = _mm_or_ps(identOne, _mm_andnot_ps(ident, _mm_sub_ps(vOne, _mm_add_ps(xx, zz))));
+      r2 = _mm_andnot_ps(ident, _mm_add_ps(yz, wx));
+      r3 = _mm_set_ps(trans[i + 3].y, trans[i + 2].y, trans[i + 1].y, trans[i].y);
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(&((F32 *)out[i])[4], r0);
+      _mm_storeu_ps(&((F32 *)out[i + 1])[4], r1);
+      _mm_storeu_ps(&((F32 *)out[i + 2])[4], r2);
+      _mm_storeu_ps(&((F32 *)out[i + 3])[4], r3);
+
+      r0 = _mm_andnot_ps(ident, _mm_add_ps(xz, wy));
+      r1 = _mm_andnot_ps(ident, _mm_sub_ps(yz, wx));
+      r2 = _mm_or_ps(identOne, _mm_andnot_ps(ident, _mm_sub_ps(vOne, _mm_add_ps(xx, yy))));
+      r3 = _mm_set_ps(trans[i + 3].z, trans[i + 2].z, trans[i + 1].z, trans[i].z);
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(&((F32 *)out[i])[8], r0);
+      _mm_storeu_ps(&((F32 *)out[i + 1])[8], r1);
+      _mm_storeu_ps(&((F32 *)out[i + 2])[8], r2);
+      _mm_storeu_ps(&((F32 *)out[i + 3])[8], r3);
+
+      _mm_storeu_ps(&((F32 *)out[i])[12], vRow3);
+      _mm_storeu_ps(&((F32 *)out[i + 1])[12], vRow3);
+      _mm_storeu_ps(&((F32 *)out[i + 2])[12], vRow3);
+      _mm_storeu_ps(&((F32 *)out[i + 3])[12], vRow3);
+   }
+
+   for(; i < count; i++)
+      TSTransform::setMatrix(rots[i], trans[i], &out[i]);
+}
+
+//------------------------------------------------------------------------------
+
+void m_matF_x_matF_NodeList_SSE(const dsize_t count,
+                                const S32 * __restrict nodes,
+                                const S32 * __restrict parents,
+                                const MatrixF * __restrict local,
+                                MatrixF * world)
+{
+   const __m128 vRow3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+   for(dsize_t i = 0; i < count; i++)
+   {
+      const S32 node = nodes[i];
+      if (parents[i] < 0)
+      {
+         world[node] = local[node];
+         continue;
+      }
+
+      const F32 *a = world[parents[i]];
+      const F32 *b = local[node];
+      F32 *m = world[node];
+
+      const __m128 b0 = _mm_loadu_ps(b);
+      const __m128 b1 = _mm_loadu_ps(b + 4);
+      const __m128 b2 = _mm_loadu_ps(b + 8);
+      for(S32 r = 0; r < 12; r += 4)
+      {
+         __m128 row = _mm_add_ps(_mm_mul_ps(_mm_set_ps1(a[r]), b0), _mm_mul_ps(_mm_set_ps1(a[r + 1]), b1));
+         row = _mm_add_ps(row, _mm_mul_ps(_mm_set_ps1(a[r + 2]), b2));
+         // Adding -0 leaves the first three columns alone, so they come out
+         // the same as m_matF_x_matF_NodeList_C
+         row = _mm_add_ps(row, _mm_set_ps(a[r + 3], -0.0f, -0.0f, -0.0f));
+         _mm_storeu_ps(m + r, row);
+      }
+      _mm_storeu_ps(m + 12, vRow3);
+   }
+}
+
 //-----------------------------------------------------------------------------
 
 END_NS
@@ -21,6 +21,7 @@
 //-----------------------------------------------------------------------------
 
 #include "ts/tsShapeInstance.h"
+#include "ts/tsMeshIntrinsics.h"
 #include "platform/profiler.h"
 
 //-----------------------------------------------------------------------------
@@ -75,12 +76,47 @@ void TSShapeInstance::animateNodes(S32 ss)
    // @todo: When a node is added, we need to make sure to resize the nodeTransforms array as well
    mNodeTransforms.setSize(mShape->nodes.size());
 
+   // Skins need updating with the new transforms
+   mAnimationGeneration++;
+
    // temporary storage for node transforms
-   mCurrentRenderState->smNodeCurrentRotations.setSize(mShape->nodes.size());
-   mCurrentRenderState->smNodeCurrentTranslations.setSize(mShape->nodes.size());
-   mCurrentRenderState->smNodeLocalTransforms.setSize(mShape->nodes.size());
-   mCurrentRenderState->smRotationThreads.setSize(mShape->nodes.size());
-   mCurrentRenderState->smTranslationThreads.setSize(mShape->nodes.size());
+   TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+   scratch.reserve(mShape->nodes.size());
+
+   S32 i,j,nodeIndex,start,end,firstBlend = mThreadList.size();
+   S32 a = mShape->subShapeFirstNode[ss];
+   S32 b = a + mShape->subShapeNumNodes[ss];
+
+   // every node of the subshape is about to be updated
+   for (i=mDirtyNodes.start(); i<b; mDirtyNodes.next(i))
+   {
+      if (i>=a)
+         mDirtyNodes.clear(i);
+   }
+   for (i=mPendingNodes.start(); i<b; mPendingNodes.next(i))
+   {
+      if (i>=a)
+         mPendingNodes.clear(i);
+   }
+
+   // another instance may have worked out this pose already
+   mNodeLocalTransforms.setSize(mShape->nodes.size());
+   TSPoseCache::Key poseKey;
+   TSPoseCache * poseCache = mShape->getPoseCache();
+   if (poseCache && !buildPoseCacheKey(ss,poseKey))
+      poseCache = NULL;
+   if (poseCache && poseCache->fetch(poseKey,a,b-a,mNodeTransforms.address(),mNodeLocalTransforms.address()))
+   {
+      // a transition started later picks up from the scratch rotations and
+      // translations, so recover them from the cached local transforms
+      for (i=a; i<b; i++)
+      {
+         scratch.nodeCurrentRotations[i].set(mNodeLocalTransforms[i]);
+         scratch.nodeCurrentTranslations[i] = mNodeLocalTransforms[i].getPosition();
+      }
+      scratch.nodeLocalTransformDirty.clearAll();
+      return;
+   }
 
    TSIntegerSet rotBeenSet;
    TSIntegerSet tranBeenSet;
@@ -88,9 +124,8 @@ void TSShapeInstance::animateNodes(S32 ss)
    rotBeenSet.setAll(mShape->nodes.size());
    tranBeenSet.setAll(mShape->nodes.size());
    scaleBeenSet.setAll(mShape->nodes.size());
-   mCurrentRenderState->smNodeLocalTransformDirty.clearAll();
+   scratch.nodeLocalTransformDirty.clearAll();
 
-   S32 i,j,nodeIndex,a,b,start,end,firstBlend = mThreadList.size();
    for (i=0; i<mThreadList.size(); i++)
    {
       TSThread * th = mThreadList[i];
@@ -121,19 +156,17 @@ void TSShapeInstance::animateNodes(S32 ss)
    // we'll set default regardless of mask status
 
    // all the nodes marked above need to have the default transform
-   a = mShape->subShapeFirstNode[ss];
-   b = a + mShape->subShapeNumNodes[ss];
    for (i=a; i<b; i++)
    {
       if (rotBeenSet.test(i))
       {
-         mShape->defaultRotations[i].getQuatF(&mCurrentRenderState->smNodeCurrentRotations[i]);
-         mCurrentRenderState->smRotationThreads[i] = NULL;
+         mShape->defaultRotations[i].getQuatF(&scratch.nodeCurrentRotations[i]);
+         scratch.rotationThreads[i] = NULL;
       }
       if (tranBeenSet.test(i))
       {
-         mCurrentRenderState->smNodeCurrentTranslations[i] = mShape->defaultTranslations[i];
-         mCurrentRenderState->smTranslationThreads[i] = NULL;
+         scratch.nodeCurrentTranslations[i] = mShape->defaultTranslations[i];
+         scratch.translationThreads[i] = NULL;
       }
    }
 
@@ -152,30 +185,41 @@ void TSShapeInstance::animateNodes(S32 ss)
    for (i=0; i<firstBlend; i++)
    {
       TSThread * th = mThreadList[i];
+      const TSShape::Sequence * seq = th->getSequence();
+
+      // poses shared through the cache are sampled at the key position the
+      // cache quantized to, so every instance computes the same one
+      const F32 keyPos = poseCache ? TSPoseCache::snapKeyPos(th->keyPos) : th->keyPos;
+
+      // sample all the tracks of nodes in this detail in one go
+      S32 firstTrack = seq->rotationMatters.count(a);
+      mShape->sampleRotations(*seq,th->keyNum1,th->keyNum2,keyPos,firstTrack,
+                              seq->rotationMatters.count(b)-firstTrack,scratch.trackRotations);
 
       j=0;
-      start = th->getSequence()->rotationMatters.start();
+      start = seq->rotationMatters.start();
       end   = b;
-      for (nodeIndex=start; nodeIndex<end; th->getSequence()->rotationMatters.next(nodeIndex), j++)
+      for (nodeIndex=start; nodeIndex<end; seq->rotationMatters.next(nodeIndex), j++)
       {
          // skip nodes outside of this detail
          if (nodeIndex<a)
             continue;
          if (!rotBeenSet.test(nodeIndex))
          {
-            QuatF q1,q2;
-            mShape->getRotation(*th->getSequence(),th->keyNum1,j,&q1);
-            mShape->getRotation(*th->getSequence(),th->keyNum2,j,&q2);
-            TSTransform::interpolate(q1,q2,th->keyPos,&mCurrentRenderState->smNodeCurrentRotations[nodeIndex]);
+            scratch.nodeCurrentRotations[nodeIndex] = scratch.trackRotations[j-firstTrack];
             rotBeenSet.set(nodeIndex);
-            mCurrentRenderState->smRotationThreads[nodeIndex] = th;
+            scratch.rotationThreads[nodeIndex] = th;
          }
       }
 
+      firstTrack = seq->translationMatters.count(a);
+      mShape->sampleTranslations(*seq,th->keyNum1,th->keyNum2,keyPos,firstTrack,
+                                 seq->translationMatters.count(b)-firstTrack,scratch.trackTranslations);
+
       j=0;
-      start = th->getSequence()->translationMatters.start();
+      start = seq->translationMatters.start();
       end   = b;
-      for (nodeIndex=start; nodeIndex<end; th->getSequence()->translationMatters.next(nodeIndex), j++)
+      for (nodeIndex=start; nodeIndex<end; seq->translationMatters.next(nodeIndex), j++)
       {
          if (nodeIndex<a)
             continue;
@@ -185,10 +229,8 @@ void TSShapeInstance::animateNodes(S32 ss)
                handleMaskedPositionNode(th,nodeIndex,j);
             else
             {
-               const Point3F & p1 = mShape->getTranslation(*th->getSequence(),th->keyNum1,j);
-               const Point3F & p2 = mShape->getTranslation(*th->getSequence(),th->keyNum2,j);
-               TSTransform::interpolate(p1,p2,th->keyPos,&mCurrentRenderState->smNodeCurrentTranslations[nodeIndex]);
-               mCurrentRenderState->smTranslationThreads[nodeIndex] = th;
+               scratch.nodeCurrentTranslations[nodeIndex] = scratch.trackTranslations[j-firstTrack];
+               scratch.translationThreads[nodeIndex] = th;
             }
             tranBeenSet.set(nodeIndex);
          }
@@ -199,12 +241,11 @@ void TSShapeInstance::animateNodes(S32 ss)
    }
 
    // compute transforms
-   for (i=a; i<b; i++)
+   m_quatF_point3F_x_matF_BatchedList(b-a,&scratch.nodeCurrentRotations[a],&scratch.nodeCurrentTranslations[a],&scratch.nodeLocalTransforms[a]);
+   for (i=mHandsOffNodes.start(); i<b; mHandsOffNodes.next(i))
    {
-      if (!mHandsOffNodes.test(i))
-         TSTransform::setMatrix(mCurrentRenderState->smNodeCurrentRotations[i],mCurrentRenderState->smNodeCurrentTranslations[i],&mCurrentRenderState->smNodeLocalTransforms[i]);
-      else
-         mCurrentRenderState->smNodeLocalTransforms[i] = mNodeTransforms[i];     // in case mNodeTransform was changed externally
+      if (i>=a)
+         scratch.nodeLocalTransforms[i] = mNodeTransforms[i];     // in case mNodeTransform was changed externally
    }
 
    // add scale onto transforms
@@ -220,8 +261,9 @@ void TSShapeInstance::animateNodes(S32 ss)
       S32 nodeIndex = mNodeCallbacks[i].nodeIndex;
       if (nodeIndex>=start && nodeIndex<end)
       {
-         mNodeCallbacks[i].callback->setNodeTransform(this, nodeIndex, mCurrentRenderState->smNodeLocalTransforms[nodeIndex]);
-         mCurrentRenderState->smNodeLocalTransformDirty.set(nodeIndex);
+         mNodeCallbacks[i].baseTransform = scratch.nodeLocalTransforms[nodeIndex];
+         mNodeCallbacks[i].callback->setNodeTransform(this, nodeIndex, scratch.nodeLocalTransforms[nodeIndex]);
+         scratch.nodeLocalTransformDirty.set(nodeIndex);
       }
    }
 
@@ -229,10 +271,10 @@ void TSShapeInstance::animateNodes(S32 ss)
    for (i=firstBlend; i<mThreadList.size(); i++)
    {
       TSThread * th = mThreadList[i];
-      if (th->blendDisabled)
+      if (th->blendDisabled || mAnimationLOD >= smAnimationLODSkipBlends)
          continue;
 
-      handleBlendSequence(th,a,b);
+      handleBlendSequence(th,a,b,poseCache ? TSPoseCache::snapKeyPos(th->keyPos) : th->keyPos);
    }
 
    // transitions...
@@ -240,14 +282,145 @@ void TSShapeInstance::animateNodes(S32 ss)
       handleTransitionNodes(a,b);
 
    // multiply transforms...
-   for (i=a; i<b; i++)
+   concatNodeTransforms(ss,scratch.nodeLocalTransforms);
+
+   // keep the local transforms around for animateDirtyNodes
+   dMemcpy(&mNodeLocalTransforms[a],&scratch.nodeLocalTransforms[a],(b-a)*sizeof(MatrixF));
+
+   if (poseCache)
+      poseCache->store(poseKey,a,b-a,mNodeTransforms.address(),mNodeLocalTransforms.address());
+}
+
+bool TSShapeInstance::buildPoseCacheKey(S32 ss, TSPoseCache::Key & key)
+{
+   // nodes driven from outside the threads make the pose unique to this instance
+   // nor can animated scale be recovered from a cached pose for transitions
+   if (inTransition() || scaleCurrentlyAnimated() ||
+       mHandsOffNodes.testAll() || mCallbackNodes.testAll() || mDisableBlendNodes.testAll() ||
+       mMaskRotationNodes.testAll() || mMaskPosXNodes.testAll() || mMaskPosYNodes.testAll() || mMaskPosZNodes.testAll())
+      return false;
+
+   key.subShape = ss;
+   key.numThreads = 0;
+   for (S32 i=0; i<mThreadList.size(); i++)
    {
-      S32 parentIdx = mShape->nodes[i].parentIndex;
-      if (parentIdx < 0)
-         mNodeTransforms[i] = mCurrentRenderState->smNodeLocalTransforms[i];
-      else
-         mNodeTransforms[i].mul(mNodeTransforms[parentIdx],mCurrentRenderState->smNodeLocalTransforms[i]);
+      TSThread * th = mThreadList[i];
+      if (th->getSequence()->isBlend() && (th->blendDisabled || mAnimationLOD >= smAnimationLODSkipBlends))
+         continue;
+      if (key.numThreads == TSPoseCache::MaxThreads)
+         return false;
+
+      TSPoseCache::ThreadKey & threadKey = key.threads[key.numThreads++];
+      threadKey.sequence = th->sequence;
+      threadKey.keyNum1 = th->keyNum1;
+      threadKey.keyNum2 = th->keyNum2;
+      threadKey.keyPos = TSPoseCache::quantizeKeyPos(th->keyPos);
+   }
+
+   key.computeHash();
+   return true;
+}
+
+void TSShapeInstance::animateDirtyNodes(S32 ss)
+{
+   PROFILE_SCOPE( TSShapeInstance_animateDirtyNodes );
+
+   S32 a = mShape->subShapeFirstNode[ss];
+   S32 b = a + mShape->subShapeNumNodes[ss];
+
+   // transitions are computed from the thread state, so they can't be
+   // picked up where the last update left off
+   if (inTransition() || mNodeLocalTransforms.size() < b)
+   {
+      animateNodes(ss);
+      return;
+   }
+
+   TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+   scratch.reserve(mShape->nodes.size());
+
+   S32 i;
+   TSIntegerSet dirty = mDirtyNodes;
+   for (i=mDirtyNodes.start(); i<b; mDirtyNodes.next(i))
+   {
+      if (i<a)
+         continue;
+      mDirtyNodes.clear(i);
+
+      // hands-off nodes get their local transform from mNodeTransforms, as in animateNodes
+      if (mHandsOffNodes.test(i))
+         mNodeLocalTransforms[i] = mNodeTransforms[i];
+   }
+
+   // callbacks start over from the animated transform
+   for (i=0; i<mNodeCallbacks.size(); i++)
+   {
+      S32 nodeIndex = mNodeCallbacks[i].nodeIndex;
+      if (nodeIndex>=a && nodeIndex<b && dirty.test(nodeIndex))
+      {
+         mNodeLocalTransforms[nodeIndex] = mNodeCallbacks[i].baseTransform;
+         mNodeCallbacks[i].callback->setNodeTransform(this, nodeIndex, mNodeLocalTransforms[nodeIndex]);
+      }
+   }
+
+   // The cached local transforms don't match a pose being interpolated by
+   // animateNodesLOD(), so until it is done only the marked nodes are
+   // rebuilt. The nodes below them are caught up once it finishes.
+   const bool interpolating = mAnimationLODStep < mAnimationLODSteps;
+   dirty.overlap(mPendingNodes);
+   if (interpolating)
+   {
+      mPendingNodes.overlap(dirty);
+      mDirtyFlags[ss] |= NodeDirty;
+   }
+   else
+   {
+      for (i=mPendingNodes.start(); i<b; mPendingNodes.next(i))
+      {
+         if (i>=a)
+            mPendingNodes.clear(i);
+      }
    }
+
+   concatNodeTransforms(ss,mNodeLocalTransforms.address(),&dirty,!interpolating);
+
+   // Skins need updating with the new transforms
+   mAnimationGeneration++;
+}
+
+void TSShapeInstance::concatNodeTransforms(S32 ss, const MatrixF * localTransforms, const TSIntegerSet * dirty, bool descendants)
+{
+   S32 a = mShape->subShapeFirstNode[ss];
+   S32 count = mShape->subShapeNumNodes[ss];
+   const S32 * order = mShape->nodeEvalOrder.address() + a;
+   const S32 * parents = mShape->nodeEvalParents.address() + a;
+
+   if (dirty)
+   {
+      // pick out the dirty nodes and (optionally) everything below them...
+      // parents come first in the evaluation order, so one pass is enough
+      TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+      TSIntegerSet subtrees = *dirty;
+      S32 numNodes = 0;
+      for (S32 i=0; i<count; i++)
+      {
+         S32 nodeIndex = order[i];
+         S32 parentIdx = parents[i];
+         if (!subtrees.test(nodeIndex))
+         {
+            if (!descendants || parentIdx<0 || !subtrees.test(parentIdx))
+               continue;
+            subtrees.set(nodeIndex);
+         }
+         scratch.evalNodes[numNodes] = nodeIndex;
+         scratch.evalParents[numNodes++] = parentIdx;
+      }
+      order = scratch.evalNodes;
+      parents = scratch.evalParents;
+      count = numNodes;
+   }
+
+   m_matF_x_matF_NodeList(count,order,parents,localTransforms,mNodeTransforms.address());
 }
 
 void TSShapeInstance::handleDefaultScale(S32 a, S32 b, TSIntegerSet & scaleBeenSet)
@@ -255,37 +428,36 @@ void TSShapeInstance::handleDefaultScale(S32 a, S32 b, TSIntegerSet & scaleBeenS
    // set default scale values (i.e., identity) and do any initialization
    // relating to animated scale (since scale normally not animated)
 
-   mCurrentRenderState->smScaleThreads.setSize(mShape->nodes.size());
+   TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+   scratch.reserve(mShape->nodes.size());
+
    scaleBeenSet.takeAway(mCallbackNodes);
    scaleBeenSet.takeAway(mHandsOffNodes);
    if (animatesUniformScale())
    {
-      mCurrentRenderState->smNodeCurrentUniformScales.setSize(mShape->nodes.size());
       for (S32 i=a; i<b; i++)
          if (scaleBeenSet.test(i))
          {
-            mCurrentRenderState->smNodeCurrentUniformScales[i] = 1.0f;
-            mCurrentRenderState->smScaleThreads[i] = NULL;
+            scratch.nodeCurrentUniformScales[i] = 1.0f;
+            scratch.scaleThreads[i] = NULL;
          }
    }
    else if (animatesAlignedScale())
    {
-      mCurrentRenderState->smNodeCurrentAlignedScales.setSize(mShape->nodes.size());
       for (S32 i=a; i<b; i++)
          if (scaleBeenSet.test(i))
          {
-            mCurrentRenderState->smNodeCurrentAlignedScales[i].set(1.0f,1.0f,1.0f);
-            mCurrentRenderState->smScaleThreads[i] = NULL;
+            scratch.nodeCurrentAlignedScales[i].set(1.0f,1.0f,1.0f);
+            scratch.scaleThreads[i] = NULL;
          }
    }
    else
    {
-      mCurrentRenderState->smNodeCurrentArbitraryScales.setSize(mShape->nodes.size());
       for (S32 i=a; i<b; i++)
          if (scaleBeenSet.test(i))
          {
-            mCurrentRenderState->smNodeCurrentArbitraryScales[i].identity();
-            mCurrentRenderState->smScaleThreads[i] = NULL;
+            scratch.nodeCurrentArbitraryScales[i].identity();
+            scratch.scaleThreads[i] = NULL;
          }
    }
 
@@ -295,6 +467,8 @@ void TSShapeInstance::handleDefaultScale(S32 a, S32 b, TSIntegerSet & scaleBeenS
 
 void TSShapeInstance::updateTransitionNodeTransforms(TSIntegerSet& transitionNodes)
 {
+   TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+
    // handle transitions
    transitionNodes.clearAll();
    transitionNodes.overlap(mTransitionRotationNodes);
@@ -306,19 +480,19 @@ void TSShapeInstance::updateTransitionNodeTransforms(TSIntegerSet& transitionNod
    // for blended or scale-animated nodes, as all others are already up to date
    for (S32 i=transitionNodes.start(); i<MAX_TS_SET_SIZE; transitionNodes.next(i))
    {
-      if (mCurrentRenderState->smNodeLocalTransformDirty.test(i))
+      if (scratch.nodeLocalTransformDirty.test(i))
       {
          if (scaleCurrentlyAnimated())
          {
             // @todo:No support for scale yet => need to do proper affine decomposition here
-            mCurrentRenderState->smNodeCurrentTranslations[i] = mCurrentRenderState->smNodeLocalTransforms[i].getPosition();
-            mCurrentRenderState->smNodeCurrentRotations[i].set(mCurrentRenderState->smNodeLocalTransforms[i]);
+            scratch.nodeCurrentTranslations[i] = scratch.nodeLocalTransforms[i].getPosition();
+            scratch.nodeCurrentRotations[i].set(scratch.nodeLocalTransforms[i]);
          }
          else
          {
             // Scale is identity => can do a cheap decomposition
-            mCurrentRenderState->smNodeCurrentTranslations[i] = mCurrentRenderState->smNodeLocalTransforms[i].getPosition();
-            mCurrentRenderState->smNodeCurrentRotations[i].set(mCurrentRenderState->smNodeLocalTransforms[i]);
+            scratch.nodeCurrentTranslations[i] = scratch.nodeLocalTransforms[i].getPosition();
+            scratch.nodeCurrentRotations[i].set(scratch.nodeLocalTransforms[i]);
          }
       }
    }
@@ -326,6 +500,8 @@ void TSShapeInstance::updateTransitionNodeTransforms(TSIntegerSet& transitionNod
 
 void TSShapeInstance::handleTransitionNodes(S32 a, S32 b)
 {
+   TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+
    TSIntegerSet transitionNodes;
    updateTransitionNodeTransforms(transitionNodes);
 
@@ -336,7 +512,7 @@ void TSShapeInstance::handleTransitionNodes(S32 a, S32 b)
    {
       if (nodeIndex<a)
          continue;
-      TSThread * thread = mCurrentRenderState->smRotationThreads[nodeIndex];
+      TSThread * thread = scratch.rotationThreads[nodeIndex];
       thread = thread && thread->transitionData.inTransition ? thread : NULL;
       if (!thread)
       {
@@ -354,7 +530,7 @@ void TSShapeInstance::handleTransitionNodes(S32 a, S32 b)
          AssertFatal(thread!=NULL,"TSShapeInstance::handleRotTransitionNodes (rotation)");
       }
       QuatF tmpQ;
-      TSTransform::interpolate(mNodeReferenceRotations[nodeIndex].getQuatF(&tmpQ),mCurrentRenderState->smNodeCurrentRotations[nodeIndex],thread->transitionData.pos,&mCurrentRenderState->smNodeCurrentRotations[nodeIndex]);
+      TSTransform::interpolate(mNodeReferenceRotations[nodeIndex].getQuatF(&tmpQ),scratch.nodeCurrentRotations[nodeIndex],thread->transitionData.pos,&scratch.nodeCurrentRotations[nodeIndex]);
    }
 
    // then translation
@@ -362,7 +538,7 @@ void TSShapeInstance::handleTransitionNodes(S32 a, S32 b)
    end   = b;
    for (nodeIndex=start; nodeIndex<end; mTransitionTranslationNodes.next(nodeIndex))
    {
-      TSThread * thread = mCurrentRenderState->smTranslationThreads[nodeIndex];
+      TSThread * thread = scratch.translationThreads[nodeIndex];
       thread = thread && thread->transitionData.inTransition ? thread : NULL;
       if (!thread)
       {
@@ -379,7 +555,7 @@ void TSShapeInstance::handleTransitionNodes(S32 a, S32 b)
          }
          AssertFatal(thread!=NULL,"TSShapeInstance::handleTransitionNodes (translation).");
       }
-      Point3F & p = mCurrentRenderState->smNodeCurrentTranslations[nodeIndex];
+      Point3F & p = scratch.nodeCurrentTranslations[nodeIndex];
       Point3F & p1 = mNodeReferenceTranslations[nodeIndex];
       Point3F & p2 = p;
       F32 k = thread->transitionData.pos;
@@ -395,7 +571,7 @@ void TSShapeInstance::handleTransitionNodes(S32 a, S32 b)
       end   = b;
       for (nodeIndex=start; nodeIndex<end; mTransitionScaleNodes.next(nodeIndex))
       {
-         TSThread * thread = mCurrentRenderState->smScaleThreads[nodeIndex];
+         TSThread * thread = scratch.scaleThreads[nodeIndex];
          thread = thread && thread->transitionData.inTransition ? thread : NULL;
          if (!thread)
          {
@@ -413,14 +589,14 @@ void TSShapeInstance::handleTransitionNodes(S32 a, S32 b)
             AssertFatal(thread!=NULL,"TSShapeInstance::handleTransitionNodes (scale).");
          }
          if (animatesUniformScale())
-            mCurrentRenderState->smNodeCurrentUniformScales[nodeIndex] += thread->transitionData.pos * (mNodeReferenceUniformScales[nodeIndex]-mCurrentRenderState->smNodeCurrentUniformScales[nodeIndex]);
+            scratch.nodeCurrentUniformScales[nodeIndex] += thread->transitionData.pos * (mNodeReferenceUniformScales[nodeIndex]-scratch.nodeCurrentUniformScales[nodeIndex]);
          else if (animatesAlignedScale())
-            TSTransform::interpolate(mNodeReferenceScaleFactors[nodeIndex],mCurrentRenderState->smNodeCurrentAlignedScales[nodeIndex],thread->transitionData.pos,&mCurrentRenderState->smNodeCurrentAlignedScales[nodeIndex]);
+            TSTransform::interpolate(mNodeReferenceScaleFactors[nodeIndex],scratch.nodeCurrentAlignedScales[nodeIndex],thread->transitionData.pos,&scratch.nodeCurrentAlignedScales[nodeIndex]);
          else
          {
             QuatF q;
-            TSTransform::interpolate(mNodeReferenceScaleFactors[nodeIndex],mCurrentRenderState->smNodeCurrentArbitraryScales[nodeIndex].mScale,thread->transitionData.pos,&mCurrentRenderState->smNodeCurrentArbitraryScales[nodeIndex].mScale);
-            TSTransform::interpolate(mNodeReferenceArbitraryScaleRots[nodeIndex].getQuatF(&q),mCurrentRenderState->smNodeCurrentArbitraryScales[nodeIndex].mRotate,thread->transitionData.pos,&mCurrentRenderState->smNodeCurrentArbitraryScales[nodeIndex].mRotate);
+            TSTransform::interpolate(mNodeReferenceScaleFactors[nodeIndex],scratch.nodeCurrentArbitraryScales[nodeIndex].mScale,thread->transitionData.pos,&scratch.nodeCurrentArbitraryScales[nodeIndex].mScale);
+            TSTransform::interpolate(mNodeReferenceArbitraryScaleRots[nodeIndex].getQuatF(&q),scratch.nodeCurrentArbitraryScales[nodeIndex].mRotate,thread->transitionData.pos,&scratch.nodeCurrentArbitraryScales[nodeIndex].mRotate);
          }
       }
    }
@@ -430,47 +606,51 @@ void TSShapeInstance::handleTransitionNodes(S32 a, S32 b)
    end   = b;
    for (nodeIndex=start; nodeIndex<end; transitionNodes.next(nodeIndex))
    {
-      TSTransform::setMatrix(mCurrentRenderState->smNodeCurrentRotations[nodeIndex], mCurrentRenderState->smNodeCurrentTranslations[nodeIndex], &mCurrentRenderState->smNodeLocalTransforms[nodeIndex]);
+      TSTransform::setMatrix(scratch.nodeCurrentRotations[nodeIndex], scratch.nodeCurrentTranslations[nodeIndex], &scratch.nodeLocalTransforms[nodeIndex]);
       if (scaleCurrentlyAnimated())
       {
          if (animatesUniformScale())
-            TSTransform::applyScale(mCurrentRenderState->smNodeCurrentUniformScales[nodeIndex],&mCurrentRenderState->smNodeLocalTransforms[nodeIndex]);
+            TSTransform::applyScale(scratch.nodeCurrentUniformScales[nodeIndex],&scratch.nodeLocalTransforms[nodeIndex]);
          else if (animatesAlignedScale())
-               TSTransform::applyScale(mCurrentRenderState->smNodeCurrentAlignedScales[nodeIndex],&mCurrentRenderState->smNodeLocalTransforms[nodeIndex]);
+               TSTransform::applyScale(scratch.nodeCurrentAlignedScales[nodeIndex],&scratch.nodeLocalTransforms[nodeIndex]);
          else
-            TSTransform::applyScale(mCurrentRenderState->smNodeCurrentArbitraryScales[nodeIndex],&mCurrentRenderState->smNodeLocalTransforms[nodeIndex]);
+            TSTransform::applyScale(scratch.nodeCurrentArbitraryScales[nodeIndex],&scratch.nodeLocalTransforms[nodeIndex]);
       }
    }
 }
 
 void TSShapeInstance::handleNodeScale(S32 a, S32 b)
 {
+   TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+
    if (animatesUniformScale())
    {
       for (S32 i=a; i<b; i++)
          if (!mHandsOffNodes.test(i))
-            TSTransform::applyScale(mCurrentRenderState->smNodeCurrentUniformScales[i],&mCurrentRenderState->smNodeLocalTransforms[i]);
+            TSTransform::applyScale(scratch.nodeCurrentUniformScales[i],&scratch.nodeLocalTransforms[i]);
    }
    else if (animatesAlignedScale())
    {
       for (S32 i=a; i<b; i++)
          if (!mHandsOffNodes.test(i))
-            TSTransform::applyScale(mCurrentRenderState->smNodeCurrentAlignedScales[i],&mCurrentRenderState->smNodeLocalTransforms[i]);
+            TSTransform::applyScale(scratch.nodeCurrentAlignedScales[i],&scratch.nodeLocalTransforms[i]);
    }
    else
    {
       for (S32 i=a; i<b; i++)
          if (!mHandsOffNodes.test(i))
-            TSTransform::applyScale(mCurrentRenderState->smNodeCurrentArbitraryScales[i],&mCurrentRenderState->smNodeLocalTransforms[i]);
+            TSTransform::applyScale(scratch.nodeCurrentArbitraryScales[i],&scratch.nodeLocalTransforms[i]);
    }
 
    TSIntegerSet scaledNodes;
    scaledNodes.difference(mHandsOffNodes);
-   mCurrentRenderState->smNodeLocalTransformDirty.overlap(scaledNodes);
+   scratch.nodeLocalTransformDirty.overlap(scaledNodes);
 }
 
 void TSShapeInstance::handleAnimatedScale(TSThread * thread, S32 a, S32 b, TSIntegerSet & scaleBeenSet)
 {
+   TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+
    S32 j=0;
    S32 start = thread->getSequence()->scaleMatters.start();
    S32 end   = b;
@@ -534,28 +714,28 @@ void TSShapeInstance::handleAnimatedScale(TSThread * thread, S32 a, S32 b, TSInt
          {
             case 0:  // uniform -> uniform
             {
-               mCurrentRenderState->smNodeCurrentUniformScales[nodeIndex] = uniformScale;
+               scratch.nodeCurrentUniformScales[nodeIndex] = uniformScale;
                break;
             }
             case 4:  // uniform -> aligned
             case 5:  // aligned -> aligned
-               mCurrentRenderState->smNodeCurrentAlignedScales[nodeIndex] = alignedScale;
+               scratch.nodeCurrentAlignedScales[nodeIndex] = alignedScale;
                break;
             case 8:  // uniform -> arbitrary
             case 9:  // aligned -> arbitrary
             {
-               mCurrentRenderState->smNodeCurrentArbitraryScales[nodeIndex].identity();
-               mCurrentRenderState->smNodeCurrentArbitraryScales[nodeIndex].mScale = alignedScale;
+               scratch.nodeCurrentArbitraryScales[nodeIndex].identity();
+               scratch.nodeCurrentArbitraryScales[nodeIndex].mScale = alignedScale;
                break;
             }
             case 10: // arbitrary -> arbitary
             {
-               mCurrentRenderState->smNodeCurrentArbitraryScales[nodeIndex] = arbitraryScale;
+               scratch.nodeCurrentArbitraryScales[nodeIndex] = arbitraryScale;
                break;
             }
             default: AssertFatal(0,"TSShapeInstance::handleAnimatedScale"); break;
          }
-         mCurrentRenderState->smScaleThreads[nodeIndex] = thread;
+         scratch.scaleThreads[nodeIndex] = thread;
          scaleBeenSet.set(nodeIndex);
       }
    }
@@ -563,23 +743,34 @@ void TSShapeInstance::handleAnimatedScale(TSThread * thread, S32 a, S32 b, TSInt
 
 void TSShapeInstance::handleMaskedPositionNode(TSThread * th, S32 nodeIndex, S32 offset)
 {
+   TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+
    const Point3F & p1 = mShape->getTranslation(*th->getSequence(),th->keyNum1,offset);
    const Point3F & p2 = mShape->getTranslation(*th->getSequence(),th->keyNum2,offset);
    Point3F p;
    TSTransform::interpolate(p1,p2,th->keyPos,&p);
 
    if (!mMaskPosXNodes.test(nodeIndex))
-      mCurrentRenderState->smNodeCurrentTranslations[nodeIndex].x = p.x;
+      scratch.nodeCurrentTranslations[nodeIndex].x = p.x;
 
    if (!mMaskPosYNodes.test(nodeIndex))
-      mCurrentRenderState->smNodeCurrentTranslations[nodeIndex].y = p.y;
+      scratch.nodeCurrentTranslations[nodeIndex].y = p.y;
 
    if (!mMaskPosZNodes.test(nodeIndex))
-      mCurrentRenderState->smNodeCurrentTranslations[nodeIndex].z = p.z;
+      scratch.nodeCurrentTranslations[nodeIndex].z = p.z;
 }
 
-void TSShapeInstance::handleBlendSequence(TSThread * thread, S32 a, S32 b)
+void TSShapeInstance::handleBlendSequence(TSThread * thread, S32 a, S32 b, F32 keyPos)
 {
+   TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+
+   // sample every track up to the end of this detail in one go
+   const TSShape::Sequence * seq = thread->getSequence();
+   mShape->sampleRotations(*seq,thread->keyNum1,thread->keyNum2,keyPos,0,
+                           seq->rotationMatters.count(b),scratch.trackRotations);
+   mShape->sampleTranslations(*seq,thread->keyNum1,thread->keyNum2,keyPos,0,
+                              seq->translationMatters.count(b),scratch.trackTranslations);
+
    S32 jrot=0;
    S32 jtrans=0;
    S32 jscale=0;
@@ -606,22 +797,13 @@ void TSShapeInstance::handleBlendSequence(TSThread * thread, S32 a, S32 b)
       MatrixF mat(true);
       if (thread->getSequence()->rotationMatters.test(nodeIndex))
       {
-         QuatF q1,q2;
-         mShape->getRotation(*thread->getSequence(),thread->keyNum1,jrot,&q1);
-         mShape->getRotation(*thread->getSequence(),thread->keyNum2,jrot,&q2);
-         QuatF quat;
-         TSTransform::interpolate(q1,q2,thread->keyPos,&quat);
-         TSTransform::setMatrix(quat,&mat);
+         TSTransform::setMatrix(scratch.trackRotations[jrot],&mat);
          jrot++;
       }
 
       if (thread->getSequence()->translationMatters.test(nodeIndex))
       {
-         const Point3F & p1 = mShape->getTranslation(*thread->getSequence(),thread->keyNum1,jtrans);
-         const Point3F & p2 = mShape->getTranslation(*thread->getSequence(),thread->keyNum2,jtrans);
-         Point3F p;
-         TSTransform::interpolate(p1,p2,thread->keyPos,&p);
-         mat.setColumn(3,p);
+         mat.setColumn(3,scratch.trackTranslations[jtrans]);
          jtrans++;
       }
 
@@ -631,7 +813,7 @@ void TSShapeInstance::handleBlendSequence(TSThread * thread, S32 a, S32 b)
          {
             F32 s1 = mShape->getUniformScale(*thread->getSequence(),thread->keyNum1,jscale);
             F32 s2 = mShape->getUniformScale(*thread->getSequence(),thread->keyNum2,jscale);
-            F32 scale = TSTransform::interpolate(s1,s2,thread->keyPos);
+            F32 scale = TSTransform::interpolate(s1,s2,keyPos);
             TSTransform::applyScale(scale,&mat);
          }
          else if (animatesAlignedScale())
@@ -639,7 +821,7 @@ void TSShapeInstance::handleBlendSequence(TSThread * thread, S32 a, S32 b)
             Point3F s1 = mShape->getAlignedScale(*thread->getSequence(),thread->keyNum1,jscale);
             Point3F s2 = mShape->getAlignedScale(*thread->getSequence(),thread->keyNum2,jscale);
             Point3F scale;
-            TSTransform::interpolate(s1,s2,thread->keyPos,&scale);
+            TSTransform::interpolate(s1,s2,keyPos,&scale);
             TSTransform::applyScale(scale,&mat);
          }
          else
@@ -648,15 +830,15 @@ void TSShapeInstance::handleBlendSequence(TSThread * thread, S32 a, S32 b)
             mShape->getArbitraryScale(*thread->getSequence(),thread->keyNum1,jscale,&s1);
             mShape->getArbitraryScale(*thread->getSequence(),thread->keyNum2,jscale,&s2);
             TSScale scale;
-            TSTransform::interpolate(s1,s2,thread->keyPos,&scale);
+            TSTransform::interpolate(s1,s2,keyPos,&scale);
             TSTransform::applyScale(scale,&mat);
          }
          jscale++;
       }
 
       // apply blend transform
-      mCurrentRenderState->smNodeLocalTransforms[nodeIndex].mul(mat);
-      mCurrentRenderState->smNodeLocalTransformDirty.set(nodeIndex);
+      scratch.nodeLocalTransforms[nodeIndex].mul(mat);
+      scratch.nodeLocalTransformDirty.set(nodeIndex);
    }
 }
 
@@ -855,14 +1037,19 @@ void TSShapeInstance::animate(S32 dl)
    if (ss<0)
       return;
 
+   // flags raised while animating are left for the next call
    U32 dirtyFlags = mDirtyFlags[ss];
+   mDirtyFlags[ss] &= ~dirtyFlags;
 
    if (dirtyFlags & ThreadDirty)
       sortThreads();
 
-   // animate nodes?
-   if (dirtyFlags & TransformDirty)
-      animateNodes(ss);
+   // animate nodes? (distant shapes may leave them dirty until a later frame)
+   const bool nodesDeferred = !animateNodesLOD(ss, dirtyFlags & TransformDirty);
+
+   // nodes driven by game code changed, and weren't just animated?
+   if ((dirtyFlags & NodeDirty) && (nodesDeferred || !(dirtyFlags & TransformDirty)))
+      animateDirtyNodes(ss);
 
    // animate objects?
    if (dirtyFlags & VisDirty)
@@ -874,7 +1061,111 @@ void TSShapeInstance::animate(S32 dl)
    if (dirtyFlags & MatFrameDirty)
       animateMatFrame(ss);
 
-   mDirtyFlags[ss] = 0;
+   if (nodesDeferred)
+      mDirtyFlags[ss] |= TransformDirty;
+}
+
+bool TSShapeInstance::animateNodesLOD(S32 ss, bool transformDirty)
+{
+   if (mAnimationLOD == 0)
+   {
+      mAnimationLODStep = mAnimationLODSteps = 0;
+      if (transformDirty)
+         animateNodes(ss);
+      return true;
+   }
+
+   const S32 interval = 1 << mAnimationLOD;
+   const bool update = transformDirty && (++mAnimationLODFrame % interval) == 0;
+
+   // Interpolating can't represent animated scale, so just snap to each update
+   if (!smAnimationLODInterpolate || scaleCurrentlyAnimated())
+   {
+      mAnimationLODStep = mAnimationLODSteps = 0;
+      if (update)
+         animateNodes(ss);
+      return update || !transformDirty;
+   }
+
+   if (update)
+   {
+      // Move from the pose currently shown to the new one over the
+      // frames until the next update. The buffers are swapped rather than
+      // copied, so only the nodes animateNodes() doesn't compute from the
+      // threads are carried over.
+      mAnimationLODFrom.swap(mNodeTransforms);
+      copyUninterpolatedNodes(ss, mAnimationLODFrom);
+      animateNodes(ss);
+      if (mAnimationLODFrom.size() == mNodeTransforms.size())
+      {
+         mAnimationLODTo.swap(mNodeTransforms);
+         copyUninterpolatedNodes(ss, mAnimationLODTo);
+         mAnimationLODStep = 0;
+         mAnimationLODSteps = interval;
+      }
+      else
+      {
+         // nothing was shown yet, so show the new pose straight away
+         mAnimationLODStep = mAnimationLODSteps = 0;
+      }
+   }
+
+   if (mAnimationLODStep < mAnimationLODSteps)
+   {
+      PROFILE_SCOPE( TSShapeInstance_animateNodesLOD_Interpolate );
+
+      const F32 t = F32(++mAnimationLODStep) / F32(mAnimationLODSteps);
+      const S32 a = mShape->subShapeFirstNode[ss];
+      const S32 b = getMin(a + mShape->subShapeNumNodes[ss], mAnimationLODFrom.size());
+
+      QuatF q1, q2, q;
+      Point3F p;
+      for (S32 i=a; i<b; i++)
+      {
+         // these are set from outside the threads, so keep them as they are
+         if (mHandsOffNodes.test(i) || mCallbackNodes.test(i))
+            continue;
+
+         const MatrixF &from = mAnimationLODFrom[i];
+         const MatrixF &to = mAnimationLODTo[i];
+         q1.set(from);
+         q2.set(to);
+         TSTransform::interpolate(q1,q2,t,&q);
+         TSTransform::interpolate(from.getPosition(),to.getPosition(),t,&p);
+         TSTransform::setMatrix(q,p,&mNodeTransforms[i]);
+      }
+
+      // Skins need updating with the new transforms
+      mAnimationGeneration++;
+   }
+
+   return update || !transformDirty;
+}
+
+void TSShapeInstance::copyUninterpolatedNodes(S32 ss, const Vector<MatrixF> &src)
+{
+   mNodeTransforms.setSize(src.size());
+
+   const S32 a = getMin(mShape->subShapeFirstNode[ss], src.size());
+   const S32 b = getMin(a + mShape->subShapeNumNodes[ss], src.size());
+
+   // nodes of the other subshapes
+   if (a > 0)
+      dMemcpy(mNodeTransforms.address(), src.address(), a*sizeof(MatrixF));
+   if (b < src.size())
+      dMemcpy(&mNodeTransforms[b], &src[b], (src.size()-b)*sizeof(MatrixF));
+
+   S32 i;
+   for (i=mHandsOffNodes.start(); i<b; mHandsOffNodes.next(i))
+   {
+      if (i>=a)
+         mNodeTransforms[i] = src[i];
+   }
+   for (i=mCallbackNodes.start(); i<b; mCallbackNodes.next(i))
+   {
+      if (i>=a)
+         mNodeTransforms[i] = src[i];
+   }
 }
 
 void TSShapeInstance::animateNodeSubtrees(bool forceFull)
@@ -890,7 +1181,12 @@ void TSShapeInstance::animateNodeSubtrees(bool forceFull)
       if (mDirtyFlags[i] & TransformDirty)
       {
          animateNodes(i);
-         mDirtyFlags[i] &= ~TransformDirty;
+         mDirtyFlags[i] &= ~(TransformDirty|NodeDirty);
+      }
+      else if (mDirtyFlags[i] & NodeDirty)
+      {
+         mDirtyFlags[i] &= ~NodeDirty;
+         animateDirtyNodes(i);
       }
    }
 }
@@ -910,6 +1206,11 @@ void TSShapeInstance::animateSubtrees(bool forceFull)
          animate(i);
          mDirtyFlags[i] = 0;
       }
+      else if (mDirtyFlags[i] & NodeDirty)
+      {
+         mDirtyFlags[i] &= ~NodeDirty;
+         animateDirtyNodes(i);
+      }
    }
 }
 
@@ -1111,6 +1412,18 @@ void TSShapeInstance::setNodeAnimationState(S32 nodeIndex, U32 animationState, T
       mCallbackNodes.clear(nodeIndex);
 }
 
+void TSShapeInstance::setNodeDirty(S32 nodeIndex)
+{
+   mDirtyNodes.set(nodeIndex);
+
+   for (S32 i=0; i<mShape->subShapeFirstNode.size(); i++)
+   {
+      S32 a = mShape->subShapeFirstNode[i];
+      if (nodeIndex>=a && nodeIndex<a+mShape->subShapeNumNodes[i])
+         mDirtyFlags[i] |= NodeDirty;
+   }
+}
+
 U32 TSShapeInstance::getNodeAnimationState(S32 nodeIndex)
 {
    U32 ret = 0;
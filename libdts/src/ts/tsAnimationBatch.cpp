@@ -0,0 +1,222 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "ts/tsAnimationBatch.h"
+#include "ts/tsShapeInstance.h"
+#include "ts/tsRenderState.h"
+#include "platform/platformThreads.h"
+#include "platform/platformIntrinsics.h"
+#include "platform/profiler.h"
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+TSAnimationBatch::TSAnimationBatch(U32 numThreads) :
+   mPartitions(NULL),
+   mNumPartitions(0),
+   mStartSignal(NULL),
+   mDoneSignal(NULL),
+   mQuit(false),
+   mInstances(NULL),
+   mDelta(0.0f),
+   mStages(0)
+{
+   if ( numThreads < 1 )
+      numThreads = 1;
+
+   mStates.setSize(numThreads);
+   mPartitions = (Partition*)dMalloc_aligned(numThreads * sizeof(Partition), CacheLineSize);
+   mNumPartitions = numThreads;
+   for ( U32 i=0; i<numThreads; i++ )
+   {
+      mStates[i] = new TSRenderState();
+      mPartitions[i].next = 0;
+      mPartitions[i].end = 0;
+   }
+
+   if ( numThreads < 2 )
+      return;
+
+   mStartSignal = new Semaphore(0);
+   mDoneSignal = new Semaphore(0);
+
+   // The calling thread acts as thread 0
+   for ( U32 i=1; i<numThreads; i++ )
+   {
+      Worker *worker = new Worker;
+      worker->batch = this;
+      worker->index = i;
+      worker->thread = new Thread(&TSAnimationBatch::workerMain, worker);
+
+      if ( !worker->thread->start() )
+      {
+         Log::errorf("TSAnimationBatch: unable to start worker thread %u", i);
+         delete worker->thread;
+         delete worker;
+         break;
+      }
+
+      mWorkers.push_back(worker);
+   }
+
+   // Drop scratch for any threads which failed to start
+   for ( S32 i=mWorkers.size()+1; i<mStates.size(); i++ )
+      delete mStates[i];
+   mStates.setSize(mWorkers.size()+1);
+   mNumPartitions = mStates.size();
+}
+
+TSAnimationBatch::~TSAnimationBatch()
+{
+   mQuit = true;
+   if ( mStartSignal )
+      mStartSignal->release(mWorkers.size());
+
+   for ( S32 i=0; i<mWorkers.size(); i++ )
+   {
+      mWorkers[i]->thread->join();
+      delete mWorkers[i]->thread;
+      delete mWorkers[i];
+   }
+   mWorkers.clear();
+
+   for ( S32 i=0; i<mStates.size(); i++ )
+      delete mStates[i];
+   mStates.clear();
+
+   dFree_aligned(mPartitions);
+
+   delete mStartSignal;
+   delete mDoneSignal;
+}
+
+void TSAnimationBatch::workerMain(void *data)
+{
+   Worker *worker = reinterpret_cast<Worker*>(data);
+   TSAnimationBatch *batch = worker->batch;
+
+   for (;;)
+   {
+      batch->mStartSignal->acquire();
+      if ( batch->mQuit )
+         break;
+
+      batch->runJobs(worker->index);
+      batch->mDoneSignal->release();
+   }
+}
+
+void TSAnimationBatch::process(TSShapeInstance **instances, U32 count, F32 dt, U32 stages)
+{
+   PROFILE_SCOPE( TSAnimationBatch_process );
+
+   if ( count == 0 )
+      return;
+
+   mInstances = instances;
+   mDelta = dt;
+   mStages = stages;
+
+   // Split the list evenly, handing the remainder out one apiece
+   const U32 numThreads = mStates.size();
+   const U32 share = count / numThreads;
+   const U32 extra = count % numThreads;
+   U32 start = 0;
+
+   for ( U32 i=0; i<numThreads; i++ )
+   {
+      const U32 size = share + (i < extra ? 1 : 0);
+      mPartitions[i].next = start;
+      mPartitions[i].end = start + size;
+      start += size;
+   }
+
+   // The semaphores order the writes above before the workers see them
+   if ( mWorkers.size() )
+      mStartSignal->release(mWorkers.size());
+
+   runJobs(0);
+
+   for ( S32 i=0; i<mWorkers.size(); i++ )
+      mDoneSignal->acquire();
+
+   mInstances = NULL;
+}
+
+bool TSAnimationBatch::claim(Partition &part, U32 &outIndex)
+{
+   for (;;)
+   {
+      U32 idx = dAtomicRead(part.next);
+      if ( idx >= part.end )
+         return false;
+
+      if ( dCompareAndSwap(part.next, idx, idx+1) )
+      {
+         outIndex = idx;
+         return true;
+      }
+   }
+}
+
+void TSAnimationBatch::runJobs(U32 threadIndex)
+{
+   TSRenderState *state = mStates[threadIndex];
+   const U32 numThreads = mNumPartitions;
+   U32 idx;
+
+   // Own partition first, then steal from the others in turn
+   for ( U32 i=0; i<numThreads; i++ )
+   {
+      Partition &part = mPartitions[(threadIndex + i) % numThreads];
+      while ( claim(part, idx) )
+         processInstance(mInstances[idx], state);
+   }
+}
+
+void TSAnimationBatch::processInstance(TSShapeInstance *inst, TSRenderState *state)
+{
+   PROFILE_SCOPE( TSAnimationBatch_processInstance );
+
+   // Borrow the instance for this thread, restoring the caller's state after
+   TSRenderState *prevState = inst->mCurrentRenderState;
+   inst->beginUpdate(state);
+
+   if ( mStages & AdvanceTime )
+      inst->advanceTime(mDelta);
+
+   if ( mStages & Animate )
+      inst->animate();
+
+   if ( mStages & Skin )
+      inst->prepareSkin(*state);
+
+   inst->beginUpdate(prevState);
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
@@ -0,0 +1,142 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _TSANIMATIONBATCH_H_
+#define _TSANIMATIONBATCH_H_
+
+#ifndef _PLATFORM_H_
+#include "platform/platform.h"
+#endif
+
+#ifndef _TVECTOR_H_
+#include "core/util/tVector.h"
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+class TSShapeInstance;
+class TSRenderState;
+class Thread;
+class Semaphore;
+
+/// Animates many TSShapeInstances in parallel.
+///
+/// Each call to process() runs advanceTime(), animate() and prepareSkin() on
+/// every instance in the list. The list is split evenly between the calling
+/// thread and a pool of worker threads; a thread which finishes its share
+/// steals instances from the others until all are done.
+///
+/// Every thread has its own TSRenderState, so instances never share scratch
+/// space. The usual TSShapeInstance threading rules still apply: an instance
+/// may appear in the list only once. Skins are prepared into buffers owned by
+/// each instance and only uploaded by the next render() on the render thread
+/// (see TSShapeInstance::prepareSkin).
+///
+/// TSCallback and trigger handlers are run on whichever thread animates the
+/// instance. The profiler is not thread safe, so builds with
+/// LIBDTSHAPE_ENABLE_PROFILER should use a single thread.
+class TSAnimationBatch
+{
+public:
+   enum Stages
+   {
+      AdvanceTime = BIT(0),   ///< TSShapeInstance::advanceTime
+      Animate     = BIT(1),   ///< TSShapeInstance::animate at the current detail
+      Skin        = BIT(2),   ///< TSShapeInstance::prepareSkin
+      AllStages   = AdvanceTime | Animate | Skin
+   };
+
+protected:
+   enum
+   {
+      CacheLineSize = 64
+   };
+
+   /// Range of the instance list which a thread works through. Other threads
+   /// steal from the front of the range once their own is empty.
+   struct Partition
+   {
+      volatile U32 next;
+      U32 end;
+      U8 pad[CacheLineSize - 2*sizeof(U32)]; ///< Keep each partition on its own cache line
+   };
+
+   struct Worker
+   {
+      TSAnimationBatch *batch;
+      U32 index;
+      Thread *thread;
+   };
+
+   Vector<Worker*> mWorkers;
+   Vector<TSRenderState*> mStates;     ///< One per thread, [0] is the calling thread
+   Partition *mPartitions;             ///< One per thread, cache line aligned
+   U32 mNumPartitions;
+
+   Semaphore *mStartSignal;
+   Semaphore *mDoneSignal;
+   volatile bool mQuit;
+
+   /// @name Current job
+   /// @{
+   TSShapeInstance **mInstances;
+   F32 mDelta;
+   U32 mStages;
+   /// @}
+
+   static void workerMain(void *data);
+
+   /// Processes instances until every partition is empty
+   void runJobs(U32 threadIndex);
+
+   /// Claims the next instance from a partition, or returns false
+   bool claim(Partition &part, U32 &outIndex);
+
+   void processInstance(TSShapeInstance *inst, TSRenderState *state);
+
+public:
+   /// @param numThreads Total number of threads to use, including the caller.
+   ///        Values below 2 run everything on the calling thread.
+   TSAnimationBatch(U32 numThreads);
+   ~TSAnimationBatch();
+
+   /// Total number of threads used, including the caller
+   U32 getThreadCount() const { return mStates.size(); }
+
+   /// Scratch state used by a thread; valid for 0 <= idx < getThreadCount()
+   TSRenderState *getRenderState(U32 idx) const { return mStates[idx]; }
+
+   /// Runs the selected stages on @a count instances, returning once every
+   /// instance has been processed.
+   void process(TSShapeInstance **instances, U32 count, F32 dt, U32 stages = AllStages);
+};
+
+//-----------------------------------------------------------------------------
+
+END_NS
+
+#endif // _TSANIMATIONBATCH_H_
@@ -0,0 +1,96 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "ts/tsAnimationScratch.h"
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+// Keep each array on a 16 byte boundary so they can be used with SIMD loads
+static inline MEM_ADDRESS _scratchAlign(MEM_ADDRESS size)
+{
+   return (size + 15) & ~(MEM_ADDRESS)15;
+}
+
+TSAnimationScratch::TSAnimationScratch() :
+   mNumNodes(0),
+   nodeCurrentRotations(NULL),
+   nodeCurrentTranslations(NULL),
+   nodeCurrentUniformScales(NULL),
+   nodeCurrentAlignedScales(NULL),
+   nodeCurrentArbitraryScales(NULL),
+   nodeLocalTransforms(NULL),
+   trackRotations(NULL),
+   trackTranslations(NULL),
+   evalNodes(NULL),
+   evalParents(NULL),
+   rotationThreads(NULL),
+   translationThreads(NULL),
+   scaleThreads(NULL)
+{
+}
+
+void TSAnimationScratch::reserve(S32 numNodes)
+{
+   if (numNodes <= mNumNodes)
+      return;
+
+   const MEM_ADDRESS n = numNodes;
+   const MEM_ADDRESS rotSize = _scratchAlign(sizeof(QuatF) * n);
+   const MEM_ADDRESS posSize = _scratchAlign(sizeof(Point3F) * n);
+   const MEM_ADDRESS uniformSize = _scratchAlign(sizeof(F32) * n);
+   const MEM_ADDRESS arbitrarySize = _scratchAlign(sizeof(TSScale) * n);
+   const MEM_ADDRESS matSize = _scratchAlign(sizeof(MatrixF) * n);
+   const MEM_ADDRESS threadSize = _scratchAlign(sizeof(TSThread*) * n);
+   const MEM_ADDRESS indexSize = _scratchAlign(sizeof(S32) * n);
+
+   // Local transforms are touched most, so they go first on the boundary
+   const MEM_ADDRESS total = 15 + matSize + rotSize * 2 + posSize * 3 + uniformSize + arbitrarySize + threadSize * 3 + indexSize * 2;
+
+   mArena.freeBlocks();
+   U8 *ptr = reinterpret_cast<U8*>(mArena.alloc((S32)total));
+   ptr = reinterpret_cast<U8*>(_scratchAlign(reinterpret_cast<MEM_ADDRESS>(ptr)));
+
+   nodeLocalTransforms = reinterpret_cast<MatrixF*>(ptr);         ptr += matSize;
+   nodeCurrentRotations = reinterpret_cast<QuatF*>(ptr);          ptr += rotSize;
+   nodeCurrentTranslations = reinterpret_cast<Point3F*>(ptr);     ptr += posSize;
+   nodeCurrentUniformScales = reinterpret_cast<F32*>(ptr);        ptr += uniformSize;
+   nodeCurrentAlignedScales = reinterpret_cast<Point3F*>(ptr);    ptr += posSize;
+   nodeCurrentArbitraryScales = reinterpret_cast<TSScale*>(ptr);  ptr += arbitrarySize;
+   trackRotations = reinterpret_cast<QuatF*>(ptr);                ptr += rotSize;
+   trackTranslations = reinterpret_cast<Point3F*>(ptr);           ptr += posSize;
+   evalNodes = reinterpret_cast<S32*>(ptr);                       ptr += indexSize;
+   evalParents = reinterpret_cast<S32*>(ptr);                     ptr += indexSize;
+   rotationThreads = reinterpret_cast<TSThread**>(ptr);           ptr += threadSize;
+   translationThreads = reinterpret_cast<TSThread**>(ptr);        ptr += threadSize;
+   scaleThreads = reinterpret_cast<TSThread**>(ptr);
+
+   mNumNodes = numNodes;
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
@@ -0,0 +1,114 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _TSANIMATIONSCRATCH_H_
+#define _TSANIMATIONSCRATCH_H_
+
+#ifndef _DATACHUNKER_H_
+#include "core/dataChunker.h"
+#endif
+
+#ifndef _TSINTEGERSET_H_
+#include "ts/tsIntegerSet.h"
+#endif
+
+#ifndef _TSTRANSFORM_H_
+#include "ts/tsTransform.h"
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+class TSThread;
+
+/// Per-node workspace used while animating a TSShapeInstance.
+///
+/// All of the arrays are carved from one block taken from a DataChunker, so
+/// once the scratch has been sized for the largest shape it animates there is
+/// no further heap traffic. The block is only replaced when a shape with more
+/// nodes comes along.
+///
+/// A scratch must only be used by one thread at a time. TSRenderState carries
+/// one, so each thread gets its own by using its own render state.
+class TSAnimationScratch
+{
+protected:
+   DataChunker mArena;
+   S32 mNumNodes;          ///< Number of nodes the arrays can hold
+
+public:
+   /// @name Workspace for Node Transforms
+   /// @{
+   QuatF   *nodeCurrentRotations;
+   Point3F *nodeCurrentTranslations;
+   F32     *nodeCurrentUniformScales;
+   Point3F *nodeCurrentAlignedScales;
+   TSScale *nodeCurrentArbitraryScales;
+   MatrixF *nodeLocalTransforms;
+   TSIntegerSet nodeLocalTransformDirty;
+   /// @}
+
+   /// @name Sampled Tracks
+   /// Keyframes of one thread's sequence, indexed by track rather than node
+   /// @{
+   QuatF   *trackRotations;
+   Point3F *trackTranslations;
+   /// @}
+
+   /// @name Node Evaluation
+   /// Nodes (and their parents) picked out of TSShape::nodeEvalOrder for a
+   /// partial update
+   /// @{
+   S32 *evalNodes;
+   S32 *evalParents;
+   /// @}
+
+   /// @name Threads
+   /// keep track of who controls what on currently animating shape
+   /// @{
+   TSThread **rotationThreads;
+   TSThread **translationThreads;
+   TSThread **scaleThreads;
+   /// @}
+
+   TSAnimationScratch();
+
+   /// Makes room for @a numNodes nodes. This is a no-op unless @a numNodes is
+   /// larger than any count seen before. Contents are undefined afterwards.
+   void reserve(S32 numNodes);
+
+   S32 getNumNodes() const { return mNumNodes; }
+
+private:
+   TSAnimationScratch(const TSAnimationScratch&);
+   TSAnimationScratch& operator=(const TSAnimationScratch&);
+};
+
+//-----------------------------------------------------------------------------
+
+END_NS
+
+#endif // _TSANIMATIONSCRATCH_H_
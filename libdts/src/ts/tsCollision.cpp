@@ -24,6 +24,7 @@
 
 #include "ts/tsShapeInstance.h"
 #include "ts/tsMaterialList.h"
+#include "ts/tsMeshBVH.h"
 //#include "scene/sceneObject.h"
 #include "collision/convex.h"
 #include "collision/collision.h"
@@ -261,6 +262,11 @@ bool TSShapeInstance::castRayRendered(const Point3F & a, const Point3F & b, RayI
    if ( ss == -1 )
       return false;
 
+   // Nothing can be hit outside the animated bounds, and skins needn't
+   // be refitted for rays which miss them
+   if ( !getAnimatedBounds().collideLine(a,b) )
+      return false;
+
    S32 start = mShape->subShapeFirstObject[ss];
    S32 end   = mShape->subShapeNumObjects[ss] + start;
    RayInfo saveRay;
@@ -331,6 +337,130 @@ bool TSShapeInstance::castRayRendered(const Point3F & a, const Point3F & b, RayI
    return found;
 }
 
+U32 TSShapeInstance::castRays(const RayBatch &batch, S32 dl)
+{
+   PROFILE_SCOPE( TSShapeInstance_castRays );
+
+   for (U32 i=0; i<batch.count; i++)
+   {
+      batch.hit[i] = 0;
+      if (batch.results)
+         batch.results[i].t = 1.0f;
+   }
+
+   // if dl==-1, nothing to do
+   if (dl==-1)
+      return 0;
+
+   AssertFatal(dl>=0 && dl<mShape->details.size(),"TSShapeInstance::castRays");
+
+   // get subshape and object detail
+   const TSDetail * detail = &mShape->details[dl];
+   S32 ss = detail->subShapeNum;
+   S32 od = detail->objectDetailNum;
+
+   if ( ss < 0 )
+      return 0;
+
+   // As castRayRendered, skip everything if no ray reaches the animated bounds
+   const Box3F &animatedBounds = getAnimatedBounds();
+   U32 numInBounds = 0;
+   for (U32 i=0; i<batch.count && !numInBounds; i++)
+      numInBounds += animatedBounds.collideLine(batch.start[i], batch.end[i]);
+   if (!numInBounds)
+      return 0;
+
+   S32 start = mShape->subShapeFirstObject[ss];
+   S32 end   = mShape->subShapeNumObjects[ss] + start;
+
+   // Rays are moved into node space a block at a time, on the stack
+   const U32 BlockSize = 64;
+   Point3F ta[BlockSize];
+   Point3F tb[BlockSize];
+   const MatrixF *hitMat[BlockSize];
+   U8 meshHit[BlockSize];
+
+   U32 numHit = 0;
+   for (U32 base=0; base<batch.count; base+=BlockSize)
+   {
+      const U32 num = getMin(batch.count - base, BlockSize);
+      const Point3F *a = batch.start + base;
+      const Point3F *b = batch.end + base;
+      RayInfo *results = batch.results ? batch.results + base : NULL;
+      U8 *hit = batch.hit + base;
+
+      const MatrixF * previousMat = NULL;
+
+      for (S32 i=start; i<end; i++)
+      {
+         MeshObjectInstance * mesh = &mMeshObjects[i];
+
+         if (od >= mesh->object->numMeshes)
+            continue;
+
+         if (&mesh->getTransform() != previousMat)
+         {
+            // different node from before, set up for this node
+            previousMat = &mesh->getTransform();
+
+            MatrixF mat = *previousMat;
+            mat.inverse();
+            for (U32 j=0; j<num; j++)
+            {
+               mat.mulP(a[j],&ta[j]);
+               mat.mulP(b[j],&tb[j]);
+            }
+         }
+
+         if (!results)
+         {
+            // Occlusion only, so stop once every ray is blocked
+            mesh->castRays(od, ta, tb, num, NULL, hit, mMaterialList);
+
+            U32 numBlocked = 0;
+            for (U32 j=0; j<num; j++)
+               numBlocked += hit[j];
+            if (numBlocked == num)
+               break;
+
+            continue;
+         }
+
+         // t is unchanged by the transform, so results[j].t stays the
+         // distance to beat from one node to the next
+         dMemset(meshHit, 0, num);
+         mesh->castRays(od, ta, tb, num, results, meshHit, mMaterialList);
+
+         for (U32 j=0; j<num; j++)
+         {
+            if (meshHit[j])
+            {
+               hit[j] = 1;
+               hitMat[j] = previousMat;
+            }
+         }
+      }
+
+      for (U32 j=0; j<num; j++)
+      {
+         if (!hit[j])
+            continue;
+
+         numHit++;
+         if (results)
+         {
+            RayInfo &info = results[j];
+            hitMat[j]->mulV(info.normal);
+            info.point  = b[j]-a[j];
+            info.point *= info.t;
+            info.point += a[j];
+         }
+      }
+   }
+
+   return numHit;
+}
+
 Point3F TSShapeInstance::support(const Point3F & v, S32 dl)
 {
    // if dl==-1, nothing to do
@@ -437,6 +567,97 @@ void TSShapeInstance::computeBounds(S32 dl, Box3F & bounds)
    }
 }
 
+void TSShapeInstance::updateHitBoxes()
+{
+   if (mHitBoxGeneration == mAnimationGeneration && mHitBoxes.size() == mShape->boneBounds.size())
+      return;
+
+   PROFILE_SCOPE( TSShapeInstance_updateHitBoxes );
+
+   const Vector<TSShape::BoneBounds> &boneBounds = mShape->boneBounds;
+   mHitBoxes.setSize(boneBounds.size());
+   mAnimatedBounds = Box3F::Invalid;
+
+   for (S32 i=0; i<boneBounds.size(); i++)
+   {
+      const TSShape::BoneBounds &bounds = boneBounds[i];
+      HitBox &hitBox = mHitBoxes[i];
+      hitBox.index = i;
+
+      const bool hasNode = bounds.node >= 0 && bounds.node < mNodeTransforms.size();
+      const bool hasObjectNode = bounds.objectNode >= 0 && bounds.objectNode < mNodeTransforms.size();
+
+      if (hasObjectNode && hasNode)
+         hitBox.transform.mul(mNodeTransforms[bounds.objectNode], mNodeTransforms[bounds.node]);
+      else if (hasNode)
+         hitBox.transform = mNodeTransforms[bounds.node];
+      else if (hasObjectNode)
+         hitBox.transform = mNodeTransforms[bounds.objectNode];
+      else
+         hitBox.transform.identity();
+
+      hitBox.invTransform = hitBox.transform;
+      hitBox.invTransform.inverse();
+
+      Box3F box = bounds.box;
+      hitBox.transform.mul(box);
+      mAnimatedBounds.intersect(box);
+   }
+
+   // Shapes without geometry have nothing better than their default bounds
+   if (boneBounds.empty())
+      mAnimatedBounds = mShape->bounds;
+
+   mHitBoxGeneration = mAnimationGeneration;
+}
+
+const Box3F& TSShapeInstance::getAnimatedBounds()
+{
+   updateHitBoxes();
+   return mAnimatedBounds;
+}
+
+const Vector<TSShapeInstance::HitBox>& TSShapeInstance::getHitBoxes()
+{
+   updateHitBoxes();
+   return mHitBoxes;
+}
+
+S32 TSShapeInstance::castRayHitBoxes(const Point3F &start, const Point3F &end, F32 *outT)
+{
+   updateHitBoxes();
+
+   S32 best = -1;
+   F32 bestT = 1.0f;
+
+   for (S32 i=0; i<mHitBoxes.size(); i++)
+   {
+      const HitBox &hitBox = mHitBoxes[i];
+      const Box3F &box = mShape->boneBounds[hitBox.index].box;
+
+      // Boxes are axis aligned in their own space
+      Point3F a, b;
+      hitBox.invTransform.mulP(start, &a);
+      hitBox.invTransform.mulP(end, &b);
+
+      F32 t;
+      Point3F normal;
+      if (!box.collideLine(a, b, &t, &normal))
+         continue;
+
+      if (best < 0 || t < bestT)
+      {
+         best = i;
+         bestT = t;
+      }
+   }
+
+   if (best >= 0 && outT)
+      *outT = bestT;
+
+   return best;
+}
+
 //-------------------------------------------------------------------------------------
 // Object (MeshObjectInstance & PluginObjectInstance) collision methods
 //-------------------------------------------------------------------------------------
@@ -507,17 +728,70 @@ void TSShapeInstance::MeshObjectInstance::support(S32 objectDetail, const Point3
 bool TSShapeInstance::MeshObjectInstance::castRay( S32 objectDetail, const Point3F & start, const Point3F & end, RayInfo * rayInfo, TSMaterialList* materials )
 {
    TSMesh* mesh = getMesh( objectDetail );
-   if( mesh && !forceHidden && visible > 0.01f )
-      return mesh->castRay( frame, start, end, rayInfo, materials );
-   return false;
+   if( !mesh || forceHidden || visible <= 0.01f )
+      return false;
+
+   if ( mesh->getMeshType() == TSMesh::SkinMeshType )
+      return mesh->castRayBVH( getSkinRayBVH( objectDetail ), start, end, rayInfo, materials );
+
+   return mesh->castRay( frame, start, end, rayInfo, materials );
 }
 
 bool TSShapeInstance::MeshObjectInstance::castRayRendered( S32 objectDetail, const Point3F & start, const Point3F & end, RayInfo * rayInfo, TSMaterialList* materials )
 {
    TSMesh* mesh = getMesh( objectDetail );
-   if( mesh && !forceHidden && visible > 0.01f )
-      return mesh->castRayRendered( frame, start, end, rayInfo, materials );
-   return false;
+   if( !mesh || forceHidden || visible <= 0.01f )
+      return false;
+
+   if ( mesh->getMeshType() == TSMesh::SkinMeshType )
+      return mesh->castRayBVH( getSkinRayBVH( objectDetail ), start, end, rayInfo, materials );
+
+   return mesh->castRayRendered( frame, start, end, rayInfo, materials );
+}
+
+void TSShapeInstance::MeshObjectInstance::castRays( S32 objectDetail, const Point3F *starts, const Point3F *ends, U32 count, RayInfo *results, U8 *hit, TSMaterialList *materials )
+{
+   TSMesh* mesh = getMesh( objectDetail );
+   if( !mesh || forceHidden || visible <= 0.01f )
+      return;
+
+   if ( mesh->getMeshType() == TSMesh::SkinMeshType )
+      mesh->castRaysBVH( getSkinRayBVH( objectDetail ), starts, ends, count, results, hit, materials );
+   else
+      mesh->castRays( frame, starts, ends, count, results, hit, materials );
+}
+
+TSMeshBVH* TSShapeInstance::MeshObjectInstance::getSkinRayBVH( S32 objectDetail )
+{
+   TSMesh *mesh = getMesh( objectDetail );
+   if ( !mesh || mesh->getMeshType() != TSMesh::SkinMeshType )
+      return NULL;
+
+   if ( mSkinRayBVH && mSkinRayDetail == objectDetail && mSkinRayGeneration == *mTransformsGeneration )
+      return mSkinRayBVH;
+
+   PROFILE_SCOPE( TSShapeInstance_MeshObjectInstance_getSkinRayBVH );
+
+   TSSkinMesh *skin = static_cast<TSSkinMesh*>( mesh );
+
+   // A new detail means a different mesh, and so a different tree
+   if ( mSkinRayDetail != objectDetail )
+   {
+      SAFE_DELETE( mSkinRayBVH );
+
+      const TSMeshBVH *bindBVH = skin->getBindRayBVH();
+      if ( !bindBVH )
+         return NULL;
+
+      mSkinRayBVH = new TSMeshBVH( *bindBVH );
+      mSkinRayDetail = objectDetail;
+   }
+
+   skin->skinPositions( *mTransforms, mSkinRayBones, mSkinRayVerts );
+   mSkinRayBVH->refit( mSkinRayVerts.address(), sizeof( Point3F ) );
+   mSkinRayGeneration = *mTransformsGeneration;
+
+   return mSkinRayBVH;
 }
 
 void TSShape::findColDetails( bool useVisibleMesh, Vector<S32> *outDetails, Vector<S32> *outLOSDetails ) const
@@ -30,12 +30,89 @@ BEGIN_NS(DTShape)
 
 //-----------------------------------------------------------------------------
 
-#define SETUPTO(upto) ( ((1<<(upto&31))-1)*2+1 ) // careful not to shift more than 31 times
+#define SETUPTO(upto) ( ((1U<<(upto&31))-1)*2+1 ) // careful not to shift more than 31 times
+
+// x86-64 always has SSE2, so the whole set operations can use it
+#if defined(LIBDTSHAPE_CPU_X86_64)
+#  include <emmintrin.h>
+#  define TS_SET_SSE2
+#endif
+#if defined(LIBDTSHAPE_COMPILER_VISUALC)
+#  include <intrin.h>
+#endif
+
+static inline S32 _lowestBit(U32 dword)
+{
+#if defined(LIBDTSHAPE_COMPILER_GCC)
+   return __builtin_ctz(dword);
+#elif defined(LIBDTSHAPE_COMPILER_VISUALC)
+   unsigned long bit;
+   _BitScanForward(&bit, dword);
+   return (S32)bit;
+#else
+   S32 bit = 0;
+   while (!(dword & 1))
+   {
+      dword >>= 1;
+      bit++;
+   }
+   return bit;
+#endif
+}
+
+static inline S32 _highestBit(U32 dword)
+{
+#if defined(LIBDTSHAPE_COMPILER_GCC)
+   return 31 - __builtin_clz(dword);
+#elif defined(LIBDTSHAPE_COMPILER_VISUALC)
+   unsigned long bit;
+   _BitScanReverse(&bit, dword);
+   return (S32)bit;
+#else
+   return (S32)getBinLog2(dword);
+#endif
+}
+
+static inline S32 _countBits(U32 dword)
+{
+#if defined(LIBDTSHAPE_COMPILER_GCC)
+   return __builtin_popcount(dword);
+#else
+   dword = dword - ((dword >> 1) & 0x55555555);
+   dword = (dword & 0x33333333) + ((dword >> 2) & 0x33333333);
+   return (S32)((((dword + (dword >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+#endif
+}
+
+void TSIntegerSet::reserve(S32 dwords)
+{
+   if (dwords <= numDwords)
+      return;
+
+   // grow geometrically so sets built up bit by bit don't keep reallocating
+   S32 newDwords = getMax(dwords, numDwords * 2);
+   newDwords = (newDwords + DwordAlign - 1) & ~(DwordAlign - 1);
+
+   U32 *newBits = new U32[newDwords];
+   dMemcpy(newBits, getBits(), numDwords*4);
+   dMemset(newBits + numDwords, 0, (newDwords-numDwords)*4);
+
+   if (numDwords > InlineDwords)
+      delete [] heapBits;
+   heapBits = newBits;
+   numDwords = newDwords;
+}
+
+void TSIntegerSet::clearAll()
+{
+   dMemset(getBits(),0,numDwords*4);
+}
 
 void TSIntegerSet::clearAll(S32 upto)
 {
-   AssertFatal(upto<=MAX_TS_SET_SIZE,"TSIntegerSet::clearAll: out of range");
+   upto = getMin(upto, numDwords<<5);
 
+   U32 *bits = getBits();
    dMemset(bits,0,(upto>>5)*4);
    if (upto&31)
       bits[upto>>5] &= ~SETUPTO(upto);
@@ -43,16 +120,24 @@ void TSIntegerSet::clearAll(S32 upto)
 
 void TSIntegerSet::setAll(S32 upto)
 {
-   AssertFatal(upto<=MAX_TS_SET_SIZE,"TSIntegerSet::setAll: out of range");
+   reserve((upto+31)>>5);
 
-   dMemset(bits,0xFFFFFFFF,(upto>>5)*4);
+   U32 *bits = getBits();
+   dMemset(bits,0xFF,(upto>>5)*4);
    if (upto&31)
       bits[upto>>5] |= SETUPTO(upto);
 }
 
+bool TSIntegerSet::testAll() const
+{
+   return testAll(numDwords<<5);
+}
+
 bool TSIntegerSet::testAll(S32 upto) const
 {
-   AssertFatal(upto<=MAX_TS_SET_SIZE,"TSIntegerSet::testAll: out of range");
+   upto = getMin(upto, numDwords<<5);
+
+   const U32 *bits = getBits();
    S32 i;
    for (i=0; i<(upto>>5); i++)
       if (bits[i])
@@ -62,77 +147,112 @@ bool TSIntegerSet::testAll(S32 upto) const
    return false;
 }
 
+S32 TSIntegerSet::count() const
+{
+   return count(numDwords<<5);
+}
+
 S32 TSIntegerSet::count(S32 upto) const
 {
-   AssertFatal(upto<=MAX_TS_SET_SIZE,"TSIntegerSet::count: out of range");
+   upto = getMin(upto, numDwords<<5);
 
+   const U32 *bits = getBits();
    S32 count = 0;
-   U32 dword = bits[0];
-   for (S32 i = 0; i < upto; i++)
-   {
-      // get next word
-      if (!(i & 0x1F))
-         dword = bits[i>>5];
-      // test bits in word
-      if (dword & (1 << (i & 0x1F)))
-         count++;
-   }
+   for (S32 i=0; i<(upto>>5); i++)
+      count += _countBits(bits[i]);
+   if (upto&31)
+      count += _countBits(bits[upto>>5] & ~(0xFFFFFFFF << (upto&31)));
    return count;
 }
 
 void TSIntegerSet::intersect(const TSIntegerSet & otherSet)
 {
-   for (S32 i=0; i<MAX_TS_SET_DWORDS; i++)
-      bits[i] &= otherSet.bits[i];
+   const S32 sz = getMin(numDwords, otherSet.numDwords);
+   U32 *bits = getBits();
+   const U32 *otherBits = otherSet.getBits();
+
+   S32 i = 0;
+#ifdef TS_SET_SSE2
+   for (; i<sz; i+=4)
+   {
+      __m128i a = _mm_loadu_si128((const __m128i*)&bits[i]);
+      __m128i b = _mm_loadu_si128((const __m128i*)&otherBits[i]);
+      _mm_storeu_si128((__m128i*)&bits[i], _mm_and_si128(a, b));
+   }
+#endif
+   for (; i<sz; i++)
+      bits[i] &= otherBits[i];
+
+   // the other set has nothing past its end
+   dMemset(bits+sz,0,(numDwords-sz)*4);
 }
 
 void TSIntegerSet::overlap(const TSIntegerSet & otherSet)
 {
-   for (S32 i=0; i<MAX_TS_SET_DWORDS; i++)
-      bits[i] |= otherSet.bits[i];
+   const S32 sz = (otherSet.end()+31)>>5;
+   reserve(sz);
+   U32 *bits = getBits();
+   const U32 *otherBits = otherSet.getBits();
+
+   S32 i = 0;
+#ifdef TS_SET_SSE2
+   for (; i+4<=sz; i+=4)
+   {
+      __m128i a = _mm_loadu_si128((const __m128i*)&bits[i]);
+      __m128i b = _mm_loadu_si128((const __m128i*)&otherBits[i]);
+      _mm_storeu_si128((__m128i*)&bits[i], _mm_or_si128(a, b));
+   }
+#endif
+   for (; i<sz; i++)
+      bits[i] |= otherBits[i];
 }
 
 void TSIntegerSet::difference(const TSIntegerSet & otherSet)
 {
-   for (S32 i=0; i<MAX_TS_SET_DWORDS; i++)
-      bits[i] = (bits[i] | otherSet.bits[i]) & ~(bits[i] & otherSet.bits[i]);
+   const S32 sz = (otherSet.end()+31)>>5;
+   reserve(sz);
+   U32 *bits = getBits();
+   const U32 *otherBits = otherSet.getBits();
+
+   S32 i = 0;
+#ifdef TS_SET_SSE2
+   for (; i+4<=sz; i+=4)
+   {
+      __m128i a = _mm_loadu_si128((const __m128i*)&bits[i]);
+      __m128i b = _mm_loadu_si128((const __m128i*)&otherBits[i]);
+      _mm_storeu_si128((__m128i*)&bits[i], _mm_xor_si128(a, b));
+   }
+#endif
+   for (; i<sz; i++)
+      bits[i] ^= otherBits[i];
 }
 
 void TSIntegerSet::takeAway(const TSIntegerSet & otherSet)
 {
-   for (S32 i=0; i<MAX_TS_SET_DWORDS; i++)
-      bits[i] &= ~otherSet.bits[i];
+   const S32 sz = getMin(numDwords, otherSet.numDwords);
+   U32 *bits = getBits();
+   const U32 *otherBits = otherSet.getBits();
+
+   S32 i = 0;
+#ifdef TS_SET_SSE2
+   for (; i<sz; i+=4)
+   {
+      __m128i a = _mm_loadu_si128((const __m128i*)&bits[i]);
+      __m128i b = _mm_loadu_si128((const __m128i*)&otherBits[i]);
+      _mm_storeu_si128((__m128i*)&bits[i], _mm_andnot_si128(b, a));
+   }
+#endif
+   for (; i<sz; i++)
+      bits[i] &= ~otherBits[i];
 }
 
 S32 TSIntegerSet::start() const
 {
-   for (S32 i=0; i<MAX_TS_SET_DWORDS; i++)
+   const U32 *bits = getBits();
+   for (S32 i=0; i<numDwords; i++)
    {
-      // search for set bit one dword at a time
-      U32 dword = bits[i];
-      if (dword!=0)
-      {
-         // got dword, now search one byte at a time
-         S32 j = 0;
-         U32 mask = 0xFF;
-         do
-         {
-            if (dword&mask)
-            {
-               // got byte, now search one bit at a time
-               U32 bit = mask & ~(mask<<1); // grabs the smallest bit
-               do
-               {
-                  if (dword&bit)
-                     return (i<<5)+j;
-                  j++;
-                  bit <<= 1;
-               } while (1);
-            }
-            mask <<= 8;
-            j += 8;
-         } while (1);
-      }
+      if (bits[i]!=0)
+         return (i<<5) + _lowestBit(bits[i]);
    }
 
    return MAX_TS_SET_SIZE;
@@ -140,33 +260,11 @@ S32 TSIntegerSet::start() const
 
 S32 TSIntegerSet::end() const
 {
-   for (S32 i=MAX_TS_SET_DWORDS-1; i>=0; i--)
+   const U32 *bits = getBits();
+   for (S32 i=numDwords-1; i>=0; i--)
    {
-      // search for set bit one dword at a time
-      U32 dword = bits[i];
-      if (bits[i])
-      {
-         // got dword, now search one byte at a time
-         S32 j = 31;
-         U32 mask = 0xFF000000;
-         do
-         {
-            if (dword&mask)
-            {
-               // got byte, now one bit at a time
-               U32 bit = mask & ~(mask>>1); // grabs the highest bit
-               do
-               {
-                  if (dword&bit)
-                     return (i<<5)+j+1;
-                  j--;
-                  bit >>= 1;
-               } while (1);
-            }
-            mask >>= 8;
-            j -= 8;
-         } while (1);
-      }
+      if (bits[i]!=0)
+         return (i<<5) + _highestBit(bits[i]) + 1;
    }
 
    return 0;
@@ -175,63 +273,51 @@ S32 TSIntegerSet::end() const
 void TSIntegerSet::next(S32 & i) const
 {
    i++;
-   U32 idx = i>>5;
-   U32 bit = 1 << (i&31);
-   U32 dword = bits[idx] & ~(bit-1);
-   while (dword==0)
+   S32 idx = i>>5;
+   if (idx >= numDwords)
    {
-      i = (i+32) & ~31;
-      if (i>=MAX_TS_SET_SIZE)
-         return;
-      dword=bits[++idx];
-      bit = 1;
-   }
-   dword = bits[idx];
-   while ( (bit & dword) == 0)
-   {
-      bit <<= 1;
-      i++;
+      i = MAX_TS_SET_SIZE;
+      return;
    }
-}
 
-/* Or would one byte at a time be better...
-void TSIntegerSet::next(S32 & i)
-{
-   U32 idx = i>>3;
-   U8 bit = 1 << (i&7);
-   U8 byte = ((U8*)bits)[idx] & ~(bit*2-1);
-   while (byte==0)
+   // mask off the bits below i, then skip to the next non-empty dword
+   const U32 *bits = getBits();
+   U32 dword = bits[idx] & (0xFFFFFFFF << (i&31));
+   while (dword==0)
    {
-      i = (i+8) & ~7;
-      if (i>=MAX_TS_SET_SIZE)
+      if (++idx >= numDwords)
+      {
+         i = MAX_TS_SET_SIZE;
          return;
-      byte=((U8*)bits)[++idx];
-      bit = 1;
-   }
-   byte = ((U8*)bits)[idx];
-   while (bit & byte == 0)
-   {
-      bit <<= 1;
-      i++;
+      }
+      dword = bits[idx];
    }
+   i = (idx<<5) + _lowestBit(dword);
 }
-*/
 
 void TSIntegerSet::copy(const TSIntegerSet & otherSet)
 {
-   dMemcpy(bits,otherSet.bits,MAX_TS_SET_DWORDS*4);
+   if (&otherSet == this)
+      return;
+
+   // only as much storage as the other set actually uses
+   const S32 sz = getMin(otherSet.numDwords, (S32)(((otherSet.end()+127)>>7)<<2));
+   reserve(sz);
+   U32 *bits = getBits();
+   dMemcpy(bits,otherSet.getBits(),sz*4);
+   dMemset(bits+sz,0,(numDwords-sz)*4);
 }
 
 void TSIntegerSet::insert(S32 index, bool value)
 {
-   AssertFatal(index<MAX_TS_SET_SIZE,"TSIntegerSet::insert: out of range");
+   AssertFatal(index>=0,"TSIntegerSet::insert: out of range");
 
-   // shift bits in words after the insertion point
-   U32 endWord = (end() >> 5) + 1;
-   if (endWord >= MAX_TS_SET_DWORDS)
-      endWord = MAX_TS_SET_DWORDS-1;
+   // make room for the highest bit to move up one
+   reserve((getMax(end(),index)>>5) + 1);
+   U32 *bits = getBits();
 
-   for (S32 i = endWord; i > (index >> 5); i--)
+   // shift bits in words after the insertion point
+   for (S32 i = numDwords-1; i > (index >> 5); i--)
    {
       bits[i] = bits[i] << 1;
       if (bits[i-1] & 0x80000000)
@@ -239,8 +325,8 @@ void TSIntegerSet::insert(S32 index, bool value)
    }
 
    // shift to create space in target word
-   U32 lowMask = (1 << (index & 0x1f)) - 1;              // bits below the insert point
-   U32 highMask = ~(lowMask | (1 << (index & 0x1f)));    // bits above the insert point
+   U32 lowMask = (1U << (index & 0x1f)) - 1;              // bits below the insert point
+   U32 highMask = ~(lowMask | (1U << (index & 0x1f)));    // bits above the insert point
 
    S32 word = index >> 5;
    bits[word] = ((bits[word] << 1) & highMask) | (bits[word] & lowMask);
@@ -252,20 +338,20 @@ void TSIntegerSet::insert(S32 index, bool value)
 
 void TSIntegerSet::erase(S32 index)
 {
-   AssertFatal(index<MAX_TS_SET_SIZE,"TSIntegerSet::erase: out of range");
+   AssertFatal(index>=0,"TSIntegerSet::erase: out of range");
 
-   // shift to erase bit in target word
    S32 word = index >> 5;
-   U32 lowMask = (1 << (index & 0x1f)) - 1;              // bits below the erase point
+   if (word >= numDwords)
+      return;
+   U32 *bits = getBits();
+
+   // shift to erase bit in target word
+   U32 lowMask = (1U << (index & 0x1f)) - 1;              // bits below the erase point
 
    bits[word] = ((bits[word] >> 1) & ~lowMask) | (bits[word] & lowMask);
 
    // shift bits in words after the erase point
-   U32 endWord = (end() >> 5) + 1;
-   if (endWord >= MAX_TS_SET_DWORDS)
-      endWord = MAX_TS_SET_DWORDS-1;
-
-   for (S32 i = (index >> 5) + 1; i <= endWord; i++)
+   for (S32 i = word + 1; i < numDwords; i++)
    {
       if (bits[i] & 0x1)
          bits[i-1] |= 0x80000000;
@@ -275,14 +361,23 @@ void TSIntegerSet::erase(S32 index)
 
 TSIntegerSet::TSIntegerSet()
 {
+   numDwords = InlineDwords;
    clearAll();
 }
 
 TSIntegerSet::TSIntegerSet(const TSIntegerSet & otherSet)
 {
+   numDwords = InlineDwords;
+   clearAll();
    copy(otherSet);
 }
 
+TSIntegerSet::~TSIntegerSet()
+{
+   if (numDwords > InlineDwords)
+      delete [] heapBits;
+}
+
 void TSIntegerSet::read(Stream * s)
 {
    clearAll();
@@ -292,8 +387,9 @@ void TSIntegerSet::read(Stream * s)
 
    S32 sz;
    s->read(&sz);
-   AssertFatal(sz<=MAX_TS_SET_DWORDS,"TSIntegerSet::  set too large...increase max set size and re-compile");
+   reserve(sz);
 
+   U32 *bits = getBits();
    for (S32 i=0; i<sz; i++) // now mirrors the write code...
       s->read(&(bits[i]));
 }
@@ -301,11 +397,9 @@ void TSIntegerSet::read(Stream * s)
 void TSIntegerSet::write(Stream * s) const
 {
    s->write((S32)0); // don't do this anymore, keep in to avoid versioning
-   S32 i,sz=0;
-   for (i=0; i<MAX_TS_SET_DWORDS; i++)
-      if (bits[i]!=0)
-         sz=i+1;
+   S32 i,sz=(end()+31)>>5;
    s->write(sz);
+   const U32 *bits = getBits();
    for (i=0; i<sz; i++)
       s->write(bits[i]);
 }
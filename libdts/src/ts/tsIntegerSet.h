@@ -36,22 +36,43 @@ BEGIN_NS(DTShape)
 
 //-----------------------------------------------------------------------------
 
-#if defined(LIBDTSHAPE_MAX_LIB)
-#define MAX_TS_SET_DWORDS 32
-#else
-#define MAX_TS_SET_DWORDS 64
-#endif
-
-#define MAX_TS_SET_SIZE   (32*MAX_TS_SET_DWORDS)
+/// Returned by TSIntegerSet::start() and TSIntegerSet::next() once there are
+/// no more set bits
+#define MAX_TS_SET_SIZE   S32_MAX
 
 class Stream;
 
 /// The standard mathmatical set, where there are no duplicates.  However,
 /// this set uses bits instead of numbers.
+///
+/// The set grows to hold the highest bit set in it, so there is no limit on
+/// the number of nodes or objects. Sets of up to 256 bits are stored inline,
+/// so copying one doesn't touch the heap. Bits past the end of the storage
+/// are treated as false.
 class TSIntegerSet
 {
-   /// The bits!
-   U32 bits[MAX_TS_SET_DWORDS];
+   enum
+   {
+      InlineDwords = 8,    ///< 256 bits
+      DwordAlign   = 4     ///< storage is a multiple of 128 bits for the SIMD paths
+   };
+
+   /// Number of dwords of storage (a multiple of DwordAlign)
+   S32 numDwords;
+
+   /// The bits! Stored inline unless numDwords > InlineDwords. Nothing points
+   /// into the set itself, so Vector can move it around with memmove.
+   union
+   {
+      U32 inlineBits[InlineDwords];
+      U32 *heapBits;
+   };
+
+   U32 *getBits() { return numDwords > InlineDwords ? heapBits : inlineBits; }
+   const U32 *getBits() const { return numDwords > InlineDwords ? heapBits : inlineBits; }
+
+   /// Makes sure the storage holds at least @a dwords dwords
+   void reserve(S32 dwords);
 
 public:
 
@@ -63,14 +84,17 @@ public:
    bool test(S32 index) const;
 
    /// Sets all bits to false
-   void clearAll(S32 upto = MAX_TS_SET_SIZE);
-   /// Sets all bits to true
-   void setAll(S32 upto = MAX_TS_SET_SIZE);
+   void clearAll();
+   void clearAll(S32 upto);
+   /// Sets all bits below upto to true
+   void setAll(S32 upto);
    /// Tests all bits for true
-   bool testAll(S32 upto = MAX_TS_SET_SIZE) const;
+   bool testAll() const;
+   bool testAll(S32 upto) const;
 
    /// Counts set bits
-   S32 count(S32 upto = MAX_TS_SET_SIZE) const;
+   S32 count() const;
+   S32 count(S32 upto) const;
 
    /// intersection (a & b)
    void intersect(const TSIntegerSet&);
@@ -98,27 +122,31 @@ public:
 
    TSIntegerSet();
    TSIntegerSet(const TSIntegerSet&);
+   ~TSIntegerSet();
 };
 
 inline void TSIntegerSet::clear(S32 index)
 {
-   AssertFatal(index>=0 && index<MAX_TS_SET_SIZE,"TS::IntegerSet::clear");
+   AssertFatal(index>=0,"TS::IntegerSet::clear");
 
-   bits[index>>5] &= ~(1 << (index & 31));
+   if ((index>>5) < numDwords)
+      getBits()[index>>5] &= ~(1U << (index & 31));
 }
 
 inline void TSIntegerSet::set(S32 index)
 {
-   AssertFatal(index>=0 && index<MAX_TS_SET_SIZE,"TS::IntegerSet::set");
+   AssertFatal(index>=0,"TS::IntegerSet::set");
 
-   bits[index>>5] |= 1 << (index & 31);
+   if ((index>>5) >= numDwords)
+      reserve((index>>5)+1);
+   getBits()[index>>5] |= 1U << (index & 31);
 }
 
 inline bool TSIntegerSet::test(S32 index) const
 {
-   AssertFatal(index>=0 && index<MAX_TS_SET_SIZE,"TS::IntegerSet::test");
+   AssertFatal(index>=0,"TS::IntegerSet::test");
 
-   return ((bits[index>>5] & (1 << (index & 31)))!=0);
+   return (index>>5) < numDwords && ((getBits()[index>>5] & (1U << (index & 31)))!=0);
 }
 
 //-----------------------------------------------------------------------------
@@ -30,11 +30,13 @@
 #include "ts/tsShapeInstance.h"
 #include "ts/tsRenderState.h"
 #include "ts/tsMaterialList.h"
+#include "ts/tsMeshBVH.h"
 #include "math/mMath.h"
 #include "math/mathIO.h"
 #include "math/mathUtils.h"
 #include "core/log.h"
 #include "collision/convex.h"
+#include "collision/collision.h"
 #include "collision/optimizedPolyList.h"
 #include "platform/profiler.h"
 #include "ts/tsMaterialManager.h"
@@ -169,12 +171,23 @@ void TSMesh::innerRender( TSMaterialList *materials, TSRenderState &rdata, TSMes
    if ( getMeshType() == TSMesh::SkinMeshType )
    {
       TSShapeInstance::MeshObjectInstance *objInst = (TSShapeInstance::MeshObjectInstance*)rdata.getMeshObjectInstance();
-      coreRI->mNodeTransforms = objInst->mActiveTransforms.address();
-      coreRI->mNumNodeTransforms = objInst->mActiveTransforms.size();
+      if ( static_cast<TSSkinMesh*>(this)->batchData.dualQuat )
+      {
+         coreRI->mNodeDualQuats = objInst->mActiveDualQuats.address();
+         coreRI->mNumNodeDualQuats = objInst->mActiveDualQuats.size();
+         coreRI->mNumNodeTransforms = 0;
+      }
+      else
+      {
+         coreRI->mNodeTransforms = objInst->mActiveTransforms.address();
+         coreRI->mNumNodeTransforms = objInst->mActiveTransforms.size();
+         coreRI->mNumNodeDualQuats = 0;
+      }
    }
    else
    {
       coreRI->mNumNodeTransforms = 0;
+      coreRI->mNumNodeDualQuats = 0;
    }
    
    for ( S32 i = 0; i < primitives.size(); i++ )
@@ -553,270 +566,204 @@ void TSMesh::support( S32 frame, const Point3F &v, F32 *currMaxDP, Point3F *curr
 
 bool TSMesh::castRay( S32 frame, const Point3F & start, const Point3F & end, RayInfo * rayInfo, TSMaterialList* materials )
 {
-#if 0
-   if ( planeNormals.empty() )
-      buildConvexHull(); // if haven't done it yet...
-
-   // Keep track of startTime and endTime.  They start out at just under 0 and just over 1, respectively.
-   // As we check against each plane, prune start and end times back to represent current intersection of
-   // line with all the planes (or rather with all the half-spaces defined by the planes).
-   // But, instead of explicitly keeping track of startTime and endTime, keep track as numerator and denominator
-   // so that we can avoid as many divisions as possible.
-
-   //   F32 startTime = -0.01f;
-   F32 startNum = -0.01f;
-   F32 startDen =  1.00f;
-   //   F32 endTime   = 1.01f;
-   F32 endNum = 1.01f;
-   F32 endDen = 1.00f;
-
-   S32 curPlane = 0;
-   U32 curMaterial = 0;
-   bool found = false;
-
-   // the following block of code is an optimization...
-   // it isn't necessary if the longer version of the main loop is used
-   bool tmpFound;
-   S32 tmpPlane;
-   F32 sgn = -1.0f;
-   F32 * pnum = &startNum;
-   F32 * pden = &startDen;
-   S32 * pplane = &curPlane;
-   bool * pfound = &found;
-
-   S32 startPlane = frame * planesPerFrame;
-   for ( S32  i = startPlane; i < startPlane + planesPerFrame; i++ )
-   {
-      // if start & end outside, no collision
-      // if start & end inside, continue
-      // if start outside, end inside, or visa versa, find intersection of line with plane
-      //    then update intersection of line with hull (using startTime and endTime)
-      F32 dot1 = mDot( planeNormals[i], start ) - planeConstants[i];
-      F32 dot2 = mDot( planeNormals[i], end) - planeConstants[i];
-      if ( dot1 * dot2 > 0.0f )
-      {
-         // same side of the plane...which side -- dot==0 considered inside
-         if ( dot1 > 0.0f )
-            return false; // start and end outside of this plane, no collision
-         
-         // start and end inside plane, continue
-         continue;
-      }
+   // Collision meshes go through the same triangle hierarchy as visible
+   // ones, which also copes with meshes which are not convex.
+   return TSMesh::castRayRendered( frame, start, end, rayInfo, materials );
+}
 
-      //AssertFatal( dot1 / ( dot1 - dot2 ) >= 0.0f && dot1 / ( dot1 - dot2 ) <= 1.0f,"TSMesh::castRay (1)" );
-
-      // find intersection (time) with this plane...
-      // F32 time = dot1 / (dot1-dot2);
-      F32 num = mFabs( dot1 );
-      F32 den = mFabs( dot1 - dot2 );
-
-      // the following block of code is an optimized version...
-      // this can be commented out and the following block of code used instead
-      // if debugging a problem in this code, that should probably be done
-      // if you want to see how this works, look at the following block of code,
-      // not this one...
-      // Note that this does not get optimized appropriately...it is included this way
-      // as an idea for future optimization.
-      if ( sgn * dot1 >= 0 )
-      {
-         sgn *= -1.0f;
-         pnum = (F32*) ((dsize_t)pnum ^ (dsize_t)&endNum ^ (dsize_t)&startNum);
-         pden = (F32*) ((dsize_t)pden ^ (dsize_t)&endDen ^ (dsize_t)&startDen);
-         pplane = (S32*) ((dsize_t)pplane ^ (dsize_t)&tmpPlane ^ (dsize_t)&curPlane);
-         pfound = (bool*) ((dsize_t)pfound ^ (dsize_t)&tmpFound ^ (dsize_t)&found);
-      }
-
-      bool noCollision = num * endDen * sgn < endNum * den * sgn && num * startDen * sgn < startNum * den * sgn;
-      if (num * *pden * sgn < *pnum * den * sgn && !noCollision)
-      {
-         *pnum = num;
-         *pden = den;
-         *pplane = i;
-         *pfound = true;
-      }
-      else if ( noCollision )
-         return false;
-
-//      if (dot1<=0.0f)
-//      {
-//         // start is inside plane, end is outside...chop off end
-//         if (num*endDen<endNum*den) // if (time<endTime)
-//         {
-//            if (num*startDen<startNum*den) //if (time<startTime)
-//               // no intersection of line and hull
-//               return false;
-//            // endTime = time;
-//            endNum = num;
-//            endDen = den;
-//         }
-//         // else, no need to do anything, just continue (we've been more inside than this)
-//      }
-//      else // dot2<=0.0f
-//      {
-//         // end is inside poly, start is outside...chop off start
-//         AssertFatal(dot2<=0.0f,"TSMesh::castRay (2)");
-//         if (num*startDen>startNum*den) // if (time>startTime)
-//        {
-//            if (num*endDen>endNum*den) //if (time>endTime)
-//               // no intersection of line and hull
-//               return false;
-//            // startTime   = time;
-//            startNum = num;
-//            startDen = den;
-//            curPlane    = i;
-//            curMaterial = planeMaterials[i-startPlane];
-//            found = true;
-//         }
-//         // else, no need to do anything, just continue (we've been more inside than this)
-//      }
-   }
-
-   // setup rayInfo
-   if ( found && rayInfo )
-   {
-      curMaterial       = planeMaterials[ curPlane - startPlane ];
-
-      rayInfo->t        = (F32)startNum/(F32)startDen; // finally divide...
-      rayInfo->normal   = planeNormals[curPlane];
-
-      if (materials && materials->size() > 0)
-         rayInfo->material = materials->getMaterialInst( curMaterial );
-      else
-         rayInfo->material = NULL;
+/// Fills in @a rayInfo from a hit on one of @a mesh's triangles
+static void setRayInfo( const TSMesh *mesh, const TSMeshBVH *bvh, const TSMeshBVH::Hit &hit,
+                        const Point3F &start, const Point3F &end, RayInfo *rayInfo, TSMaterialList *materials )
+{
+   U32 idx[3], matIndex;
+   bvh->getTriangle( hit.triangle, idx, matIndex );
 
-      rayInfo->setContactPoint( start, end );
+   rayInfo->t = hit.t;
+   rayInfo->normal = hit.normal;
+   rayInfo->face = hit.triangle;
+   rayInfo->barycentric = hit.bary;
+   rayInfo->material = materials ? materials->getMaterialInst( matIndex ) : NULL;
 
-      return true;
+   if ( rayInfo->generateTexCoord )
+   {
+      const F32 w1 = hit.bary.x;
+      const F32 w2 = hit.bary.y;
+      const F32 w0 = 1.0f - w1 - w2;
+
+      if ( mesh->mVertexData.isReady() )
+      {
+         rayInfo->texCoord = mesh->mVertexData.getBase( idx[0] ).tvert() * w0 +
+                             mesh->mVertexData.getBase( idx[1] ).tvert() * w1 +
+                             mesh->mVertexData.getBase( idx[2] ).tvert() * w2;
+      }
+      else if ( mesh->tverts.size() > 0 )
+      {
+         rayInfo->texCoord = mesh->tverts[idx[0]] * w0 + mesh->tverts[idx[1]] * w1 + mesh->tverts[idx[2]] * w2;
+      }
    }
-   else if ( found )
-      return true;
-#endif
-   // only way to get here is if start is inside hull...
-   // we could return null and just plug in garbage for the material and normal...
-   return false;
+
+   rayInfo->setContactPoint( start, end );
 }
 
 bool TSMesh::castRayRendered( S32 frame, const Point3F & start, const Point3F & end, RayInfo * rayInfo, TSMaterialList* materials )
 {
-#if 0
-   if( vertsPerFrame <= 0 ) 
+   return castRayBVH( getRayBVH( frame ), start, end, rayInfo, materials );
+}
+
+void TSMesh::castRays( S32 frame, const Point3F *starts, const Point3F *ends, U32 count, RayInfo *results, U8 *hit, TSMaterialList *materials )
+{
+   castRaysBVH( getRayBVH( frame ), starts, ends, count, results, hit, materials );
+}
+
+bool TSMesh::castRayBVH( const TSMeshBVH *bvh, const Point3F &start, const Point3F &end, RayInfo *rayInfo, TSMaterialList *materials )
+{
+   if ( !bvh )
       return false;
 
-   if( mNumVerts == 0 )
+   TSMeshBVH::Hit hit;
+   if ( !bvh->castRay( start, end, rayInfo ? &hit : NULL ) )
       return false;
 
-   S32 firstVert  = vertsPerFrame * frame;
+   if ( rayInfo )
+      setRayInfo( this, bvh, hit, start, end, rayInfo, materials );
 
-	bool found = false;
-	F32 best_t = F32_MAX;
-   U32 bestIdx0 = 0, bestIdx1 = 0, bestIdx2 = 0;
-   TSMaterialInstance* bestMaterial = NULL;
-	Point3F dir = end - start;
+   return true;
+}
 
-   for ( S32 i = 0; i < primitives.size(); i++ )
+void TSMesh::castRaysBVH( const TSMeshBVH *bvh, const Point3F *starts, const Point3F *ends, U32 count, RayInfo *results, U8 *hit, TSMaterialList *materials )
+{
+   if ( !bvh )
+      return;
+
+   if ( !results )
    {
-      TSDrawPrimitive & draw = primitives[i];
-      U32 drawStart = draw.start;
+      bvh->castRays( starts, ends, count, NULL, hit, true );
+      return;
+   }
 
-      AssertFatal( draw.matIndex & TSDrawPrimitive::Indexed,"TSMesh::castRayRendered (1)" );
+   // Work through the rays in blocks to keep the scratch on the stack
+   const U32 BlockSize = 64;
+   TSMeshBVH::Hit hits[BlockSize];
+   U8 found[BlockSize];
 
-      U32 matIndex = draw.matIndex & TSDrawPrimitive::MaterialMask;
-      TSMaterialInstance* material = ( materials ? materials->getMaterialInst( matIndex ) : 0 );
+   for ( U32 base = 0; base < count; base += BlockSize )
+   {
+      const U32 num = getMin( count - base, BlockSize );
+      for ( U32 i = 0; i < num; i++ )
+      {
+         hits[i].t = results[base + i].t;
+         found[i] = 0;
+      }
 
-      U32 idx0, idx1, idx2;
+      bvh->castRays( starts + base, ends + base, num, hits, found, false );
+
+      for ( U32 i = 0; i < num; i++ )
+      {
+         if ( !found[i] )
+            continue;
+
+         setRayInfo( this, bvh, hits[i], starts[base + i], ends[base + i], &results[base + i], materials );
+         hit[base + i] = 1;
+      }
+   }
+}
+
+TSMeshBVH* TSMesh::getRayBVH( S32 frame )
+{
+   if ( frame < 0 || frame >= numFrames )
+      return NULL;
+
+   if ( frame < mRayBVHs.size() && mRayBVHs[frame] )
+      return mRayBVHs[frame];
+
+   if ( vertsPerFrame <= 0 )
+      return NULL;
+
+   const S32 firstVert = vertsPerFrame * frame;
+   const Point3F *vertBase;
+   U32 stride;
+
+   if ( mVertexData.isReady() )
+   {
+      if ( mVertexData.size() < firstVert + vertsPerFrame )
+         return NULL;
+      vertBase = &mVertexData.getBase( firstVert ).vert();
+      stride = mVertexData.vertSize();
+   }
+   else
+   {
+      if ( verts.size() < firstVert + vertsPerFrame )
+         return NULL;
+      vertBase = verts.address() + firstVert;
+      stride = sizeof( Point3F );
+   }
+
+   TSMeshBVH *bvh = buildRayBVH( vertBase, stride );
+
+   while ( mRayBVHs.size() <= frame )
+      mRayBVHs.push_back( NULL );
+   mRayBVHs[frame] = bvh;
+
+   return bvh;
+}
+
+TSMeshBVH* TSMesh::buildRayBVH( const Point3F *vertBase, U32 stride ) const
+{
+   Vector<U32> triIndices;
+   Vector<U32> triMaterials;
+
+   for ( S32 i = 0; i < primitives.size(); i++ )
+   {
+      const TSDrawPrimitive & draw = primitives[i];
+      const U32 drawStart = draw.start;
+      const U32 matIndex = draw.matIndex & TSDrawPrimitive::MaterialMask;
+
+      AssertFatal( draw.matIndex & TSDrawPrimitive::Indexed,"TSMesh::buildRayBVH (1)" );
 
-      // gonna depend on what kind of primitive it is...
       if ( (draw.matIndex & TSDrawPrimitive::TypeMask) == TSDrawPrimitive::Triangles )
       {
-         for ( S32 j = 0; j < draw.numElements-2; j++)
+         for ( S32 j = 0; j + 2 < draw.numElements; j += 3 )
          {
-            idx0 = indices[drawStart + j + 0];
-            idx1 = indices[drawStart + j + 1];
-            idx2 = indices[drawStart + j + 2];
-
-			   F32 cur_t = 0;
-			   Point2F b;
-
-			   if(castRayTriangle(start, dir, mVertexData[firstVert + idx0].vert(),
-               mVertexData[firstVert + idx1].vert(), mVertexData[firstVert + idx2].vert(), cur_t, b))
-			   {
-				   if(cur_t < best_t)
-				   {
-					   best_t = cur_t;
-                  bestIdx0 = idx0;
-                  bestIdx1 = idx1;
-                  bestIdx2 = idx2;
-                  bestMaterial = material;
-					   found = true;
-				   }
-			   }
+            triIndices.push_back( indices[drawStart + j + 0] );
+            triIndices.push_back( indices[drawStart + j + 1] );
+            triIndices.push_back( indices[drawStart + j + 2] );
+            triMaterials.push_back( matIndex );
          }
       }
       else
       {
-         AssertFatal( (draw.matIndex & TSDrawPrimitive::TypeMask) == TSDrawPrimitive::Strip,"TSMesh::castRayRendered (2)" );
+         AssertFatal( (draw.matIndex & TSDrawPrimitive::TypeMask) == TSDrawPrimitive::Strip,"TSMesh::buildRayBVH (2)" );
 
-         idx0 = indices[drawStart + 0];
-         idx2 = indices[drawStart + 1];
+         U32 idx0 = indices[drawStart + 0];
+         U32 idx1;
+         U32 idx2 = indices[drawStart + 1];
          U32 * nextIdx = &idx1;
          for ( S32 j = 2; j < draw.numElements; j++ )
          {
             *nextIdx = idx2;
-            // nextIdx = (j%2)==0 ? &idx0 : &idx1;
             nextIdx = (U32*) ( (dsize_t)nextIdx ^ (dsize_t)&idx0 ^ (dsize_t)&idx1);
             idx2 = indices[drawStart + j];
             if ( idx0 == idx1 || idx0 == idx2 || idx1 == idx2 )
                continue;
 
-			   F32 cur_t = 0;
-			   Point2F b;
-
-			   if(castRayTriangle(start, dir, mVertexData[firstVert + idx0].vert(), 
-               mVertexData[firstVert + idx1].vert(), mVertexData[firstVert + idx2].vert(), cur_t, b))
-			   {
-				   if(cur_t < best_t)
-				   {
-					   best_t = cur_t;
-                  bestIdx0 = firstVert + idx0;
-                  bestIdx1 = firstVert + idx1;
-                  bestIdx2 = firstVert + idx2;
-                  bestMaterial = material;
-					   found = true;
-				   }
-			   }
+            triIndices.push_back( idx0 );
+            triIndices.push_back( idx1 );
+            triIndices.push_back( idx2 );
+            triMaterials.push_back( matIndex );
          }
       }
    }
 
-   // setup rayInfo
-   if ( found && rayInfo )
-   {
-      rayInfo->t = best_t;
-
-      Point3F normal;
-      mCross(mVertexData[bestIdx2].vert()-mVertexData[bestIdx0].vert(),mVertexData[bestIdx1].vert()-mVertexData[bestIdx0].vert(),&normal);
-      if ( mDot( normal, normal ) < 0.001f )
-      {
-         mCross( mVertexData[bestIdx0].vert() - mVertexData[bestIdx1].vert(), mVertexData[bestIdx2].vert() - mVertexData[bestIdx1].vert(), &normal );
-         if ( mDot( normal, normal ) < 0.001f )
-         {
-            mCross( mVertexData[bestIdx1].vert() - mVertexData[bestIdx2].vert(), mVertexData[bestIdx0].vert() - mVertexData[bestIdx2].vert(), &normal );
-         }
-      }
-      normal.normalize();
-      rayInfo->normal = normal;
-
-      rayInfo->material = bestMaterial;
-
-      rayInfo->setContactPoint( start, end );
-
-      return true;
-   }
-   else if ( found )
-      return true;
+   TSMeshBVH *bvh = new TSMeshBVH;
+   bvh->build( vertBase, stride, triIndices, triMaterials );
+   return bvh;
+}
 
-#endif
-   return false;
+void TSMesh::clearRayBVHs()
+{
+   for ( S32 i = 0; i < mRayBVHs.size(); i++ )
+      delete mRayBVHs[i];
+   mRayBVHs.clear();
 }
 
 bool TSMesh::addToHull( U32 idx0, U32 idx1, U32 idx2 )
@@ -1111,6 +1058,7 @@ TSMesh::~TSMesh()
 {
    mNumVerts = 0;
    SAFE_DELETE(mRenderer);
+   clearRayBVHs();
 }
 
 //-----------------------------------------------------
@@ -1129,14 +1077,111 @@ void TSSkinMesh::updateSkinBones( const Vector<MatrixF> &transforms, Vector<Matr
    }
 }
 
+void TSSkinMesh::updateSkinBones( const Vector<MatrixF> &transforms, Vector<DualQuatF>& dest )
+{
+   // Update transforms for current mesh
+   dest.setSize(batchData.nodeIndex.size());
+   
+   MatrixF boneMat;
+   for( int i=0; i<batchData.nodeIndex.size(); i++ )
+   {
+      S32 node = batchData.nodeIndex[i];
+      boneMat.mul( transforms[node], batchData.initialTransforms[i] );
+      dest[i].set( boneMat );
+   }
+}
+
+void TSSkinMesh::skinPositions( const Vector<MatrixF> &transforms, Vector<MatrixF> &bones, Vector<Point3F> &outVerts )
+{
+   PROFILE_SCOPE( TSSkinMesh_skinPositions );
+
+   updateSkinBones( transforms, bones );
+
+   const S32 numVerts = batchData.initialVerts.size();
+   outVerts.setSize( numVerts );
+   dMemset( outVerts.address(), 0, numVerts * sizeof( Point3F ) );
+
+   // Straight from the vertex, bone, weight tuples, which every shape has
+   // whichever skinning batches were built
+   Point3F skinned;
+   for ( S32 i = 0; i < vertexIndex.size(); i++ )
+   {
+      const S32 vidx = vertexIndex[i];
+      const S32 bidx = boneIndex[i];
+      const F32 w = weight[i];
+      if ( vidx < 0 || vidx >= numVerts || bidx < 0 || bidx >= bones.size() || w == 0.0f )
+         continue;
+
+      bones[bidx].mulP( batchData.initialVerts[vidx], &skinned );
+      outVerts[vidx] += skinned * w;
+   }
+}
+
+TSMeshBVH* TSSkinMesh::getBindRayBVH()
+{
+   if ( mRayBVHs.size() && mRayBVHs[0] )
+      return mRayBVHs[0];
+
+   if ( batchData.initialVerts.empty() )
+      return NULL;
+
+   TSMeshBVH *bvh = buildRayBVH( batchData.initialVerts.address(), sizeof( Point3F ) );
+   if ( mRayBVHs.empty() )
+      mRayBVHs.push_back( NULL );
+   mRayBVHs[0] = bvh;
+
+   return bvh;
+}
+
 void TSSkinMesh::updateSkin( const Vector<MatrixF> &transforms, TSRenderState &rdata )
 {
    PROFILE_SCOPE( TSSkinMesh_UpdateSkin );
 
    AssertFatal(batchDataInitialized, "Batch data not initialized. Call createBatchData() before any skin update is called.");
 
+   // If using hardware skinning, don't update (data is set in createBatchData)
+   if (!batchData.vertexBatchOperations.empty() && TSShape::useHardwareSkinning())
+      return;
+
    TSMeshInstanceRenderData *renderData = rdata.getCurrentRenderData();
-   
+
+   // Map to verts in renderer. If the renderer provides per-instance storage
+   // the shared mesh vertex data is left untouched.
+   U8 *outPtr = reinterpret_cast<U8 *>(mVertexData.address());
+   U8 *altPtr = mRenderer->mapVerts(this, renderData);
+   if (altPtr) outPtr = altPtr;
+   else mSharedSkinRenderData = renderData;
+
+   skinVerts( transforms, rdata, outPtr, mVertexData.vertSize() );
+
+   // Load verts
+   if (altPtr)
+      mRenderer->unmapVerts(this, renderData);
+}
+
+void TSSkinMesh::uploadSkin( const U8 *skinnedVerts, TSRenderState &rdata )
+{
+   PROFILE_SCOPE( TSSkinMesh_UploadSkin );
+
+   TSMeshInstanceRenderData *renderData = rdata.getCurrentRenderData();
+
+   U8 *outPtr = reinterpret_cast<U8 *>(mVertexData.address());
+   U8 *altPtr = mRenderer->mapVerts(this, renderData);
+   if (altPtr) outPtr = altPtr;
+   else mSharedSkinRenderData = renderData;
+
+   dMemcpy( outPtr, skinnedVerts, mVertexData.size() * mVertexData.vertSize() );
+
+   if (altPtr)
+      mRenderer->unmapVerts(this, renderData);
+
+   _createVBIB(renderData);
+}
+
+void TSSkinMesh::skinVerts( const Vector<MatrixF> &transforms, TSRenderState &rdata, U8 *outPtr, dsize_t outStride )
+{
+   AssertFatal(batchDataInitialized, "Batch data not initialized. Call createBatchData() before any skin update is called.");
+
    // set arrays
 #if defined(LIBDTSHAPE_MAX_LIB)
    verts.setSize(batchData.initialVerts.size());
@@ -1153,26 +1198,46 @@ void TSSkinMesh::updateSkin( const Vector<MatrixF> &transforms, TSRenderState &r
    }
 #endif
    const MatrixF * matrices = NULL;
+   const DualQuatF * dualQuats = NULL;
    
-   if (!TSShape::smUseHardwareSkinning)
+   if (batchData.dualQuat)
    {
-      static Vector<MatrixF> sBoneTransforms;
-      sBoneTransforms.setSize( batchData.nodeIndex.size() );
+      PROFILE_START(TSSkinMesh_UpdateTransforms);
+      updateSkinBones( transforms, rdata.gBoneDualQuats );
+      dualQuats = rdata.gBoneDualQuats.address();
+      PROFILE_END();
+   }
+   else if (!TSShape::useHardwareSkinning())
+   {
+      // The bone palette lives in the render state rather than a static so
+      // that instances skinned on separate threads never share scratch space
+      Vector<MatrixF> &boneTransforms = rdata.gBoneTransforms;
+      boneTransforms.setSize( batchData.nodeIndex.size() );
       
       // set up bone transforms
       PROFILE_START(TSSkinMesh_UpdateTransforms);
       for( int i=0; i<batchData.nodeIndex.size(); i++ )
       {
          S32 node = batchData.nodeIndex[i];
-         sBoneTransforms[i].mul( transforms[node], batchData.initialTransforms[i] );
+         boneTransforms[i].mul( transforms[node], batchData.initialTransforms[i] );
       }
-      matrices = &sBoneTransforms[0];
+      matrices = boneTransforms.address();
       PROFILE_END();
    }
 
    // Perform skinning
    const bool bBatchByVert = !batchData.vertexBatchOperations.empty();
-   if(bBatchByVert)
+   
+   if(batchData.dualQuat)
+   {
+      // Every vertex must have exactly one op, see createDualQuatBatchData
+      AssertFatal( batchData.vertexBatchOperations.size() == batchData.initialVerts.size(), "Assumption failed!" );
+
+      m_dualQuat_x_BatchedVertexList(dualQuats, batchData.vertexBatchOperations.size(),
+         batchData.vertexBatchOperations.address(), batchData.initialVerts.address(),
+         batchData.initialNorms.address(), outPtr, outStride);
+   }
+   else if(bBatchByVert)
    {
       const Point3F *inVerts = &batchData.initialVerts[0];
       const Point3F *inNorms = &batchData.initialNorms[0];
@@ -1183,10 +1248,6 @@ void TSSkinMesh::updateSkin( const Vector<MatrixF> &transforms, TSRenderState &r
 
       Point3F skinnedVert;
       Point3F skinnedNorm;
-      
-      // If using hardware skinning, don't update (data is set in createBatchData)
-      if (TSShape::smUseHardwareSkinning)
-         return;
 
       for( Vector<BatchData::BatchedVertex>::const_iterator itr = batchData.vertexBatchOperations.begin();
          itr != batchData.vertexBatchOperations.end(); itr++ )
@@ -1211,20 +1272,36 @@ void TSSkinMesh::updateSkin( const Vector<MatrixF> &transforms, TSRenderState &r
          
 
          // Assign results 
-         __TSMeshVertexBase &dest = mVertexData.getBase(curVert.vertexIndex);
+         __TSMeshVertexBase &dest = *reinterpret_cast<__TSMeshVertexBase *>(outPtr + curVert.vertexIndex * outStride);
          dest.vert(skinnedVert);
          dest.normal(skinnedNorm);
       }
    }
+   else if (!batchData.vertexBatch4.empty()) // Batch by vertex, blending transforms
+   {
+      AssertFatal( batchData.vertexBatch4.size() >= mNumVerts, "Assumption failed!" );
+
+      m_matF_x_BatchedVertex4List(matrices, mNumVerts, batchData.vertexBatch4.address(),
+         outPtr, outStride);
+   }
+   else if (!batchData.soaBlockStart.empty()) // Structure-of-arrays
+   {
+      const dsize_t numBlocks = batchData.soaBlockStart.size() - 1;
+      const dsize_t streamSize = numBlocks * BatchData::soaBlockSize;
+      AssertFatal( mNumVerts <= streamSize, "Assumption failed!" );
+
+      // Skin into the render state's streams, then interleave into the output
+      rdata.gSoASkinStore.setSize( streamSize * 6 );
+
+      m_matF_x_SoAVertWeightBlocks(matrices, numBlocks, batchData.soaInfluences.address(),
+         batchData.soaBlockStart.address(), batchData.soaInitialStreams.address(),
+         rdata.gSoASkinStore.address(), streamSize);
+
+      interleave_SoA_vert_normal(mNumVerts, rdata.gSoASkinStore.address(), streamSize,
+         outPtr, outStride);
+   }
    else // Batch by transform
    {
-      U8 *outPtr = reinterpret_cast<U8 *>(mVertexData.address());
-      dsize_t outStride = mVertexData.vertSize();
-      
-      // Map to verts in renderer
-      U8 *altPtr = mRenderer->mapVerts(this, renderData);
-      if (altPtr) outPtr = altPtr;
-      
       // Set position/normal to zero so we can accumulate
       zero_vert_normal_bulk(mNumVerts, outPtr, outStride);
 
@@ -1241,10 +1318,6 @@ void TSSkinMesh::updateSkin( const Vector<MatrixF> &transforms, TSRenderState &r
          m_matF_x_BatchedVertWeightList(curBoneMat, numVerts, curTransform.alignedMem,
             outPtr, outStride);
       }
-      
-      // Load verts
-      if (altPtr)
-         mRenderer->unmapVerts(this, renderData);
    }
 }
 
@@ -1262,6 +1335,8 @@ void TSSkinMesh::createBatchData()
       return;
 
    batchDataInitialized = true;
+   batchData.dualQuat = TSShape::smUseDualQuatSkinning;
+
    S32 * curVtx = vertexIndex.begin();
    S32 * curBone = boneIndex.begin();
    F32 * curWeight = weight.begin();
@@ -1296,20 +1371,20 @@ void TSSkinMesh::createBatchData()
          S32 opIdx = batchOperations.last().transformCount++;
 
          // Limit the number of weights per bone (keep the N largest influences)
-         if ( opIdx >= TSSkinMesh::BatchData::maxBonePerVert || (TSShape::smAllowHardwareSkinning && opIdx >= TSSkinMesh::BatchData::maxBonePerVertGPU)  )
+         const S32 maxInfluences = TSShape::smAllowHardwareSkinning && !batchData.dualQuat ? TSSkinMesh::BatchData::maxBonePerVertGPU : TSSkinMesh::BatchData::maxBonePerVert;
+         if ( opIdx >= maxInfluences )
          {
             if ( !issuedWeightWarning )
             {
                issuedWeightWarning = true;
                Log::warnf( "At least one vertex has too many bone weights - limiting "
-                  "to the largest %d influences (see maxBonePerVert in tsMesh.h).",
-                          TSShape::smAllowHardwareSkinning ? TSSkinMesh::BatchData::maxBonePerVertGPU : TSSkinMesh::BatchData::maxBonePerVert );
+                  "to the largest %d influences (see maxBonePerVert in tsMesh.h).", maxInfluences );
             }
 
             // Too many weights => find and replace the smallest one
             S32 minIndex = 0;
             F32 minWeight = batchOperations.last().transform[0].weight;
-            for ( S32 i = 1; i < batchOperations.last().transformCount; i++ )
+            for ( S32 i = 1; i < maxInfluences; i++ )
             {
                if ( batchOperations.last().transform[i].weight < minWeight )
                {
@@ -1318,8 +1393,11 @@ void TSSkinMesh::createBatchData()
                }
             }
 
+            batchOperations.last().transformCount = maxInfluences;
+            if ( w <= minWeight )
+               continue;
+
             opIdx = minIndex;
-            batchOperations.last().transformCount = TSSkinMesh::BatchData::maxBonePerVert;
          }
 
          batchOperations.last().transform[opIdx].transformIndex = midx;
@@ -1357,7 +1435,28 @@ void TSSkinMesh::createBatchData()
       }
    }
 
-   if (TSShape::smAllowHardwareSkinning)
+   // Find the most influences on any one vertex
+   S32 maxInfluences = 0;
+   {
+      Vector<S32> vertInfluences;
+      vertInfluences.setSize(batchData.initialVerts.size());
+      dMemset(vertInfluences.address(), '\0', sizeof(S32) * vertInfluences.size());
+
+      for ( S32 i = 0; i < batchOperations.size(); i++ )
+      {
+         S32 &count = vertInfluences[batchOperations[i].vertexIndex];
+         count += batchOperations[i].transformCount;
+         maxInfluences = getMax(maxInfluences, count);
+      }
+   }
+
+   if (batchData.dualQuat)
+   {
+      // Dual quaternions are only blended on the CPU, so these never use
+      // the hardware layout
+      createDualQuatBatchData(batchOperations);
+   }
+   else if (TSShape::smAllowHardwareSkinning)
    {
       // Copy data to member, and be done
       batchData.vertexBatchOperations.set(batchOperations.address(), batchOperations.size());
@@ -1421,6 +1520,16 @@ void TSSkinMesh::createBatchData()
          v.weight(weights);
       }
    }
+   else if (TSShape::smUseSoASkinning)
+   {
+      createSoABatchData(batchOperations);
+   }
+   else if (maxInfluences <= getMin(TSShape::smMaxSkinByVertexInfluences, (S32)BatchData::maxBonePerVertGPU))
+   {
+      // Few enough influences that blending the transforms per vertex is
+      // cheaper than revisiting each vertex once per bone
+      createVertex4BatchData(batchOperations);
+   }
    else
    {
       // Convert to batch-by-transform, which is better for CPU skinning,
@@ -1483,6 +1592,205 @@ void TSSkinMesh::createBatchData()
    }
 }
 
+void TSSkinMesh::createVertex4BatchData( const Vector<BatchData::BatchedVertex> &batchOperations )
+{
+   const S32 numVerts = batchData.initialVerts.size();
+
+   // Every vertex gets an entry, so vertices without influences are zeroed
+   // just as the batch-by-transform path would
+   batchData.vertexBatch4.setSize(numVerts);
+   for ( S32 i = 0; i < numVerts; i++ )
+   {
+      BatchData::BatchedVertex4 &dest = batchData.vertexBatch4[i];
+      dest.vert = batchData.initialVerts[i];
+      dest.vidx = i;
+      dest.normal = batchData.initialNorms[i];
+      dest.transformCount = 0;
+      for ( S32 j = 0; j < BatchData::maxBonePerVertGPU; j++ )
+      {
+         dest.transformIndex[j] = 0;
+         dest.weight[j] = 0.0f;
+      }
+   }
+
+   for ( S32 i = 0; i < batchOperations.size(); i++ )
+   {
+      const BatchData::BatchedVertex &curVert = batchOperations[i];
+
+      BatchData::BatchedVertex4 &dest = batchData.vertexBatch4[curVert.vertexIndex];
+      for ( S32 j = 0; j < curVert.transformCount; j++ )
+      {
+         AssertFatal( dest.transformCount < BatchData::maxBonePerVertGPU, "Too many weights!" );
+         dest.transformIndex[dest.transformCount] = curVert.transform[j].transformIndex;
+         dest.weight[dest.transformCount] = curVert.transform[j].weight;
+         dest.transformCount++;
+      }
+   }
+}
+
+void TSSkinMesh::createDualQuatBatchData( const Vector<BatchData::BatchedVertex> &batchOperations )
+{
+   const S32 numVerts = batchData.initialVerts.size();
+
+   // The influences of one vertex may be spread over several ops, but dual
+   // quaternions must be blended in one go. Gather them so there is exactly
+   // one op per vertex, in vertex order; vertices without influences keep
+   // a count of zero and are zeroed like the other CPU paths do.
+   batchData.vertexBatchOperations.setSize(numVerts);
+   for ( S32 i = 0; i < numVerts; i++ )
+   {
+      batchData.vertexBatchOperations[i].vertexIndex = i;
+      batchData.vertexBatchOperations[i].transformCount = 0;
+   }
+
+   for ( S32 i = 0; i < batchOperations.size(); i++ )
+   {
+      const BatchData::BatchedVertex &curVert = batchOperations[i];
+      BatchData::BatchedVertex &dest = batchData.vertexBatchOperations[curVert.vertexIndex];
+
+      for ( S32 j = 0; j < curVert.transformCount; j++ )
+      {
+         const BatchData::TransformOp &op = curVert.transform[j];
+         if ( dest.transformCount < BatchData::maxBonePerVert )
+         {
+            dest.transform[dest.transformCount++] = op;
+            continue;
+         }
+
+         // Full, so keep the largest influences. The blend is normalized
+         // afterwards, so the weights need no fixing up.
+         S32 minIndex = 0;
+         for ( S32 k = 1; k < dest.transformCount; k++ )
+         {
+            if ( dest.transform[k].weight < dest.transform[minIndex].weight )
+               minIndex = k;
+         }
+         if ( op.weight > dest.transform[minIndex].weight )
+            dest.transform[minIndex] = op;
+      }
+   }
+}
+
+void TSSkinMesh::createSoABatchData( const Vector<BatchData::BatchedVertex> &batchOperations )
+{
+   const S32 blockSize = BatchData::soaBlockSize;
+   const S32 numVerts = batchData.initialVerts.size();
+   const S32 numBlocks = (numVerts + blockSize - 1) / blockSize;
+   const S32 streamSize = numBlocks * blockSize;
+
+   // Split the initial verts and normals into padded streams
+   batchData.soaInitialStreams.setSize(streamSize * 6);
+   dMemset(batchData.soaInitialStreams.address(), '\0', sizeof(F32) * streamSize * 6);
+
+   F32 *streams = batchData.soaInitialStreams.address();
+   for ( S32 i = 0; i < numVerts; i++ )
+   {
+      streams[i]                  = batchData.initialVerts[i].x;
+      streams[i + streamSize]     = batchData.initialVerts[i].y;
+      streams[i + streamSize * 2] = batchData.initialVerts[i].z;
+      streams[i + streamSize * 3] = batchData.initialNorms[i].x;
+      streams[i + streamSize * 4] = batchData.initialNorms[i].y;
+      streams[i + streamSize * 5] = batchData.initialNorms[i].z;
+   }
+
+   // Rank each bone by the order in which batch-by-transform would visit it.
+   // Influences are accumulated in that order so both paths produce exactly
+   // the same result.
+   Vector<S32> boneRank;
+   boneRank.setSize(batchData.nodeIndex.size());
+   for ( S32 i = 0; i < boneRank.size(); i++ )
+      boneRank[i] = -1;
+
+   S32 nextRank = 0;
+   for ( S32 i = 0; i < batchOperations.size(); i++ )
+   {
+      const BatchData::BatchedVertex &curVert = batchOperations[i];
+      for ( S32 j = 0; j < curVert.transformCount; j++ )
+      {
+         S32 &rank = boneRank[curVert.transform[j].transformIndex];
+         if ( rank == -1 )
+            rank = nextRank++;
+      }
+   }
+
+   // Gather the influences for each vertex. One vertex may be spread over
+   // several ops, so count them first and then fill each vertex's range in
+   // op order.
+   Vector<S32> vertStart;
+   vertStart.setSize(streamSize + 1);
+   dMemset(vertStart.address(), '\0', sizeof(S32) * vertStart.size());
+
+   for ( S32 i = 0; i < batchOperations.size(); i++ )
+      vertStart[batchOperations[i].vertexIndex + 1] += batchOperations[i].transformCount;
+   for ( S32 i = 0; i < streamSize; i++ )
+      vertStart[i + 1] += vertStart[i];
+
+   Vector<S32> vertCount;
+   vertCount.setSize(streamSize);
+   dMemset(vertCount.address(), '\0', sizeof(S32) * vertCount.size());
+
+   Vector<BatchData::TransformOp> vertOps;
+   vertOps.setSize(vertStart[streamSize]);
+   for ( S32 i = 0; i < batchOperations.size(); i++ )
+   {
+      const BatchData::BatchedVertex &curVert = batchOperations[i];
+      S32 &count = vertCount[curVert.vertexIndex];
+      for ( S32 j = 0; j < curVert.transformCount; j++ )
+         vertOps[vertStart[curVert.vertexIndex] + count++] = curVert.transform[j];
+   }
+
+   // insertion sort each vertex by bone rank (stable, and counts are small)
+   for ( S32 i = 0; i < numVerts; i++ )
+   {
+      BatchData::TransformOp *ops = vertOps.address() + vertStart[i];
+      for ( S32 j = 1; j < vertCount[i]; j++ )
+      {
+         const BatchData::TransformOp op = ops[j];
+         S32 k = j - 1;
+         for ( ; k >= 0 && boneRank[ops[k].transformIndex] > boneRank[op.transformIndex]; k-- )
+            ops[k + 1] = ops[k];
+         ops[k + 1] = op;
+      }
+   }
+
+   // Build the influence slots for each block
+   batchData.soaBlockStart.setSize(numBlocks + 1);
+   batchData.soaInfluences.clear();
+
+   for ( S32 block = 0; block < numBlocks; block++ )
+   {
+      batchData.soaBlockStart[block] = batchData.soaInfluences.size();
+
+      S32 slots = 0;
+      for ( S32 lane = 0; lane < blockSize; lane++ )
+         slots = getMax(slots, vertCount[block * blockSize + lane]);
+
+      for ( S32 slot = 0; slot < slots; slot++ )
+      {
+         batchData.soaInfluences.increment();
+         BatchData::SoAInfluence &influence = batchData.soaInfluences.last();
+
+         for ( S32 lane = 0; lane < blockSize; lane++ )
+         {
+            const S32 vidx = block * blockSize + lane;
+            if ( slot < vertCount[vidx] )
+            {
+               const BatchData::TransformOp &op = vertOps[vertStart[vidx] + slot];
+               influence.bone[lane] = op.transformIndex;
+               influence.weight[lane] = op.weight;
+            }
+            else
+            {
+               influence.bone[lane] = -1;
+               influence.weight[lane] = 0.0f;
+            }
+         }
+      }
+   }
+
+   batchData.soaBlockStart[numBlocks] = batchData.soaInfluences.size();
+}
+
 void TSSkinMesh::render( TSMeshRenderer &renderer )
 {
    innerRender( renderer );
@@ -1510,12 +1818,14 @@ void TSSkinMesh::render(   TSMaterialList *materials,
 
    const bool renderDirty = mRenderer->isDirty(this, rdata.getCurrentRenderData());
 
-   if ( renderDirty || isSkinDirty )
+   // The shared vertex data may hold the skin of another instance
+   const bool sharedSkinDirty = mSharedSkinRenderData && mSharedSkinRenderData != rdata.getCurrentRenderData();
+
+   // Perform skinning and update the GFX vertex buffer, unless the
+   // transforms are unchanged since this instance was last skinned
+   if ( renderDirty || isSkinDirty || sharedSkinDirty )
    {
-      // Perform skinning
       updateSkin( transforms, rdata );
-      
-      // Update GFX vertex buffer
       _createVBIB(rdata.getCurrentRenderData());
    }
 
@@ -1549,6 +1859,31 @@ bool TSSkinMesh::castRay( S32 frame, const Point3F &start, const Point3F &end, R
    return false;
 }
 
+void TSSkinMesh::castRays( S32 frame, const Point3F *starts, const Point3F *ends, U32 count, RayInfo *results, U8 *hit, TSMaterialList *materials )
+{
+   LIBDTSHAPE_UNUSED(frame);
+   LIBDTSHAPE_UNUSED(starts);
+   LIBDTSHAPE_UNUSED(ends);
+   LIBDTSHAPE_UNUSED(count);
+   LIBDTSHAPE_UNUSED(results);
+   LIBDTSHAPE_UNUSED(hit);
+   LIBDTSHAPE_UNUSED(materials);
+}
+
+bool TSSkinMesh::castRayRendered( S32 frame, const Point3F &start, const Point3F &end, RayInfo *rayInfo, TSMaterialList *materials )
+{
+   // The vertices here are in the bind pose, not where the instance drew
+   // them. Instances cast against their own refitted copy of the hierarchy
+   // instead (see TSShapeInstance::MeshObjectInstance::getSkinRayBVH).
+   LIBDTSHAPE_UNUSED(frame);
+   LIBDTSHAPE_UNUSED(start);
+   LIBDTSHAPE_UNUSED(end);
+   LIBDTSHAPE_UNUSED(rayInfo);
+   LIBDTSHAPE_UNUSED(materials);
+
+   return false;
+}
+
 bool TSSkinMesh::buildConvexHull()
 {
    return false; // no error, but we don't do anything either...
@@ -2407,53 +2742,16 @@ void TSMesh::assemble( TSIOState &ioState, bool skip )
    tsalloc.get32( (S32*)&mCenter, 3 );
    mRadius = (F32)tsalloc.get32();
 
-   S32 numVerts = tsalloc.get32();
-   S32 *ptr32 = getSharedData32( parentMesh, 3 * numVerts, (S32**)ioState.smVertsList.address(), ioState, skip );
-   verts.set( (Point3F*)ptr32, numVerts );
-
-   S32 numTVerts = tsalloc.get32();
-   ptr32 = getSharedData32( parentMesh, 2 * numTVerts, (S32**)ioState.smTVertsList.address(), ioState, skip );
-   tverts.set( (Point2F*)ptr32, numTVerts );
-
-   if ( ioState.smReadVersion > 25 )
-   {
-      numTVerts = tsalloc.get32();
-      ptr32 = getSharedData32( parentMesh, 2 * numTVerts, (S32**)ioState.smTVerts2List.address(), ioState, skip );
-      tverts2.set( (Point2F*)ptr32, numTVerts );
-
-      S32 numVColors = tsalloc.get32();
-      ptr32 = getSharedData32( parentMesh, numVColors, (S32**)ioState.smColorsList.address(), ioState, skip );
-      colors.set( (ColorI*)ptr32, numVColors );
-   }
-
-   S8 *ptr8;
-   if ( ioState.smReadVersion > 21 && ioState.smUseEncodedNormals)
-   {
-      // we have encoded normals and we want to use them...
-      if ( parentMesh < 0 )
-         tsalloc.getPointer32( numVerts * 3 ); // advance past norms, don't use
-      norms.set( NULL, 0 );
-
-      ptr8 = getSharedData8( parentMesh, numVerts, (S8**)ioState.smEncodedNormsList.address(), ioState, skip );
-      encodedNorms.set( ptr8, numVerts );
-   }
-   else if ( ioState.smReadVersion > 21 )
-   {
-      // we have encoded normals but we don't want to use them...
-      ptr32 = getSharedData32( parentMesh, 3 * numVerts, (S32**)ioState.smNormsList.address(), ioState, skip );
-      norms.set( (Point3F*)ptr32, numVerts );
+   // cache-ready meshes carry their aligned vertex data, tangents included,
+   // and don't share vertex data with a parent mesh
+   TSBasicVertexFormat vertexFormat;
+   if ( ioState.smReadVersion > 27 )
+      vertexFormat.readAlloc( &tsalloc );
 
-      if ( parentMesh < 0 )
-         tsalloc.getPointer8( numVerts ); // advance past encoded normls, don't use
-      encodedNorms.set( NULL, 0 );
-   }
+   if ( vertexFormat.vertexSize > 0 )
+      _assembleVertexData( ioState, vertexFormat, skip );
    else
-   {
-      // no encoded normals...
-      ptr32 = getSharedData32( parentMesh, 3 * numVerts, (S32**)ioState.smNormsList.address(), ioState, skip );
-      norms.set( (Point3F*)ptr32, numVerts );
-      encodedNorms.set( NULL, 0 );
-   }
+      _assembleVertexArrays( ioState, ioState.smReadVersion > 27 ? -1 : parentMesh, skip );
 
    // copy the primitives and indices...how we do this depends on what
    // form we want them in when copied...just get pointers to data for now
@@ -2552,91 +2850,122 @@ void TSMesh::assemble( TSIOState &ioState, bool skip )
    if ( tsalloc.allocShape32( 0 ) && ioState.smReadVersion < 19 )
       computeBounds(); // only do this if we copied the data...
 
-   if(getMeshType() != SkinMeshType)
+   if(getMeshType() != SkinMeshType && !mVertexData.isReady())
       createTangents(verts, norms);
 }
 
-void TSMesh::disassemble(TSIOState &ioState)
+void TSMesh::_assembleVertexArrays( TSIOState &ioState, S32 dataParent, bool skip )
 {
-   tsalloc.setGuard();
+   S32 numVerts = tsalloc.get32();
+   S32 *ptr32 = getSharedData32( dataParent, 3 * numVerts, (S32**)ioState.smVertsList.address(), ioState, skip );
+   verts.set( (Point3F*)ptr32, numVerts );
 
-   tsalloc.set32( numFrames );
-   tsalloc.set32( numMatFrames );
-   tsalloc.set32( parentMesh );
-   tsalloc.copyToBuffer32( (S32*)&mBounds, 6 );
-   tsalloc.copyToBuffer32( (S32*)&mCenter, 3 );
-   tsalloc.set32( (S32)mRadius );
+   S32 numTVerts = tsalloc.get32();
+   ptr32 = getSharedData32( dataParent, 2 * numTVerts, (S32**)ioState.smTVertsList.address(), ioState, skip );
+   tverts.set( (Point2F*)ptr32, numTVerts );
 
-   // Re-create the vectors
-   if(mVertexData.isReady())
+   if ( ioState.smReadVersion > 25 )
    {
-      verts.setSize(mNumVerts);
-      tverts.setSize(mNumVerts);
-      norms.setSize(mNumVerts);
-
-      if(mHasColor)
-         colors.setSize(mNumVerts);
-      if(mHasTVert2)
-         tverts2.setSize(mNumVerts);
+      numTVerts = tsalloc.get32();
+      ptr32 = getSharedData32( dataParent, 2 * numTVerts, (S32**)ioState.smTVerts2List.address(), ioState, skip );
+      tverts2.set( (Point2F*)ptr32, numTVerts );
 
-      // Fill arrays
-      for(U32 i = 0; i < mNumVerts; i++)
-      {
-         const __TSMeshVertexBase &cv = mVertexData.getBase(i);
-         verts[i] = cv.vert();
-         tverts[i] = cv.tvert();
-         norms[i] = cv.normal();
-         
-         if (mHasColor || mHasTVert2)
-         {
-            const __TSMeshVertex_3xUVColor &cvc = mVertexData.getColor(i);
-            if(mHasColor)
-               cvc.color().getColor(&colors[i]);
-            if(mHasTVert2)
-               tverts2[i] = cvc.tvert2();
-         }
-         
-      }
+      S32 numVColors = tsalloc.get32();
+      ptr32 = getSharedData32( dataParent, numVColors, (S32**)ioState.smColorsList.address(), ioState, skip );
+      colors.set( (ColorI*)ptr32, numVColors );
    }
 
-   // verts...
-   tsalloc.set32( verts.size() );
-   if ( parentMesh < 0 )
-      tsalloc.copyToBuffer32( (S32*)verts.address(), 3 * verts.size() ); // if no parent mesh, then save off our verts
-
-   // tverts...
-   tsalloc.set32( tverts.size() );
-   if ( parentMesh < 0 )
-      tsalloc.copyToBuffer32( (S32*)tverts.address(), 2 * tverts.size() ); // if no parent mesh, then save off our tverts
+   S8 *ptr8;
+   if ( ioState.smReadVersion > 21 && ioState.smUseEncodedNormals)
+   {
+      // we have encoded normals and we want to use them...
+      if ( dataParent < 0 )
+         tsalloc.getPointer32( numVerts * 3 ); // advance past norms, don't use
+      norms.set( NULL, 0 );
 
-   if (ioState.smVersion > 25)
+      ptr8 = getSharedData8( dataParent, numVerts, (S8**)ioState.smEncodedNormsList.address(), ioState, skip );
+      encodedNorms.set( ptr8, numVerts );
+   }
+   else if ( ioState.smReadVersion > 21 )
    {
-      // tverts2...
-      tsalloc.set32( tverts2.size() );
-      if ( parentMesh < 0 )
-         tsalloc.copyToBuffer32( (S32*)tverts2.address(), 2 * tverts2.size() ); // if no parent mesh, then save off our tverts
+      // we have encoded normals but we don't want to use them...
+      ptr32 = getSharedData32( dataParent, 3 * numVerts, (S32**)ioState.smNormsList.address(), ioState, skip );
+      norms.set( (Point3F*)ptr32, numVerts );
 
-      // colors
-      tsalloc.set32( colors.size() );
-      if ( parentMesh < 0 )
-         tsalloc.copyToBuffer32( (S32*)colors.address(), colors.size() ); // if no parent mesh, then save off our tverts
+      if ( dataParent < 0 )
+         tsalloc.getPointer8( numVerts ); // advance past encoded normls, don't use
+      encodedNorms.set( NULL, 0 );
+   }
+   else
+   {
+      // no encoded normals...
+      ptr32 = getSharedData32( dataParent, 3 * numVerts, (S32**)ioState.smNormsList.address(), ioState, skip );
+      norms.set( (Point3F*)ptr32, numVerts );
+      encodedNorms.set( NULL, 0 );
    }
+}
 
-   // norms...
-   if ( parentMesh < 0 ) // if no parent mesh, then save off our norms
-      tsalloc.copyToBuffer32( (S32*)norms.address(), 3 * norms.size() ); // norms.size()==verts.size() or error...
+void TSMesh::_assembleVertexData( TSIOState &ioState, const TSBasicVertexFormat &format, bool skip )
+{
+   S32 numVerts = tsalloc.get32();
+   S32 *ptr32 = tsalloc.getPointer32( numVerts * format.vertexSize / sizeof(S32) );
 
-   // encoded norms...
-   if ( parentMesh < 0 )
+   mNumVerts = numVerts;
+   mVertSize = format.vertexSize;
+   mHasTVert2 = format.texCoordOffset >= 0;
+   mHasColor = format.colorOffset >= 0;
+
+   U32 colorOffset = 0;
+   if ( mHasTVert2 )
+      colorOffset = format.texCoordOffset;
+   else if ( mHasColor )
+      colorOffset = format.colorOffset - sizeof(Point2F);
+   U32 boneOffset = format.boneOffset >= 0 ? format.boneOffset : 0;
+
+   // only keep the vertices once we're copying into the shape
+   void *aligned_mem = NULL;
+   if ( !skip && numVerts && tsalloc.allocShape32( 0 ) )
    {
-      // if no parent mesh, compute encoded normals and copy over
-      for ( S32 i = 0; i < norms.size(); i++ )
-      {
-         U8 normIdx = encodedNorms.size() ? encodedNorms[i] : encodeNormal( norms[i] );
-         tsalloc.copyToBuffer8( (S8*)&normIdx, 1 );
-      }
+      aligned_mem = dMalloc_aligned( mVertSize * mNumVerts, 16 );
+      AssertFatal(aligned_mem, "Aligned malloc failed! Debug!");
+      dMemcpy( aligned_mem, ptr32, mVertSize * mNumVerts );
    }
 
+   mVertexData.set( aligned_mem, mVertSize, aligned_mem ? mNumVerts : 0, colorOffset, boneOffset );
+   mVertexData.setReady( true );
+
+   verts.set( NULL, 0 );
+   tverts.set( NULL, 0 );
+   tverts2.set( NULL, 0 );
+   colors.set( NULL, 0 );
+   norms.set( NULL, 0 );
+   encodedNorms.set( NULL, 0 );
+}
+
+void TSMesh::disassemble(TSIOState &ioState)
+{
+   tsalloc.setGuard();
+
+   tsalloc.set32( numFrames );
+   tsalloc.set32( numMatFrames );
+   tsalloc.set32( parentMesh );
+   tsalloc.copyToBuffer32( (S32*)&mBounds, 6 );
+   tsalloc.copyToBuffer32( (S32*)&mCenter, 3 );
+   tsalloc.set32( (S32)mRadius );
+
+   // cache-ready shapes store the aligned vertex data as is, and give each
+   // mesh its own copy rather than sharing with a parent mesh
+   TSBasicVertexFormat vertexFormat;
+   if ( ioState.smVersion > 27 && mVertexData.isReady() )
+      vertexFormat.addMeshRequirements( this );
+   if ( ioState.smVersion > 27 )
+      vertexFormat.writeAlloc( &tsalloc );
+
+   if ( vertexFormat.vertexSize > 0 )
+      _disassembleVertexData( ioState );
+   else
+      _disassembleVertexArrays( ioState, parentMesh < 0 || ioState.smVersion > 27 );
+
    // optimize triangle draw order during disassemble
    {
       TempAlloc<TriListOpt::IndexType> tmpIdxs(indices.size());
@@ -2647,7 +2976,7 @@ void TSMesh::disassemble(TSIOState &ioState)
          // only optimize triangle lists (strips and fans are assumed to be already optimized)
          if ( (prim.matIndex & TSDrawPrimitive::TypeMask) == TSDrawPrimitive::Triangles )
          {
-            TriListOpt::OptimizeTriangleOrdering(verts.size(), prim.numElements,
+            TriListOpt::OptimizeTriangleOrdering(mVertexData.isReady() ? mNumVerts : verts.size(), prim.numElements,
                indices.address() + prim.start, tmpIdxs.ptr);
             dCopyArray(indices.address() + prim.start, tmpIdxs.ptr,
                prim.numElements);
@@ -2697,6 +3026,79 @@ void TSMesh::disassemble(TSIOState &ioState)
    tsalloc.setGuard();
 }
 
+void TSMesh::_disassembleVertexArrays( TSIOState &ioState, bool ownData )
+{
+   // Re-create the vectors
+   if(mVertexData.isReady())
+      unpackVertexData();
+
+   // verts...
+   tsalloc.set32( verts.size() );
+   if ( ownData )
+      tsalloc.copyToBuffer32( (S32*)verts.address(), 3 * verts.size() ); // if no parent mesh, then save off our verts
+
+   // tverts...
+   tsalloc.set32( tverts.size() );
+   if ( ownData )
+      tsalloc.copyToBuffer32( (S32*)tverts.address(), 2 * tverts.size() ); // if no parent mesh, then save off our tverts
+
+   if (ioState.smVersion > 25)
+   {
+      // tverts2...
+      tsalloc.set32( tverts2.size() );
+      if ( ownData )
+         tsalloc.copyToBuffer32( (S32*)tverts2.address(), 2 * tverts2.size() ); // if no parent mesh, then save off our tverts
+
+      // colors
+      tsalloc.set32( colors.size() );
+      if ( ownData )
+         tsalloc.copyToBuffer32( (S32*)colors.address(), colors.size() ); // if no parent mesh, then save off our tverts
+   }
+
+   // norms...
+   if ( ownData ) // if no parent mesh, then save off our norms
+      tsalloc.copyToBuffer32( (S32*)norms.address(), 3 * norms.size() ); // norms.size()==verts.size() or error...
+
+   // encoded norms...
+   if ( ownData )
+   {
+      // if no parent mesh, compute encoded normals and copy over
+      for ( S32 i = 0; i < norms.size(); i++ )
+      {
+         U8 normIdx = encodedNorms.size() ? encodedNorms[i] : encodeNormal( norms[i] );
+         tsalloc.copyToBuffer8( (S8*)&normIdx, 1 );
+      }
+   }
+}
+
+void TSMesh::_disassembleVertexData( TSIOState &ioState )
+{
+   tsalloc.set32( mNumVerts );
+   if ( mNumVerts == 0 )
+      return;
+
+   TempAlloc<U8> vertexData( mVertexData.mem_size() );
+   dMemcpy( vertexData.ptr, mVertexData.address(), mVertexData.mem_size() );
+
+   // skins may have been skinned on the cpu into mVertexData, so store
+   // the bind pose
+   if ( getMeshType() == SkinMeshType )
+   {
+      const TSSkinMesh::BatchData &batchData = static_cast<TSSkinMesh*>(this)->batchData;
+      if ( batchData.initialVerts.size() == mNumVerts && batchData.initialNorms.size() == mNumVerts )
+      {
+         for ( U32 i = 0; i < mNumVerts; i++ )
+         {
+            __TSMeshVertexBase &v = *reinterpret_cast<__TSMeshVertexBase *>(vertexData.ptr + i * mVertexData.vertSize());
+            v.vert( batchData.initialVerts[i] );
+            v.normal( batchData.initialNorms[i] );
+         }
+      }
+   }
+
+   tsalloc.copyToBuffer32( (S32*)vertexData.ptr, mVertexData.mem_size() / sizeof(S32) );
+}
+
 //-----------------------------------------------------------------------------
 // TSSkinMesh assemble from/ dissemble to memory buffer
 //-----------------------------------------------------------------------------
@@ -2707,20 +3109,22 @@ void TSSkinMesh::assemble( TSIOState &ioState, bool skip )
 
    TSMesh::assemble( ioState, skip );
 
+   const S32 dataParent = ioState.smReadVersion > 27 ? -1 : parentMesh;
+
    S32 sz = tsalloc.get32();
    S32 numVerts = sz;
-   S32 * ptr32 = getSharedData32( parentMesh, 3 * numVerts, (S32**)ioState.smVertsList.address(), ioState, skip );
+   S32 * ptr32 = getSharedData32( dataParent, 3 * numVerts, (S32**)ioState.smVertsList.address(), ioState, skip );
    batchData.initialVerts.set( (Point3F*)ptr32, sz );
 
    S8 * ptr8;
    if ( ioState.smReadVersion>21 && ioState.smUseEncodedNormals )
    {
       // we have encoded normals and we want to use them...
-      if ( parentMesh < 0 )
+      if ( dataParent < 0 )
          tsalloc.getPointer32( numVerts * 3 ); // advance past norms, don't use
       batchData.initialNorms.set( NULL, 0 );
 
-      ptr8 = getSharedData8( parentMesh, numVerts, (S8**)ioState.smEncodedNormsList.address(), ioState, skip );
+      ptr8 = getSharedData8( dataParent, numVerts, (S8**)ioState.smEncodedNormsList.address(), ioState, skip );
       encodedNorms.set( ptr8, numVerts );
       // Note: we don't set the encoded normals flag because we handle them in updateSkin and
       //       hide the fact that we are using them from base class (TSMesh)
@@ -2728,10 +3132,10 @@ void TSSkinMesh::assemble( TSIOState &ioState, bool skip )
    else if ( ioState.smReadVersion > 21 )
    {
       // we have encoded normals but we don't want to use them...
-      ptr32 = getSharedData32( parentMesh, 3 * numVerts, (S32**)ioState.smNormsList.address(), ioState, skip );
+      ptr32 = getSharedData32( dataParent, 3 * numVerts, (S32**)ioState.smNormsList.address(), ioState, skip );
       batchData.initialNorms.set( (Point3F*)ptr32, numVerts );
 
-      if ( parentMesh < 0 )
+      if ( dataParent < 0 )
          tsalloc.getPointer8( numVerts ); // advance past encoded normls, don't use
       
       encodedNorms.set( NULL, 0 );
@@ -2739,35 +3143,67 @@ void TSSkinMesh::assemble( TSIOState &ioState, bool skip )
    else
    {
       // no encoded normals...
-      ptr32 = getSharedData32( parentMesh, 3 * numVerts, (S32**)ioState.smNormsList.address(), ioState, skip );
+      ptr32 = getSharedData32( dataParent, 3 * numVerts, (S32**)ioState.smNormsList.address(), ioState, skip );
       batchData.initialNorms.set( (Point3F*)ptr32, numVerts );
       encodedNorms.set( NULL, 0 );
    }
 
    sz = tsalloc.get32();
-   ptr32 = getSharedData32( parentMesh, 16 * sz, (S32**)ioState.smInitTransformList.address(), ioState, skip );
+   ptr32 = getSharedData32( dataParent, 16 * sz, (S32**)ioState.smInitTransformList.address(), ioState, skip );
    batchData.initialTransforms.set( ptr32, sz );
 
    sz = tsalloc.get32();
-   ptr32 = getSharedData32( parentMesh, sz, (S32**)ioState.smVertexIndexList.address(), ioState, skip );
+   ptr32 = getSharedData32( dataParent, sz, (S32**)ioState.smVertexIndexList.address(), ioState, skip );
    vertexIndex.set( ptr32, sz );
 
-   ptr32 = getSharedData32( parentMesh, sz, (S32**)ioState.smBoneIndexList.address(), ioState, skip );
+   ptr32 = getSharedData32( dataParent, sz, (S32**)ioState.smBoneIndexList.address(), ioState, skip );
    boneIndex.set( ptr32, sz );
 
-   ptr32 = getSharedData32( parentMesh, sz, (S32**)ioState.smWeightList.address(), ioState, skip );
+   ptr32 = getSharedData32( dataParent, sz, (S32**)ioState.smWeightList.address(), ioState, skip );
    weight.set( (F32*)ptr32, sz );
 
    sz = tsalloc.get32();
-   ptr32 = getSharedData32( parentMesh, sz, (S32**)ioState.smNodeIndexList.address(), ioState, skip );
+   ptr32 = getSharedData32( dataParent, sz, (S32**)ioState.smNodeIndexList.address(), ioState, skip );
    batchData.nodeIndex.set( ptr32, sz );
 
+   if ( ioState.smReadVersion > 27 )
+   {
+      // hardware skinned meshes keep their batch by vertex operations, the
+      // bone indices and weights are already in the vertex data
+      sz = tsalloc.get32();
+      ptr32 = tsalloc.getPointer32( sz * BatchData::bakedOpSize );
+      if ( sz && mVertexData.address() )
+      {
+         Vector<BatchData::BatchedVertex> batchOperations;
+         batchOperations.setSize( sz );
+         for ( S32 i = 0; i < sz; i++, ptr32 += BatchData::bakedOpSize )
+         {
+            BatchData::BatchedVertex &op = batchOperations[i];
+            op.vertexIndex = ptr32[0];
+            op.transformCount = ptr32[1];
+            for ( S32 j = 0; j < BatchData::maxBonePerVertGPU; j++ )
+            {
+               op.transform[j].transformIndex = ptr32[2 + j];
+               op.transform[j].weight = ((F32*)ptr32)[2 + BatchData::maxBonePerVertGPU + j];
+            }
+         }
+
+         batchData.dualQuat = TSShape::smUseDualQuatSkinning;
+         if ( batchData.dualQuat )
+            createDualQuatBatchData( batchOperations );
+         else
+            batchData.vertexBatchOperations.set( batchOperations.address(), batchOperations.size() );
+         batchDataInitialized = true;
+      }
+   }
+
    tsalloc.checkGuard();
 
    if ( tsalloc.allocShape32( 0 ) && ioState.smReadVersion < 19 )
       TSMesh::computeBounds(); // only do this if we copied the data...
 
-   createTangents(batchData.initialVerts, batchData.initialNorms);
+   if ( !mVertexData.isReady() )
+      createTangents(batchData.initialVerts, batchData.initialNorms);
 }
 
 //-----------------------------------------------------------------------------
@@ -2775,11 +3211,24 @@ void TSSkinMesh::assemble( TSIOState &ioState, bool skip )
 //-----------------------------------------------------------------------------
 void TSSkinMesh::disassemble(TSIOState &ioState)
 {
+   // cache-ready shapes store the bone indices and weights in the vertex data
+   bool bakeBatch = ioState.smVersion > 27 && mVertexData.getBoneOffset() && TSShape::smAllowHardwareSkinning;
+   if ( bakeBatch )
+   {
+      // dual quaternion batches don't fill in the vertex bone data
+      createBatchData();
+      bakeBatch = !batchData.dualQuat;
+      for ( S32 i = 0; i < batchData.vertexBatchOperations.size(); i++ )
+         bakeBatch &= batchData.vertexBatchOperations[i].transformCount <= BatchData::maxBonePerVertGPU;
+   }
+
    TSMesh::disassemble(ioState);
 
+   const bool ownData = parentMesh < 0 || ioState.smVersion > 27;
+
    tsalloc.set32( batchData.initialVerts.size() );
    // if we have no parent mesh, then save off our verts & norms
-   if ( parentMesh < 0 )
+   if ( ownData )
    {
       tsalloc.copyToBuffer32( (S32*)batchData.initialVerts.address(), 3 * batchData.initialVerts.size() );
 
@@ -2795,11 +3244,11 @@ void TSSkinMesh::disassemble(TSIOState &ioState)
    }
 
    tsalloc.set32( batchData.initialTransforms.size() );
-   if ( parentMesh < 0 )
+   if ( ownData )
       tsalloc.copyToBuffer32( (S32*)batchData.initialTransforms.address(), batchData.initialTransforms.size() * 16 );
 
    tsalloc.set32( vertexIndex.size() );
-   if ( parentMesh < 0 )
+   if ( ownData )
    {
       tsalloc.copyToBuffer32( (S32*)vertexIndex.address(), vertexIndex.size() );
 
@@ -2809,9 +3258,29 @@ void TSSkinMesh::disassemble(TSIOState &ioState)
    }
 
    tsalloc.set32( batchData.nodeIndex.size() );
-   if ( parentMesh < 0 )
+   if ( ownData )
       tsalloc.copyToBuffer32( (S32*)batchData.nodeIndex.address(), batchData.nodeIndex.size() );
 
+   if ( ioState.smVersion > 27 )
+   {
+      const Vector<BatchData::BatchedVertex> &ops = batchData.vertexBatchOperations;
+      tsalloc.set32( bakeBatch ? ops.size() : 0 );
+      for ( S32 i = 0; bakeBatch && i < ops.size(); i++ )
+      {
+         // vertex index, transform count, then the transform indices and weights
+         S32 op[BatchData::bakedOpSize];
+         op[0] = ops[i].vertexIndex;
+         op[1] = ops[i].transformCount;
+         for ( S32 j = 0; j < BatchData::maxBonePerVertGPU; j++ )
+         {
+            const bool used = j < ops[i].transformCount;
+            op[2 + j] = used ? ops[i].transform[j].transformIndex : -1;
+            ((F32*)op)[2 + BatchData::maxBonePerVertGPU + j] = used ? ops[i].transform[j].weight : -1.0f;
+         }
+         tsalloc.copyToBuffer32( op, BatchData::bakedOpSize );
+      }
+   }
+
    tsalloc.setGuard();
 }
 
@@ -2820,6 +3289,8 @@ TSSkinMesh::TSSkinMesh()
    meshType = SkinMeshType;
    mDynamic = true;
    batchDataInitialized = false;
+   batchData.dualQuat = false;
+   mSharedSkinRenderData = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -2978,6 +3449,61 @@ void TSSkinMesh::convertToAlignedMeshData()
       _convertToAlignedMeshData(mVertexData, batchData.initialVerts, batchData.initialNorms);
 }
 
+void TSMesh::unpackVertexData()
+{
+   verts.setSize(mNumVerts);
+   tverts.setSize(mNumVerts);
+   norms.setSize(mNumVerts);
+   tangents.setSize(mNumVerts);
+
+   if(mHasColor)
+      colors.setSize(mNumVerts);
+   if(mHasTVert2)
+      tverts2.setSize(mNumVerts);
+
+   // Fill arrays
+   for(U32 i = 0; i < mNumVerts; i++)
+   {
+      const __TSMeshVertexBase &cv = mVertexData.getBase(i);
+      verts[i] = cv.vert();
+      tverts[i] = cv.tvert();
+      norms[i] = cv.normal();
+      tangents[i] = cv.tangent();
+      
+      if (mHasColor || mHasTVert2)
+      {
+         const __TSMeshVertex_3xUVColor &cvc = mVertexData.getColor(i);
+         if(mHasColor)
+            cvc.color().getColor(&colors[i]);
+         if(mHasTVert2)
+            tverts2[i] = cvc.tvert2();
+      }
+   }
+}
+
+void TSMesh::releaseVertexData()
+{
+   if(!mVertexData.isReady())
+      return;
+
+   unpackVertexData();
+   mVertexData.set(NULL, 0, 0, 0, 0);
+   mVertexData.setReady(false);
+}
+
+void TSSkinMesh::releaseVertexData()
+{
+   Parent::releaseVertexData();
+
+   // Batches by vertex either wrote bone data into the vertex data or were
+   // built for the layout it had
+   if(!batchData.vertexBatchOperations.empty())
+   {
+      batchData.vertexBatchOperations.clear();
+      batchDataInitialized = false;
+   }
+}
+
 void TSMesh::_convertToAlignedMeshData( TSMeshVertexArray &vertexData, const Vector<Point3F> &_verts, const Vector<Point3F> &_norms )
 {
    U32 colorOffset = 0;
@@ -3160,38 +3686,22 @@ void TSBasicVertexFormat::readAlloc(TSShapeAlloc* alloc)
 
 void TSBasicVertexFormat::addMeshRequirements(TSMesh *mesh)
 {
-   bool hasColors = false;
-   bool hasTexcoord2 = false;
-   bool hasSkin = false;
-   /*
-   hasColors = mesh->getHasColor() || (colorOffset != -1);
-   hasTexcoord2 = mesh->getHasTVert2() || (texCoordOffset != -1);
-   hasSkin = (mesh->getMeshType() == TSMesh::SkinMeshType) || (boneOffset != -1);
-   
-   S32 offset = sizeof(TSMesh::__TSMeshVertexBase);
-   
-   if ((hasTexcoord2 || hasColors))
+   const TSMesh::TSMeshVertexArray &vertexData = mesh->mVertexData;
+   AssertFatal(vertexData.isReady(), "TSBasicVertexFormat::addMeshRequirements - mesh has no aligned vertex data");
+
+   // the second uv set and color share one block after the base vertex
+   if (mesh->mHasTVert2)
+      texCoordOffset = vertexData.getColorOffset();
+   if (mesh->mHasColor)
+      colorOffset = vertexData.getColorOffset() + sizeof(Point2F);
+
+   if (vertexData.getBoneOffset())
    {
-      if (texCoordOffset == -1 || colorOffset == -1)
-      {
-         texCoordOffset = offset;
-         colorOffset = offset + (sizeof(float) * 2);
-      }
-      
-      offset += sizeof(TSMesh::__TSMeshVertex_3xUVColor);
+      boneOffset = vertexData.getBoneOffset();
+      numBones = getMax(numBones, (S16)1);
    }
-   
-   if (hasSkin)
-   {
-      boneOffset = offset;
-      
-      U32 numMeshBones = mesh->getMaxBonesPerVert();
-      U32 boneBlocks = numMeshBones / 4;
-      U32 extraBlocks = numMeshBones % 4 != 0 ? 1 : 0;
-      U32 neededBones = boneBlocks + extraBlocks;
-      numBones = MAX(neededBones, numBones);
-   }*/
-}
 
+   vertexSize = vertexData.vertSize();
+}
 
 END_NS
@@ -33,6 +33,9 @@
 #ifndef _MMATH_H_
 #include "math/mMath.h"
 #endif
+#ifndef _MDUALQUAT_H_
+#include "math/mDualQuat.h"
+#endif
 #ifndef _TVECTOR_H_
 #include "core/util/tVector.h"
 #endif
@@ -70,6 +73,7 @@ class TSMeshRenderer;
 class TSMeshInstanceRenderData;
 class TSIOState;
 class TSMesh;
+class TSMeshBVH;
 class TSShapeAlloc;
 
 struct TSDrawPrimitive
@@ -149,6 +153,16 @@ protected:
    void _convertToAlignedMeshData( TSMeshVertexArray &vertexData, const Vector<Point3F> &_verts, const Vector<Point3F> &_norms );
    void _createVBIB( TSMeshInstanceRenderData *meshRenderData = NULL );
 
+   /// @name Vertex assembly
+   /// Version 28 shapes store the aligned vertex data of standard and skin
+   /// meshes as is. Older shapes and other meshes use separate arrays.
+   /// @{
+   void _assembleVertexArrays( TSIOState &loadState, S32 dataParent, bool skip );
+   void _assembleVertexData( TSIOState &loadState, const TSBasicVertexFormat &format, bool skip );
+   void _disassembleVertexArrays( TSIOState &loadState, bool ownData );
+   void _disassembleVertexData( TSIOState &loadState );
+   /// @}
+
   public:
 
    enum
@@ -299,6 +313,13 @@ protected:
    TSMeshVertexArray mVertexData;
    dsize_t mNumVerts;
    virtual void convertToAlignedMeshData();
+
+   /// Fills the vertex arrays (tangents included) back in from mVertexData
+   void unpackVertexData();
+
+   /// Unpacks and frees mVertexData, so the next convertToAlignedMeshData
+   /// call lays the vertices out again. Used when the vertex format changes.
+   virtual void releaseVertexData();
    /// @}
 
    /// @name Vertex data
@@ -344,6 +365,9 @@ protected:
    U32 mergeBufferStart;
    /// @}
 
+   /// Ray cast hierarchy per frame, built by getRayBVH
+   Vector<TSMeshBVH*> mRayBVHs;
+
    /// @name Render Methods
    /// @{
 
@@ -375,8 +399,36 @@ protected:
    virtual void support( S32 frame, const Point3F &v, F32 *currMaxDP, Point3F *currSupport );
    virtual bool castRay( S32 frame, const Point3F & start, const Point3F & end, RayInfo * rayInfo, TSMaterialList* materials );
    virtual bool castRayRendered( S32 frame, const Point3F & start, const Point3F & end, RayInfo * rayInfo, TSMaterialList* materials );
+
+   /// Casts @a count rays, in mesh space, at once.
+   ///
+   /// If @a results is NULL this only tests for occlusion: rays whose @a hit
+   /// flag is already set are skipped, and the flag is set for rays which
+   /// are blocked. Otherwise results[i].t is the distance to beat and rays
+   /// which hit something nearer get their result filled in and flag set.
+   virtual void castRays( S32 frame, const Point3F *starts, const Point3F *ends, U32 count, RayInfo *results, U8 *hit, TSMaterialList *materials );
    virtual bool buildConvexHull(); ///< returns false if not convex (still builds planes)
    bool addToHull( U32 idx0, U32 idx1, U32 idx2 );
+
+   /// Returns the triangle hierarchy used by castRay for a frame, building it
+   /// on first use. Building is not thread safe, so shapes which are ray cast
+   /// from several threads should build them up front.
+   /// @see TSShape::buildRayBVHs
+   TSMeshBVH* getRayBVH( S32 frame );
+
+   /// Builds a triangle hierarchy over the primitives of the mesh, with
+   /// vertex positions read from @a vertBase every @a stride bytes. The
+   /// caller owns the result.
+   TSMeshBVH* buildRayBVH( const Point3F *vertBase, U32 stride ) const;
+
+   /// castRayRendered and castRays against @a bvh rather than the mesh's own
+   /// hierarchy. Skins use these with hierarchies refitted to an instance.
+   bool castRayBVH( const TSMeshBVH *bvh, const Point3F &start, const Point3F &end, RayInfo *rayInfo, TSMaterialList *materials );
+   void castRaysBVH( const TSMeshBVH *bvh, const Point3F *starts, const Point3F *ends, U32 count, RayInfo *results, U8 *hit, TSMaterialList *materials );
+
+   /// Frees the triangle hierarchies. Call this after changing the vertices
+   /// or primitives of the mesh.
+   void clearRayBVHs();
    /// @}
 
    /// @name Bounding Methods
@@ -454,6 +506,8 @@ public:
       {
          maxBonePerVert = 16,   // Abitrarily chosen
          maxBonePerVertGPU = 4, // xyzw
+         soaBlockSize = 8,      // Vertices per structure-of-arrays block
+         bakedOpSize = 2 + 2 * maxBonePerVertGPU, // Words per batch by vertex op in cache-ready shapes
       };
 
       /// @name Batch by vertex
@@ -481,6 +535,26 @@ public:
       Vector<BatchedVertex> vertexBatchOperations;
       /// @}
 
+      /// @name Batch by vertex (CPU)
+      /// Used for CPU skinning of meshes where no vertex has more than
+      /// TSShape::smMaxSkinByVertexInfluences influences. The influencing
+      /// bone transforms are blended first, so each vertex is transformed
+      /// and written once, without a separate zero pass.
+      /// @{
+      struct BatchedVertex4
+      {
+         Point3F vert;   // Do not change the ordering of these members
+         S32 vidx;
+         Point3F normal;
+         S32 transformCount;
+         S32 transformIndex[maxBonePerVertGPU];
+         F32 weight[maxBonePerVertGPU];
+      };
+
+      /// One entry per vertex, in vertex order
+      Vector<BatchedVertex4> vertexBatch4;
+      /// @}
+
       /// @name Batch by Bone Transform
       /// These are used for batches where each element is a bone transform,
       /// and verts/normals are batch transformed against each element
@@ -523,6 +597,35 @@ public:
       Vector<S32> transformKeys;
       /// @}
 
+      /// @name Structure-of-arrays batches
+      /// Used instead of the batch by bone transform data when
+      /// TSShape::smUseSoASkinning is set. Vertices are skinned in blocks of
+      /// soaBlockSize from separate x/y/z streams, so the skin loop reads and
+      /// writes linearly, and the result is interleaved into the vertex
+      /// buffer in a final pass.
+      /// @{
+
+      /// One influence for each vertex in a block
+      struct SoAInfluence
+      {
+         S32 bone[soaBlockSize];   ///< Bone transform index, or -1 if the vertex has no influence here
+         F32 weight[soaBlockSize];
+      };
+
+      /// Initial positions and normals as 6 streams (px, py, pz, nx, ny, nz),
+      /// each padded to a multiple of soaBlockSize
+      Vector<F32> soaInitialStreams;
+
+      /// Influences for each block. Block n uses soaBlockStart[n] up to
+      /// soaBlockStart[n+1]
+      Vector<SoAInfluence> soaInfluences;
+      Vector<S32> soaBlockStart;
+      /// @}
+
+      /// Skin with a dual quaternion palette rather than matrices. Set from
+      /// TSShape::smUseDualQuatSkinning when the batch data is created.
+      bool dualQuat;
+
       // # = num bones
       Vector<S32> nodeIndex;
       Vector<MatrixF> initialTransforms;
@@ -536,13 +639,32 @@ public:
    /// for use.
    virtual void convertToAlignedMeshData();
 
+   /// Also drops batches that wrote into the released vertex data
+   virtual void releaseVertexData();
+
 public:
    typedef TSMesh Parent;
    void createBatchData();
 
+   /// Build the per-vertex blended batches from the batch-by-vertex operations
+   void createVertex4BatchData( const Vector<BatchData::BatchedVertex> &batchOperations );
+
+   /// Build one batch-by-vertex operation per vertex for dual quaternion skinning
+   void createDualQuatBatchData( const Vector<BatchData::BatchedVertex> &batchOperations );
+
+   /// Build the structure-of-arrays batches from the batch-by-vertex operations
+   void createSoABatchData( const Vector<BatchData::BatchedVertex> &batchOperations );
+
    /// Structure containing data needed to batch skinning
    BatchData batchData;
    bool batchDataInitialized;
+
+   /// Render data of the instance last skinned into mVertexData, when the
+   /// renderer has no per-instance storage (see TSMeshRenderer::mapVerts).
+   /// Another instance rendering this mesh must then skin it again even if
+   /// its own transforms have not changed. Only updateSkin() and uploadSkin()
+   /// write this, so like them it belongs to the render thread.
+   TSMeshInstanceRenderData *mSharedSkinRenderData;
    
    /// vectors that define the vertex, weight, bone tuples
    Vector<F32> weight;
@@ -551,10 +673,40 @@ public:
 
    /// set transforms...
    void updateSkinBones( const Vector<MatrixF> &transforms, Vector<MatrixF>& dest );
+
+   /// set transforms as a dual quaternion palette...
+   void updateSkinBones( const Vector<MatrixF> &transforms, Vector<DualQuatF>& dest );
    
+   /// Skins only the vertex positions, on the CPU, into @a outVerts. This
+   /// doesn't touch the render data so it works with hardware skinning and
+   /// without a renderer. @a bones is scratch space for the bone palette.
+   void skinPositions( const Vector<MatrixF> &transforms, Vector<MatrixF> &bones, Vector<Point3F> &outVerts );
+
+   /// Returns the triangle hierarchy of the bind pose, building it on first
+   /// use. Instances copy it and refit the copy to their pose, so the tree
+   /// is only built once per mesh.
+   /// @see TSShapeInstance::MeshObjectInstance::getSkinRayBVH
+   TSMeshBVH* getBindRayBVH();
+
    /// set verts and normals...
+   ///
+   /// Output goes to the buffer returned by TSMeshRenderer::mapVerts for the
+   /// current render data; if the renderer returns NULL the shared
+   /// mVertexData is written instead. This talks to the renderer, so only
+   /// call it from the render thread.
    void updateSkin( const Vector<MatrixF> &transforms, TSRenderState &rdata );
 
+   /// Skins verts and normals into @a outPtr, which must hold a copy of
+   /// mVertexData so the other vertex fields are valid. All scratch memory
+   /// comes from @a rdata and neither the renderer nor the mesh is touched,
+   /// so different instances may be skinned on different threads as long as
+   /// each thread uses its own TSRenderState.
+   void skinVerts( const Vector<MatrixF> &transforms, TSRenderState &rdata, U8 *outPtr, dsize_t outStride );
+
+   /// Copies verts skinned by skinVerts() to the renderer and updates the
+   /// vertex buffer. Render thread only, like updateSkin().
+   void uploadSkin( const U8 *skinnedVerts, TSRenderState &rdata );
+
    // render methods..
    void render( TSMeshRenderer &renderer );
    void render(   TSMaterialList *, 
@@ -566,6 +718,8 @@ public:
    // collision methods...
    bool buildPolyList( S32 frame, AbstractPolyList *polyList, U32 &surfaceKey, TSMaterialList *materials );
    bool castRay( S32 frame, const Point3F &start, const Point3F &end, RayInfo *rayInfo, TSMaterialList *materials );
+   bool castRayRendered( S32 frame, const Point3F &start, const Point3F &end, RayInfo *rayInfo, TSMaterialList *materials );
+   void castRays( S32 frame, const Point3F *starts, const Point3F *ends, U32 count, RayInfo *results, U8 *hit, TSMaterialList *materials );
    bool buildConvexHull(); // does nothing, skins don't use this
 
    void computeBounds( const MatrixF &transform, Box3F &bounds, S32 frame, Point3F *center, F32 *radius );
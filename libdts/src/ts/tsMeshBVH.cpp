@@ -0,0 +1,1007 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "ts/tsMeshBVH.h"
+#include "ts/tsMesh.h"
+#include "ts/tsMeshIntrinsics.h"
+#include "ts/arch/tsMeshIntrinsics.arch.h"
+#include "platform/profiler.h"
+
+#if defined(LIBDTSHAPE_CPU_X86_64) || (defined(LIBDTSHAPE_CPU_X86) && (defined(__SSE__) || _M_IX86_FP >= 1))
+#define TSMESHBVH_USE_SSE
+#include <xmmintrin.h>
+#if defined(LIBDTSHAPE_TS_AVX_INTRINSICS)
+#define TSMESHBVH_USE_AVX
+#include <immintrin.h>
+#endif
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+/// Half the surface area of a box, which is all the SAH needs
+static inline F32 halfArea(const Box3F &box)
+{
+   const Point3F ext = box.getExtents();
+   return ext.x * ext.y + ext.y * ext.z + ext.z * ext.x;
+}
+
+/// Clips the segment start + dir*t, 0 <= t <= maxT against a box.
+/// Returns the entry time in @a outT if any part of the segment is inside.
+static inline bool rayBox(const Box3F &box, const Point3F &start, const Point3F &invDir, F32 maxT, F32 &outT)
+{
+   F32 t1 = (box.minExtents.x - start.x) * invDir.x;
+   F32 t2 = (box.maxExtents.x - start.x) * invDir.x;
+   F32 tmin = getMin(t1, t2);
+   F32 tmax = getMax(t1, t2);
+
+   t1 = (box.minExtents.y - start.y) * invDir.y;
+   t2 = (box.maxExtents.y - start.y) * invDir.y;
+   tmin = getMax(tmin, getMin(t1, t2));
+   tmax = getMin(tmax, getMax(t1, t2));
+
+   t1 = (box.minExtents.z - start.z) * invDir.z;
+   t2 = (box.maxExtents.z - start.z) * invDir.z;
+   tmin = getMax(tmin, getMin(t1, t2));
+   tmax = getMin(tmax, getMax(t1, t2));
+
+   tmin = getMax(tmin, 0.0f);
+   tmax = getMin(tmax, maxT);
+
+   outT = tmin;
+   return tmin <= tmax;
+}
+
+/// Two sided Moller-Trumbore test, accepting hits with 0 <= t <= maxT
+static inline bool rayTriangle(const TSMeshBVH::Triangle &tri, const Point3F &start, const Point3F &dir,
+                               F32 maxT, F32 &outT, Point2F &outBary)
+{
+   Point3F pvec;
+   mCross(dir, tri.edge2, &pvec);
+
+   const F32 det = mDot(tri.edge1, pvec);
+   if ( det == 0.0f )
+      return false;
+
+   const F32 invDet = 1.0f / det;
+   const Point3F tvec = start - tri.v0;
+
+   const F32 u = mDot(tvec, pvec) * invDet;
+   if ( u < 0.0f || u > 1.0f )
+      return false;
+
+   Point3F qvec;
+   mCross(tvec, tri.edge1, &qvec);
+
+   const F32 v = mDot(dir, qvec) * invDet;
+   if ( v < 0.0f || u + v > 1.0f )
+      return false;
+
+   const F32 t = mDot(tri.edge2, qvec) * invDet;
+   if ( t < 0.0f || t > maxT )
+      return false;
+
+   outT = t;
+   outBary.set(u, v);
+   return true;
+}
+
+//-----------------------------------------------------------------------------
+// Packet tests. Rays are held in structure of arrays form, one F32[PacketSize]
+// per component; a lane with a negative maxT never hits anything.
+
+#ifdef TSMESHBVH_USE_SSE
+
+/// rayBox for a packet of rays. Returns a mask of the lanes which enter the
+/// box, with the earliest entry time of those lanes in @a outT.
+static inline U32 packetBox(const Box3F &box, const F32 *ox, const F32 *oy, const F32 *oz,
+                            const F32 *ix, const F32 *iy, const F32 *iz, const F32 *maxT, F32 &outT)
+{
+   const __m128 invX = _mm_loadu_ps(ix);
+   const __m128 invY = _mm_loadu_ps(iy);
+   const __m128 invZ = _mm_loadu_ps(iz);
+
+   __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.minExtents.x), _mm_loadu_ps(ox)), invX);
+   __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.maxExtents.x), _mm_loadu_ps(ox)), invX);
+   __m128 tmin = _mm_min_ps(t1, t2);
+   __m128 tmax = _mm_max_ps(t1, t2);
+
+   t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.minExtents.y), _mm_loadu_ps(oy)), invY);
+   t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.maxExtents.y), _mm_loadu_ps(oy)), invY);
+   tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+   tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+
+   t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.minExtents.z), _mm_loadu_ps(oz)), invZ);
+   t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.maxExtents.z), _mm_loadu_ps(oz)), invZ);
+   tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+   tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+
+   tmin = _mm_max_ps(tmin, _mm_setzero_ps());
+   tmax = _mm_min_ps(tmax, _mm_loadu_ps(maxT));
+
+   const U32 mask = _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+
+   // Misses are pushed out of the way before taking the nearest entry
+   tmin = _mm_or_ps(_mm_and_ps(_mm_cmple_ps(tmin, tmax), tmin),
+                    _mm_andnot_ps(_mm_cmple_ps(tmin, tmax), _mm_set1_ps(F32_MAX)));
+   tmin = _mm_min_ps(tmin, _mm_shuffle_ps(tmin, tmin, _MM_SHUFFLE(2, 3, 0, 1)));
+   tmin = _mm_min_ps(tmin, _mm_shuffle_ps(tmin, tmin, _MM_SHUFFLE(1, 0, 3, 2)));
+   _mm_store_ss(&outT, tmin);
+
+   return mask;
+}
+
+/// rayTriangle for the lanes of a packet in @a laneMask. Returns a mask of
+/// the lanes which hit, with their distances and weights in the out arrays.
+static inline U32 packetTriangle(const TSMeshBVH::Triangle &tri, U32 laneMask,
+                                 const F32 *ox, const F32 *oy, const F32 *oz,
+                                 const F32 *dx, const F32 *dy, const F32 *dz, const F32 *maxT,
+                                 F32 *outT, F32 *outU, F32 *outV)
+{
+   const __m128 dirX = _mm_loadu_ps(dx);
+   const __m128 dirY = _mm_loadu_ps(dy);
+   const __m128 dirZ = _mm_loadu_ps(dz);
+
+   const __m128 e1x = _mm_set1_ps(tri.edge1.x);
+   const __m128 e1y = _mm_set1_ps(tri.edge1.y);
+   const __m128 e1z = _mm_set1_ps(tri.edge1.z);
+   const __m128 e2x = _mm_set1_ps(tri.edge2.x);
+   const __m128 e2y = _mm_set1_ps(tri.edge2.y);
+   const __m128 e2z = _mm_set1_ps(tri.edge2.z);
+
+   // pvec = dir x edge2
+   const __m128 px = _mm_sub_ps(_mm_mul_ps(dirY, e2z), _mm_mul_ps(dirZ, e2y));
+   const __m128 py = _mm_sub_ps(_mm_mul_ps(dirZ, e2x), _mm_mul_ps(dirX, e2z));
+   const __m128 pz = _mm_sub_ps(_mm_mul_ps(dirX, e2y), _mm_mul_ps(dirY, e2x));
+
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0f);
+
+   const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+   __m128 valid = _mm_cmpneq_ps(det, zero);
+   const __m128 invDet = _mm_div_ps(one, det);
+
+   // tvec = start - v0
+   const __m128 tx = _mm_sub_ps(_mm_loadu_ps(ox), _mm_set1_ps(tri.v0.x));
+   const __m128 ty = _mm_sub_ps(_mm_loadu_ps(oy), _mm_set1_ps(tri.v0.y));
+   const __m128 tz = _mm_sub_ps(_mm_loadu_ps(oz), _mm_set1_ps(tri.v0.z));
+
+   const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+   valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+   // qvec = tvec x edge1
+   const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+   const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+   const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+   const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dirX, qx), _mm_mul_ps(dirY, qy)), _mm_mul_ps(dirZ, qz)), invDet);
+   valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+   const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+   valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmple_ps(t, _mm_loadu_ps(maxT))));
+
+   const U32 mask = _mm_movemask_ps(valid) & laneMask;
+   if ( mask )
+   {
+      _mm_storeu_ps(outT, t);
+      _mm_storeu_ps(outU, u);
+      _mm_storeu_ps(outV, v);
+   }
+
+   return mask;
+}
+
+/// Rays of one packet in structure of arrays form, with the nearest hit of
+/// each lane found so far
+template<U32 N> struct RayPacket
+{
+   F32 ox[N], oy[N], oz[N];
+   F32 dx[N], dy[N], dz[N];
+   F32 ix[N], iy[N], iz[N];
+   F32 maxT[N];
+   const TSMeshBVH::Triangle *bestTri[N];
+   Point2F bestBary[N];
+
+   /// Fills the lanes from up to N rays. Lanes past @a count and, for
+   /// anyHit, rays which are done get a negative maxT so they never enter a
+   /// box. Returns the number of active lanes.
+   U32 load(const Point3F *starts, const Point3F *ends, U32 count, const TSMeshBVH::Hit *hits, const U8 *found, bool anyHit)
+   {
+      U32 numActive = 0;
+      for ( U32 i=0; i<N; i++ )
+      {
+         bestTri[i] = NULL;
+
+         if ( i >= count || (anyHit && found[i]) )
+         {
+            ox[i] = oy[i] = oz[i] = 0.0f;
+            dx[i] = dy[i] = dz[i] = 1.0f;
+            ix[i] = iy[i] = iz[i] = 1.0f;
+            maxT[i] = -1.0f;
+            continue;
+         }
+
+         const Point3F dir = ends[i] - starts[i];
+         ox[i] = starts[i].x;
+         oy[i] = starts[i].y;
+         oz[i] = starts[i].z;
+         dx[i] = dir.x;
+         dy[i] = dir.y;
+         dz[i] = dir.z;
+         ix[i] = (dir.x != 0.0f) ? 1.0f / dir.x : 1e30f;
+         iy[i] = (dir.y != 0.0f) ? 1.0f / dir.y : 1e30f;
+         iz[i] = (dir.z != 0.0f) ? 1.0f / dir.z : 1e30f;
+         maxT[i] = anyHit ? 1.0f : hits[i].t;
+         numActive++;
+      }
+      return numActive;
+   }
+
+   /// Records the hits of the first @a count lanes
+   void store(U32 count, TSMeshBVH::Hit *hits, U8 *found) const
+   {
+      for ( U32 lane=0; lane<count; lane++ )
+      {
+         const TSMeshBVH::Triangle *tri = bestTri[lane];
+         if ( !tri )
+            continue;
+
+         TSMeshBVH::Hit &hit = hits[lane];
+         hit.t = maxT[lane];
+         hit.bary = bestBary[lane];
+         hit.triangle = tri->index;
+         mCross(tri->edge2, tri->edge1, &hit.normal);
+         hit.normal.normalize();
+         found[lane] = 1;
+      }
+   }
+
+   /// Largest maxT of all the lanes; nodes entered beyond it can be skipped
+   F32 furthest() const
+   {
+      F32 result = maxT[0];
+      for ( U32 lane=1; lane<N; lane++ )
+         result = getMax(result, maxT[lane]);
+      return result;
+   }
+};
+
+#endif
+
+#ifdef TSMESHBVH_USE_AVX
+
+// 8 lane versions of the above for CPUs with AVX. These only use AVX, not
+// FMA, so every lane rounds exactly as the SSE and scalar tests do.
+
+static TS_TARGET_AVX inline U32 packetBoxAVX(const Box3F &box, const F32 *ox, const F32 *oy, const F32 *oz,
+                                             const F32 *ix, const F32 *iy, const F32 *iz, const F32 *maxT, F32 &outT)
+{
+   const __m256 invX = _mm256_loadu_ps(ix);
+   const __m256 invY = _mm256_loadu_ps(iy);
+   const __m256 invZ = _mm256_loadu_ps(iz);
+
+   __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.minExtents.x), _mm256_loadu_ps(ox)), invX);
+   __m256 t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.maxExtents.x), _mm256_loadu_ps(ox)), invX);
+   __m256 tmin = _mm256_min_ps(t1, t2);
+   __m256 tmax = _mm256_max_ps(t1, t2);
+
+   t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.minExtents.y), _mm256_loadu_ps(oy)), invY);
+   t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.maxExtents.y), _mm256_loadu_ps(oy)), invY);
+   tmin = _mm256_max_ps(tmin, _mm256_min_ps(t1, t2));
+   tmax = _mm256_min_ps(tmax, _mm256_max_ps(t1, t2));
+
+   t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.minExtents.z), _mm256_loadu_ps(oz)), invZ);
+   t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(box.maxExtents.z), _mm256_loadu_ps(oz)), invZ);
+   tmin = _mm256_max_ps(tmin, _mm256_min_ps(t1, t2));
+   tmax = _mm256_min_ps(tmax, _mm256_max_ps(t1, t2));
+
+   tmin = _mm256_max_ps(tmin, _mm256_setzero_ps());
+   tmax = _mm256_min_ps(tmax, _mm256_loadu_ps(maxT));
+
+   const __m256 enter = _mm256_cmp_ps(tmin, tmax, _CMP_LE_OQ);
+   const U32 mask = _mm256_movemask_ps(enter);
+
+   tmin = _mm256_blendv_ps(_mm256_set1_ps(F32_MAX), tmin, enter);
+   tmin = _mm256_min_ps(tmin, _mm256_permute_ps(tmin, _MM_SHUFFLE(2, 3, 0, 1)));
+   tmin = _mm256_min_ps(tmin, _mm256_permute_ps(tmin, _MM_SHUFFLE(1, 0, 3, 2)));
+   tmin = _mm256_min_ps(tmin, _mm256_permute2f128_ps(tmin, tmin, 1));
+   _mm_store_ss(&outT, _mm256_castps256_ps128(tmin));
+
+   return mask;
+}
+
+static TS_TARGET_AVX inline U32 packetTriangleAVX(const TSMeshBVH::Triangle &tri, U32 laneMask,
+                                                  const F32 *ox, const F32 *oy, const F32 *oz,
+                                                  const F32 *dx, const F32 *dy, const F32 *dz, const F32 *maxT,
+                                                  F32 *outT, F32 *outU, F32 *outV)
+{
+   const __m256 dirX = _mm256_loadu_ps(dx);
+   const __m256 dirY = _mm256_loadu_ps(dy);
+   const __m256 dirZ = _mm256_loadu_ps(dz);
+
+   const __m256 e1x = _mm256_set1_ps(tri.edge1.x);
+   const __m256 e1y = _mm256_set1_ps(tri.edge1.y);
+   const __m256 e1z = _mm256_set1_ps(tri.edge1.z);
+   const __m256 e2x = _mm256_set1_ps(tri.edge2.x);
+   const __m256 e2y = _mm256_set1_ps(tri.edge2.y);
+   const __m256 e2z = _mm256_set1_ps(tri.edge2.z);
+
+   // pvec = dir x edge2
+   const __m256 px = _mm256_sub_ps(_mm256_mul_ps(dirY, e2z), _mm256_mul_ps(dirZ, e2y));
+   const __m256 py = _mm256_sub_ps(_mm256_mul_ps(dirZ, e2x), _mm256_mul_ps(dirX, e2z));
+   const __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dirX, e2y), _mm256_mul_ps(dirY, e2x));
+
+   const __m256 zero = _mm256_setzero_ps();
+   const __m256 one = _mm256_set1_ps(1.0f);
+
+   const __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+   __m256 valid = _mm256_cmp_ps(det, zero, _CMP_NEQ_UQ);
+   const __m256 invDet = _mm256_div_ps(one, det);
+
+   // tvec = start - v0
+   const __m256 tx = _mm256_sub_ps(_mm256_loadu_ps(ox), _mm256_set1_ps(tri.v0.x));
+   const __m256 ty = _mm256_sub_ps(_mm256_loadu_ps(oy), _mm256_set1_ps(tri.v0.y));
+   const __m256 tz = _mm256_sub_ps(_mm256_loadu_ps(oz), _mm256_set1_ps(tri.v0.z));
+
+   const __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)), _mm256_mul_ps(tz, pz)), invDet);
+   valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+
+   // qvec = tvec x edge1
+   const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+   const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+   const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+
+   const __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dirX, qx), _mm256_mul_ps(dirY, qy)), _mm256_mul_ps(dirZ, qz)), invDet);
+   valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+
+   const __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), invDet);
+   valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_loadu_ps(maxT), _CMP_LE_OQ)));
+
+   const U32 mask = _mm256_movemask_ps(valid) & laneMask;
+   if ( mask )
+   {
+      _mm256_storeu_ps(outT, t);
+      _mm256_storeu_ps(outU, u);
+      _mm256_storeu_ps(outV, v);
+   }
+
+   return mask;
+}
+
+/// TSMeshBVH::castPacket for up to WidePacketSize rays
+static TS_TARGET_AVX void castPacketAVX(const TSMeshBVH::Node *nodes, const TSMeshBVH::Triangle *triangles,
+                                        const Point3F *starts, const Point3F *ends, U32 count,
+                                        TSMeshBVH::Hit *hits, U8 *found, bool anyHit)
+{
+   typedef TSMeshBVH::Node Node;
+   typedef TSMeshBVH::Triangle Triangle;
+   const U32 WidePacketSize = TSMeshBVH::WidePacketSize;
+   const U32 MaxDepth = TSMeshBVH::MaxDepth;
+
+   // Same walk as castPacket, with twice the lanes
+   RayPacket<WidePacketSize> ray;
+   U32 numActive = ray.load(starts, ends, count, hits, found, anyHit);
+   if ( numActive == 0 )
+      return;
+
+   U32 stackNode[MaxDepth];
+   U32 stackMask[MaxDepth];
+   F32 stackT[MaxDepth];
+   S32 sp = 0;
+
+   U32 nodeIndex = 0;
+   F32 entryT;
+   U32 mask = packetBoxAVX(nodes[0].bounds, ray.ox, ray.oy, ray.oz, ray.ix, ray.iy, ray.iz, ray.maxT, entryT);
+
+   for (;;)
+   {
+      const Node &node = nodes[nodeIndex];
+
+      if ( !mask )
+      {
+         // nothing to do here
+      }
+      else if ( node.count )
+      {
+         const Triangle *tri = triangles + node.first;
+         for ( U32 i=0; i<node.count; i++, tri++ )
+         {
+            F32 t[WidePacketSize], u[WidePacketSize], v[WidePacketSize];
+            const U32 hitMask = packetTriangleAVX(*tri, mask, ray.ox, ray.oy, ray.oz, ray.dx, ray.dy, ray.dz, ray.maxT, t, u, v);
+            if ( !hitMask )
+               continue;
+
+            for ( U32 lane=0; lane<WidePacketSize; lane++ )
+            {
+               if ( !(hitMask & BIT(lane)) )
+                  continue;
+
+               if ( anyHit )
+               {
+                  found[lane] = 1;
+                  ray.maxT[lane] = -1.0f;
+                  if ( --numActive == 0 )
+                     return;
+               }
+               else
+               {
+                  ray.maxT[lane] = t[lane];
+                  ray.bestTri[lane] = tri;
+                  ray.bestBary[lane].set(u[lane], v[lane]);
+               }
+            }
+         }
+      }
+      else
+      {
+         F32 tA, tB;
+         const U32 maskA = packetBoxAVX(nodes[node.first].bounds, ray.ox, ray.oy, ray.oz, ray.ix, ray.iy, ray.iz, ray.maxT, tA);
+         const U32 maskB = packetBoxAVX(nodes[node.first+1].bounds, ray.ox, ray.oy, ray.oz, ray.ix, ray.iy, ray.iz, ray.maxT, tB);
+
+         if ( maskA && maskB )
+         {
+            const bool aFirst = tA <= tB;
+            stackNode[sp] = aFirst ? node.first + 1 : node.first;
+            stackMask[sp] = aFirst ? maskB : maskA;
+            stackT[sp] = aFirst ? tB : tA;
+            sp++;
+            nodeIndex = aFirst ? node.first : node.first + 1;
+            mask = aFirst ? maskA : maskB;
+            continue;
+         }
+         else if ( maskA || maskB )
+         {
+            nodeIndex = maskA ? node.first : node.first + 1;
+            mask = maskA | maskB;
+            continue;
+         }
+      }
+
+      const F32 furthest = ray.furthest();
+      while ( sp > 0 && stackT[sp-1] > furthest )
+         sp--;
+
+      if ( sp == 0 )
+         break;
+
+      sp--;
+      nodeIndex = stackNode[sp];
+      mask = stackMask[sp];
+   }
+
+   ray.store(count, hits, found);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+
+bool TSMeshBVH::smUseAVX = false;
+
+//-----------------------------------------------------------------------------
+
+void TSMeshBVH::build(const Point3F *verts, U32 stride, const Vector<U32> &indices, const Vector<U32> &materials)
+{
+   PROFILE_SCOPE( TSMeshBVH_build );
+
+   const U32 numTris = indices.size() / 3;
+   AssertFatal(materials.size() == numTris, "TSMeshBVH::build - need one material per triangle");
+
+   mNodes.clear();
+   mTriangles.clear();
+   mIndices = indices;
+   mMaterials = materials;
+
+   if ( numTris == 0 )
+      return;
+
+   const U8 *base = reinterpret_cast<const U8*>(verts);
+   #define BVH_VERT(idx) (*reinterpret_cast<const Point3F*>(base + (idx) * stride))
+
+   Vector<BuildTri> tris;
+   Vector<U32> order;
+   tris.setSize(numTris);
+   order.setSize(numTris);
+
+   Box3F rootBounds = Box3F::Invalid;
+   for ( U32 i=0; i<numTris; i++ )
+   {
+      BuildTri &tri = tris[i];
+      tri.bounds = Box3F::Invalid;
+      tri.bounds.intersect(BVH_VERT(indices[i*3+0]));
+      tri.bounds.intersect(BVH_VERT(indices[i*3+1]));
+      tri.bounds.intersect(BVH_VERT(indices[i*3+2]));
+      tri.center = tri.bounds.getCenter();
+      rootBounds.intersect(tri.bounds);
+      order[i] = i;
+   }
+
+   // A binary tree over n leaves has at most 2n-1 nodes
+   mNodes.reserve(numTris * 2);
+   mNodes.increment();
+   mNodes[0].bounds = rootBounds;
+   mNodes[0].first = 0;
+   mNodes[0].count = numTris;
+
+   // Split depth first, so each subtree ends up in one run of nodes
+   Vector<U32> stack;
+   Vector<U32> depths;
+   stack.push_back(0);
+   depths.push_back(0);
+
+   while ( !stack.empty() )
+   {
+      const U32 nodeIndex = stack.last();
+      const U32 depth = depths.last();
+      stack.pop_back();
+      depths.pop_back();
+
+      if ( depth + 1 >= MaxDepth || !splitNode(nodeIndex, tris, order) )
+         continue;
+
+      const U32 left = mNodes[nodeIndex].first;
+      stack.push_back(left + 1);
+      depths.push_back(depth + 1);
+      stack.push_back(left);
+      depths.push_back(depth + 1);
+   }
+
+   mTriangles.setSize(numTris);
+   for ( U32 i=0; i<numTris; i++ )
+   {
+      const U32 src = order[i];
+      const Point3F &v0 = BVH_VERT(indices[src*3+0]);
+
+      Triangle &tri = mTriangles[i];
+      tri.v0 = v0;
+      tri.edge1 = BVH_VERT(indices[src*3+1]) - v0;
+      tri.edge2 = BVH_VERT(indices[src*3+2]) - v0;
+      tri.index = src;
+   }
+
+   #undef BVH_VERT
+
+   mNodes.compact();
+}
+
+void TSMeshBVH::refit(const Point3F *verts, U32 stride)
+{
+   PROFILE_SCOPE( TSMeshBVH_refit );
+
+   const U8 *base = reinterpret_cast<const U8*>(verts);
+   #define BVH_VERT(idx) (*reinterpret_cast<const Point3F*>(base + (idx) * stride))
+
+   for ( S32 i=0; i<mTriangles.size(); i++ )
+   {
+      Triangle &tri = mTriangles[i];
+      const U32 *idx = mIndices.address() + tri.index * 3;
+      const Point3F &v0 = BVH_VERT(idx[0]);
+
+      tri.v0 = v0;
+      tri.edge1 = BVH_VERT(idx[1]) - v0;
+      tri.edge2 = BVH_VERT(idx[2]) - v0;
+   }
+
+   #undef BVH_VERT
+
+   // Children always come after their parent, so walking backwards visits
+   // both children of a node before the node itself
+   for ( S32 i=mNodes.size()-1; i>=0; i-- )
+   {
+      Node &node = mNodes[i];
+
+      if ( node.count )
+      {
+         node.bounds = Box3F::Invalid;
+         const Triangle *tri = mTriangles.address() + node.first;
+         for ( U32 j=0; j<node.count; j++, tri++ )
+         {
+            node.bounds.intersect(tri->v0);
+            node.bounds.intersect(tri->v0 + tri->edge1);
+            node.bounds.intersect(tri->v0 + tri->edge2);
+         }
+      }
+      else
+      {
+         node.bounds = mNodes[node.first].bounds;
+         node.bounds.intersect(mNodes[node.first+1].bounds);
+      }
+   }
+}
+
+bool TSMeshBVH::splitNode(U32 nodeIndex, Vector<BuildTri> &tris, Vector<U32> &order)
+{
+   const U32 first = mNodes[nodeIndex].first;
+   const U32 count = mNodes[nodeIndex].count;
+   const F32 nodeArea = halfArea(mNodes[nodeIndex].bounds);
+
+   if ( count <= MaxLeafSize )
+      return false;
+
+   Box3F centers = Box3F::Invalid;
+   for ( U32 i=first; i<first+count; i++ )
+      centers.intersect(tris[order[i]].center);
+
+   // Find the cheapest split between bins on any axis
+   S32 bestAxis = -1;
+   U32 bestSplit = 0;
+   F32 bestCost = F32_MAX;
+
+   for ( U32 axis=0; axis<3; axis++ )
+   {
+      const F32 lo = centers.minExtents[axis];
+      const F32 extent = centers.maxExtents[axis] - lo;
+      if ( extent <= 0.0f )
+         continue;
+
+      U32 binCount[NumBins];
+      Box3F binBounds[NumBins];
+      for ( U32 b=0; b<NumBins; b++ )
+      {
+         binCount[b] = 0;
+         binBounds[b] = Box3F::Invalid;
+      }
+
+      const F32 scale = NumBins / extent;
+      for ( U32 i=first; i<first+count; i++ )
+      {
+         const BuildTri &tri = tris[order[i]];
+         const U32 b = getMin(U32((tri.center[axis] - lo) * scale), U32(NumBins - 1));
+         binCount[b]++;
+         binBounds[b].intersect(tri.bounds);
+      }
+
+      // Sweep from the right to get the cost of everything past each split,
+      // then from the left to add the cost of everything before it
+      F32 rightCost[NumBins];
+      Box3F box = Box3F::Invalid;
+      U32 num = 0;
+      for ( U32 b=NumBins-1; b>0; b-- )
+      {
+         num += binCount[b];
+         box.intersect(binBounds[b]);
+         rightCost[b] = num ? num * halfArea(box) : 0.0f;
+      }
+
+      box = Box3F::Invalid;
+      num = 0;
+      for ( U32 b=0; b<NumBins-1; b++ )
+      {
+         num += binCount[b];
+         box.intersect(binBounds[b]);
+         if ( num == 0 || num == count )
+            continue;
+
+         const F32 cost = num * halfArea(box) + rightCost[b+1];
+         if ( cost < bestCost )
+         {
+            bestCost = cost;
+            bestAxis = axis;
+            bestSplit = b;
+         }
+      }
+   }
+
+   U32 mid;
+   if ( bestAxis < 0 )
+   {
+      // Every center is in the same place, so no split helps rays. Halve
+      // big nodes anyway to keep the leaves small.
+      if ( count <= MaxLeafSize * 4 )
+         return false;
+      mid = first + count / 2;
+   }
+   else
+   {
+      // Splitting costs about one extra box test per ray
+      if ( bestCost >= (count - 1) * nodeArea )
+         return false;
+
+      const F32 lo = centers.minExtents[bestAxis];
+      const F32 scale = NumBins / (centers.maxExtents[bestAxis] - lo);
+
+      U32 i = first;
+      U32 j = first + count;
+      while ( i < j )
+      {
+         const BuildTri &tri = tris[order[i]];
+         const U32 b = getMin(U32((tri.center[bestAxis] - lo) * scale), U32(NumBins - 1));
+         if ( b <= bestSplit )
+            i++;
+         else
+         {
+            j--;
+            const U32 tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+         }
+      }
+      mid = i;
+   }
+
+   const U32 left = mNodes.size();
+   mNodes.increment(2);
+
+   Node &leftNode = mNodes[left];
+   leftNode.bounds = Box3F::Invalid;
+   leftNode.first = first;
+   leftNode.count = mid - first;
+
+   Node &rightNode = mNodes[left+1];
+   rightNode.bounds = Box3F::Invalid;
+   rightNode.first = mid;
+   rightNode.count = first + count - mid;
+
+   for ( U32 i=first; i<mid; i++ )
+      leftNode.bounds.intersect(tris[order[i]].bounds);
+   for ( U32 i=mid; i<first+count; i++ )
+      rightNode.bounds.intersect(tris[order[i]].bounds);
+
+   mNodes[nodeIndex].first = left;
+   mNodes[nodeIndex].count = 0;
+   return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TSMeshBVH::castRay(const Point3F &start, const Point3F &end, Hit *hit) const
+{
+   if ( mNodes.empty() )
+      return false;
+
+   const Point3F dir = end - start;
+
+   // A zero component never leaves its slab, so any large value will do
+   Point3F invDir;
+   for ( U32 i=0; i<3; i++ )
+      invDir[i] = (dir[i] != 0.0f) ? 1.0f / dir[i] : 1e30f;
+
+   F32 bestT = 1.0f;
+   const Triangle *bestTri = NULL;
+
+   F32 t;
+   if ( !rayBox(mNodes[0].bounds, start, invDir, bestT, t) )
+      return false;
+
+   // Far children waiting to be visited, with their entry times
+   U32 stackNode[MaxDepth];
+   F32 stackT[MaxDepth];
+   S32 sp = 0;
+
+   U32 nodeIndex = 0;
+   for (;;)
+   {
+      const Node &node = mNodes[nodeIndex];
+
+      if ( node.count )
+      {
+         const Triangle *tri = mTriangles.address() + node.first;
+         for ( U32 i=0; i<node.count; i++, tri++ )
+         {
+            Point2F bary;
+            if ( !rayTriangle(*tri, start, dir, bestT, t, bary) )
+               continue;
+
+            if ( !hit )
+               return true;
+
+            bestT = t;
+            bestTri = tri;
+            hit->bary = bary;
+         }
+      }
+      else
+      {
+         F32 tA, tB;
+         const bool hitA = rayBox(mNodes[node.first].bounds, start, invDir, bestT, tA);
+         const bool hitB = rayBox(mNodes[node.first+1].bounds, start, invDir, bestT, tB);
+
+         if ( hitA && hitB )
+         {
+            // Visit the nearer child first so the far one can be culled
+            const bool aFirst = tA <= tB;
+            stackNode[sp] = aFirst ? node.first + 1 : node.first;
+            stackT[sp] = aFirst ? tB : tA;
+            sp++;
+            nodeIndex = aFirst ? node.first : node.first + 1;
+            continue;
+         }
+         else if ( hitA || hitB )
+         {
+            nodeIndex = hitA ? node.first : node.first + 1;
+            continue;
+         }
+      }
+
+      // Skip anything which starts beyond the best hit so far
+      while ( sp > 0 && stackT[sp-1] > bestT )
+         sp--;
+
+      if ( sp == 0 )
+         break;
+
+      sp--;
+      nodeIndex = stackNode[sp];
+   }
+
+   if ( !bestTri )
+      return false;
+
+   hit->t = bestT;
+   hit->triangle = bestTri->index;
+   mCross(bestTri->edge2, bestTri->edge1, &hit->normal);
+   hit->normal.normalize();
+   return true;
+}
+
+void TSMeshBVH::castRays(const Point3F *starts, const Point3F *ends, U32 count, Hit *hits, U8 *found, bool anyHit) const
+{
+   PROFILE_SCOPE( TSMeshBVH_castRays );
+
+   if ( mNodes.empty() )
+      return;
+
+#ifdef TSMESHBVH_USE_AVX
+   if ( smUseAVX )
+   {
+      for ( U32 i=0; i<count; i+=WidePacketSize )
+         castPacketAVX(mNodes.address(), mTriangles.address(), starts + i, ends + i,
+                       getMin(count - i, U32(WidePacketSize)), hits ? hits + i : NULL, found + i, anyHit);
+      return;
+   }
+#endif
+
+#ifdef TSMESHBVH_USE_SSE
+   for ( U32 i=0; i<count; i+=PacketSize )
+      castPacket(starts + i, ends + i, getMin(count - i, U32(PacketSize)), hits ? hits + i : NULL, found + i, anyHit);
+#else
+   // Without SIMD a packet only adds work, so cast the rays one at a time
+   for ( U32 i=0; i<count; i++ )
+   {
+      if ( anyHit )
+      {
+         if ( !found[i] && castRay(starts[i], ends[i], NULL) )
+            found[i] = 1;
+         continue;
+      }
+
+      Hit hit;
+      if ( castRay(starts[i], ends[i], &hit) && hit.t < hits[i].t )
+      {
+         hits[i] = hit;
+         found[i] = 1;
+      }
+   }
+#endif
+}
+
+#ifdef TSMESHBVH_USE_SSE
+
+void TSMeshBVH::castPacket(const Point3F *starts, const Point3F *ends, U32 count, Hit *hits, U8 *found, bool anyHit) const
+{
+   // The box test below works on every lane at once. Lanes with a negative
+   // maxT never enter a box; that covers unused lanes and, for anyHit, rays
+   // which are done.
+   RayPacket<PacketSize> ray;
+   U32 numActive = ray.load(starts, ends, count, hits, found, anyHit);
+   if ( numActive == 0 )
+      return;
+
+   // Each node is visited with the mask of lanes which entered it
+   U32 stackNode[MaxDepth];
+   U32 stackMask[MaxDepth];
+   F32 stackT[MaxDepth];
+   S32 sp = 0;
+
+   U32 nodeIndex = 0;
+   F32 entryT;
+   U32 mask = packetBox(mNodes[0].bounds, ray.ox, ray.oy, ray.oz, ray.ix, ray.iy, ray.iz, ray.maxT, entryT);
+
+   for (;;)
+   {
+      const Node &node = mNodes[nodeIndex];
+
+      if ( !mask )
+      {
+         // nothing to do here
+      }
+      else if ( node.count )
+      {
+         const Triangle *tri = mTriangles.address() + node.first;
+         for ( U32 i=0; i<node.count; i++, tri++ )
+         {
+            F32 t[PacketSize], u[PacketSize], v[PacketSize];
+            const U32 hitMask = packetTriangle(*tri, mask, ray.ox, ray.oy, ray.oz, ray.dx, ray.dy, ray.dz, ray.maxT, t, u, v);
+            if ( !hitMask )
+               continue;
+
+            for ( U32 lane=0; lane<PacketSize; lane++ )
+            {
+               if ( !(hitMask & BIT(lane)) )
+                  continue;
+
+               if ( anyHit )
+               {
+                  found[lane] = 1;
+                  ray.maxT[lane] = -1.0f;
+                  if ( --numActive == 0 )
+                     return;
+               }
+               else
+               {
+                  ray.maxT[lane] = t[lane];
+                  ray.bestTri[lane] = tri;
+                  ray.bestBary[lane].set(u[lane], v[lane]);
+               }
+            }
+         }
+      }
+      else
+      {
+         F32 tA, tB;
+         const U32 maskA = packetBox(mNodes[node.first].bounds, ray.ox, ray.oy, ray.oz, ray.ix, ray.iy, ray.iz, ray.maxT, tA);
+         const U32 maskB = packetBox(mNodes[node.first+1].bounds, ray.ox, ray.oy, ray.oz, ray.ix, ray.iy, ray.iz, ray.maxT, tB);
+
+         if ( maskA && maskB )
+         {
+            const bool aFirst = tA <= tB;
+            stackNode[sp] = aFirst ? node.first + 1 : node.first;
+            stackMask[sp] = aFirst ? maskB : maskA;
+            stackT[sp] = aFirst ? tB : tA;
+            sp++;
+            nodeIndex = aFirst ? node.first : node.first + 1;
+            mask = aFirst ? maskA : maskB;
+            continue;
+         }
+         else if ( maskA || maskB )
+         {
+            nodeIndex = maskA ? node.first : node.first + 1;
+            mask = maskA | maskB;
+            continue;
+         }
+      }
+
+      // A node can be skipped once every lane has a hit in front of it
+      const F32 furthest = ray.furthest();
+      while ( sp > 0 && stackT[sp-1] > furthest )
+         sp--;
+
+      if ( sp == 0 )
+         break;
+
+      sp--;
+      nodeIndex = stackNode[sp];
+      mask = stackMask[sp];
+   }
+
+   ray.store(count, hits, found);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+
+END_NS
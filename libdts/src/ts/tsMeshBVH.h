@@ -0,0 +1,181 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _TSMESHBVH_H_
+#define _TSMESHBVH_H_
+
+#ifndef _PLATFORM_H_
+#include "platform/platform.h"
+#endif
+
+#ifndef _TVECTOR_H_
+#include "core/util/tVector.h"
+#endif
+
+#ifndef _MBOX_H_
+#include "math/mBox.h"
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+/// Bounding volume hierarchy over the triangles of one mesh frame.
+///
+/// The tree is built top down with a binned surface area heuristic. Nodes are
+/// stored depth first in one array with the two children of a node next to
+/// each other, and the triangles of each leaf are stored together with their
+/// first vertex and edges so a ray test touches no other memory.
+///
+/// Triangles keep the number they were given in build(), which can be used
+/// with getTriangle() to find the vertices and material of a hit.
+///
+/// A built tree is read only, so rays may be cast against it from several
+/// threads at once. Trees may be copied, e.g. to refit() one copy per
+/// animated instance.
+class TSMeshBVH
+{
+public:
+   enum Constants
+   {
+      NumBins = 16,        ///< SAH candidate splits per axis
+      MaxLeafSize = 4,     ///< Leaves are split down to this many triangles if worthwhile
+      MaxDepth = 48,       ///< Deeper nodes become leaves; also the traversal stack size
+      PacketSize = 4,      ///< Rays traversed together by castRays, one per SSE lane
+      WidePacketSize = 8   ///< Rays traversed together with smUseAVX, one per AVX lane
+   };
+
+   struct Node
+   {
+      Box3F bounds;
+      U32 first;           ///< Leaf: first triangle, otherwise first child
+      U32 count;           ///< Leaf: number of triangles, otherwise 0
+   };
+
+   struct Triangle
+   {
+      Point3F v0;
+      Point3F edge1;       ///< v1 - v0
+      Point3F edge2;       ///< v2 - v0
+      U32 index;           ///< Triangle number passed to build()
+   };
+
+   struct Hit
+   {
+      F32 t;               ///< Distance along the ray, 0..1 from start to end
+      Point2F bary;        ///< Weights of v1 and v2 at the hit point
+      VectorF normal;      ///< Unit face normal, (v2-v0) x (v1-v0)
+      U32 triangle;        ///< Triangle number passed to build()
+   };
+
+protected:
+   Vector<Node> mNodes;
+   Vector<Triangle> mTriangles;
+   Vector<U32> mIndices;      ///< 3 per triangle, in build() order
+   Vector<U32> mMaterials;    ///< 1 per triangle, in build() order
+
+   struct BuildTri
+   {
+      Box3F bounds;
+      Point3F center;
+   };
+
+   /// Splits mNodes[nodeIndex] if that is cheaper than leaving it a leaf.
+   /// Returns false if it is left as a leaf.
+   bool splitNode(U32 nodeIndex, Vector<BuildTri> &tris, Vector<U32> &order);
+
+   /// castRays for up to PacketSize rays; only built with SSE
+   void castPacket(const Point3F *starts, const Point3F *ends, U32 count, Hit *hits, U8 *found, bool anyHit) const;
+
+public:
+   /// castRays uses WidePacketSize packets. Set by initMeshIntrinsics() when
+   /// the CPU and OS support AVX; only has an effect in x86 builds.
+   ///
+   /// Wide packets pay off when the rays of a batch stay close together,
+   /// e.g. a tight shotgun spread. Rays which fan out split up sooner and
+   /// a wide packet then visits more of the tree than two narrow ones, so
+   /// clear this if most batches are spread out.
+   static bool smUseAVX;
+
+   /// Builds the tree.
+   ///
+   /// @param verts      First vertex position
+   /// @param stride     Bytes between vertex positions
+   /// @param indices    3 vertex indices per triangle
+   /// @param materials  Material index of each triangle
+   void build(const Point3F *verts, U32 stride, const Vector<U32> &indices, const Vector<U32> &materials);
+
+   /// Moves the triangles to new vertex positions, keeping the tree built
+   /// for the old ones. Node bounds are recomputed bottom up in one pass, so
+   /// this is much cheaper than build(), but the tree gets looser the further
+   /// the vertices move. Meant for skins, where each pose stays close to
+   /// the bind pose the tree was built for.
+   ///
+   /// @param verts   First vertex position, indexed as in build()
+   /// @param stride  Bytes between vertex positions
+   void refit(const Point3F *verts, U32 stride);
+
+   bool isEmpty() const { return mTriangles.empty(); }
+   U32 getTriangleCount() const { return mTriangles.size(); }
+   U32 getNodeCount() const { return mNodes.size(); }
+   const Box3F &getBounds() const { return mNodes[0].bounds; }
+
+   /// Returns the vertex indices and material of a triangle
+   void getTriangle(U32 triangle, U32 *outIndices, U32 &outMaterial) const
+   {
+      outIndices[0] = mIndices[triangle*3+0];
+      outIndices[1] = mIndices[triangle*3+1];
+      outIndices[2] = mIndices[triangle*3+2];
+      outMaterial = mMaterials[triangle];
+   }
+
+   /// Finds the nearest triangle crossed by the segment @a start to @a end.
+   /// Triangles are hit from either side.
+   ///
+   /// If @a hit is NULL the search stops at the first triangle found, which
+   /// is all a line of sight test needs.
+   bool castRay(const Point3F &start, const Point3F &end, Hit *hit) const;
+
+   /// Casts @a count rays, PacketSize at a time where SSE is available and
+   /// WidePacketSize at a time with smUseAVX. Rays in a packet share one walk
+   /// of the tree and are tested against each box and triangle together, so
+   /// rays which start close together and point the same way cost little
+   /// more than one. Elsewhere the rays are cast one by one.
+   ///
+   /// On input hits[i].t is the furthest distance to look along ray i, 1 for
+   /// the whole segment. Rays which hit a nearer triangle have their Hit
+   /// filled in and found[i] set to 1; the others are left alone.
+   ///
+   /// With @a anyHit, rays whose found flag is already set are skipped and
+   /// the others stop at the first triangle they cross; only found is written
+   /// and @a hits may be NULL.
+   void castRays(const Point3F *starts, const Point3F *ends, U32 count, Hit *hits, U8 *found, bool anyHit) const;
+};
+
+//-----------------------------------------------------------------------------
+
+END_NS
+
+#endif // _TSMESHBVH_H_
@@ -22,6 +22,7 @@
 
 #include "platform/platform.h"
 #include "ts/tsMesh.h"
+#include "ts/tsMeshBVH.h"
 #include "ts/tsMeshIntrinsics.h"
 #include "ts/arch/tsMeshIntrinsics.arch.h"
 #include "libdtshape.h"
@@ -34,6 +35,12 @@ BEGIN_NS(DTShape)
 
 void (*zero_vert_normal_bulk)(const dsize_t count, U8 * __restrict const outPtr, const dsize_t outStride) = NULL;
 void (*m_matF_x_BatchedVertWeightList)(const MatrixF &mat, const dsize_t count, const TSSkinMesh::BatchData::BatchedVertWeight * __restrict batch, U8 * const __restrict outPtr, const dsize_t outStride) = NULL;
+void (*m_matF_x_BatchedVertex4List)(const MatrixF *matrices, const dsize_t count, const TSSkinMesh::BatchData::BatchedVertex4 * __restrict batch, U8 * const __restrict outPtr, const dsize_t outStride) = NULL;
+void (*m_dualQuat_x_BatchedVertexList)(const DualQuatF *dualQuats, const dsize_t count, const TSSkinMesh::BatchData::BatchedVertex * __restrict batch, const Point3F * __restrict inVerts, const Point3F * __restrict inNorms, U8 * const __restrict outPtr, const dsize_t outStride) = NULL;
+void (*m_matF_x_SoAVertWeightBlocks)(const MatrixF *matrices, const dsize_t numBlocks, const TSSkinMesh::BatchData::SoAInfluence * __restrict influences, const S32 *blockStart, const F32 * __restrict inStreams, F32 * __restrict outStreams, const dsize_t streamSize) = NULL;
+void (*m_quat16_nlerp_BatchedKeyList)(const dsize_t count, const Quat16 * __restrict keys1, const Quat16 * __restrict keys2, const dsize_t keyStride, const F32 t, QuatF * __restrict out) = NULL;
+void (*m_quatF_point3F_x_matF_BatchedList)(const dsize_t count, const QuatF * __restrict rots, const Point3F * __restrict trans, MatrixF * __restrict out) = NULL;
+void (*m_matF_x_matF_NodeList)(const dsize_t count, const S32 * __restrict nodes, const S32 * __restrict parents, const MatrixF * __restrict local, MatrixF * world) = NULL;
 
 //------------------------------------------------------------------------------
 // Default C++ Implementations (pretty slow)
@@ -81,6 +88,241 @@ void m_matF_x_BatchedVertWeightList_C(const MatrixF &mat,
    }
 }
 
+//------------------------------------------------------------------------------
+
+void m_matF_x_BatchedVertex4List_C(const MatrixF *matrices,
+                                   const dsize_t count,
+                                   const TSSkinMesh::BatchData::BatchedVertex4 * __restrict batch,
+                                   U8 * const __restrict outPtr,
+                                   const dsize_t outStride)
+{
+   for(dsize_t i = 0; i < count; i++)
+   {
+      const TSSkinMesh::BatchData::BatchedVertex4 &inElem = batch[i];
+      TSMesh::__TSMeshVertexBase *outElem = reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + inElem.vidx * outStride);
+
+      // Blend the top 3 rows of the influencing transforms
+      F32 m[12];
+      for(S32 j = 0; j < 12; j++)
+         m[j] = 0.0f;
+
+      for(S32 k = 0; k < inElem.transformCount; k++)
+      {
+         const F32 *src = matrices[inElem.transformIndex[k]];
+         const F32 w = inElem.weight[k];
+         for(S32 j = 0; j < 12; j++)
+            m[j] += src[j] * w;
+      }
+
+      const Point3F &v = inElem.vert;
+      const Point3F &n = inElem.normal;
+      outElem->_vert.set(m[0] * v.x + m[1] * v.y + m[2]  * v.z + m[3],
+                         m[4] * v.x + m[5] * v.y + m[6]  * v.z + m[7],
+                         m[8] * v.x + m[9] * v.y + m[10] * v.z + m[11]);
+      outElem->_normal.set(m[0] * n.x + m[1] * n.y + m[2]  * n.z,
+                           m[4] * n.x + m[5] * n.y + m[6]  * n.z,
+                           m[8] * n.x + m[9] * n.y + m[10] * n.z);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+void m_dualQuat_x_BatchedVertexList_C(const DualQuatF *dualQuats,
+                                      const dsize_t count,
+                                      const TSSkinMesh::BatchData::BatchedVertex * __restrict batch,
+                                      const Point3F * __restrict inVerts,
+                                      const Point3F * __restrict inNorms,
+                                      U8 * const __restrict outPtr,
+                                      const dsize_t outStride)
+{
+   DualQuatF blend;
+
+   for(dsize_t i = 0; i < count; i++)
+   {
+      const TSSkinMesh::BatchData::BatchedVertex &inElem = batch[i];
+      TSMesh::__TSMeshVertexBase *outElem = reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outPtr + inElem.vertexIndex * outStride);
+
+      // Vertices without influences are zeroed, as in the other paths
+      if(inElem.transformCount <= 0)
+      {
+         outElem->_vert.set(0.0f, 0.0f, 0.0f);
+         outElem->_normal.set(0.0f, 0.0f, 0.0f);
+         continue;
+      }
+
+      // q and -q are the same rotation, so blend every influence in the
+      // same hemisphere as the first to take the shortest path
+      const QuatF &pivot = dualQuats[inElem.transform[0].transformIndex].real;
+
+      blend.real.set(0.0f, 0.0f, 0.0f, 0.0f);
+      blend.dual.set(0.0f, 0.0f, 0.0f, 0.0f);
+
+      for(S32 k = 0; k < inElem.transformCount; k++)
+      {
+         const DualQuatF &dq = dualQuats[inElem.transform[k].transformIndex];
+         F32 w = inElem.transform[k].weight;
+         if(pivot.x * dq.real.x + pivot.y * dq.real.y + pivot.z * dq.real.z + pivot.w * dq.real.w < 0.0f)
+            w = -w;
+
+         blend.real.x += dq.real.x * w; blend.real.y += dq.real.y * w;
+         blend.real.z += dq.real.z * w; blend.real.w += dq.real.w * w;
+         blend.dual.x += dq.dual.x * w; blend.dual.y += dq.dual.y * w;
+         blend.dual.z += dq.dual.z * w; blend.dual.w += dq.dual.w * w;
+      }
+
+      blend.normalize();
+      blend.mulP(inVerts[inElem.vertexIndex], &outElem->_vert);
+      blend.mulV(inNorms[inElem.vertexIndex], &outElem->_normal);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+void m_matF_x_SoAVertWeightBlocks_C(const MatrixF *matrices,
+                                    const dsize_t numBlocks,
+                                    const TSSkinMesh::BatchData::SoAInfluence * __restrict influences,
+                                    const S32 *blockStart,
+                                    const F32 * __restrict inStreams,
+                                    F32 * __restrict outStreams,
+                                    const dsize_t streamSize)
+{
+   const S32 blockSize = TSSkinMesh::BatchData::soaBlockSize;
+
+   const F32 *inPX = inStreams;
+   const F32 *inPY = inStreams + streamSize;
+   const F32 *inPZ = inStreams + streamSize * 2;
+   const F32 *inNX = inStreams + streamSize * 3;
+   const F32 *inNY = inStreams + streamSize * 4;
+   const F32 *inNZ = inStreams + streamSize * 5;
+
+   F32 *outPX = outStreams;
+   F32 *outPY = outStreams + streamSize;
+   F32 *outPZ = outStreams + streamSize * 2;
+   F32 *outNX = outStreams + streamSize * 3;
+   F32 *outNY = outStreams + streamSize * 4;
+   F32 *outNZ = outStreams + streamSize * 5;
+
+   for(dsize_t block = 0; block < numBlocks; block++)
+   {
+      const dsize_t base = block * blockSize;
+
+      for(S32 lane = 0; lane < blockSize; lane++)
+      {
+         outPX[base + lane] = 0.0f;
+         outPY[base + lane] = 0.0f;
+         outPZ[base + lane] = 0.0f;
+         outNX[base + lane] = 0.0f;
+         outNY[base + lane] = 0.0f;
+         outNZ[base + lane] = 0.0f;
+      }
+
+      for(S32 i = blockStart[block]; i < blockStart[block + 1]; i++)
+      {
+         const TSSkinMesh::BatchData::SoAInfluence &influence = influences[i];
+
+         for(S32 lane = 0; lane < blockSize; lane++)
+         {
+            if(influence.bone[lane] < 0)
+               continue;
+
+            const F32 *m = matrices[influence.bone[lane]];
+            const F32 w = influence.weight[lane];
+            const dsize_t idx = base + lane;
+
+            // Same evaluation order as MatrixF::mulP / mulV
+            outPX[idx] += (m[0] * inPX[idx] + m[1] * inPY[idx] + m[2]  * inPZ[idx] + m[3])  * w;
+            outPY[idx] += (m[4] * inPX[idx] + m[5] * inPY[idx] + m[6]  * inPZ[idx] + m[7])  * w;
+            outPZ[idx] += (m[8] * inPX[idx] + m[9] * inPY[idx] + m[10] * inPZ[idx] + m[11]) * w;
+
+            outNX[idx] += (m[0] * inNX[idx] + m[1] * inNY[idx] + m[2]  * inNZ[idx]) * w;
+            outNY[idx] += (m[4] * inNX[idx] + m[5] * inNY[idx] + m[6]  * inNZ[idx]) * w;
+            outNZ[idx] += (m[8] * inNX[idx] + m[9] * inNY[idx] + m[10] * inNZ[idx]) * w;
+         }
+      }
+   }
+}
+
+//------------------------------------------------------------------------------
+
+void interleave_SoA_vert_normal(const dsize_t count,
+                                const F32 * __restrict inStreams,
+                                const dsize_t streamSize,
+                                U8 * __restrict const outPtr,
+                                const dsize_t outStride)
+{
+   U8 *outData = outPtr;
+
+   for(dsize_t i = 0; i < count; i++)
+   {
+      TSMesh::__TSMeshVertexBase *outElem = reinterpret_cast<TSMesh::__TSMeshVertexBase *>(outData);
+      outElem->_vert.set(inStreams[i], inStreams[i + streamSize], inStreams[i + streamSize * 2]);
+      outElem->_normal.set(inStreams[i + streamSize * 3], inStreams[i + streamSize * 4], inStreams[i + streamSize * 5]);
+      outData += outStride;
+   }
+}
+
+//------------------------------------------------------------------------------
+
+void m_quat16_nlerp_BatchedKeyList_C(const dsize_t count,
+                                     const Quat16 * __restrict keys1,
+                                     const Quat16 * __restrict keys2,
+                                     const dsize_t keyStride,
+                                     const F32 t,
+                                     QuatF * __restrict out)
+{
+   QuatF q1, q2;
+   for(dsize_t i = 0; i < count; i++)
+   {
+      keys1[i * keyStride].getQuatF(&q1);
+      keys2[i * keyStride].getQuatF(&q2);
+      TSTransform::interpolate(q1, q2, t, &out[i]);
+   }
+}
+
+//------------------------------------------------------------------------------
+
+void m_quatF_point3F_x_matF_BatchedList_C(const dsize_t count,
+                                          const QuatF * __restrict rots,
+                                          const Point3F * __restrict trans,
+                                          MatrixF * __restrict out)
+{
+   for(dsize_t i = 0; i < count; i++)
+      TSTransform::setMatrix(rots[i], trans[i], &out[i]);
+}
+
+//------------------------------------------------------------------------------
+
+void m_matF_x_matF_NodeList_C(const dsize_t count,
+                              const S32 * __restrict nodes,
+                              const S32 * __restrict parents,
+                              const MatrixF * __restrict local,
+                              MatrixF * world)
+{
+   for(dsize_t i = 0; i < count; i++)
+   {
+      const S32 node = nodes[i];
+      if (parents[i] < 0)
+      {
+         world[node] = local[node];
+         continue;
+      }
+
+      // Same as MatrixF::mul with the bottom rows of both matrices left out
+      const F32 *a = world[parents[i]];
+      const F32 *b = local[node];
+      F32 *m = world[node];
+      for(S32 r = 0; r < 12; r += 4)
+      {
+         m[r]     = a[r]*b[0] + a[r+1]*b[4] + a[r+2]*b[8];
+         m[r + 1] = a[r]*b[1] + a[r+1]*b[5] + a[r+2]*b[9];
+         m[r + 2] = a[r]*b[2] + a[r+1]*b[6] + a[r+2]*b[10];
+         m[r + 3] = a[r]*b[3] + a[r+1]*b[7] + a[r+2]*b[11] + a[r+3];
+      }
+      m[12] = m[13] = m[14] = 0.0f;
+      m[15] = 1.0f;
+   }
+}
+
 //-----------------------------------------------------------------------------
 
 END_NS
@@ -97,18 +339,46 @@ void DTShapeInit::initMeshIntrinsics()
       // Assign defaults (C++ versions)
       zero_vert_normal_bulk = zero_vert_normal_bulk_C;
       m_matF_x_BatchedVertWeightList = m_matF_x_BatchedVertWeightList_C;
+      m_matF_x_BatchedVertex4List = m_matF_x_BatchedVertex4List_C;
+      m_matF_x_SoAVertWeightBlocks = m_matF_x_SoAVertWeightBlocks_C;
+      m_dualQuat_x_BatchedVertexList = m_dualQuat_x_BatchedVertexList_C;
+      m_quat16_nlerp_BatchedKeyList = m_quat16_nlerp_BatchedKeyList_C;
+      m_quatF_point3F_x_matF_BatchedList = m_quatF_point3F_x_matF_BatchedList_C;
+      m_matF_x_matF_NodeList = m_matF_x_matF_NodeList_C;
 
    #if defined(LIBDTSHAPE_OS_XENON)
       zero_vert_normal_bulk = zero_vert_normal_bulk_X360;
       m_matF_x_BatchedVertWeightList = m_matF_x_BatchedVertWeightList_X360;
    #else
       // Find the best implementation for the current CPU
-      if(Platform::SystemInfo.processor.properties & CPU_PROP_SSE)
+      const U32 properties = Platform::SystemInfo.processor.properties;
+      if(properties & CPU_PROP_SSE)
       {
-   #if defined(LIBDTSHAPE_CPU_X86)
+   #if defined(LIBDTSHAPE_CPU_X86) || defined(LIBDTSHAPE_CPU_X86_64)
          
          zero_vert_normal_bulk = zero_vert_normal_bulk_SSE;
          m_matF_x_BatchedVertWeightList = m_matF_x_BatchedVertWeightList_SSE;
+         m_matF_x_BatchedVertex4List = m_matF_x_BatchedVertex4List_SSE;
+         m_quat16_nlerp_BatchedKeyList = m_quat16_nlerp_BatchedKeyList_SSE;
+         m_quatF_point3F_x_matF_BatchedList = m_quatF_point3F_x_matF_BatchedList_SSE;
+         m_matF_x_matF_NodeList = m_matF_x_matF_NodeList_SSE;
+
+   #if defined(LIBDTSHAPE_TS_AVX_INTRINSICS)
+         TSMeshBVH::smUseAVX = (properties & CPU_PROP_AVX) != 0;
+
+         // These produce the same output as the C versions, bit for bit
+         if(properties & CPU_PROP_AVX2)
+         {
+            zero_vert_normal_bulk = zero_vert_normal_bulk_AVX;
+            m_matF_x_BatchedVertWeightList = m_matF_x_BatchedVertWeightList_AVX2;
+
+            m_matF_x_SoAVertWeightBlocks = m_matF_x_SoAVertWeightBlocks_AVX2;
+            m_quat16_nlerp_BatchedKeyList = m_quat16_nlerp_BatchedKeyList_AVX2;
+
+            if(properties & CPU_PROP_AVX512F)
+               m_matF_x_BatchedVertWeightList = m_matF_x_BatchedVertWeightList_AVX512;
+         }
+   #endif
 
          /* This code still has a bug left in it
    #if (_MSC_VER >= 1500)
@@ -118,7 +388,7 @@ void DTShapeInit::initMeshIntrinsics()
             */
    #endif
       }
-      else if(Platform::SystemInfo.processor.properties & CPU_PROP_ALTIVEC)
+      else if(properties & CPU_PROP_ALTIVEC)
       {
    #if !defined(LIBDTSHAPE_OS_XENON) && defined(LIBDTSHAPE_CPU_PPC)
          zero_vert_normal_bulk = zero_vert_normal_bulk_gccvec;
@@ -23,6 +23,10 @@
 #ifndef _TSMESHINTRINSICS_H_
 #define _TSMESHINTRINSICS_H_
 
+#ifndef _TSTRANSFORM_H_
+#include "ts/tsTransform.h"
+#endif
+
 //-----------------------------------------------------------------------------
 
 BEGIN_NS(DTShape)
@@ -31,6 +35,10 @@ BEGIN_NS(DTShape)
 
 /// This is the batch-by-transform skin loop
 ///
+/// The implementation is picked at startup in DTShapeInit::initMeshIntrinsics
+/// based on the detected CPU features. The AVX2 and AVX-512 versions produce
+/// the same output as the C version, bit for bit.
+///
 /// @param mat       Bone transform
 /// @param count     Number of input elements in the batch
 /// @param batch     Pointer to the first element in an aligned array of input elements
@@ -43,6 +51,138 @@ extern void (*m_matF_x_BatchedVertWeightList)
                                     U8 * const __restrict outPtr,
                                     const dsize_t outStride);
 
+/// This is the batch-by-vertex skin loop
+///
+/// The bone transforms influencing each vertex are blended by weight, and
+/// the vertex position and normal are transformed by the result and
+/// written once.
+///
+/// @param matrices  Bone transforms, indexed by BatchedVertex4::transformIndex
+/// @param count     Number of input elements in the batch
+/// @param batch     Pointer to the first element of the batch
+/// @param outPtr    Pointer to index 0 of a TSMesh aligned vertex buffer
+/// @param outStride Size, in bytes, of one entry in the vertex buffer
+extern void (*m_matF_x_BatchedVertex4List)
+                                   (const MatrixF *matrices,
+                                    const dsize_t count,
+                                    const TSSkinMesh::BatchData::BatchedVertex4 * __restrict batch,
+                                    U8 * const __restrict outPtr,
+                                    const dsize_t outStride);
+
+/// This is the dual quaternion skin loop
+///
+/// The dual quaternions influencing each vertex are blended by weight (each
+/// flipped into the same hemisphere as the first), normalized, and the
+/// vertex position and normal are transformed by the result. The batch must
+/// hold exactly one element per vertex; elements without influences write a
+/// zero position and normal.
+///
+/// @param dualQuats Bone transforms, indexed by TransformOp::transformIndex
+/// @param count     Number of input elements in the batch
+/// @param batch     Pointer to the first element of the batch
+/// @param inVerts   Bind pose vertex positions, indexed by BatchedVertex::vertexIndex
+/// @param inNorms   Bind pose vertex normals, indexed by BatchedVertex::vertexIndex
+/// @param outPtr    Pointer to index 0 of a TSMesh aligned vertex buffer
+/// @param outStride Size, in bytes, of one entry in the vertex buffer
+extern void (*m_dualQuat_x_BatchedVertexList)
+                                   (const DualQuatF *dualQuats,
+                                    const dsize_t count,
+                                    const TSSkinMesh::BatchData::BatchedVertex * __restrict batch,
+                                    const Point3F * __restrict inVerts,
+                                    const Point3F * __restrict inNorms,
+                                    U8 * const __restrict outPtr,
+                                    const dsize_t outStride);
+
+/// This is the structure-of-arrays skin loop
+///
+/// Each block of TSSkinMesh::BatchData::soaBlockSize vertices accumulates its
+/// influences in order, so the output matches the batch-by-transform loop
+/// bit for bit when influences are sorted the same way.
+///
+/// @param matrices    Bone transforms, indexed by SoAInfluence::bone
+/// @param numBlocks   Number of vertex blocks
+/// @param influences  Influences for all blocks
+/// @param blockStart  numBlocks + 1 offsets into influences
+/// @param inStreams   Position and normal streams (px, py, pz, nx, ny, nz)
+/// @param outStreams  Skinned streams, in the same layout as inStreams
+/// @param streamSize  Number of elements in each stream
+extern void (*m_matF_x_SoAVertWeightBlocks)
+                                   (const MatrixF *matrices,
+                                    const dsize_t numBlocks,
+                                    const TSSkinMesh::BatchData::SoAInfluence * __restrict influences,
+                                    const S32 *blockStart,
+                                    const F32 * __restrict inStreams,
+                                    F32 * __restrict outStreams,
+                                    const dsize_t streamSize);
+
+/// Copy skinned position and normal streams into a vertex buffer
+///
+/// @param count      Number of vertices
+/// @param inStreams  Position and normal streams (px, py, pz, nx, ny, nz)
+/// @param streamSize Number of elements in each stream
+/// @param outPtr     Pointer to a TSMesh aligned vertex buffer
+/// @param outStride  Size, in bytes, of one entry in the vertex buffer
+extern void interleave_SoA_vert_normal
+                          (const dsize_t count,
+                           const F32 * __restrict inStreams,
+                           const dsize_t streamSize,
+                           U8 * __restrict const outPtr,
+                           const dsize_t outStride);
+
+/// Decode and interpolate a run of node rotation keyframes
+///
+/// Output i is TSTransform::interpolate of keys1[i * keyStride] and
+/// keys2[i * keyStride]. The SSE and AVX2 versions produce the same output
+/// as the C version, bit for bit.
+///
+/// @param count     Number of rotation tracks
+/// @param keys1     First keyframe of the first track
+/// @param keys2     Second keyframe of the first track
+/// @param keyStride Distance, in keys, from one track to the next
+/// @param t         How far to interpolate from keys1 to keys2 (0-1)
+/// @param out       Interpolated rotations
+extern void (*m_quat16_nlerp_BatchedKeyList)
+                                   (const dsize_t count,
+                                    const Quat16 * __restrict keys1,
+                                    const Quat16 * __restrict keys2,
+                                    const dsize_t keyStride,
+                                    const F32 t,
+                                    QuatF * __restrict out);
+
+/// Build node transforms from rotations and translations
+///
+/// Output i is the same as TSTransform::setMatrix(rots[i], trans[i], &out[i]).
+///
+/// @param count     Number of transforms
+/// @param rots      Node rotations
+/// @param trans     Node translations
+/// @param out       Node transforms
+extern void (*m_quatF_point3F_x_matF_BatchedList)
+                                   (const dsize_t count,
+                                    const QuatF * __restrict rots,
+                                    const Point3F * __restrict trans,
+                                    MatrixF * __restrict out);
+
+/// Concatenate node transforms down the node hierarchy
+///
+/// For each entry, world[nodes[i]] = world[parents[i]] * local[nodes[i]], or
+/// just local[nodes[i]] when parents[i] is -1. Entries are processed in order,
+/// so parents must come before their children (see TSShape::nodeEvalOrder).
+/// The transforms are treated as 3x4 affine matrices; the bottom row of the
+/// output is always (0, 0, 0, 1).
+///
+/// @param count     Number of nodes
+/// @param nodes     Node indices
+/// @param parents   Parent of each node, or -1
+/// @param local     Node transforms relative to their parent, indexed by node
+/// @param world     Node transforms relative to the shape, indexed by node
+extern void (*m_matF_x_matF_NodeList)
+                                   (const dsize_t count,
+                                    const S32 * __restrict nodes,
+                                    const S32 * __restrict parents,
+                                    const MatrixF * __restrict local,
+                                    MatrixF * world);
+
 /// Set the vertex position and normal to (0, 0, 0)
 ///
 /// @param count     Number of elements
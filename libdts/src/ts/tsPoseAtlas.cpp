@@ -0,0 +1,316 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#include "ts/tsPoseAtlas.h"
+#include "ts/tsShapeInstance.h"
+#include "ts/tsMesh.h"
+#include "core/stream/stream.h"
+#include "core/log.h"
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+static inline U32 alignPaletteOffset(U32 offset)
+{
+   return (offset + TSPoseAtlas::PaletteAlign - 1) & ~(U32)(TSPoseAtlas::PaletteAlign - 1);
+}
+
+TSPoseAtlas::TSPoseAtlas() :
+   mBuffer(NULL),
+   mBufferSize(0),
+   mHeader(NULL),
+   mSequences(NULL),
+   mMeshes(NULL)
+{
+   VECTOR_SET_ASSOCIATION(mData);
+}
+
+void TSPoseAtlas::clear()
+{
+   mData.clear();
+   mBuffer = NULL;
+   mBufferSize = 0;
+   mHeader = NULL;
+   mSequences = NULL;
+   mMeshes = NULL;
+}
+
+bool TSPoseAtlas::validate(const U8 *buffer, U32 size) const
+{
+   if (!buffer || size < sizeof(Header))
+      return false;
+
+   const Header *header = (const Header*)buffer;
+   if (header->magic != FileMagic || header->version != FileVersion || header->bufferSize != size)
+      return false;
+
+   // tables, then the frames, must fit in the buffer
+   U32 tableEnd = sizeof(Header) + header->numSequences * sizeof(SequenceEntry) + header->numMeshes * sizeof(MeshEntry);
+   if (header->paletteOffset < tableEnd || header->paletteOffset > size || (header->paletteOffset & (PaletteAlign-1)))
+      return false;
+   if (header->frameSize && header->numFrames > (size - header->paletteOffset) / header->frameSize)
+      return false;
+
+   const SequenceEntry *sequences = (const SequenceEntry*)(buffer + sizeof(Header));
+   for (U32 i=0; i<header->numSequences; i++)
+   {
+      if (sequences[i].numFrames == 0 || sequences[i].firstFrame + sequences[i].numFrames > header->numFrames)
+         return false;
+   }
+
+   const MeshEntry *meshes = (const MeshEntry*)(sequences + header->numSequences);
+   for (U32 i=0; i<header->numMeshes; i++)
+   {
+      U32 boneSize = meshes[i].dualQuat ? sizeof(DualQuatF) : sizeof(MatrixF);
+      if (meshes[i].offset > header->frameSize || meshes[i].numBones > (header->frameSize - meshes[i].offset) / boneSize)
+         return false;
+   }
+
+   return true;
+}
+
+void TSPoseAtlas::setup(const U8 *buffer, U32 size)
+{
+   mBuffer = buffer;
+   mBufferSize = size;
+   mHeader = (const Header*)buffer;
+   mSequences = (const SequenceEntry*)(buffer + sizeof(Header));
+   mMeshes = (const MeshEntry*)(mSequences + mHeader->numSequences);
+}
+
+bool TSPoseAtlas::setBuffer(const void *data, U32 size)
+{
+   clear();
+
+   if (((MEM_ADDRESS)data & (PaletteAlign-1)) || !validate((const U8*)data, size))
+      return false;
+
+   setup((const U8*)data, size);
+   return true;
+}
+
+bool TSPoseAtlas::read(Stream &s)
+{
+   clear();
+
+   Header header;
+   U32 start = s.getPosition();
+   if (!s.read(sizeof(Header), &header) || header.magic != FileMagic || header.bufferSize < sizeof(Header))
+      return false;
+
+   mData.setSize(header.bufferSize);
+   s.setPosition(start);
+   if (!s.read(header.bufferSize, mData.address()) || !validate(mData.address(), mData.size()))
+   {
+      mData.clear();
+      return false;
+   }
+
+   setup(mData.address(), mData.size());
+   return true;
+}
+
+bool TSPoseAtlas::write(Stream &s) const
+{
+   if (!mBuffer)
+      return false;
+   return s.write(mBufferSize, mBuffer);
+}
+
+//-----------------------------------------------------------------------------
+
+bool TSPoseAtlas::bake(TSShapeInstance *shapeInst, const Vector<S32> &sequences, F32 sampleRate)
+{
+   clear();
+
+   TSShape *shape = shapeInst->getShape();
+   if (sampleRate <= 0.0f || sequences.empty())
+      return false;
+
+   // frames for each sequence...cyclic sequences don't repeat their first frame
+   Vector<SequenceEntry> seqEntries;
+   seqEntries.setSize(sequences.size());
+   U32 numFrames = 0;
+   for (S32 i=0; i<sequences.size(); i++)
+   {
+      if (sequences[i] < 0 || sequences[i] >= shape->sequences.size())
+      {
+         Log::errorf(LogEntry::General, "TSPoseAtlas::bake: invalid sequence index %d", sequences[i]);
+         return false;
+      }
+
+      const TSShape::Sequence &seq = shape->sequences[sequences[i]];
+      S32 frames = getMax((S32)mCeil(seq.duration * sampleRate), 1);
+      SequenceEntry &entry = seqEntries[i];
+      entry.sequence = sequences[i];
+      entry.cyclic = seq.isCyclic() ? 1 : 0;
+      entry.firstFrame = numFrames;
+      entry.numFrames = entry.cyclic ? frames : frames + 1;
+      numFrames += entry.numFrames;
+   }
+
+   // ...and the palette of each skin mesh in a frame
+   Vector<MeshEntry> meshEntries;
+   U32 frameSize = 0;
+   for (S32 i=0; i<shape->meshes.size(); i++)
+   {
+      TSMesh *mesh = shape->meshes[i];
+      if (!mesh || mesh->getMeshType() != TSMesh::SkinMeshType)
+         continue;
+
+      TSSkinMesh *skin = static_cast<TSSkinMesh*>(mesh);
+      if (!skin->batchDataInitialized)
+         skin->createBatchData();
+
+      meshEntries.increment();
+      MeshEntry &entry = meshEntries.last();
+      entry.meshIndex = i;
+      entry.offset = frameSize;
+      entry.numBones = skin->batchData.nodeIndex.size();
+      entry.dualQuat = skin->batchData.dualQuat ? 1 : 0;
+      frameSize = alignPaletteOffset(frameSize + entry.numBones * (entry.dualQuat ? sizeof(DualQuatF) : sizeof(MatrixF)));
+   }
+
+   U32 paletteOffset = alignPaletteOffset(sizeof(Header) + seqEntries.size() * sizeof(SequenceEntry) + meshEntries.size() * sizeof(MeshEntry));
+   U32 bufferSize = paletteOffset + numFrames * frameSize;
+
+   mData.setSize(bufferSize);
+   dMemset(mData.address(), 0, bufferSize);
+
+   Header *header = (Header*)mData.address();
+   header->magic = FileMagic;
+   header->version = FileVersion;
+   header->bufferSize = bufferSize;
+   header->numSequences = seqEntries.size();
+   header->numMeshes = meshEntries.size();
+   header->numFrames = numFrames;
+   header->frameSize = frameSize;
+   header->paletteOffset = paletteOffset;
+   header->sampleRate = sampleRate;
+
+   dMemcpy(mData.address() + sizeof(Header), seqEntries.address(), seqEntries.size() * sizeof(SequenceEntry));
+   dMemcpy(mData.address() + sizeof(Header) + seqEntries.size() * sizeof(SequenceEntry), meshEntries.address(), meshEntries.size() * sizeof(MeshEntry));
+
+   // play each sequence on its own on the instance and grab the palettes
+   while (shapeInst->threadCount())
+      shapeInst->destroyThread(shapeInst->getThread(0));
+   TSThread *thread = shapeInst->addThread();
+
+   Vector<MatrixF> matrices;
+   Vector<DualQuatF> dualQuats;
+   for (S32 i=0; i<seqEntries.size(); i++)
+   {
+      const SequenceEntry &seq = seqEntries[i];
+      shapeInst->setSequence(thread, seq.sequence, 0.0f);
+
+      U32 posSteps = seq.cyclic ? seq.numFrames : getMax(seq.numFrames - 1, 1U);
+      for (U32 j=0; j<seq.numFrames; j++)
+      {
+         shapeInst->setPos(thread, F32(j) / F32(posSteps));
+         shapeInst->animateNodeSubtrees(true);
+
+         U8 *frame = mData.address() + paletteOffset + (seq.firstFrame + j) * frameSize;
+         for (S32 k=0; k<meshEntries.size(); k++)
+         {
+            const MeshEntry &entry = meshEntries[k];
+            TSSkinMesh *skin = static_cast<TSSkinMesh*>(shape->meshes[entry.meshIndex]);
+            if (entry.dualQuat)
+            {
+               skin->updateSkinBones(shapeInst->mNodeTransforms, dualQuats);
+               dMemcpy(frame + entry.offset, dualQuats.address(), entry.numBones * sizeof(DualQuatF));
+            }
+            else
+            {
+               skin->updateSkinBones(shapeInst->mNodeTransforms, matrices);
+               dMemcpy(frame + entry.offset, matrices.address(), entry.numBones * sizeof(MatrixF));
+            }
+         }
+      }
+   }
+
+   shapeInst->destroyThread(thread);
+
+   setup(mData.address(), mData.size());
+   return true;
+}
+
+//-----------------------------------------------------------------------------
+
+S32 TSPoseAtlas::findSequence(S32 sequence) const
+{
+   for (U32 i=0; i<getNumSequences(); i++)
+   {
+      if (mSequences[i].sequence == sequence)
+         return i;
+   }
+   return -1;
+}
+
+S32 TSPoseAtlas::findMesh(S32 meshIndex) const
+{
+   for (U32 i=0; i<getNumMeshes(); i++)
+   {
+      if (mMeshes[i].meshIndex == meshIndex)
+         return i;
+   }
+   return -1;
+}
+
+S32 TSPoseAtlas::getFrame(S32 sequence, F32 pos) const
+{
+   S32 index = findSequence(sequence);
+   if (index < 0)
+      return -1;
+
+   const SequenceEntry &seq = mSequences[index];
+   pos = mClampF(pos, 0.0f, 1.0f);
+
+   S32 frame;
+   if (seq.cyclic)
+      frame = (S32)mFloor(pos * seq.numFrames + 0.5f) % seq.numFrames;
+   else
+      frame = (S32)mFloor(pos * (seq.numFrames - 1) + 0.5f);
+   return seq.firstFrame + frame;
+}
+
+const MatrixF *TSPoseAtlas::getPalette(S32 frame, S32 mesh) const
+{
+   if (mMeshes[mesh].dualQuat)
+      return NULL;
+   return (const MatrixF*)(mBuffer + mHeader->paletteOffset + frame * mHeader->frameSize + mMeshes[mesh].offset);
+}
+
+const DualQuatF *TSPoseAtlas::getDualQuatPalette(S32 frame, S32 mesh) const
+{
+   if (!mMeshes[mesh].dualQuat)
+      return NULL;
+   return (const DualQuatF*)(mBuffer + mHeader->paletteOffset + frame * mHeader->frameSize + mMeshes[mesh].offset);
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
@@ -0,0 +1,171 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+
+#ifndef _TSPOSEATLAS_H_
+#define _TSPOSEATLAS_H_
+
+#ifndef _PLATFORM_H_
+#include "platform/platform.h"
+#endif
+
+#ifndef _TVECTOR_H_
+#include "core/util/tVector.h"
+#endif
+
+#ifndef _MMATRIX_H_
+#include "math/mMatrix.h"
+#endif
+
+#ifndef _MDUALQUAT_H_
+#include "math/mDualQuat.h"
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+class Stream;
+class TSShapeInstance;
+
+/// Bone palettes of whole sequences, baked ahead of time.
+///
+/// Large crowds rarely need every character to run its own animation. A pose
+/// atlas samples a set of sequences at a fixed rate and stores, for every
+/// frame, the skin bone palette of each skinned mesh in the shape (exactly
+/// what TSSkinMesh::updateSkinBones would build). Instances can then be drawn
+/// from a (sequence, position) pair without animating at all; see
+/// TSRenderState::setPoseAtlas.
+///
+/// Everything lives in one contiguous buffer laid out as a Header, the
+/// SequenceEntry and MeshEntry tables, then the palettes of each frame. The
+/// buffer can be written to a file and later wrapped in place with
+/// setBuffer(), e.g. straight from a memory mapped file.
+class TSPoseAtlas
+{
+public:
+   enum
+   {
+      FileMagic = 0x41505344,    ///< "DSPA"
+      FileVersion = 1,
+      PaletteAlign = 16
+   };
+
+   struct Header
+   {
+      U32 magic;
+      U32 version;
+      U32 bufferSize;
+      U32 numSequences;
+      U32 numMeshes;
+      U32 numFrames;
+      U32 frameSize;             ///< bytes of palette data per frame
+      U32 paletteOffset;         ///< offset of the first frame in the buffer
+      F32 sampleRate;            ///< frames per second
+      U32 reserved[3];
+   };
+
+   struct SequenceEntry
+   {
+      S32 sequence;              ///< index of the sequence in the shape
+      U32 firstFrame;
+      U32 numFrames;
+      U32 cyclic;
+   };
+
+   struct MeshEntry
+   {
+      S32 meshIndex;             ///< index of the skin mesh in TSShape::meshes
+      U32 offset;                ///< offset of the palette within a frame
+      U32 numBones;
+      U32 dualQuat;              ///< palette holds DualQuatF rather than MatrixF
+   };
+
+protected:
+   Vector<U8> mData;             ///< owned storage, empty when wrapping an external buffer
+   const U8 *mBuffer;
+   U32 mBufferSize;
+
+   const Header *mHeader;
+   const SequenceEntry *mSequences;
+   const MeshEntry *mMeshes;
+
+   bool validate(const U8 *buffer, U32 size) const;
+   void setup(const U8 *buffer, U32 size);
+
+public:
+   TSPoseAtlas();
+
+   /// Samples @a sequences of the instance's shape at @a sampleRate frames per
+   /// second. The instance is used as a scratch pad: its threads are replaced
+   /// and its node transforms left in the last baked pose.
+   bool bake(TSShapeInstance *shapeInst, const Vector<S32> &sequences, F32 sampleRate);
+
+   /// Uses @a data directly without copying it. The memory must stay valid,
+   /// and unchanged, for as long as the atlas uses it.
+   bool setBuffer(const void *data, U32 size);
+
+   /// Reads an atlas written by write() into storage owned by the atlas
+   bool read(Stream &s);
+   bool write(Stream &s) const;
+
+   void clear();
+   bool isValid() const { return mHeader != NULL; }
+
+   const U8 *getBuffer() const { return mBuffer; }
+   U32 getBufferSize() const { return mBufferSize; }
+
+   F32 getSampleRate() const { return mHeader ? mHeader->sampleRate : 0.0f; }
+   U32 getNumFrames() const { return mHeader ? mHeader->numFrames : 0; }
+
+   U32 getNumSequences() const { return mHeader ? mHeader->numSequences : 0; }
+   const SequenceEntry &getSequenceEntry(S32 index) const { return mSequences[index]; }
+
+   U32 getNumMeshes() const { return mHeader ? mHeader->numMeshes : 0; }
+   const MeshEntry &getMeshEntry(S32 index) const { return mMeshes[index]; }
+
+   /// Returns the index of the entry for the shape's sequence @a sequence,
+   /// or -1 if it wasn't baked
+   S32 findSequence(S32 sequence) const;
+
+   /// Returns the index of the entry for the skin mesh @a meshIndex, or -1
+   S32 findMesh(S32 meshIndex) const;
+
+   /// Returns the atlas frame nearest to position @a pos (0-1, as in
+   /// TSThread::getPos) of the shape's sequence @a sequence, or -1 if the
+   /// sequence wasn't baked
+   S32 getFrame(S32 sequence, F32 pos) const;
+
+   /// Palette of the mesh entry @a mesh in @a frame. Only one of these
+   /// returns a palette for a given mesh, depending on MeshEntry::dualQuat.
+   const MatrixF *getPalette(S32 frame, S32 mesh) const;
+   const DualQuatF *getDualQuatPalette(S32 frame, S32 mesh) const;
+};
+
+//-----------------------------------------------------------------------------
+
+END_NS
+
+#endif // _TSPOSEATLAS_H_
@@ -0,0 +1,192 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "ts/tsPoseCache.h"
+#include "core/util/hashFunction.h"
+#include "platform/platformThreads.h"
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+S32 TSPoseCache::smKeyPosSteps = 16;
+
+void TSPoseCache::Key::computeHash()
+{
+   // only hash the threads in use, the rest of the array is garbage
+   const U32 size = (U32)((const U8*)&threads[numThreads] - (const U8*)this);
+   hash = DTShape::hash((const U8*)this, size, 0);
+}
+
+bool TSPoseCache::Key::operator==(const Key &other) const
+{
+   if (hash != other.hash || subShape != other.subShape || numThreads != other.numThreads)
+      return false;
+   return dMemcmp(threads, other.threads, numThreads * sizeof(ThreadKey)) == 0;
+}
+
+//-----------------------------------------------------------------------------
+
+TSPoseCache::TSPoseCache(S32 numNodes, S32 maxEntries) :
+   mNumNodes(numNodes),
+   mMaxEntries(maxEntries),
+   mMostRecent(-1),
+   mLeastRecent(-1),
+   mHits(0),
+   mMisses(0)
+{
+   VECTOR_SET_ASSOCIATION(mEntries);
+   VECTOR_SET_ASSOCIATION(mPoses);
+
+   mEntries.reserve(maxEntries);
+   mPoses.setSize(maxEntries * numNodes * 2);
+   mLock = new Semaphore(1);
+}
+
+TSPoseCache::~TSPoseCache()
+{
+   delete mLock;
+}
+
+S32 TSPoseCache::find(const Key &key) const
+{
+   for (S32 i=0; i<mEntries.size(); i++)
+   {
+      if (mEntries[i].key == key)
+         return i;
+   }
+   return -1;
+}
+
+void TSPoseCache::touch(S32 index)
+{
+   if (mMostRecent == index)
+      return;
+
+   // unlink...
+   Entry &entry = mEntries[index];
+   if (entry.prev >= 0)
+      mEntries[entry.prev].next = entry.next;
+   if (entry.next >= 0)
+      mEntries[entry.next].prev = entry.prev;
+   if (mLeastRecent == index)
+      mLeastRecent = entry.prev;
+
+   // ...and put at the front
+   entry.prev = -1;
+   entry.next = mMostRecent;
+   if (mMostRecent >= 0)
+      mEntries[mMostRecent].prev = index;
+   mMostRecent = index;
+   if (mLeastRecent < 0)
+      mLeastRecent = index;
+}
+
+bool TSPoseCache::fetch(const Key &key, S32 first, S32 count, MatrixF *world, MatrixF *local)
+{
+   mLock->acquire();
+
+   S32 index = find(key);
+   if (index < 0)
+   {
+      mMisses++;
+      mLock->release();
+      return false;
+   }
+
+   const MatrixF *pose = &mPoses[index * mNumNodes * 2];
+   dMemcpy(world + first, pose + first, count * sizeof(MatrixF));
+   dMemcpy(local + first, pose + mNumNodes + first, count * sizeof(MatrixF));
+   touch(index);
+   mHits++;
+
+   mLock->release();
+   return true;
+}
+
+void TSPoseCache::store(const Key &key, S32 first, S32 count, const MatrixF *world, const MatrixF *local)
+{
+   if (mMaxEntries <= 0)
+      return;
+
+   mLock->acquire();
+
+   // another instance may have got here first
+   S32 index = find(key);
+   if (index < 0)
+   {
+      if (mEntries.size() < mMaxEntries)
+      {
+         index = mEntries.size();
+         mEntries.increment();
+         mEntries[index].prev = mEntries[index].next = -1;
+      }
+      else
+         index = mLeastRecent;
+      mEntries[index].key = key;
+   }
+
+   MatrixF *pose = &mPoses[index * mNumNodes * 2];
+   dMemcpy(pose + first, world + first, count * sizeof(MatrixF));
+   dMemcpy(pose + mNumNodes + first, local + first, count * sizeof(MatrixF));
+   touch(index);
+
+   mLock->release();
+}
+
+void TSPoseCache::clear()
+{
+   mLock->acquire();
+   mEntries.clear();
+   mMostRecent = mLeastRecent = -1;
+   mLock->release();
+}
+
+U32 TSPoseCache::getHits() const
+{
+   mLock->acquire();
+   const U32 hits = mHits;
+   mLock->release();
+   return hits;
+}
+
+U32 TSPoseCache::getMisses() const
+{
+   mLock->acquire();
+   const U32 misses = mMisses;
+   mLock->release();
+   return misses;
+}
+
+void TSPoseCache::resetStats()
+{
+   mLock->acquire();
+   mHits = mMisses = 0;
+   mLock->release();
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
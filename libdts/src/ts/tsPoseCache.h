@@ -0,0 +1,161 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _TSPOSECACHE_H_
+#define _TSPOSECACHE_H_
+
+#ifndef _PLATFORM_H_
+#include "platform/platform.h"
+#endif
+
+#ifndef _TVECTOR_H_
+#include "core/util/tVector.h"
+#endif
+
+#ifndef _MMATRIX_H_
+#include "math/mMatrix.h"
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+class Semaphore;
+
+/// Node poses shared between the instances of one shape.
+///
+/// Crowds often play the same cyclic sequences in step. Instead of every
+/// instance sampling its keyframes and concatenating its node transforms, the
+/// first one to animate a given thread state stores the resulting pose here
+/// and the others copy it.
+///
+/// A pose is looked up by subshape plus, for each thread that affects the
+/// nodes, the sequence, the keyframe pair and the key position rounded to
+/// 1/smKeyPosSteps. Instances using the cache sample their threads at the
+/// rounded key positions (the threads themselves are left alone), so a cached
+/// pose is exactly what the instance would have computed itself.
+///
+/// The least recently used pose is replaced once the cache is full. The cache
+/// is safe to use from several animation threads at once.
+///
+/// @see TSShape::setPoseCacheSize
+class TSPoseCache
+{
+public:
+   enum
+   {
+      MaxThreads = 4    ///< instances with more threads than this animate themselves
+   };
+
+   struct ThreadKey
+   {
+      S32 sequence;
+      S32 keyNum1;
+      S32 keyNum2;
+      S32 keyPos;       ///< quantized key position
+   };
+
+   struct Key
+   {
+      S32 subShape;
+      S32 numThreads;
+      ThreadKey threads[MaxThreads];
+
+      /// Hash of the fields above, filled in by computeHash()
+      U32 hash;
+
+      void computeHash();
+      bool operator==(const Key &other) const;
+   };
+
+   /// Key positions are rounded to this many steps between keyframes
+   static S32 smKeyPosSteps;
+
+   /// Returns @a keyPos rounded to a whole number of smKeyPosSteps
+   static S32 quantizeKeyPos(F32 keyPos) { return (S32)mFloor(keyPos * smKeyPosSteps + 0.5f); }
+
+   /// Returns @a keyPos rounded to the nearest of smKeyPosSteps
+   static F32 snapKeyPos(F32 keyPos) { return F32(quantizeKeyPos(keyPos)) / F32(smKeyPosSteps); }
+
+protected:
+   struct Entry
+   {
+      Key key;
+      S32 prev;         ///< previous entry in the LRU list, towards the most recently used
+      S32 next;         ///< next entry in the LRU list, towards the least recently used
+   };
+
+   S32 mNumNodes;
+   S32 mMaxEntries;
+
+   Vector<Entry> mEntries;
+   Vector<MatrixF> mPoses;    ///< world transforms then local transforms, mNumNodes each, per entry
+
+   S32 mMostRecent;           ///< head of the LRU list
+   S32 mLeastRecent;          ///< tail of the LRU list
+
+   Semaphore *mLock;
+
+   U32 mHits;
+   U32 mMisses;
+
+   S32 find(const Key &key) const;
+   void touch(S32 index);
+
+public:
+   TSPoseCache(S32 numNodes, S32 maxEntries);
+   ~TSPoseCache();
+
+   /// Copies a cached pose for nodes [first, first+count) into @a world and
+   /// @a local (both indexed by node). Returns false if the pose isn't cached.
+   bool fetch(const Key &key, S32 first, S32 count, MatrixF *world, MatrixF *local);
+
+   /// Stores the pose for nodes [first, first+count), replacing the least
+   /// recently used pose if the cache is full
+   void store(const Key &key, S32 first, S32 count, const MatrixF *world, const MatrixF *local);
+
+   /// Forgets all cached poses
+   void clear();
+
+   S32 getMaxEntries() const { return mMaxEntries; }
+   S32 getNumEntries() const { return mEntries.size(); }
+
+   /// @name Statistics
+   /// @{
+   U32 getHits() const;
+   U32 getMisses() const;
+   void resetStats();
+   /// @}
+
+private:
+   TSPoseCache(const TSPoseCache&);
+   TSPoseCache& operator=(const TSPoseCache&);
+};
+
+//-----------------------------------------------------------------------------
+
+END_NS
+
+#endif // _TSPOSECACHE_H_
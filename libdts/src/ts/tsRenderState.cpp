@@ -42,15 +42,11 @@ TSRenderState::TSRenderState()
       mMaterialHint( NULL ),
       mCuller( NULL ),
       mUseOriginSort( false ),
-      smNodeCurrentRotations(__FILE__, __LINE__),
-      smNodeCurrentTranslations(__FILE__, __LINE__),
-      smNodeCurrentUniformScales(__FILE__, __LINE__),
-      smNodeCurrentAlignedScales(__FILE__, __LINE__),
-      smNodeCurrentArbitraryScales(__FILE__, __LINE__),
-      smNodeLocalTransforms(__FILE__, __LINE__),
-      smRotationThreads(__FILE__, __LINE__),
-      smTranslationThreads(__FILE__, __LINE__),
-      smScaleThreads(__FILE__, __LINE__)
+      mPoseAtlas( NULL ),
+      mPoseAtlasFrame( 0 ),
+      gBoneTransforms(__FILE__, __LINE__),
+      gBoneDualQuats(__FILE__, __LINE__),
+      gSoASkinStore(__FILE__, __LINE__)
 {
    smDetailAdjust = 1.0f;
    smSmallestVisiblePixelSize = -1.0f;
@@ -74,7 +70,9 @@ TSRenderState::TSRenderState( TSRenderState &state )
       mNoRenderNonTranslucent( state.mNoRenderNonTranslucent ),
       mMaterialHint( state.mMaterialHint ),
       mCuller( state.mCuller ),
-      mUseOriginSort( state.mUseOriginSort )//,
+      mUseOriginSort( state.mUseOriginSort ),
+      mPoseAtlas( state.mPoseAtlas ),
+      mPoseAtlasFrame( state.mPoseAtlasFrame )//,
       //mMeshRenderInfos( state.mMeshRenderInfos )
 {
 }
@@ -85,18 +83,13 @@ void TSRenderState::reset()
    mTranslucentRenderInsts.clear();
    mChunker.clear();
    
-   smNodeCurrentRotations.clear();
-   smNodeCurrentTranslations.clear();
-   smNodeCurrentUniformScales.clear();
-   smNodeCurrentUniformScales.clear();
-   smNodeCurrentAlignedScales.clear();
-   smNodeCurrentArbitraryScales.clear();
-   smNodeLocalTransforms.clear();
-   smNodeLocalTransformDirty.clearAll();
+   gBoneTransforms.clear();
+   gBoneDualQuats.clear();
+   gSoASkinStore.clear();
+   gCullBatch.clear();
+   gCullVisible.clear();
    
-   smRotationThreads.clear();
-   smTranslationThreads.clear();
-   smScaleThreads.clear();
+   // mAnimationScratch is deliberately kept so it is not reallocated every frame
 }
 
 
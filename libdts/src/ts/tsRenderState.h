@@ -28,6 +28,10 @@
 #include "math/mMatrix.h"
 #endif
 
+#ifndef _MDUALQUAT_H_
+#include "math/mDualQuat.h"
+#endif
+
 #ifndef _MRECT_H_
 #include "math/mRect.h"
 #endif
@@ -40,12 +44,12 @@
 #include "core/util/tVector.h"
 #endif
 
-#ifndef _TSINTEGERSET_H_
-#include "ts/tsIntegerSet.h"
+#ifndef _TSANIMATIONSCRATCH_H_
+#include "ts/tsAnimationScratch.h"
 #endif
 
-#ifndef _TSTRANSFORM_H_
-#include "ts/tsTransform.h"
+#ifndef _MATHUTIL_FRUSTUM_H_
+#include "math/util/frustum.h"
 #endif
 
 //-----------------------------------------------------------------------------
@@ -61,6 +65,7 @@ class TSMeshRenderer;
 class TSMesh;
 class TSMeshInstanceRenderData;
 class TSThread;
+class TSPoseAtlas;
 
 typedef U32 TSRenderInstTypeHash;
 
@@ -124,6 +129,11 @@ typedef struct TSRenderInst
    MatrixF* mNodeTransforms;
    U32 mNumNodeTransforms;
    
+   // GPU dual quaternion skinning transforms, used instead of
+   // mNodeTransforms when the mesh skins with dual quaternions
+   DualQuatF* mNodeDualQuats;
+   U32 mNumNodeDualQuats;
+   
    void clear();
    void render(TSRenderState *state);
 } TSRenderInst;
@@ -214,34 +224,47 @@ public:
    /// sorting for transparency instead of the nearest
    /// bounding box point.
    bool mUseOriginSort;
+
+   /// An optional atlas of baked bone palettes. When set,
+   /// skinned meshes take their palette from frame
+   /// mPoseAtlasFrame of the atlas instead of the node
+   /// transforms of the instance (hardware skinning only).
+   const TSPoseAtlas *mPoseAtlas;
+   S32 mPoseAtlasFrame;
    
    /// Generic pointer to a render data object
    TSMeshInstanceRenderData *mRenderData;
    
+   /// @name Workspaces
+   /// Scratch storage for rendering, kept here rather than in statics so
+   /// that separate render states can be used on separate threads.
+   /// @{
+
    /// Render Workspace normal store
    Vector<Point3F> gNormalStore;
    
+   /// Bone palette, filled by TSSkinMesh::updateSkin
+   Vector<MatrixF> gBoneTransforms;
+
+   /// Bone palette for dual quaternion skinning
+   Vector<DualQuatF> gBoneDualQuats;
+
+   /// Skinned position and normal streams of structure-of-arrays skinning
+   Vector<F32> gSoASkinStore;
+
+   /// Object bounds of the detail being rendered, for batched culling
+   FrustumCullBatch gCullBatch;
+
+   /// Visibility bits resulting from culling gCullBatch
+   Vector<U32> gCullVisible;
+
+   /// @}
+   
    /// Global preference for rendering imposters to shadows.
    bool smDetailCanShadow;
    
-   /// @name Workspace for Node Transforms
-   /// @{
-   Vector<QuatF>   smNodeCurrentRotations;
-   Vector<Point3F> smNodeCurrentTranslations;
-   Vector<F32>     smNodeCurrentUniformScales;
-   Vector<Point3F> smNodeCurrentAlignedScales;
-   Vector<TSScale> smNodeCurrentArbitraryScales;
-   Vector<MatrixF> smNodeLocalTransforms;
-   TSIntegerSet    smNodeLocalTransformDirty;
-   /// @}
-   
-   /// @name Threads
-   /// keep track of who controls what on currently animating shape
-   /// @{
-   Vector<TSThread*> smRotationThreads;
-   Vector<TSThread*> smTranslationThreads;
-   Vector<TSThread*> smScaleThreads;
-   /// @}
+   /// Workspace for node transforms, kept across frames
+   TSAnimationScratch mAnimationScratch;
    
    /// Scale pixel size by this amount when selecting
    /// detail levels.
@@ -320,6 +343,11 @@ public:
    ///@see mUseOriginSort
    void setOriginSort( bool enable ) { mUseOriginSort = enable; }
    bool useOriginSort() const { return mUseOriginSort; }
+
+   ///@see mPoseAtlas
+   void setPoseAtlas( const TSPoseAtlas *atlas, S32 frame ) { mPoseAtlas = atlas; mPoseAtlasFrame = frame; }
+   const TSPoseAtlas* getPoseAtlas() const { return mPoseAtlas; }
+   S32 getPoseAtlasFrame() const { return mPoseAtlasFrame; }
    
    ///@see mMeshObjectInstance
    void setMeshObjectInstance( void* shape ) { mMeshObjectInstance = shape; }
@@ -28,12 +28,18 @@
 #include "ts/tsMaterialList.h"
 #include "core/log.h"
 #include "ts/tsShapeInstance.h"
+#include "ts/tsMeshIntrinsics.h"
+#include "ts/tsPoseCache.h"
+#include "ts/tsSortedMesh.h"
+#include "ts/tsDecal.h"
 #include "collision/convex.h"
 #include "ts/tsMaterial.h"
 #include "ts/tsMaterialManager.h"
 #include "math/mathIO.h"
 #include "core/util/endian.h"
+#include "core/util/hashFunction.h"
 #include "core/stream/fileStream.h"
+#include "core/stream/memStream.h"
 
 //-----------------------------------------------------------------------------
 
@@ -56,10 +62,14 @@ const F32 TSShape::smAlphaOutDefault = -1.0f;
 bool TSShape::smAllowHardwareSkinning = true;
 bool TSShape::smUseHardwareSkinning = true;
 bool TSShape::smUseComputeSkinning = false;
+bool TSShape::smUseSoASkinning = false;
+bool TSShape::smUseDualQuatSkinning = false;
+bool TSShape::smBuildRayBVHs = false;
+S32 TSShape::smMaxSkinByVertexInfluences = TSSkinMesh::BatchData::maxBonePerVertGPU;
 
 TSIOState::TSIOState()
 {
-   smVersion = 26;
+   smVersion = 28;
    smReadVersion = -1;
    
    smNumSkipLoadDetails = 0;
@@ -72,11 +82,47 @@ TSIOState::TSIOState()
    smUseEncodedNormals = false;
 }
 
+U32 TSIOState::getAllocKey() const
+{
+   // options that don't fit get a key that is never trusted
+   if ((U32)smMinStripSize > 0xFF || (U32)smNumSkipLoadDetails > 0xFFFF)
+      return U32_MAX;
+
+   return (smUseTriangles ? BIT(0) : 0) |
+          (smUseOneStrip ? BIT(1) : 0) |
+          (smUseEncodedNormals ? BIT(2) : 0) |
+          (smMinStripSize << 8) |
+          (smNumSkipLoadDetails << 16);
+}
+
+U32 TSIOState::getLayoutKey(S32 version)
+{
+   // version 28 also stores the aligned vertex structs byte for byte, which
+   // only read back right on a host with the same byte order
+   const bool cacheReady = version > 27;
+   const U32 layout[] =
+   {
+      (U32)version,
+      (U32)sizeof(void*),
+      (U32)sizeof(TSMesh),
+      (U32)sizeof(TSSkinMesh),
+      (U32)sizeof(TSDecalMesh),
+      (U32)sizeof(TSSortedMesh),
+      cacheReady ? (U32)sizeof(TSMesh::__TSMeshVertexBase) : 0,
+      cacheReady ? (U32)sizeof(TSMesh::__TSMeshVertex_3xUVColor) : 0,
+      cacheReady ? (U32)sizeof(TSMesh::__TSMeshVertex_BoneData) : 0,
+      cacheReady ? convertLEndianToHost((U32)0x12345678) : 0
+   };
+   return DTShape::hash((const U8*)layout, sizeof(layout), 0);
+}
+
 TSShape::TSShape()
 {
    materialList = NULL;
    mReadVersion = -1; // -1 means constructed from scratch (e.g., in exporter or no read yet)
    mSequencesConstructed = false;
+   mAnimationCompressed = false;
+   mPoseCache = NULL;
    mShapeData = NULL;
    mShapeDataSize = 0;
    
@@ -101,6 +147,12 @@ TSShape::TSShape()
    VECTOR_SET_ASSOCIATION(detailCollisionAccelerators);
    VECTOR_SET_ASSOCIATION(names);
 
+   VECTOR_SET_ASSOCIATION(rotationTracks);
+   VECTOR_SET_ASSOCIATION(translationTracks);
+   VECTOR_SET_ASSOCIATION(compressedRotations);
+   VECTOR_SET_ASSOCIATION(compressedTranslations);
+   VECTOR_SET_ASSOCIATION(quantizedTranslations);
+
    VECTOR_SET_ASSOCIATION( nodes );
    VECTOR_SET_ASSOCIATION( objects );
    VECTOR_SET_ASSOCIATION( objectStates );
@@ -116,6 +168,9 @@ TSShape::TSShape()
    VECTOR_SET_ASSOCIATION( subShapeFirstTranslucentObject );
    VECTOR_SET_ASSOCIATION( meshes );
 
+   VECTOR_SET_ASSOCIATION( nodeEvalOrder );
+   VECTOR_SET_ASSOCIATION( nodeEvalParents );
+
    VECTOR_SET_ASSOCIATION( alphaIn );
    VECTOR_SET_ASSOCIATION( alphaOut );
 }
@@ -123,6 +178,7 @@ TSShape::TSShape()
 TSShape::~TSShape()
 {
    delete materialList;
+   delete mPoseCache;
 
    S32 i;
 
@@ -400,6 +456,50 @@ void TSShape::getObjectDetails(S32 objIndex, Vector<S32>& objDetails)
    }
 }
 
+void TSShape::sampleRotations(const Sequence & seq, S32 keyNum1, S32 keyNum2, F32 keyPos, S32 firstTrack, S32 numTracks, QuatF * out) const
+{
+   if (numTracks <= 0)
+      return;
+
+   if (!mAnimationCompressed)
+   {
+      const Quat16 * keys = &nodeRotations[seq.baseRotation + firstTrack*seq.numKeyframes];
+      m_quat16_nlerp_BatchedKeyList(numTracks, keys + keyNum1, keys + keyNum2, seq.numKeyframes, keyPos, out);
+      return;
+   }
+
+   QuatF q1,q2;
+   for (S32 i=0; i<numTracks; i++)
+   {
+      getCompressedRotation(seq,keyNum1,firstTrack+i,&q1);
+      getCompressedRotation(seq,keyNum2,firstTrack+i,&q2);
+      TSTransform::interpolate(q1,q2,keyPos,&out[i]);
+   }
+}
+
+void TSShape::sampleTranslations(const Sequence & seq, S32 keyNum1, S32 keyNum2, F32 keyPos, S32 firstTrack, S32 numTracks, Point3F * out) const
+{
+   if (!mAnimationCompressed)
+   {
+      const Point3F * keys = numTracks > 0 ? &nodeTranslations[seq.baseTranslation + firstTrack*seq.numKeyframes] : NULL;
+      for (S32 i=0; i<numTracks; i++, keys += seq.numKeyframes)
+         TSTransform::interpolate(keys[keyNum1],keys[keyNum2],keyPos,&out[i]);
+      return;
+   }
+
+   for (S32 i=0; i<numTracks; i++)
+   {
+      TSTransform::interpolate(getCompressedTranslation(seq,keyNum1,firstTrack+i),
+                               getCompressedTranslation(seq,keyNum2,firstTrack+i),keyPos,&out[i]);
+   }
+}
+
+void TSShape::setPoseCacheSize(S32 maxEntries)
+{
+   delete mPoseCache;
+   mPoseCache = maxEntries > 0 ? new TSPoseCache(nodes.size(), maxEntries) : NULL;
+}
+
 void TSShape::init()
 {
    S32 numSubShapes = subShapeFirstNode.size();
@@ -445,6 +545,48 @@ void TSShape::init()
       }
    }
 
+   // cached poses are for the old nodes and sequences
+   if (mPoseCache)
+      setPoseCacheSize(mPoseCache->getMaxEntries());
+
+   // sort the nodes of each subshape by depth for animateNodes
+   nodeEvalOrder.setSize(nodes.size());
+   nodeEvalParents.setSize(nodes.size());
+   for (i=0; i<nodes.size(); i++)
+   {
+      nodeEvalOrder[i] = i;
+      nodeEvalParents[i] = nodes[i].parentIndex;
+   }
+   Vector<S32> nodeDepths;
+   nodeDepths.setSize(nodes.size());
+   for (i=0; i<numSubShapes; i++)
+   {
+      S32 start = subShapeFirstNode[i];
+      S32 end   = start + subShapeNumNodes[i];
+      S32 maxDepth = 0;
+      for (j=start; j<end; j++)
+      {
+         S32 depth = 0;
+         for (S32 parent=nodes[j].parentIndex; parent>=start && parent<end; parent=nodes[parent].parentIndex)
+            depth++;
+         nodeDepths[j] = depth;
+         maxDepth = getMax(maxDepth,depth);
+      }
+
+      S32 k = start;
+      for (S32 depth=0; depth<=maxDepth; depth++)
+      {
+         for (j=start; j<end; j++)
+         {
+            if (nodeDepths[j]==depth)
+            {
+               nodeEvalOrder[k] = j;
+               nodeEvalParents[k++] = nodes[j].parentIndex;
+            }
+         }
+      }
+   }
+
    mFlags = 0;
    for (i=0; i<sequences.size(); i++)
    {
@@ -560,6 +702,10 @@ void TSShape::init()
 
    initVertexFeatures();
    initMaterialList();
+   computeBoneBounds();
+
+   if (smBuildRayBVHs)
+      buildRayBVHs();
 }
 
 void TSShape::initVertexFeatures()
@@ -639,6 +785,11 @@ void TSShape::initVertexFeatures()
                mesh->getMeshType() != TSMesh::SkinMeshType ) )
          continue;
 
+      // Vertex data laid out for another format (e.g. read from a
+      // cache-ready shape written with different skinning) is redone
+      if ( mesh->mVertexData.isReady() && mesh->mVertexData.vertSize() != mVertSize )
+         mesh->releaseVertexData();
+
       // Set the flags.
       mesh->mVertexFormat = &mVertexFormat;
       mesh->mVertSize = mVertSize;
@@ -658,11 +809,22 @@ void TSShape::initRender()
    for ( ; iter != meshes.end(); iter++ )
    {
       TSMesh *mesh = (*iter);
+      if ( !mesh )
+         continue;
+
       mesh->initRender();
       
       // Init the vertex buffer.
       if ( mesh->getMeshType() == TSMesh::StandardMeshType )
          mesh->createVBIB();
+      
+      // Build the skin batches now rather than lazily on first render,
+      // so instances skinned on separate threads don't race to create them.
+      else if ( mesh->getMeshType() == TSMesh::SkinMeshType )
+      {
+         mesh->convertToAlignedMeshData();
+         mesh->createBatchData();
+      }
    }
 }
 
@@ -844,6 +1006,140 @@ void TSShape::computeBounds(S32 dl, Box3F & bounds) const
    }
 }
 
+/// Returns the boneBounds entry for a pair of nodes, adding it if needed
+static S32 findBoneBounds(Vector<TSShape::BoneBounds> &boneBounds, S32 node, S32 objectNode)
+{
+   for (S32 i = 0; i < boneBounds.size(); i++)
+   {
+      if (boneBounds[i].node == node && boneBounds[i].objectNode == objectNode)
+         return i;
+   }
+
+   boneBounds.increment();
+   TSShape::BoneBounds &entry = boneBounds.last();
+   entry.node = node;
+   entry.objectNode = objectNode;
+   entry.box = Box3F::Invalid;
+   entry.capsuleStart.zero();
+   entry.capsuleEnd.zero();
+   entry.capsuleRadius = 0.0f;
+   return boneBounds.size() - 1;
+}
+
+void TSShape::computeBoneBounds()
+{
+   boneBounds.clear();
+
+   // Gather every point with the entry it belongs to
+   Vector<Point3F> points;
+   Vector<S32> pointEntry;
+
+   for (S32 i = 0; i < objects.size(); i++)
+   {
+      const Object &object = objects[i];
+
+      for (S32 j = 0; j < object.numMeshes; j++)
+      {
+         TSMesh *mesh = meshes[object.startMeshIndex + j];
+         if (!mesh)
+            continue;
+
+         if (mesh->getMeshType() == TSMesh::SkinMeshType)
+         {
+            const TSSkinMesh *skin = static_cast<TSSkinMesh*>(mesh);
+            const TSSkinMesh::BatchData &batchData = skin->batchData;
+
+            // Each bone gets every vertex it has any weight on, so blends
+            // of several bones stay inside the union of their bounds
+            for (S32 k = 0; k < skin->vertexIndex.size(); k++)
+            {
+               const S32 vidx = skin->vertexIndex[k];
+               const S32 bone = skin->boneIndex[k];
+               if (vidx < 0 || vidx >= batchData.initialVerts.size() ||
+                   bone < 0 || bone >= batchData.nodeIndex.size() || skin->weight[k] <= 0.0f)
+                  continue;
+
+               points.increment();
+               batchData.initialTransforms[bone].mulP(batchData.initialVerts[vidx], &points.last());
+               pointEntry.push_back(findBoneBounds(boneBounds, batchData.nodeIndex[bone], object.nodeIndex));
+            }
+         }
+         else if (mesh->getMeshType() != TSMesh::DecalMeshType && mesh->getMeshType() != TSMesh::NullMeshType)
+         {
+            // Rigid meshes are already in the space of their node. Measure
+            // every frame rather than trusting the stored bounds.
+            Box3F meshBounds;
+            mesh->computeBounds(MatrixF::Identity, meshBounds, -1, NULL, NULL);
+            if (!meshBounds.isValidBox())
+               continue;
+
+            const S32 entry = findBoneBounds(boneBounds, object.nodeIndex, -1);
+            for (U32 k = 0; k < 8; k++)
+            {
+               points.push_back(meshBounds.computeVertex(k));
+               pointEntry.push_back(entry);
+            }
+         }
+      }
+   }
+
+   for (S32 i = 0; i < points.size(); i++)
+      boneBounds[pointEntry[i]].box.intersect(points[i]);
+
+   // Capsules run along the longest side of the box, through its middle.
+   // The radius reaches the furthest point from that line, then each end
+   // is pulled in as far as it can be with every point still inside.
+   Vector<S32> capsuleAxis;
+   Vector<F32> capsuleLow;
+   Vector<F32> capsuleHigh;
+   capsuleAxis.setSize(boneBounds.size());
+   capsuleLow.setSize(boneBounds.size());
+   capsuleHigh.setSize(boneBounds.size());
+   for (S32 i = 0; i < boneBounds.size(); i++)
+   {
+      const Point3F extents = boneBounds[i].box.getExtents();
+      capsuleAxis[i] = (extents.x >= extents.y && extents.x >= extents.z) ? 0 : (extents.y >= extents.z ? 1 : 2);
+      capsuleLow[i] = F32_MAX;
+      capsuleHigh[i] = -F32_MAX;
+   }
+
+   for (S32 i = 0; i < points.size(); i++)
+   {
+      BoneBounds &entry = boneBounds[pointEntry[i]];
+      Point3F offset = points[i] - entry.box.getCenter();
+      offset[capsuleAxis[pointEntry[i]]] = 0.0f;
+      entry.capsuleRadius = getMax(entry.capsuleRadius, offset.len());
+   }
+
+   for (S32 i = 0; i < points.size(); i++)
+   {
+      const S32 e = pointEntry[i];
+      const BoneBounds &entry = boneBounds[e];
+      Point3F offset = points[i] - entry.box.getCenter();
+      const F32 along = offset[capsuleAxis[e]];
+      offset[capsuleAxis[e]] = 0.0f;
+
+      // The point is inside while the nearest end is within reach of it
+      const F32 reach = mSqrt(getMax(entry.capsuleRadius * entry.capsuleRadius - offset.lenSquared(), 0.0f));
+      capsuleLow[e] = getMin(capsuleLow[e], along + reach);
+      capsuleHigh[e] = getMax(capsuleHigh[e], along - reach);
+   }
+
+   for (S32 i = 0; i < boneBounds.size(); i++)
+   {
+      BoneBounds &entry = boneBounds[i];
+
+      // Short and wide, so a sphere anywhere between the two will do
+      if (capsuleLow[i] > capsuleHigh[i])
+         capsuleLow[i] = capsuleHigh[i] = (capsuleLow[i] + capsuleHigh[i]) * 0.5f;
+
+      entry.capsuleStart = entry.box.getCenter();
+      entry.capsuleEnd = entry.capsuleStart;
+      entry.capsuleStart[capsuleAxis[i]] += capsuleLow[i];
+      entry.capsuleEnd[capsuleAxis[i]] += capsuleHigh[i];
+   }
+}
+
 #define tsalloc ioState.tsalloc
 
 
@@ -992,17 +1288,10 @@ void TSShape::assembleShape(TSIOState &ioState)
    subShapeFirstTranslucentObject.set(ptr32,numSubShapes);
 
    // get default translation and rotation
-   S16 * ptr16 = tsalloc.allocShape16(0);
-   for (i=0;i<numNodes;i++)
-      tsalloc.copyToShape16(4);
+   S16 * ptr16 = tsalloc.copyToShape16(numNodes*4,true);
    defaultRotations.set(ptr16,numNodes);
    tsalloc.align32();
-   ptr32 = tsalloc.allocShape32(0);
-   for (i=0;i<numNodes;i++)
-   {
-      tsalloc.copyToShape32(3);
-      tsalloc.copyToShape32(sizeof(Point3F)-12); // handle alignment issues w/ point3f
-   }
+   ptr32 = tsalloc.copyToShape32(numNodes*3,true);
    defaultTranslations.set(ptr32,numNodes);
 
    // get any node sequence data stored in shape
@@ -1522,12 +1811,23 @@ bool TSShape::canWriteOldFormat() const
 
 void TSShape::write(Stream * s, TSIOState *options)
 {
+   decompressAnimation();
+
    TSIOState ioState;
    if (options)
    {
       ioState = *options;
    }
 
+   // version 28 stores the vertex structs as they are in memory, but the
+   // buffers are endian-flipped a word at a time, which would scramble the
+   // byte sized fields on big endian hosts
+   if (ioState.smVersion > 27 && 0x12345678!=convertLEndianToHost(0x12345678))
+   {
+      Log::warnf("TSShape::write - version 28 shapes can only be written on little endian hosts, writing version 27.");
+      ioState.smVersion = 27;
+   }
+
    // write version
    s->write(ioState.smVersion | (mExporterVersion<<16));
 
@@ -1555,6 +1855,17 @@ void TSShape::write(Stream * s, TSIOState *options)
    start16 = size32;
    start8 = start16+size16;
 
+   // version 27 and up start with a header giving the size of the shape
+   // data a load with these options, by a build with this layout, will
+   // need, so reading is one pass
+   if (ioState.smVersion > 26)
+   {
+      s->write((U32)TSShape::HeaderSize);
+      s->write(getAssembledSize(buffer32,buffer16,buffer8,ioState));
+      s->write(ioState.getAllocKey());
+      s->write(TSIOState::getLayoutKey(ioState.smVersion));
+   }
+
    // in dwords -- write will properly endian-flip.
    s->write(sizeMemBuffer);
    s->write(start16);
@@ -1581,11 +1892,72 @@ void TSShape::write(Stream * s, TSIOState *options)
    delete [] buffer8;
 }
 
+U32 TSShape::getAssembledSize(S32 *buffer32, S16 *buffer16, S8 *buffer8, TSIOState &options)
+{
+   // run the sizing pass of a read over the buffers into a scratch shape
+   TSShape shape;
+   TSIOState ioState;
+   ioState = options;
+   ioState.smReadVersion = shape.mReadVersion = options.smVersion;
+   tsalloc.setRead(buffer32,buffer16,buffer8,true);
+   tsalloc.setAliasInput(true);
+   shape.assembleShape(ioState);
+   return tsalloc.getSize();
+}
+
 //-------------------------------------------------
 // read whole shape
 //-------------------------------------------------
 
 bool TSShape::read(Stream * s, TSIOState *options)
+{
+   return _read(s, options, NULL);
+}
+
+void TSShape::buildRayBVHs()
+{
+   for (S32 i = 0; i < meshes.size(); i++)
+   {
+      TSMesh *mesh = meshes[i];
+      if (!mesh)
+         continue;
+
+      // Skins are hit tested in their animated pose, with instances
+      // refitting a copy of the bind pose tree
+      if (mesh->getMeshType() == TSMesh::SkinMeshType)
+      {
+         static_cast<TSSkinMesh*>(mesh)->getBindRayBVH();
+         continue;
+      }
+
+      for (S32 frame = 0; frame < mesh->numFrames; frame++)
+         mesh->getRayBVH(frame);
+   }
+}
+
+bool TSShape::readFromBuffer(void *data, U32 size, TSIOState *options)
+{
+   MemStream stream(size, data, true, false);
+   return _read(&stream, options, (S8*)data);
+}
+
+bool TSShape::readFromFile(const String &path, TSIOState *options)
+{
+   FileMapping mapping;
+   if (mapping.open(path.c_str()))
+      return readFromBuffer(mapping.getData(), mapping.getSize(), options);
+
+   FileStream stream;
+   stream.open(path, FileStream::Read);
+   if (stream.getStatus() != Stream::Ok)
+   {
+      Log::errorf( "Resource<TSShape>::create - Could not open '%s'", path.c_str() );
+      return false;
+   }
+   return read(&stream, options);
+}
+
+bool TSShape::_read(Stream * s, TSIOState *options, S8 *image)
 {
    TSIOState ioState;
    if (options)
@@ -1607,6 +1979,37 @@ bool TSShape::read(Stream * s, TSIOState *options)
    }
    ioState.smReadVersion = mReadVersion;
 
+   // the header is only trusted if it was written for the same load options
+   // by a build that lays the shape data out the same way, otherwise the
+   // recorded size could be too small for the meshes built in it
+   U32 allocSize = 0;
+   if (mReadVersion>26)
+   {
+      U32 headerStart = s->getPosition();
+      U32 headerSize, allocKey, layoutKey = 0;
+      s->read(&headerSize);
+      s->read(&allocSize);
+      s->read(&allocKey);
+      if (headerSize>=4*sizeof(U32))
+         s->read(&layoutKey);
+      if (headerSize<3*sizeof(U32) || !s->setPosition(headerStart+headerSize))
+      {
+         Log::errorf(LogEntry::General, "Error: bad shape file header.");
+         return false;
+      }
+      const bool sameLayout = headerSize>=4*sizeof(U32) && layoutKey==TSIOState::getLayoutKey(mReadVersion);
+      if (!sameLayout || allocKey==U32_MAX || allocKey!=ioState.getAllocKey())
+         allocSize = 0;
+
+      // version 28 vertex data is only usable by the build layout it was
+      // written for, there are no separate arrays to fall back on
+      if (mReadVersion>27 && !sameLayout)
+      {
+         Log::errorf(LogEntry::General, "Error: version 28 shape was written for a different vertex layout or byte order, convert it again with TSShape::convertToCacheReady.");
+         return false;
+      }
+   }
+
    S32 * memBuffer32;
    S16 * memBuffer16;
    S8 * memBuffer8;
@@ -1632,9 +2035,21 @@ bool TSShape::read(Stream * s, TSIOState *options)
          return false;
       }
 
-      S32 * tmp = new S32[sizeMemBuffer];
-      s->read(sizeof(S32)*sizeMemBuffer,(U8*)tmp);
-      memBuffer32 = tmp;
+      // use the buffers in place if we can, they don't need endian-flipping
+      U32 bufferStart = s->getPosition();
+      if (image && 0x12345678==convertLEndianToHost(0x12345678) && !((MEM_ADDRESS)(image+bufferStart) & 3) &&
+          sizeMemBuffer <= (s->getStreamSize()-bufferStart)/sizeof(S32))
+      {
+         memBuffer32 = (S32*)(image+bufferStart);
+         s->setPosition(bufferStart+sizeof(S32)*sizeMemBuffer);
+      }
+      else
+      {
+         image = NULL;
+         memBuffer32 = new S32[sizeMemBuffer];
+         s->read(sizeof(S32)*sizeMemBuffer,(U8*)memBuffer32);
+      }
+      S32 * tmp = memBuffer32;
       memBuffer16 = (S16*)(tmp+startU16);
       memBuffer8  = (S8*)(tmp+startU8);
 
@@ -1664,16 +2079,31 @@ bool TSShape::read(Stream * s, TSIOState *options)
 	// since we read in the buffers, we need to endian-flip their entire contents...
    fixEndian(memBuffer32,memBuffer16,memBuffer8,count32,count16,count8);
 
+   // everything assembleShape copies out of the buffers ends up in vectors,
+   // so there's no need to stage it in the shape data buffer too
    tsalloc.setRead(memBuffer32,memBuffer16,memBuffer8,true);
-   assembleShape(ioState); // determine size of buffer needed
-   mShapeDataSize = tsalloc.getSize();
-   tsalloc.doAlloc();
-   mShapeData = tsalloc.getBuffer();
-   tsalloc.setRead(memBuffer32,memBuffer16,memBuffer8,false);
-   assembleShape(ioState); // copy to buffer
+   tsalloc.setAliasInput(true);
+   if (allocSize)
+   {
+      // size known from the header, allocate and copy in one go
+      mShapeDataSize = allocSize;
+      tsalloc.doAlloc(allocSize);
+      mShapeData = tsalloc.getBuffer();
+      assembleShape(ioState);
+   }
+   else
+   {
+      assembleShape(ioState); // determine size of buffer needed
+      mShapeDataSize = tsalloc.getSize();
+      tsalloc.doAlloc();
+      mShapeData = tsalloc.getBuffer();
+      tsalloc.setRead(memBuffer32,memBuffer16,memBuffer8,false);
+      assembleShape(ioState); // copy to buffer
+   }
    AssertFatal(tsalloc.getSize()==mShapeDataSize,"TSShape::read: shape data buffer size mis-calculated");
 
-   delete [] memBuffer32;
+   if (!image)
+      delete [] memBuffer32;
 
    if (ioState.smInitOnRead)
       init();
@@ -1975,6 +2405,13 @@ void TSShape::createEmptyShape()
    triggers.set(NULL, 0);
    billboardDetails.set(NULL, 0);
 
+   rotationTracks.clear();
+   translationTracks.clear();
+   compressedRotations.clear();
+   compressedTranslations.clear();
+   quantizedTranslations.clear();
+   mAnimationCompressed = false;
+
    names.setSize(3);
    names[0] = "Detail2";
    names[1] = "Mesh2";
@@ -2051,17 +2488,9 @@ TSShape *TSShape::createFromPath(const DTShape::Path &path)
 
    if ( extension.equal( "dts", String::NoCase ) )
    {
-      FileStream stream;
-      stream.open( path.getFullPath(), FileStream::Read );
-      if ( stream.getStatus() != Stream::Ok )
-      {
-         Log::errorf( "Resource<TSShape>::create - Could not open '%s'", path.getFullPath().c_str() );
-         return NULL;
-      }
-
       ret = new TSShape;
       ret->mPath = path.getFullPath();
-      readSuccess = ret->read(&stream);
+      readSuccess = ret->readFromFile( ret->mPath );
    }
    else if ( extension.equal( "dae", String::NoCase ) || extension.equal( "kmz", String::NoCase ) )
    {
@@ -2074,16 +2503,9 @@ TSShape *TSShape::createFromPath(const DTShape::Path &path)
       DTShape::Path cachedPath = path;
       cachedPath.setExtension("cached.dts");
        
-      FileStream stream;
-      stream.open( cachedPath.getFullPath(), FileStream::Read );
-      if ( stream.getStatus() != Stream::Ok )
-      {
-         Log::errorf( "Resource<TSShape>::create - Could not open '%s'", cachedPath.getFullPath().c_str() );
-         return NULL;
-      }
       ret = new TSShape;
       ret->mPath = cachedPath.getFullPath();
-      readSuccess = ret->read(&stream);
+      readSuccess = ret->readFromFile( ret->mPath );
 #endif
    }
    else
@@ -2099,10 +2521,40 @@ TSShape *TSShape::createFromPath(const DTShape::Path &path)
       delete ret;
       ret = NULL;
    }
+   else if ( smCompressAnimation )
+      ret->compressAnimation();
 
    return ret;
 }
 
+bool TSShape::convertToCacheReady(const DTShape::Path &srcPath, const DTShape::Path &destPath)
+{
+   TSShape *shape = createFromPath(srcPath);
+   if (!shape)
+      return false;
+
+   FileStream stream;
+   stream.open(destPath.getFullPath(), FileStream::Write);
+   if (stream.getStatus() != Stream::Ok)
+   {
+      Log::errorf( "TSShape::convertToCacheReady - Could not open '%s' for writing", destPath.getFullPath().c_str() );
+      delete shape;
+      return false;
+   }
+
+   // lay out the vertex data for this runtime, so it's what gets stored
+   shape->initVertexFeatures();
+
+   TSIOState ioState;
+   ioState.smVersion = 28;
+   shape->write(&stream, &ioState);
+
+   bool ok = stream.getStatus() != Stream::IOError;
+   stream.close();
+   delete shape;
+   return ok;
+}
+
 TSShape::ConvexHullAccelerator* TSShape::getAccelerator(S32 dl)
 {
    AssertFatal(dl < details.size(), "Error, bad detail level!");
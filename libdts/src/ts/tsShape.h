@@ -54,6 +54,7 @@ BEGIN_NS(DTShape)
 
 class TSMaterialList;
 class TSLastDetail;
+class TSPoseCache;
 class PhysicsCollision;
 
 //
@@ -112,6 +113,17 @@ public:
    TSShapeAlloc tsalloc;
    
    TSIOState();
+
+   /// Packs the load options that change the size of the assembled shape
+   /// data, so a size recorded by the writer is only trusted when they match
+   U32 getAllocKey() const;
+
+   /// Fingerprint of how this build lays out the shape data of a version
+   /// @a version shape. Meshes are constructed in place in that data, so
+   /// their size depends on the compiler, pointer width and library version
+   /// as much as on the file. From version 28 it also covers the vertex
+   /// structs and byte order, since their memory image is stored.
+   static U32 getLayoutKey(S32 version);
    
    TSIOState& operator= (TSIOState &rhs)
    {
@@ -240,6 +252,15 @@ class TSShape : public StrongRefBase
       U32 flags;
       U32 dirtyFlags; ///< determined at load time
 
+      /// @name Compressed Tracks
+      /// Index of the first rotation and translation track of this sequence.
+      /// Only valid while the shape's animation is compressed.
+      /// @see TSShape::compressAnimation
+      /// @{
+      S32 firstRotationTrack;
+      S32 firstTranslationTrack;
+      /// @}
+
       /// @name Source Data
       /// Store some information about where the sequence data came from (used by
       /// TSShapeConstructor and the Shape Editor)
@@ -302,6 +323,39 @@ class TSShape : public StrongRefBase
       F32 pos;
    };
 
+   /// A compressed rotation or translation track of one node in a sequence.
+   ///
+   /// Keys are stored for every stride-th keyframe, plus the last keyframe. Keyframes
+   /// in between are interpolated from the stored keys either side, so any keyframe
+   /// can be sampled in constant time. A stride of 0 marks a constant track, which
+   /// stores a single key.
+   struct AnimTrack
+   {
+      enum
+      {
+         Quantized = BIT(0)   ///< translation keys are 3 U16s scaled to a per-track range
+      };
+
+      S32 offset;       ///< first key (or range for quantized tracks) in the compressed vectors
+      S32 keyOffset;    ///< first key in quantizedTranslations for quantized tracks
+      U16 stride;
+      U16 flags;
+
+      bool isConstant() const { return stride == 0; }
+      bool isQuantized() const { return (flags & Quantized) != 0; }
+
+      /// Returns the stored key at or before keyframeNum, and how far (0-1) keyframeNum
+      /// is from it towards the next stored key.
+      S32 getKey(S32 keyframeNum, S32 numKeyframes, F32 *t) const
+      {
+         S32 key = keyframeNum / stride;
+         S32 start = key * stride;
+         S32 end = getMin(start + stride, numKeyframes - 1);
+         *t = (end > start) ? F32(keyframeNum - start) / F32(end - start) : 0.0f;
+         return key;
+      }
+   };
+
    /// Details are used for render detail selection.
    ///
    /// As the projected size of the shape changes,
@@ -349,6 +403,15 @@ class TSShape : public StrongRefBase
       U8**     emitStrings;
    };
    ConvexHullAccelerator* getAccelerator(S32 dl);
+
+   /// Builds the ray cast hierarchy of every mesh which has none yet. Meshes
+   /// otherwise build theirs on the first ray cast, which is not thread safe.
+   /// @see TSMesh::getRayBVH
+   void buildRayBVHs();
+
+   /// Call buildRayBVHs from init(), so shapes are ready for ray casts as soon
+   /// as they are loaded
+   static bool smBuildRayBVHs;
    /// @}
 
 
@@ -377,6 +440,17 @@ class TSShape : public StrongRefBase
 
    /// @}
 
+   /// @name Node Evaluation Order
+   /// Set up by init. The nodes of each subshape sorted by depth, so parents always
+   /// come before their children. Uses the same ranges as subShapeFirstNode and
+   /// subShapeNumNodes.
+   /// @{
+
+   Vector<S32> nodeEvalOrder;      ///< node indices
+   Vector<S32> nodeEvalParents;    ///< parent of each entry in nodeEvalOrder, or -1
+
+   /// @}
+
    /// @name Alpha Vectors
    /// these vectors describe how to transition between detail
    /// levels using alpha. "alpha-in" next detail as intraDL goes
@@ -411,6 +485,19 @@ class TSShape : public StrongRefBase
 
    /// @}
 
+   /// @name Compressed Animation
+   /// Replace nodeRotations and nodeTranslations while the animation is compressed.
+   /// @see compressAnimation
+   /// @{
+
+   Vector<AnimTrack>                rotationTracks;
+   Vector<AnimTrack>                translationTracks;
+   Vector<Quat16>                   compressedRotations;
+   Vector<Point3F>                  compressedTranslations;  ///< unquantized keys, and min/scale pairs of quantized tracks
+   Vector<U16>                      quantizedTranslations;
+
+   /// @}
+
    TSMaterialList * materialList;
 
    /// @name Bounding
@@ -421,6 +508,29 @@ class TSShape : public StrongRefBase
    Point3F center;
    Box3F bounds;
 
+   /// Bounds of the geometry which moves with one node: the skin vertices
+   /// the node influences and the meshes of objects attached to it, over
+   /// every detail. Skin vertices are taken in the bind pose, moved into
+   /// the node's space, so animating a node only moves its bounds.
+   struct BoneBounds
+   {
+      S32 node;               ///< Node the geometry moves with, or -1
+      S32 objectNode;         ///< For skins, node of the skin object, applied after node; otherwise -1
+
+      Box3F box;              ///< In the space of node, so an oriented box once animated
+      Point3F capsuleStart;   ///< Capsule around the same vertices, in the space of node
+      Point3F capsuleEnd;
+      F32 capsuleRadius;
+   };
+
+   /// One entry per node (and skin object node) with geometry, built by
+   /// computeBoneBounds.
+   /// @see TSShapeInstance::getHitBoxes
+   Vector<BoneBounds> boneBounds;
+
+   /// Fills in boneBounds from the meshes. Called by init().
+   void computeBoneBounds();
+
    /// @}
 
    // various...
@@ -470,6 +580,10 @@ class TSShape : public StrongRefBase
 
    bool mSequencesConstructed;
 
+   bool mAnimationCompressed;
+
+   TSPoseCache *mPoseCache;
+
    S8* mShapeData;
    U32 mShapeDataSize;
    
@@ -491,6 +605,12 @@ class TSShape : public StrongRefBase
    
    // Generic helpers to load a shape or cae from a pth
    static TSShape *createFromPath(const DTShape::Path &path);
+
+   /// Loads the .dts, .cached.dts or .dae at @a srcPath and writes it to
+   /// @a destPath in the cache-ready version 28 layout, which stores the
+   /// final vertex data, indices and skin batches so loading doesn't have
+   /// to build them.
+   static bool convertToCacheReady(const DTShape::Path &srcPath, const DTShape::Path &destPath);
    
    DTShape::Path getPath() { return mPath; }
 
@@ -512,11 +632,59 @@ class TSShape : public StrongRefBase
    /// @{
 
    QuatF & getRotation(const Sequence & seq, S32 keyframeNum, S32 rotNum, QuatF *) const;
-   const Point3F & getTranslation(const Sequence & seq, S32 keyframeNum, S32 tranNum) const;
+   Point3F getTranslation(const Sequence & seq, S32 keyframeNum, S32 tranNum) const;
    F32 getUniformScale(const Sequence & seq, S32 keyframeNum, S32 scaleNum) const;
    const Point3F & getAlignedScale(const Sequence & seq, S32 keyframeNum, S32 scaleNum) const;
    TSScale & getArbitraryScale(const Sequence & seq, S32 keyframeNum, S32 scaleNum, TSScale *) const;
    const ObjectState & getObjectState(const Sequence & seq, S32 keyframeNum, S32 objectNum) const;
+
+   QuatF & getCompressedRotation(const Sequence & seq, S32 keyframeNum, S32 rotNum, QuatF *) const;
+   Point3F getCompressedTranslation(const Sequence & seq, S32 keyframeNum, S32 tranNum) const;
+
+   /// Interpolates numTracks consecutive rotation tracks of a sequence, starting
+   /// at firstTrack, keyPos of the way from keyNum1 to keyNum2.
+   void sampleRotations(const Sequence & seq, S32 keyNum1, S32 keyNum2, F32 keyPos, S32 firstTrack, S32 numTracks, QuatF * out) const;
+
+   /// Interpolates numTracks consecutive translation tracks of a sequence, starting
+   /// at firstTrack, keyPos of the way from keyNum1 to keyNum2.
+   void sampleTranslations(const Sequence & seq, S32 keyNum1, S32 keyNum2, F32 keyPos, S32 firstTrack, S32 numTracks, Point3F * out) const;
+   /// @}
+
+   /// @name Animation Compression
+   /// Node rotation and translation keyframes can be held in a compressed form.
+   /// Constant tracks store one key, translations are quantized to 16 bits per
+   /// component over the range of each track, and when smAnimationMaxKeyStride is
+   /// more than 1 keys which can be interpolated from their neighbours are dropped.
+   ///
+   /// Code which reads or modifies nodeRotations or nodeTranslations directly
+   /// (writing, exporting or editing sequences) decompresses the shape first.
+   /// @{
+
+   void compressAnimation();
+   void decompressAnimation();
+   bool isAnimationCompressed() const { return mAnimationCompressed; }
+
+   /// Compress the animation of shapes loaded by createFromPath
+   static bool smCompressAnimation;
+
+   /// Most a compressed rotation may differ from the original, in radians
+   static F32 smAnimationRotationTolerance;
+
+   /// Most a compressed translation may differ from the original
+   static F32 smAnimationTranslationTolerance;
+
+   /// Longest gap between stored keys of a compressed track. 1 keeps every key.
+   static S32 smAnimationMaxKeyStride;
+   /// @}
+
+   /// @name Pose Cache
+   /// @see TSPoseCache
+   /// @{
+
+   /// Shares node poses between instances playing the same threads. Up to
+   /// @a maxEntries poses are kept; 0 turns the cache off.
+   void setPoseCacheSize(S32 maxEntries);
+   TSPoseCache* getPoseCache() const { return mPoseCache; }
    /// @}
 
    /// build LOS collision detail
@@ -637,9 +805,28 @@ class TSShape : public StrongRefBase
    /// Methods for saving/loading shapes to/from streams
    /// @{
 
+   /// Bytes in the header that follows the version word from version 27 on:
+   /// header size, shape data size, load option key and layout key.
+   enum { HeaderSize = 4 * sizeof(U32) };
+
    bool canWriteOldFormat() const;
+
+   /// Writes the shape in the version given by @a options (28 by default).
+   /// Version 28 stores the aligned vertex data of meshes that have it, as
+   /// built by initVertexFeatures(); other meshes are written as separate
+   /// vertex arrays. Big endian hosts write version 27 instead.
    void write(Stream *, TSIOState *options = NULL);
    bool read(Stream *, TSIOState *options = NULL);
+
+   /// Reads a shape from a whole .dts file held in memory, such as a
+   /// FileMapping. On little endian hosts the shape is assembled straight
+   /// from @a data instead of a copy of it. The memory only needs to stay
+   /// valid until this returns.
+   bool readFromBuffer(void *data, U32 size, TSIOState *options = NULL);
+
+   /// Reads the shape at @a path, mapping the file into memory when possible
+   bool readFromFile(const String &path, TSIOState *options = NULL);
+
    void readOldShape(Stream * s, S32 * &, S16 * &, S8 * &, S32 &, S32 &, S32 &);
    void writeName(Stream *, S32 nameIndex);
    S32  readName(Stream *, bool addName);
@@ -657,6 +844,14 @@ class TSShape : public StrongRefBase
    /// @{
 
    void fixEndian(S32 *, S16 *, S8 *, S32, S32, S32);
+
+   /// Size of the shape data assembleShape() builds from the given buffers
+   /// when loading with @a options, used by write() to fill in the header.
+   static U32 getAssembledSize(S32 *, S16 *, S8 *, TSIOState &options);
+
+   /// Common part of read() and readFromBuffer(). If @a image is the start
+   /// of the data in @a s, the shape buffers are used in place.
+   bool _read(Stream *s, TSIOState *options, S8 *image);
    /// @}
 
    /// @name Memory Buffer Transfer Methods
@@ -729,6 +924,29 @@ class TSShape : public StrongRefBase
    static bool smAllowHardwareSkinning;
    static bool smUseHardwareSkinning;
    static bool smUseComputeSkinning;
+
+   /// Build structure-of-arrays skin batches for CPU skinning instead of
+   /// batching by bone transform. Only affects meshes whose batch data is
+   /// created after this is set.
+   static bool smUseSoASkinning;
+
+   /// CPU skinned meshes where no vertex has more than this many bone
+   /// influences blend the bone transforms per vertex, rather than batching
+   /// by bone transform. At most TSSkinMesh::BatchData::maxBonePerVertGPU;
+   /// 0 disables this.
+   static S32 smMaxSkinByVertexInfluences;
+
+   /// Skin meshes with dual quaternions instead of linear blended matrices.
+   /// Bone palettes are then 8 floats per bone rather than 16, and joints
+   /// keep their volume when twisted. Bone scale is ignored. Only affects
+   /// meshes whose batch data is created after this is set.
+   ///
+   /// Dual quaternion skinning is only done on the CPU, so setting this
+   /// overrides smUseHardwareSkinning.
+   static bool smUseDualQuatSkinning;
+
+   /// Returns true if skin meshes are skinned on the GPU.
+   static bool useHardwareSkinning() { return smUseHardwareSkinning && !smUseDualQuatSkinning; }
 };
 
 typedef StrongRefPtr<TSShape> TSShapeRef;
@@ -741,11 +959,15 @@ typedef StrongRefPtr<TSShape> TSShapeRef;
 
 inline QuatF & TSShape::getRotation(const Sequence & seq, S32 keyframeNum, S32 rotNum, QuatF * quat) const
 {
+   if (mAnimationCompressed)
+      return getCompressedRotation(seq, keyframeNum, rotNum, quat);
    return nodeRotations[seq.baseRotation + rotNum*seq.numKeyframes + keyframeNum].getQuatF(quat);
 }
 
-inline const Point3F & TSShape::getTranslation(const Sequence & seq, S32 keyframeNum, S32 tranNum) const
+inline Point3F TSShape::getTranslation(const Sequence & seq, S32 keyframeNum, S32 tranNum) const
 {
+   if (mAnimationCompressed)
+      return getCompressedTranslation(seq, keyframeNum, tranNum);
    return nodeTranslations[seq.baseTranslation + tranNum*seq.numKeyframes + keyframeNum];
 }
 
@@ -49,6 +49,7 @@ void TSShapeAlloc::setRead(S32 * memBuffer32, S16 * memBuffer16, S8 * memBuffer8
    {
       mDest = NULL;
       mSize = 0;
+      mAliasInput = false;
    }
 
    setSkipMode(false);
@@ -81,6 +82,12 @@ void TSShapeAlloc::doAlloc()
    mSize = 0;
 }
 
+void TSShapeAlloc::doAlloc(S32 size)
+{
+   mSize = size;
+   doAlloc();
+}
+
 void TSShapeAlloc::align32()
 {
    readOnly();
@@ -125,6 +132,8 @@ type * TSShapeAlloc::getPointer##suffix(S32 num)              \
 type * TSShapeAlloc::copyToShape##suffix(S32 num, bool returnSomething) \
 {                                                             \
    readOnly();                                                \
+   if (mAliasInput)                                           \
+      return getPointer##suffix(num);                         \
    type * ret = (!returnSomething || mDest) ? (type*)mDest : mMemBuffer##suffix; \
    if (mDest)                                                 \
    {                                                          \
@@ -55,6 +55,9 @@ BEGIN_NS(DTShape)
 ///    of the size of the transfer).
 /// 5. call getBuffer to get the target (destination buffer)
 ///
+/// If the size is already known (it is recorded in the header of version 27
+/// shapes), call "doAlloc" with it straight after step 1 and run step 2 once.
+///
 /// write usage:
 /// 1. call "setWrite" (no parameters).
 /// 2. run through set of operations for allocating and transfering memory to internal buffers
@@ -94,6 +97,7 @@ class TSShapeAlloc
    S8 * mDest;
    S32 mSize;
    S32 mMult; ///< mult incoming sizes by this (when 0, then mDest doesn't grow --> skip mode)
+   bool mAliasInput; ///< copyToShape returns pointers into the input buffers rather than copying
 
    public:
 
@@ -105,11 +109,18 @@ class TSShapeAlloc
 
    // reading only...
    void doAlloc();
+   void doAlloc(S32 size); ///< allocate a buffer of a size computed ahead of time
    void align32(); ///< align on dword boundary
    S8 * getBuffer() { return mDest; }
    S32 getSize() { return mSize; }
    void setSkipMode(bool skip) { mMult = skip ? 0 : 1; }
 
+   /// When set, copyToShape() hands back a pointer into the input buffer
+   /// instead of copying the data into the output buffer. Only valid while
+   /// everything fetched with copyToShape() is copied out again before the
+   /// input buffers go away (as TSShape::assembleShape does).
+   void setAliasInput(bool alias) { mAliasInput = alias; }
+
    /// @name Reading Operations:
    ///
    /// get(): reads one or more entries of type from input buffer (doesn't affect output buffer)
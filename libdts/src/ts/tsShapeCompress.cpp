@@ -0,0 +1,401 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+
+#include "ts/tsShape.h"
+#include "ts/tsTransform.h"
+#include "platform/profiler.h"
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+bool TSShape::smCompressAnimation = false;
+F32 TSShape::smAnimationRotationTolerance = 0.002f;
+F32 TSShape::smAnimationTranslationTolerance = 0.001f;
+S32 TSShape::smAnimationMaxKeyStride = 1;
+
+//-----------------------------------------------------------------------------
+// Track helpers
+//-----------------------------------------------------------------------------
+
+/// Number of keys stored for a non-constant track
+static S32 _getNumTrackKeys(S32 numKeyframes, S32 stride)
+{
+   S32 last = numKeyframes - 1;
+   return last / stride + 1 + ((last % stride) ? 1 : 0);
+}
+
+/// Keyframe stored as the key'th key of a non-constant track
+static S32 _getTrackKeyframe(S32 key, S32 numKeyframes, S32 stride)
+{
+   return getMin(key * stride, numKeyframes - 1);
+}
+
+static inline bool _rotationMatches(const QuatF &q1, const QuatF &q2, F32 cosHalfTol)
+{
+   // Quat16 keys are not quite unit length
+   return mFabs(q1.dot(q2)) >= cosHalfTol * mSqrt(q1.dot(q1) * q2.dot(q2));
+}
+
+static inline bool _translationMatches(const Point3F &p1, const Point3F &p2, F32 tolSq)
+{
+   return (p1 - p2).lenSquared() <= tolSq;
+}
+
+/// Returns the longest stride (up to maxStride) at which every keyframe of the
+/// track interpolates to within tolerance of the original keys.
+static S32 _findRotationStride(const Quat16 *keys, S32 numKeyframes, S32 maxStride, F32 cosHalfTol)
+{
+   QuatF q1, q2, q, orig;
+
+   S32 stride = getMin(maxStride, numKeyframes - 1);
+   for (; stride > 1; stride--)
+   {
+      S32 i;
+      for (i=0; i<numKeyframes; i++)
+      {
+         S32 start = (i / stride) * stride;
+         S32 end = getMin(start + stride, numKeyframes - 1);
+         if (i == start)
+            continue;
+
+         keys[start].getQuatF(&q1);
+         keys[end].getQuatF(&q2);
+         TSTransform::interpolate(q1, q2, F32(i - start) / F32(end - start), &q);
+         if (!_rotationMatches(q, keys[i].getQuatF(&orig), cosHalfTol))
+            break;
+      }
+      if (i == numKeyframes)
+         break;
+   }
+   return getMax(stride, 1);
+}
+
+static S32 _findTranslationStride(const Point3F *keys, const Point3F *decoded, S32 numKeyframes, S32 maxStride, F32 tolSq)
+{
+   Point3F p;
+
+   S32 stride = getMin(maxStride, numKeyframes - 1);
+   for (; stride > 1; stride--)
+   {
+      S32 i;
+      for (i=0; i<numKeyframes; i++)
+      {
+         S32 start = (i / stride) * stride;
+         S32 end = getMin(start + stride, numKeyframes - 1);
+         if (i == start)
+            continue;
+
+         TSTransform::interpolate(decoded[start], decoded[end], F32(i - start) / F32(end - start), &p);
+         if (!_translationMatches(p, keys[i], tolSq))
+            break;
+      }
+      if (i == numKeyframes)
+         break;
+   }
+   return getMax(stride, 1);
+}
+
+static inline U16 _quantize(F32 value, F32 min, F32 invScale)
+{
+   return (U16)mClamp((S32)((value - min) * invScale + 0.5f), 0, 0xFFFF);
+}
+
+//-----------------------------------------------------------------------------
+// Sampling
+//-----------------------------------------------------------------------------
+
+/// Decodes the key'th stored key of a compressed translation track
+static inline Point3F _getTrackTranslation(const TSShape *shape, const TSShape::AnimTrack &track, S32 key)
+{
+   if (!track.isQuantized())
+      return shape->compressedTranslations[track.offset + key];
+
+   const Point3F &min = shape->compressedTranslations[track.offset];
+   const Point3F &scale = shape->compressedTranslations[track.offset + 1];
+   const U16 *q = &shape->quantizedTranslations[(track.keyOffset + key) * 3];
+   return Point3F(min.x + q[0] * scale.x, min.y + q[1] * scale.y, min.z + q[2] * scale.z);
+}
+
+QuatF & TSShape::getCompressedRotation(const Sequence & seq, S32 keyframeNum, S32 rotNum, QuatF * quat) const
+{
+   const AnimTrack &track = rotationTracks[seq.firstRotationTrack + rotNum];
+   if (track.isConstant())
+      return compressedRotations[track.offset].getQuatF(quat);
+
+   F32 t;
+   S32 key = track.offset + track.getKey(keyframeNum, seq.numKeyframes, &t);
+   if (t == 0.0f)
+      return compressedRotations[key].getQuatF(quat);
+
+   QuatF q1, q2;
+   compressedRotations[key].getQuatF(&q1);
+   compressedRotations[key+1].getQuatF(&q2);
+   return TSTransform::interpolate(q1, q2, t, quat);
+}
+
+Point3F TSShape::getCompressedTranslation(const Sequence & seq, S32 keyframeNum, S32 tranNum) const
+{
+   const AnimTrack &track = translationTracks[seq.firstTranslationTrack + tranNum];
+   if (track.isConstant())
+      return _getTrackTranslation(this, track, 0);
+
+   F32 t;
+   S32 key = track.getKey(keyframeNum, seq.numKeyframes, &t);
+   if (t == 0.0f)
+      return _getTrackTranslation(this, track, key);
+
+   Point3F p;
+   return TSTransform::interpolate(_getTrackTranslation(this, track, key),
+                                   _getTrackTranslation(this, track, key+1), t, &p);
+}
+
+//-----------------------------------------------------------------------------
+// Compression
+//-----------------------------------------------------------------------------
+
+void TSShape::compressAnimation()
+{
+   if (mAnimationCompressed)
+      return;
+
+   PROFILE_SCOPE(TSShape_compressAnimation);
+
+   rotationTracks.clear();
+   translationTracks.clear();
+   compressedRotations.clear();
+   compressedTranslations.clear();
+   quantizedTranslations.clear();
+
+   const F32 cosHalfTol = mCos(smAnimationRotationTolerance * 0.5f);
+   const F32 tolSq = smAnimationTranslationTolerance * smAnimationTranslationTolerance;
+   const S32 maxStride = mClamp(smAnimationMaxKeyStride, 1, 0xFFFF);
+
+   Vector<Point3F> decoded;
+   QuatF first, q;
+
+   for (S32 i=0; i<sequences.size(); i++)
+   {
+      Sequence &seq = sequences[i];
+      const S32 numKeyframes = seq.numKeyframes;
+
+      seq.firstRotationTrack = rotationTracks.size();
+      seq.firstTranslationTrack = translationTracks.size();
+      if (numKeyframes <= 0)
+         continue;
+
+      // Rotations
+      S32 numTracks = seq.rotationMatters.count();
+      for (S32 j=0; j<numTracks; j++)
+      {
+         const Quat16 *keys = &nodeRotations[seq.baseRotation + j*numKeyframes];
+
+         rotationTracks.increment();
+         AnimTrack &track = rotationTracks.last();
+         track.offset = compressedRotations.size();
+         track.keyOffset = 0;
+         track.flags = 0;
+
+         keys[0].getQuatF(&first);
+         S32 k;
+         for (k=1; k<numKeyframes; k++)
+         {
+            if (!_rotationMatches(first, keys[k].getQuatF(&q), cosHalfTol))
+               break;
+         }
+         if (k == numKeyframes)
+         {
+            track.stride = 0;
+            compressedRotations.push_back(keys[0]);
+            continue;
+         }
+
+         S32 stride = _findRotationStride(keys, numKeyframes, maxStride, cosHalfTol);
+         track.stride = stride;
+         S32 numKeys = _getNumTrackKeys(numKeyframes, stride);
+         for (k=0; k<numKeys; k++)
+            compressedRotations.push_back(keys[_getTrackKeyframe(k, numKeyframes, stride)]);
+      }
+
+      // Translations
+      numTracks = seq.translationMatters.count();
+      for (S32 j=0; j<numTracks; j++)
+      {
+         const Point3F *keys = &nodeTranslations[seq.baseTranslation + j*numKeyframes];
+
+         translationTracks.increment();
+         AnimTrack &track = translationTracks.last();
+         track.offset = compressedTranslations.size();
+         track.keyOffset = 0;
+         track.flags = 0;
+
+         Box3F range(keys[0], keys[0]);
+         S32 k;
+         for (k=1; k<numKeyframes; k++)
+            range.extend(keys[k]);
+
+         if (range.getExtents().lenSquared() <= tolSq)
+         {
+            track.stride = 0;
+            compressedTranslations.push_back(keys[0]);
+            continue;
+         }
+
+         // Quantize to the range of the track if the rounding error is small enough
+         Point3F scale = range.getExtents() / F32(0xFFFF);
+         Point3F invScale(scale.x > 0.0f ? 1.0f / scale.x : 0.0f,
+                          scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+                          scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+         bool quantize = (scale.lenSquared() * 0.25f <= tolSq);
+
+         decoded.setSize(numKeyframes);
+         if (quantize)
+         {
+            for (k=0; k<numKeyframes; k++)
+            {
+               const Point3F &p = keys[k];
+               U16 qx = _quantize(p.x, range.minExtents.x, invScale.x);
+               U16 qy = _quantize(p.y, range.minExtents.y, invScale.y);
+               U16 qz = _quantize(p.z, range.minExtents.z, invScale.z);
+               decoded[k].set(range.minExtents.x + qx * scale.x,
+                              range.minExtents.y + qy * scale.y,
+                              range.minExtents.z + qz * scale.z);
+            }
+         }
+         else
+            dCopyArray(decoded.address(), keys, numKeyframes);
+
+         S32 stride = _findTranslationStride(keys, decoded.address(), numKeyframes, maxStride, tolSq);
+         track.stride = stride;
+         S32 numKeys = _getNumTrackKeys(numKeyframes, stride);
+
+         if (quantize)
+         {
+            track.flags = AnimTrack::Quantized;
+            track.keyOffset = quantizedTranslations.size() / 3;
+            compressedTranslations.push_back(range.minExtents);
+            compressedTranslations.push_back(scale);
+
+            for (k=0; k<numKeys; k++)
+            {
+               const Point3F &p = keys[_getTrackKeyframe(k, numKeyframes, stride)];
+               quantizedTranslations.push_back(_quantize(p.x, range.minExtents.x, invScale.x));
+               quantizedTranslations.push_back(_quantize(p.y, range.minExtents.y, invScale.y));
+               quantizedTranslations.push_back(_quantize(p.z, range.minExtents.z, invScale.z));
+            }
+         }
+         else
+         {
+            for (k=0; k<numKeys; k++)
+               compressedTranslations.push_back(keys[_getTrackKeyframe(k, numKeyframes, stride)]);
+         }
+      }
+   }
+
+   nodeRotations.clear();
+   nodeRotations.compact();
+   nodeTranslations.clear();
+   nodeTranslations.compact();
+
+   rotationTracks.compact();
+   translationTracks.compact();
+   compressedRotations.compact();
+   compressedTranslations.compact();
+   quantizedTranslations.compact();
+
+   mAnimationCompressed = true;
+}
+
+void TSShape::decompressAnimation()
+{
+   if (!mAnimationCompressed)
+      return;
+
+   PROFILE_SCOPE(TSShape_decompressAnimation);
+
+   nodeRotations.clear();
+   nodeTranslations.clear();
+
+   QuatF q;
+   for (S32 i=0; i<sequences.size(); i++)
+   {
+      Sequence &seq = sequences[i];
+      const S32 numKeyframes = seq.numKeyframes;
+
+      S32 numTracks = seq.rotationMatters.count();
+      seq.baseRotation = nodeRotations.size();
+      if (numKeyframes > 0)
+      {
+         nodeRotations.increment(numTracks * numKeyframes);
+         for (S32 j=0; j<numTracks; j++)
+         {
+            const AnimTrack &track = rotationTracks[seq.firstRotationTrack + j];
+            Quat16 *keys = &nodeRotations[seq.baseRotation + j*numKeyframes];
+            for (S32 k=0; k<numKeyframes; k++)
+            {
+               // Copy stored keys rather than round trip them through QuatF
+               F32 t = 0.0f;
+               S32 key = track.isConstant() ? 0 : track.getKey(k, numKeyframes, &t);
+               if (t == 0.0f)
+                  keys[k] = compressedRotations[track.offset + key];
+               else
+                  keys[k].set(getCompressedRotation(seq, k, j, &q));
+            }
+         }
+      }
+
+      numTracks = seq.translationMatters.count();
+      seq.baseTranslation = nodeTranslations.size();
+      if (numKeyframes > 0)
+      {
+         nodeTranslations.increment(numTracks * numKeyframes);
+         for (S32 j=0; j<numTracks; j++)
+         {
+            Point3F *keys = &nodeTranslations[seq.baseTranslation + j*numKeyframes];
+            for (S32 k=0; k<numKeyframes; k++)
+               keys[k] = getCompressedTranslation(seq, k, j);
+         }
+      }
+   }
+
+   rotationTracks.clear();
+   rotationTracks.compact();
+   translationTracks.clear();
+   translationTracks.compact();
+   compressedRotations.clear();
+   compressedRotations.compact();
+   compressedTranslations.clear();
+   compressedTranslations.compact();
+   quantizedTranslations.clear();
+   quantizedTranslations.compact();
+
+   mAnimationCompressed = false;
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
@@ -414,13 +414,6 @@ bool TSShape::renameSequence(const String& oldName, const String& newName)
 
 bool TSShape::addNode(const String& name, const String& parentName, const Point3F& pos, const QuatF& rot)
 {
-   // Check that adding this node would not exceed the maximum count
-   if (nodes.size() >= MAX_TS_SET_SIZE)
-   {
-      Log::errorf("TSShape::addNode: Cannot add node, shape already has maximum (%d) nodes", MAX_TS_SET_SIZE);
-      return false;
-   }
-
    // Check that there is not already a node with this name
    if (findNode(name) >= 0)
    {
@@ -554,6 +547,7 @@ bool TSShape::removeNode(const String& name)
    }
 
    // Update animation sequences
+   decompressAnimation();
    for (S32 iSeq = 0; iSeq < sequences.size(); iSeq++)
    {
       TSShape::Sequence& seq = sequences[iSeq];
@@ -1462,6 +1456,10 @@ bool TSShape::addSequence(const DTShape::Path& path, const String& fromSeq,
       oldName = path.getFullPath();
    }
 
+   // Node keyframes are copied directly between the shapes
+   decompressAnimation();
+   srcShape->decompressAnimation();
+
    // Find the sequence
    S32 seqIndex = srcShape->findSequence(oldName);
    if (seqIndex < 0)
@@ -1791,6 +1789,7 @@ bool TSShape::removeSequence(const String& name)
    TSShape::Sequence& seq = sequences[seqIndex];
 
    // Remove the node transforms for this sequence
+   decompressAnimation();
    S32 transCount = eraseStates(nodeTranslations, seq.translationMatters, seq.baseTranslation, seq.numKeyframes);
    S32 rotCount = eraseStates(nodeRotations, seq.rotationMatters, seq.baseRotation, seq.numKeyframes);
    S32 scaleCount = 0;
@@ -1972,19 +1971,13 @@ void TSShape::getNodeKeyframe(S32 nodeIndex, const TSShape::Sequence& seq, S32 k
    // Get the node rotation and translation
    QuatF rot;
    if (seq.rotationMatters.test(nodeIndex))
-   {
-      S32 index = seq.rotationMatters.count(nodeIndex) * seq.numKeyframes + keyframe;
-      nodeRotations[seq.baseRotation + index].getQuatF(&rot);
-   }   
+      getRotation(seq, keyframe, seq.rotationMatters.count(nodeIndex), &rot);
    else
       defaultRotations[nodeIndex].getQuatF(&rot);
 
    Point3F trans;
    if (seq.translationMatters.test(nodeIndex))
-   {
-      S32 index = seq.translationMatters.count(nodeIndex) * seq.numKeyframes + keyframe;
-      trans = nodeTranslations[seq.baseTranslation + index];
-   }
+      trans = getTranslation(seq, keyframe, seq.translationMatters.count(nodeIndex));
    else
       trans = defaultTranslations[nodeIndex];
 
@@ -2023,6 +2016,9 @@ bool TSShape::setSequenceBlend(const String& seqName, bool blend, const String&
       return false;
    }
 
+   // Keyframes are modified in place below
+   decompressAnimation();
+
    // Set the new flag
    if (blend)
       seq.flags |= TSShape::Blend;
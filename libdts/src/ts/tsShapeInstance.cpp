@@ -23,6 +23,8 @@
 
 #include "platform/platform.h"
 #include "ts/tsShapeInstance.h"
+#include "ts/tsPoseAtlas.h"
+#include "ts/tsMeshBVH.h"
 
 #include "ts/tsLastDetail.h"
 #include "ts/tsMaterialList.h"
@@ -36,6 +38,11 @@
 
 BEGIN_NS(DTShape)
 
+bool TSShapeInstance::smUseAnimationLOD = false;
+F32 TSShapeInstance::smAnimationLODPixelSize[TSShapeInstance::NumAnimationLODs-1] = { 64.0f, 32.0f, 16.0f };
+bool TSShapeInstance::smAnimationLODInterpolate = true;
+S32 TSShapeInstance::smAnimationLODSkipBlends = TSShapeInstance::NumAnimationLODs-1;
+
 //-------------------------------------------------------------------------------------
 // constructors, destructors, initialization
 //-------------------------------------------------------------------------------------
@@ -44,6 +51,7 @@ TSShapeInstance::TSShapeInstance( TSShape *shape, TSRenderState *renderState, bo
 {
    VECTOR_SET_ASSOCIATION(mMeshObjects);
    VECTOR_SET_ASSOCIATION(mNodeTransforms);
+   VECTOR_SET_ASSOCIATION(mNodeLocalTransforms);
    VECTOR_SET_ASSOCIATION(mNodeReferenceRotations);
    VECTOR_SET_ASSOCIATION(mNodeReferenceTranslations);
    VECTOR_SET_ASSOCIATION(mNodeReferenceUniformScales);
@@ -54,6 +62,8 @@ TSShapeInstance::TSShapeInstance( TSShape *shape, TSRenderState *renderState, bo
 
    mShape = shape;
    mCurrentRenderState = renderState;
+   mAnimationGeneration = 0;
+   mHitBoxGeneration = U32_MAX;
    buildInstanceData( mShape, loadMaterials );
 }
 
@@ -114,6 +124,11 @@ void TSShapeInstance::buildInstanceData(TSShape * _shape, bool loadMaterials)
    S32 ss = mShape->subShapeFirstNode.size(); // we have this many subtrees
    mDirtyFlags = new U32[ss];
 
+   // Spread the throttled node updates of instances over different frames
+   mAnimationLOD = 0;
+   mAnimationLODFrame = (U32)( (MEM_ADDRESS)this >> 4 );
+   mAnimationLODStep = mAnimationLODSteps = 0;
+
    mGroundThread = NULL;
    mCurrentDetailLevel = 0;
 
@@ -143,6 +158,7 @@ void TSShapeInstance::initMeshObjects()
 
       // hook up the object to it's node and transforms.
       objInst->mTransforms = &mNodeTransforms;
+      objInst->mTransformsGeneration = &mAnimationGeneration;
       objInst->nodeIndex = obj->nodeIndex;
 
       // set up list of meshes
@@ -463,16 +479,72 @@ void TSShapeInstance::render( TSRenderState &rdata, S32 dl, F32 intraDL )
    // run through the meshes   
    S32 start = rdata.isNoRenderNonTranslucent() ? mShape->subShapeFirstTranslucentObject[ss] : mShape->subShapeFirstObject[ss];
    S32 end   = rdata.isNoRenderTranslucent() ? mShape->subShapeFirstTranslucentObject[ss] : mShape->subShapeFirstObject[ss] + mShape->subShapeNumObjects[ss];
+
+   // Cull the bounds of every object in one pass rather than one object
+   // at a time, and tell the objects not to test again
+   const Frustum *culler = rdata.getCuller();
+   if ( culler && end > start )
+   {
+      PROFILE_SCOPE( TSShapeInstance_RenderCull );
+
+      FrustumCullBatch &batch = rdata.gCullBatch;
+      batch.clear();
+      for (i=start; i<end; i++)
+      {
+         const MeshObjectInstance &meshObj = mMeshObjects[i];
+         TSMesh *mesh = meshObj.getMesh( od );
+         batch.push( mesh ? mesh->getBounds() : Box3F::Zero, meshObj.getTransform() );
+      }
+
+      rdata.gCullVisible.setSize( ( batch.count + 31 ) / 32 );
+      culler->cullBoxes( batch, rdata.gCullVisible.address() );
+   }
+
+   const F32 alpha = mAlphaAlways ? mAlphaAlwaysValue : 1.0f;
    for (i=start; i<end; i++)
    {
-      rdata.setMeshObjectInstance(&mMeshObjects[i]);
+      MeshObjectInstance &meshObj = mMeshObjects[i];
+      if ( culler )
+      {
+         const U32 bit = i - start;
+         if ( !( rdata.gCullVisible[ bit / 32 ] & ( 1U << ( bit % 32 ) ) ) )
+         {
+            // culled objects still track the mesh they would draw, as render() does
+            if ( !meshObj.forceHidden && meshObj.visible * alpha > 0.01f )
+               meshObj.lastMesh = meshObj.getMesh( od );
+            continue;
+         }
+      }
+
+      rdata.setMeshObjectInstance(&meshObj);
       
       // following line is handy for debugging, to see what part of the shape that it is rendering
-      // const char *name = mShape->names[ mMeshObjects[i].object->nameIndex ];
-      mMeshObjects[i].render( od, mMaterialList, rdata, mAlphaAlways ? mAlphaAlwaysValue : 1.0f );
+      // const char *name = mShape->names[ meshObj.object->nameIndex ];
+      meshObj.render( od, mMaterialList, rdata, alpha, culler != NULL );
    }
 }
 
+void TSShapeInstance::prepareSkin( TSRenderState &rdata )
+{
+   if ( mCurrentDetailLevel < 0 )
+      return;
+
+   PROFILE_SCOPE( TSShapeInstance_PrepareSkin );
+
+   const TSDetail * detail = &mShape->details[mCurrentDetailLevel];
+   S32 ss = detail->subShapeNum;
+   S32 od = detail->objectDetailNum;
+
+   // billboards have nothing to skin
+   if ( ss < 0 )
+      return;
+
+   S32 start = mShape->subShapeFirstObject[ss];
+   S32 end   = start + mShape->subShapeNumObjects[ss];
+   for (S32 i=start; i<end; i++)
+      mMeshObjects[i].prepareSkin( od, rdata );
+}
+
 void TSShapeInstance::setCurrentDetail( S32 dl, F32 intraDL )
 {
    PROFILE_SCOPE( TSShapeInstance_setCurrentDetail );
@@ -513,6 +585,9 @@ S32 TSShapeInstance::setDetailFromDistance( const TSSceneRenderState *state, F32
    // Shortcut if the distance is really close or negative.
    if ( scaledDistance <= 0.0f )
    {
+      if ( smUseAnimationLOD )
+         mAnimationLOD = 0;
+
       mShape->mDetailLevelLookup[0].get( mCurrentDetailLevel, mCurrentIntraDetailLevel );
       return mCurrentDetailLevel;
    }
@@ -557,6 +632,15 @@ S32 TSShapeInstance::setDetailFromDistance( const TSSceneRenderState *state, F32
    // For debugging/metrics.
    mCurrentRenderState->smLastPixelSize = pixelSize;
 
+   // Pick the animation rate from the same pixel size.
+   if ( smUseAnimationLOD )
+   {
+      S32 lod = 0;
+      while ( lod < NumAnimationLODs-1 && pixelSize < smAnimationLODPixelSize[lod] )
+         lod++;
+      mAnimationLOD = lod;
+   }
+
    // Clamp it to an acceptable range for the lookup table.
    U32 index = (U32)mClampF( pixelSize, 0, mShape->mDetailLevelLookup.size() - 1 );
 
@@ -577,6 +661,11 @@ S32 TSShapeInstance::setDetailFromDistance( const TSSceneRenderState *state, F32
    return mCurrentDetailLevel;
 }
 
+void TSShapeInstance::setAnimationLOD( S32 lod )
+{
+   mAnimationLOD = mClamp( lod, 0, NumAnimationLODs-1 );
+}
+
 S32 TSShapeInstance::setDetailFromScreenError( F32 errorTolerance )
 {
    PROFILE_SCOPE( TSShapeInstance_setDetailFromScreenError );
@@ -641,7 +730,7 @@ S32 TSShapeInstance::setDetailFromScreenError( F32 errorTolerance )
 // Object (MeshObjectInstance & PluginObjectInstance) render methods
 //-------------------------------------------------------------------------------------
 
-void TSShapeInstance::ObjectInstance::render( S32, TSMaterialList *, TSRenderState &rdata, F32 alpha )
+void TSShapeInstance::ObjectInstance::render( S32, TSMaterialList *, TSRenderState &rdata, F32 alpha, bool preCulled )
 {
    AssertFatal(0,"TSShapeInstance::ObjectInstance::render:  no default render method.");
 }
@@ -649,7 +738,8 @@ void TSShapeInstance::ObjectInstance::render( S32, TSMaterialList *, TSRenderSta
 void TSShapeInstance::MeshObjectInstance::render(  S32 objectDetail, 
                                                    TSMaterialList *materials, 
                                                    TSRenderState &rdata, 
-                                                   F32 alpha )
+                                                   F32 alpha,
+                                                   bool preCulled )
 {
    PROFILE_SCOPE( TSShapeInstance_MeshObjectInstance_render );
 
@@ -664,7 +754,7 @@ void TSShapeInstance::MeshObjectInstance::render(  S32 objectDetail,
 
    const MatrixF &transform = getTransform();
 
-   if ( rdata.getCuller() )
+   if ( rdata.getCuller() && !preCulled )
    {
       Box3F box( mesh->getBounds() );
       transform.mul( box );
@@ -680,16 +770,39 @@ void TSShapeInstance::MeshObjectInstance::render(  S32 objectDetail,
    
    rdata.setCurrentRenderData(renderInstData);
 
-   // Pass a hint to the mesh that time has advanced and that the
-   // skin is dirty and needs to be updated.  This should result
-   // in the skin only updating once per frame in most cases.
-   const U32 currTime = 0;// TODOSim::getCurrentTime();
-   bool isSkinDirty = true;//currTime != mLastTime;
+   // Pass a hint to the mesh that the transforms have changed since it
+   // was last skinned (by a previous pass or prepareSkin()), and that the
+   // skin needs to be updated.
+   bool isSkinDirty = this->isSkinDirty( objectDetail );
+
+   // Baked palettes replace the instance's own animation
+   if ( rdata.getPoseAtlas() && TSShape::useHardwareSkinning() && mesh->getMeshType() == TSMesh::SkinMeshType &&
+        setAtlasPalette( *rdata.getPoseAtlas(), rdata.getPoseAtlasFrame(), objectDetail ) )
+   {
+      mesh->render( materials, rdata, false, *mTransforms, *mesh->mRenderer );
+
+      // the palette no longer matches the instance's transforms
+      mSkinnedDetail = -1;
+      return;
+   }
    
+   // Upload verts skinned ahead of time by prepareSkin(), whose palette
+   // is already in mActiveTransforms
+   if (isSkinDirty && mesh->getMeshType() == TSMesh::SkinMeshType && isSkinPrepared( objectDetail ))
+   {
+      if (!TSShape::useHardwareSkinning())
+         static_cast<TSSkinMesh*>(mesh)->uploadSkin( mPreparedSkin.address(), rdata );
+      isSkinDirty = false;
+   }
+
    // Store skin mesh transforms in mActiveTransforms
    if (isSkinDirty && mesh->getMeshType() == TSMesh::SkinMeshType)
    {
-      static_cast<TSSkinMesh*>(mesh)->updateSkinBones(*mTransforms, mActiveTransforms);
+      TSSkinMesh *skin = static_cast<TSSkinMesh*>(mesh);
+      if (skin->batchData.dualQuat)
+         skin->updateSkinBones(*mTransforms, mActiveDualQuats);
+      else
+         skin->updateSkinBones(*mTransforms, mActiveTransforms);
    }
 
    mesh->render(  materials, 
@@ -698,14 +811,78 @@ void TSShapeInstance::MeshObjectInstance::render(  S32 objectDetail,
                   *mTransforms,
                   *mesh->mRenderer );
 
-   // Update the last render time.
-   mLastTime = currTime;
+   mSkinnedDetail = objectDetail;
+   mSkinnedGeneration = *mTransformsGeneration;
 }
 
 TSShapeInstance::MeshObjectInstance::MeshObjectInstance() 
    : meshList(0), object(0), frame(0), matFrame(0),
-     visible(1.0f), forceHidden(false), mLastTime( 0 )
+     visible(1.0f), forceHidden(false), mSkinnedDetail( -1 ), mSkinnedGeneration( 0 ),
+     mPreparedDetail( -1 ), mPreparedGeneration( 0 ),
+     mSkinRayBVH( NULL ), mSkinRayDetail( -1 ), mSkinRayGeneration( 0 )
+{
+}
+
+TSShapeInstance::MeshObjectInstance::~MeshObjectInstance()
+{
+   SAFE_DELETE( mSkinRayBVH );
+}
+
+bool TSShapeInstance::MeshObjectInstance::setAtlasPalette( const TSPoseAtlas &atlas, S32 frame, S32 objectDetail )
+{
+   S32 mesh = atlas.findMesh( object->startMeshIndex + objectDetail );
+   if ( mesh < 0 || frame < 0 || frame >= (S32)atlas.getNumFrames() )
+      return false;
+
+   const TSPoseAtlas::MeshEntry &entry = atlas.getMeshEntry( mesh );
+   if ( entry.dualQuat )
+      mActiveDualQuats.set( (void*)atlas.getDualQuatPalette( frame, mesh ), entry.numBones );
+   else
+      mActiveTransforms.set( (void*)atlas.getPalette( frame, mesh ), entry.numBones );
+   return true;
+}
+
+void TSShapeInstance::MeshObjectInstance::prepareSkin( S32 objectDetail, TSRenderState &rdata )
 {
+   PROFILE_SCOPE( TSShapeInstance_MeshObjectInstance_prepareSkin );
+
+   if ( forceHidden || visible <= 0.01f )
+      return;
+
+   TSMesh *mesh = getMesh(objectDetail);
+   if ( !mesh || mesh->getMeshType() != TSMesh::SkinMeshType || mesh->mNumVerts == 0 )
+      return;
+
+   if ( !isSkinDirty( objectDetail ) || isSkinPrepared( objectDetail ) )
+      return;
+
+   // Setting these up changes the mesh, so leave that to render()
+   TSSkinMesh *skin = static_cast<TSSkinMesh*>(mesh);
+   if ( !skin->mVertexData.isReady() || !skin->batchDataInitialized )
+      return;
+
+   if ( skin->batchData.dualQuat )
+      skin->updateSkinBones(*mTransforms, mActiveDualQuats);
+   else
+      skin->updateSkinBones(*mTransforms, mActiveTransforms);
+
+   if ( !TSShape::useHardwareSkinning() )
+   {
+      // Start from a copy of the mesh so the fields which aren't skinned
+      // are valid when the buffer is uploaded
+      const dsize_t vertSize = skin->mVertexData.vertSize();
+      const dsize_t size = skin->mVertexData.size() * vertSize;
+      if ( mPreparedDetail != objectDetail || mPreparedSkin.size() != size )
+      {
+         mPreparedSkin.setSize( size );
+         dMemcpy( mPreparedSkin.address(), skin->mVertexData.address(), size );
+      }
+
+      skin->skinVerts(*mTransforms, rdata, mPreparedSkin.address(), vertSize);
+   }
+
+   mPreparedDetail = objectDetail;
+   mPreparedGeneration = *mTransformsGeneration;
 }
 
 void TSShapeInstance::prepCollision()
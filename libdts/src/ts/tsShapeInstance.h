@@ -30,6 +30,9 @@
 #ifndef _TSINTEGERSET_H_
 #include "ts/tsIntegerSet.h"
 #endif
+#ifndef _TSPOSECACHE_H_
+#include "ts/tsPoseCache.h"
+#endif
 #ifndef _CORE_LOG_H_
 #include "core/log.h"
 #endif
@@ -52,6 +55,8 @@ class ConvexFeature;
 class TSSceneRenderState;
 class TSMeshInstanceRenderData;
 class TSShapeInstance;
+class TSPoseAtlas;
+struct RayBatch;
 
 
 //-------------------------------------------------------------------------------------
@@ -94,6 +99,16 @@ public:
 ///      - Updating skeletal transforms.
 ///      - Ballooning (see setShapeBalloon() and getShapeBalloon())
 ///
+/// @section TSShapeInstance_threading Threading
+///
+/// All per-update scratch data (node workspaces, skinning bone palettes) lives
+/// in the TSRenderState passed to beginUpdate(), so distinct instances may be
+/// animated and skinned on different threads provided each thread has its own
+/// TSRenderState. prepareSkin() skins into buffers owned by the instance;
+/// render() and anything else which talks to the TSMeshRenderer must stay on
+/// the render thread. A single instance is never safe to update from more
+/// than one thread at once.
+///
 /// For an excellent example of how to render a TSShape in game, see TSStatic. For examples
 /// of how to procedurally animate models, look at Player::updateLookAnimation().
 class TSShapeInstance
@@ -116,6 +131,10 @@ class TSShapeInstance
       /// look for the transforms...gets set be shape instance 'setStatics' method
       const Vector<MatrixF> *mTransforms;
 
+      /// Generation counter of mTransforms, set up alongside it. Bumped
+      /// whenever the transforms change (see TSShapeInstance::mAnimationGeneration).
+      const U32 *mTransformsGeneration;
+
       S32 nodeIndex;
      
       /// Gets the transform of this object
@@ -127,8 +146,9 @@ class TSShapeInstance
      /// @name Render Functions
      /// @{
 
-     /// Render!  This draws the base-textured object.
-      virtual void render( S32 objectDetail, TSMaterialList *, TSRenderState &rdata, F32 alpha );      
+     /// Render!  This draws the base-textured object. If @a preCulled is set
+     /// the object is known to pass the render state's culler.
+      virtual void render( S32 objectDetail, TSMaterialList *, TSRenderState &rdata, F32 alpha, bool preCulled = false );      
      /// @}
 
      /// @name Collision Routines
@@ -161,17 +181,60 @@ class TSShapeInstance
       /// Generic pointer to store instance data
       TSMeshInstanceRenderData *renderInstData;
 
-      /// The time at which this mesh 
-      /// was last rendered.
-      U32 mLastTime;
+      /// Object detail and transform generation the skin was last
+      /// updated for. The skin is only updated again once either changes,
+      /// so extra passes and unanimated frames reuse the skinned verts.
+      S32 mSkinnedDetail;
+      U32 mSkinnedGeneration;
+
+      /// Returns true if the skin of the given detail is out of date
+      bool isSkinDirty( S32 objectDetail ) const { return mSkinnedDetail != objectDetail || mSkinnedGeneration != *mTransformsGeneration; }
+
+      /// Verts skinned by prepareSkin(), waiting for render() to upload
+      /// them, and the object detail and transform generation they are for.
+      /// Kept per instance so instances of one shape can be prepared on
+      /// separate threads.
+      Vector<U8> mPreparedSkin;
+      S32 mPreparedDetail;
+      U32 mPreparedGeneration;
+
+      /// Returns true if prepareSkin() has skinned the given detail for the
+      /// current transforms
+      bool isSkinPrepared( S32 objectDetail ) const { return mPreparedDetail == objectDetail && mPreparedGeneration == *mTransformsGeneration; }
       
       /// For GPU Skinning
       Vector<MatrixF> mActiveTransforms;
 
+      /// For GPU Skinning with dual quaternions
+      Vector<DualQuatF> mActiveDualQuats;
+
+      /// @name Skinned collision
+      /// Ray casts against a skin use a copy of the skin's bind pose
+      /// hierarchy, refitted to this instance's pose when it is next cast
+      /// against after the transforms change.
+      /// @{
+      TSMeshBVH *mSkinRayBVH;
+      Vector<Point3F> mSkinRayVerts;
+      Vector<MatrixF> mSkinRayBones;
+      S32 mSkinRayDetail;
+      U32 mSkinRayGeneration;
+
+      /// Returns the hierarchy of the skin of the given detail in the
+      /// current pose, or NULL if the mesh isn't a skin
+      TSMeshBVH *getSkinRayBVH( S32 objectDetail );
+      /// @}
+
       MeshObjectInstance();
-      virtual ~MeshObjectInstance() {}
+      virtual ~MeshObjectInstance();
+
+      void render( S32 objectDetail, TSMaterialList *, TSRenderState &rdata, F32 alpha, bool preCulled = false );
+      
+      /// Skins the mesh for the given detail without rendering it
+      void prepareSkin( S32 objectDetail, TSRenderState &rdata );
 
-      void render( S32 objectDetail, TSMaterialList *, TSRenderState &rdata, F32 alpha );
+      /// Copies the palette of the mesh for the given detail from @a frame
+      /// of a pose atlas. Returns false if the atlas doesn't hold the mesh.
+      bool setAtlasPalette( const TSPoseAtlas &atlas, S32 frame, S32 objectDetail );
 
       /// Gets the mesh with specified detail level
       TSMesh * getMesh(S32 num) const { return num<object->numMeshes ? *(meshList+num) : NULL; }
@@ -184,16 +247,28 @@ class TSShapeInstance
       void support( S32 od, const Point3F &v, F32 *currMaxDP, Point3F *currSupport );
       bool castRay( S32 objectDetail, const Point3F &start, const Point3F &end, RayInfo *info, TSMaterialList *materials );
       bool castRayRendered( S32 objectDetail, const Point3F &start, const Point3F &end, RayInfo *info, TSMaterialList *materials );
+      void castRays( S32 objectDetail, const Point3F *starts, const Point3F *ends, U32 count, RayInfo *results, U8 *hit, TSMaterialList *materials );
 
      /// @}
    };
 
+   public:
+
+   /// A TSShape::BoneBounds entry placed in an instance's pose
+   struct HitBox
+   {
+      S32 index;              ///< Entry in TSShape::boneBounds
+      MatrixF transform;      ///< From the space of the bounds to shape space
+      MatrixF invTransform;   ///< From shape space to the space of the bounds
+   };
+
    protected:
 
    struct TSCallbackRecord
    {
       TSCallback * callback;
       S32 nodeIndex;
+      MatrixF baseTransform;     ///< local transform passed to the callback by the last animateNodes()
    };
 
 //-------------------------------------------------------------------------------------
@@ -207,6 +282,17 @@ class TSShapeInstance
    /// storage space for node transforms
    Vector<MatrixF> mNodeTransforms;
 
+   /// Bumped by animateNodes() whenever mNodeTransforms is recalculated, so
+   /// skinned meshes know when they need updating. Code which changes
+   /// mNodeTransforms directly should bump this too.
+   U32 mAnimationGeneration;
+
+   /// Hit boxes and animated bounds, placed for mHitBoxGeneration
+   /// @see getHitBoxes
+   Vector<HitBox> mHitBoxes;
+   Box3F mAnimatedBounds;
+   U32 mHitBoxGeneration;
+
    /// @name Reference Transform Vectors
    /// unused until first transition
    /// @{
@@ -234,6 +320,16 @@ protected:
 
    S32 mCurrentDetailLevel;
 
+   /// @name Animation LOD state
+   /// @{
+   S32 mAnimationLOD;
+   U32 mAnimationLODFrame;          ///< counts node updates, starts at a per-instance offset
+   S32 mAnimationLODStep;           ///< interpolation steps taken towards mAnimationLODTo
+   S32 mAnimationLODSteps;          ///< interpolation steps between node updates
+   Vector<MatrixF> mAnimationLODFrom;
+   Vector<MatrixF> mAnimationLODTo;
+   /// @}
+
    /// 0-1, how far along from current to next (higher) detail level...
    ///
    /// 0=at this dl, 1=at higher detail level, where higher means bigger size on screen
@@ -283,6 +379,14 @@ protected:
    // node callbacks
    Vector<TSCallbackRecord> mNodeCallbacks;
 
+   /// @name Incremental node updates
+   /// @see setNodeDirty
+   /// @{
+   Vector<MatrixF> mNodeLocalTransforms;  ///< local transforms from the last animateNodes()
+   TSIntegerSet mDirtyNodes;              ///< nodes marked by setNodeDirty() since then
+   TSIntegerSet mPendingNodes;            ///< marked nodes whose descendants wait for animation LOD interpolation
+   /// @}
+
    /// state variables
    U32 mTriggerStates;
 
@@ -362,6 +466,11 @@ protected:
    /// @{
    void setNodeAnimationState(S32 nodeIndex, U32 animationState, TSCallback * callback = NULL);
    U32  getNodeAnimationState(S32 nodeIndex);
+
+   /// Marks a hands-off or callback node as changed by game code. Unless the
+   /// threads need animating anyway, the next animate() only updates this node
+   /// and its descendants.
+   void setNodeDirty(S32 nodeIndex);
    /// @}
 
    /// @name Trigger states
@@ -405,8 +514,18 @@ protected:
    void handleNodeScale(S32 a, S32 b);
    void handleAnimatedScale(TSThread *, S32 a, S32 b, TSIntegerSet &);
    void handleMaskedPositionNode(TSThread *, S32 nodeIndex, S32 offset);
-   void handleBlendSequence(TSThread *, S32 a, S32 b);
+   void handleBlendSequence(TSThread *, S32 a, S32 b, F32 keyPos);
    void checkScaleCurrentlyAnimated();
+
+   /// Multiplies the local transforms of subshape @a ss down the node hierarchy
+   /// into mNodeTransforms. If @a dirty is given, only those nodes and, if
+   /// @a descendants is set, the nodes below them are updated.
+   void concatNodeTransforms(S32 ss, const MatrixF * localTransforms, const TSIntegerSet * dirty = NULL, bool descendants = true);
+
+   /// Fills in the key of the current pose of subshape @a ss in the shape's
+   /// TSPoseCache, with the threads' key positions quantized to the cache's
+   /// steps. Returns false if the pose can't be shared with other instances.
+   bool buildPoseCacheKey(S32 ss, TSPoseCache::Key & key);
    /// @}
 
 //-------------------------------------------------------------------------------------
@@ -450,10 +569,31 @@ protected:
 
    virtual void render( TSRenderState &rdata );
    virtual void render( TSRenderState &rdata, S32 dl, F32 intraDL = 0.0f );
+   
+   /// Skins all visible skin meshes at the current detail level into
+   /// buffers owned by the instance, leaving only the vertex buffer upload
+   /// for the next render(). Neither the renderer nor the shared mesh data
+   /// is touched, so different instances may be prepared on different
+   /// threads, each with its own TSRenderState. Meshes without vertex data
+   /// or batch data yet are left for render() to skin.
+   void prepareSkin( TSRenderState &rdata );
 
    void animate() { animate( mCurrentDetailLevel ); }
    void animate(S32 dl);
    void animateNodes(S32 ss);
+
+   /// Calls animateNodes() as allowed by the animation LOD, and steps any
+   /// interpolation between throttled updates. Returns false if a node
+   /// update was deferred to a later frame.
+   bool animateNodesLOD(S32 ss, bool transformDirty);
+
+   /// Copies the nodes that animation LOD interpolation leaves alone (those
+   /// outside subshape @a ss, hands off and callback nodes) from @a src.
+   void copyUninterpolatedNodes(S32 ss, const Vector<MatrixF> &src);
+
+   /// Updates the nodes marked by setNodeDirty() and their descendants,
+   /// reusing the local transforms from the last animateNodes().
+   void animateDirtyNodes(S32 ss);
    void animateVisibility(S32 ss);
    void animateFrame(S32 ss);
    void animateMatFrame(S32 ss);
@@ -516,6 +656,39 @@ protected:
    /// Sets the current detail level using the legacy screen error metric.
    S32 setDetailFromScreenError( F32 errorTOL );
 
+   /// @name Animation LOD
+   /// Distant instances can evaluate their node transforms less often. At
+   /// animation LOD n, animate() only recalculates the nodes on every 2^n-th
+   /// frame in which they are dirty. When smUseAnimationLOD is set the LOD is
+   /// picked from the pixel size calculated by setDetailFromDistance().
+   /// @{
+
+   enum
+   {
+      NumAnimationLODs = 4    ///< full, 1/2, 1/4 and 1/8 rate
+   };
+
+   /// Select the animation LOD in setDetailFromDistance()
+   static bool smUseAnimationLOD;
+
+   /// Shapes smaller than smAnimationLODPixelSize[n-1] pixels use at least
+   /// animation LOD n. Should be decreasing.
+   static F32 smAnimationLODPixelSize[NumAnimationLODs-1];
+
+   /// Interpolate node transforms between throttled updates. This smooths
+   /// the motion at the cost of lagging up to 2^n-1 frames behind.
+   static bool smAnimationLODInterpolate;
+
+   /// Blend threads are ignored from this animation LOD onwards
+   static S32 smAnimationLODSkipBlends;
+
+   S32 getAnimationLOD() const { return mAnimationLOD; }
+
+   /// Sets the animation LOD. This is overridden by setDetailFromDistance()
+   /// if smUseAnimationLOD is set.
+   void setAnimationLOD( S32 lod );
+   /// @}
+
    enum
    {
       TransformDirty =  BIT(0),
@@ -523,7 +696,8 @@ protected:
       FrameDirty =      BIT(2),
       MatFrameDirty =   BIT(3),
       ThreadDirty =     BIT(4),
-      AllDirtyMask = TransformDirty | VisDirty | FrameDirty | MatFrameDirty | ThreadDirty
+      NodeDirty =       BIT(5),   ///< only some nodes need updating, see setNodeDirty
+      AllDirtyMask = TransformDirty | VisDirty | FrameDirty | MatFrameDirty | ThreadDirty | NodeDirty
    };
    U32 * mDirtyFlags;
    void setDirty(U32 dirty);
@@ -540,10 +714,39 @@ protected:
    bool castRay(const Point3F & start, const Point3F & end, RayInfo *,S32 dl);
    bool castRayRendered(const Point3F & start, const Point3F & end, RayInfo *,S32 dl);
    bool quickLOS(const Point3F & start, const Point3F & end, S32 dl) { return castRay(start,end,NULL,dl); }
+
+   /// Casts a batch of rays against a detail level. Each node transform is
+   /// inverted once and applied to the whole batch, and rays are walked
+   /// through the mesh hierarchies in packets. Leave batch.results NULL for
+   /// line of sight tests, which stop as soon as every ray is blocked.
+   ///
+   /// @returns the number of rays which hit
+   U32 castRays(const RayBatch &batch, S32 dl);
    Point3F support(const Point3F & v, S32 dl);
    void computeBounds(S32 dl, Box3F & bounds); ///< uses current transforms to compute bounding box around a detail level
                                                ///< see like named method on shape if you want to use default transforms
 
+   /// Bounds of every detail in the current pose, from the node transforms
+   /// and TSShape::boneBounds alone, so no vertices are touched. Looser
+   /// than computeBounds but cheap enough for culling and broadphase.
+   /// Cached until the transforms change.
+   const Box3F& getAnimatedBounds();
+
+   /// One box per TSShape::boneBounds entry, placed in the current pose.
+   /// Cached until the transforms change.
+   const Vector<HitBox>& getHitBoxes();
+
+   /// Finds the nearest hit box crossed by the segment @a start to @a end,
+   /// in shape space. Returns its index in getHitBoxes(), or -1, with the
+   /// distance along the segment (0..1) in @a outT.
+   S32 castRayHitBoxes(const Point3F &start, const Point3F &end, F32 *outT = NULL);
+
+   protected:
+   /// Places the hit boxes and animated bounds if the transforms changed
+   void updateHitBoxes();
+
+   public:
+
 //-------------------------------------------------------------------------------------
 // Thread Control
 //-------------------------------------------------------------------------------------
@@ -0,0 +1,474 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include "ts/tsShapeLoadQueue.h"
+#include "platform/platformThreads.h"
+#include "platform/profiler.h"
+#include "core/log.h"
+#include "core/stream/fileStream.h"
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+TSShapeLoadQueue::Request::Request(const String &path, const TSIOState &options, S32 priority, U32 sequence) :
+   mPath(path),
+   mOptions(options),
+   mPriority(priority),
+   mSequence(sequence),
+   mState(Queued),
+   mCancel(false),
+   mReleased(false),
+   mBuffer(NULL),
+   mBufferSize(0),
+   mShape(NULL)
+{
+   mDoneSignal = new Semaphore(0);
+}
+
+TSShapeLoadQueue::Request::~Request()
+{
+   freeBuffer();
+   delete mShape;
+   delete mDoneSignal;
+}
+
+void TSShapeLoadQueue::Request::freeBuffer()
+{
+   if ( mBuffer )
+      dFree(mBuffer);
+   mBuffer = NULL;
+   mBufferSize = 0;
+}
+
+TSShape *TSShapeLoadQueue::Request::takeShape()
+{
+   if ( mState != Done )
+      return NULL;
+
+   TSShape *shape = mShape;
+   mShape = NULL;
+   return shape;
+}
+
+//-----------------------------------------------------------------------------
+
+TSShapeLoadQueue::TSShapeLoadQueue(U32 numThreads, U32 flags) :
+   mQuit(false),
+   mFlags(flags),
+   mNextSequence(0)
+{
+   mLock = new Semaphore(1);
+   mWorkSignal = new Semaphore(0);
+   mImportLock = new Semaphore(1);
+
+   for ( U32 i=0; i<numThreads; i++ )
+   {
+      Worker *worker = new Worker;
+      worker->queue = this;
+      worker->thread = new Thread(&TSShapeLoadQueue::workerMain, worker);
+
+      if ( !worker->thread->start() )
+      {
+         Log::errorf("TSShapeLoadQueue: unable to start worker thread %u", i);
+         delete worker->thread;
+         delete worker;
+         break;
+      }
+
+      mWorkers.push_back(worker);
+   }
+}
+
+TSShapeLoadQueue::~TSShapeLoadQueue()
+{
+   mLock->acquire();
+   for ( S32 i=0; i<mRequests.size(); i++ )
+      cancelLocked(mRequests[i]);
+   mQuit = true;
+   mLock->release();
+
+   mWorkSignal->release(mWorkers.size());
+
+   for ( S32 i=0; i<mWorkers.size(); i++ )
+   {
+      mWorkers[i]->thread->join();
+      delete mWorkers[i]->thread;
+      delete mWorkers[i];
+   }
+   mWorkers.clear();
+
+   // Anything still here was either finished or cancelled by a worker
+   for ( S32 i=0; i<mRequests.size(); i++ )
+      delete mRequests[i];
+   mRequests.clear();
+
+   delete mLock;
+   delete mWorkSignal;
+   delete mImportLock;
+}
+
+void TSShapeLoadQueue::workerMain(void *data)
+{
+   Worker *worker = reinterpret_cast<Worker*>(data);
+   TSShapeLoadQueue *queue = worker->queue;
+
+   for (;;)
+   {
+      queue->mWorkSignal->acquire();
+      if ( queue->mQuit )
+         break;
+
+      // Jobs taken by wait() leave their signal behind, so there may be nothing to do
+      queue->mLock->acquire();
+      Request *req = queue->claimJob();
+      queue->mLock->release();
+
+      if ( req )
+         queue->runStage(req);
+   }
+}
+
+//-----------------------------------------------------------------------------
+
+TSShapeLoadQueue::Request *TSShapeLoadQueue::load(const Path &path, S32 priority, const TSIOState *options)
+{
+   Request *req = new Request(path.getFullPath(), options ? *options : TSIOState(), priority, mNextSequence++);
+
+   // Only .dts files have a separate read stage
+   if ( !path.getExtension().equal("dts", String::NoCase) )
+      req->mState = Request::Read;
+
+   mLock->acquire();
+   mRequests.push_back(req);
+   mPending.push_back(req);
+   mLock->release();
+
+   mWorkSignal->release();
+   return req;
+}
+
+void TSShapeLoadQueue::setPriority(Request *req, S32 priority)
+{
+   mLock->acquire();
+   req->mPriority = priority;
+   mLock->release();
+}
+
+void TSShapeLoadQueue::cancel(Request *req)
+{
+   mLock->acquire();
+   cancelLocked(req);
+   mLock->release();
+}
+
+void TSShapeLoadQueue::cancelLocked(Request *req)
+{
+   switch ( req->mState )
+   {
+   case Request::Queued:
+   case Request::Read:
+      mPending.remove(req);
+      req->freeBuffer();
+      finishStage(req, Request::Cancelled);
+      break;
+
+   case Request::Reading:
+   case Request::Decoding:
+      req->mCancel = true;
+      break;
+
+   case Request::Decoded:
+      mDecoded.remove(req);
+      delete req->mShape;
+      req->mShape = NULL;
+      finishStage(req, Request::Cancelled);
+      break;
+
+   default:
+      break;
+   }
+}
+
+void TSShapeLoadQueue::release(Request *req)
+{
+   mLock->acquire();
+   cancelLocked(req);
+
+   if ( req->mState == Request::Reading || req->mState == Request::Decoding )
+   {
+      // The worker frees it once the stage is done
+      req->mReleased = true;
+   }
+   else
+   {
+      mRequests.remove(req);
+      delete req;
+   }
+
+   mLock->release();
+}
+
+bool TSShapeLoadQueue::wait(Request *req)
+{
+   PROFILE_SCOPE( TSShapeLoadQueue_wait );
+
+   for (;;)
+   {
+      mLock->acquire();
+      const Request::State state = req->mState;
+
+      if ( state == Request::Queued || state == Request::Read )
+      {
+         // Not started yet, so do it here rather than wait for a worker
+         mPending.remove(req);
+         startStage(req);
+         mLock->release();
+         runStage(req);
+         continue;
+      }
+
+      if ( state == Request::Decoded )
+      {
+         mDecoded.remove(req);
+         mLock->release();
+         finishRender(req);
+         break;
+      }
+
+      mLock->release();
+
+      if ( req->isFinished() )
+         break;
+
+      // Leave the signal set for any later wait()
+      req->mDoneSignal->acquire();
+      req->mDoneSignal->release();
+   }
+
+   return req->mState == Request::Done;
+}
+
+U32 TSShapeLoadQueue::update(U32 maxCount)
+{
+   PROFILE_SCOPE( TSShapeLoadQueue_update );
+
+   if ( mWorkers.empty() )
+   {
+      mLock->acquire();
+      Request *req = claimJob();
+      mLock->release();
+
+      if ( req )
+         runStage(req);
+   }
+
+   U32 count = 0;
+   while ( count < maxCount )
+   {
+      mLock->acquire();
+      if ( mDecoded.empty() )
+      {
+         mLock->release();
+         break;
+      }
+
+      Request *req = mDecoded.front();
+      mDecoded.pop_front();
+      mLock->release();
+
+      finishRender(req);
+      count++;
+   }
+
+   return count;
+}
+
+//-----------------------------------------------------------------------------
+
+TSShapeLoadQueue::Request *TSShapeLoadQueue::claimJob()
+{
+   if ( mPending.empty() )
+      return NULL;
+
+   S32 best = 0;
+   for ( S32 i=1; i<mPending.size(); i++ )
+   {
+      const Request *a = mPending[i];
+      const Request *b = mPending[best];
+
+      if ( a->mPriority != b->mPriority )
+      {
+         if ( a->mPriority > b->mPriority )
+            best = i;
+      }
+      else if ( a->mState != b->mState )
+      {
+         // Decoding first frees the file buffer sooner
+         if ( a->mState == Request::Read )
+            best = i;
+      }
+      else if ( a->mSequence < b->mSequence )
+         best = i;
+   }
+
+   Request *req = mPending[best];
+   mPending.erase_fast(best);
+   startStage(req);
+   return req;
+}
+
+void TSShapeLoadQueue::startStage(Request *req)
+{
+   req->mState = (req->mState == Request::Queued) ? Request::Reading : Request::Decoding;
+}
+
+void TSShapeLoadQueue::runStage(Request *req)
+{
+   if ( req->mState == Request::Reading )
+   {
+      bool success = readFile(req);
+
+      mLock->acquire();
+      if ( req->mCancel || !success )
+      {
+         req->freeBuffer();
+         finishStage(req, req->mCancel ? Request::Cancelled : Request::Failed);
+      }
+      else
+      {
+         req->mState = Request::Read;
+         mPending.push_back(req);
+         mWorkSignal->release();
+      }
+      mLock->release();
+   }
+   else
+   {
+      bool success = !req->mCancel && decodeShape(req);
+      req->freeBuffer();
+
+      const bool renderHere = (mFlags & InitRenderOnWorker) != 0;
+      if ( success && renderHere && !req->mCancel )
+         req->mShape->initRender();
+
+      mLock->acquire();
+      if ( req->mCancel || !success )
+      {
+         delete req->mShape;
+         req->mShape = NULL;
+         finishStage(req, req->mCancel ? Request::Cancelled : Request::Failed);
+      }
+      else if ( renderHere )
+         finishStage(req, Request::Done);
+      else
+      {
+         mDecoded.push_back(req);
+         finishStage(req, Request::Decoded);
+      }
+      mLock->release();
+   }
+}
+
+bool TSShapeLoadQueue::readFile(Request *req)
+{
+   PROFILE_SCOPE( TSShapeLoadQueue_readFile );
+
+   FileStream stream;
+   stream.open(req->mPath, FileStream::Read);
+   if ( stream.getStatus() != Stream::Ok )
+   {
+      Log::errorf( "TSShapeLoadQueue - Could not open '%s'", req->mPath.c_str() );
+      return false;
+   }
+
+   req->mBufferSize = stream.getStreamSize();
+   req->mBuffer = dMalloc(req->mBufferSize);
+   if ( !stream.read(req->mBufferSize, req->mBuffer) )
+   {
+      Log::errorf( "TSShapeLoadQueue - Error reading '%s'", req->mPath.c_str() );
+      return false;
+   }
+
+   return true;
+}
+
+bool TSShapeLoadQueue::decodeShape(Request *req)
+{
+   PROFILE_SCOPE( TSShapeLoadQueue_decodeShape );
+
+   if ( !req->mBuffer )
+   {
+      // Everything other than .dts goes through the importers
+      mImportLock->acquire();
+      req->mShape = TSShape::createFromPath(req->mPath);
+      mImportLock->release();
+      return req->mShape != NULL;
+   }
+
+   TSShape *shape = new TSShape;
+   shape->mPath = req->mPath;
+
+   if ( !shape->readFromBuffer(req->mBuffer, req->mBufferSize, &req->mOptions) )
+   {
+      Log::errorf( "TSShapeLoadQueue - Error reading '%s'", req->mPath.c_str() );
+      delete shape;
+      return false;
+   }
+
+   if ( TSShape::smCompressAnimation )
+      shape->compressAnimation();
+
+   req->mShape = shape;
+   return true;
+}
+
+void TSShapeLoadQueue::finishStage(Request *req, Request::State state)
+{
+   req->mState = state;
+
+   if ( req->mReleased )
+   {
+      mRequests.remove(req);
+      delete req;
+   }
+   else
+      req->mDoneSignal->release();
+}
+
+void TSShapeLoadQueue::finishRender(Request *req)
+{
+   PROFILE_SCOPE( TSShapeLoadQueue_finishRender );
+
+   req->mShape->initRender();
+
+   mLock->acquire();
+   finishStage(req, Request::Done);
+   mLock->release();
+}
+
+//-----------------------------------------------------------------------------
+
+END_NS
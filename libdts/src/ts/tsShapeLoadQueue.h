@@ -0,0 +1,218 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 GarageGames, LLC
+// Portions Copyright (C) 2013 James S Urquhart
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef _TSSHAPELOADQUEUE_H_
+#define _TSSHAPELOADQUEUE_H_
+
+#ifndef _TSSHAPE_H_
+#include "ts/tsShape.h"
+#endif
+
+//-----------------------------------------------------------------------------
+
+BEGIN_NS(DTShape)
+
+//-----------------------------------------------------------------------------
+
+class Thread;
+class Semaphore;
+
+/// Loads shapes on a pool of worker threads.
+///
+/// load() queues a file and returns a Request straight away. Each request
+/// passes through the following stages, each of which is a separate job so
+/// that one worker can be reading a file while another assembles a shape:
+///
+///   - Read: a .dts file is read into memory.
+///   - Decode: the shape is assembled and init()'d from the buffer, then
+///     compressed if TSShape::smCompressAnimation is set. Other formats are
+///     loaded here with TSShape::createFromPath; COLLADA import is not thread
+///     safe, so only one worker runs it at a time.
+///   - Render: TSShape::initRender. This runs in update() on the thread which
+///     owns the queue, since mesh renderers usually need to create their
+///     buffers there. The InitRenderOnWorker flag runs it on the worker too.
+///
+/// Jobs are taken highest priority first, then furthest along the pipeline,
+/// then in the order they were queued. A request can be cancelled or
+/// re-prioritised at any time; a stage which is already running is allowed to
+/// finish and its result is thrown away.
+///
+/// The queue is driven from one thread: load(), cancel(), release(), wait()
+/// and update() must all be called from the thread which created it.
+class TSShapeLoadQueue
+{
+public:
+   enum Flags
+   {
+      InitRenderOnWorker = BIT(0)   ///< Run TSShape::initRender on the worker thread
+   };
+
+   class Request
+   {
+      friend class TSShapeLoadQueue;
+
+   public:
+      enum State
+      {
+         Queued,        ///< Waiting for a worker to read the file
+         Reading,
+         Read,          ///< Waiting for a worker to decode the shape
+         Decoding,
+         Decoded,       ///< Waiting for update() to call initRender
+         Done,
+         Failed,
+         Cancelled
+      };
+
+   protected:
+      String mPath;
+      TSIOState mOptions;
+      S32 mPriority;
+      U32 mSequence;                ///< Order of the call to load()
+
+      volatile State mState;
+      volatile bool mCancel;        ///< Set while a stage is running to discard its result
+      bool mReleased;               ///< Delete once the running stage finishes
+
+      void *mBuffer;                ///< File contents between Read and Decode
+      U32 mBufferSize;
+      TSShape *mShape;
+
+      Semaphore *mDoneSignal;       ///< Released once the request is finished or Decoded
+
+      Request(const String &path, const TSIOState &options, S32 priority, U32 sequence);
+      ~Request();
+
+      void freeBuffer();
+
+   public:
+      const String &getPath() const { return mPath; }
+      S32 getPriority() const { return mPriority; }
+      State getState() const { return mState; }
+
+      /// Returns true once the request is Done, Failed or Cancelled
+      bool isFinished() const { return mState >= Done; }
+
+      /// Returns the loaded shape once the request is Done. The shape is owned
+      /// by the request unless takeShape() is called.
+      TSShape *getShape() const { return mState == Done ? mShape : NULL; }
+
+      /// Hands the loaded shape over to the caller
+      TSShape *takeShape();
+   };
+
+protected:
+   struct Worker
+   {
+      TSShapeLoadQueue *queue;
+      Thread *thread;
+   };
+
+   Vector<Worker*> mWorkers;
+   Vector<Request*> mRequests;      ///< Every request not yet released
+   Vector<Request*> mPending;       ///< Requests which are Queued or Read
+   Vector<Request*> mDecoded;       ///< Requests waiting for update()
+
+   Semaphore *mLock;
+   Semaphore *mWorkSignal;          ///< Released once per job added to mPending
+   Semaphore *mImportLock;          ///< Serializes loads through createFromPath
+   volatile bool mQuit;
+
+   U32 mFlags;
+   U32 mNextSequence;
+
+   static void workerMain(void *data);
+
+   /// Removes the best job from mPending and moves it to its running state.
+   /// Must be called with mLock held.
+   Request *claimJob();
+
+   /// Moves a Queued or Read request to Reading or Decoding
+   void startStage(Request *req);
+
+   /// Runs the current stage of a claimed request
+   void runStage(Request *req);
+
+   bool readFile(Request *req);
+   bool decodeShape(Request *req);
+
+   /// Moves a request to a final state or Decoded and wakes any waiters.
+   /// Must be called with mLock held.
+   void finishStage(Request *req, Request::State state);
+
+   /// Must be called with mLock held
+   void cancelLocked(Request *req);
+
+   /// Runs initRender on a Decoded request which has been taken off mDecoded
+   void finishRender(Request *req);
+
+public:
+   /// @param numThreads Number of worker threads to start
+   /// @param flags      Combination of Flags
+   TSShapeLoadQueue(U32 numThreads, U32 flags = 0);
+
+   /// Cancels all outstanding requests and stops the workers. Any shapes which
+   /// have not been taken are deleted along with their requests.
+   ~TSShapeLoadQueue();
+
+   U32 getThreadCount() const { return mWorkers.size(); }
+
+   /// Queues a shape for loading. Requests with a higher @a priority are
+   /// started first. @a options is copied; it defaults to a plain TSIOState
+   /// and only applies to .dts files.
+   ///
+   /// The request belongs to the queue until it is passed to release().
+   Request *load(const Path &path, S32 priority = 0, const TSIOState *options = NULL);
+
+   /// Changes the priority of a request which has not yet finished
+   void setPriority(Request *req, S32 priority);
+
+   /// Cancels a request. Queued requests are cancelled straight away; a running
+   /// stage is left to finish and its result discarded.
+   void cancel(Request *req);
+
+   /// Cancels the request if needed and frees it. The request may not be used
+   /// after this call.
+   void release(Request *req);
+
+   /// Blocks until the request is finished. A request which has not been
+   /// started is loaded on the calling thread instead of waiting for a worker.
+   ///
+   /// @returns true if the request is Done.
+   bool wait(Request *req);
+
+   /// Calls initRender on up to @a maxCount Decoded requests, marking them
+   /// Done. Call this once per tick.
+   ///
+   /// If no worker thread could be started one pending job is run here too, so
+   /// the queue keeps working without threads.
+   ///
+   /// @returns the number of requests finished by this call.
+   U32 update(U32 maxCount = U32_MAX);
+};
+
+//-----------------------------------------------------------------------------
+
+END_NS
+
+#endif // _TSSHAPELOADQUEUE_H_
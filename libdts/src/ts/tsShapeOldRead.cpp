@@ -196,6 +196,8 @@ void TSShape::fixupOldSkins(S32 numMeshes, S32 numSkins, S32 numDetails, S32 * d
 //-------------------------------------------------
 void TSShape::exportSequences(Stream * s, TSIOState *options)
 {
+   decompressAnimation();
+
    TSIOState saveState;
    if (options)
    {
@@ -308,6 +310,8 @@ void TSShape::exportSequences(Stream * s, TSIOState *options)
 //-------------------------------------------------
 void TSShape::exportSequence(Stream * s, const TSShape::Sequence& seq, TSIOState *options)
 {
+   decompressAnimation();
+
    TSIOState saveState;
    if (options)
    {
@@ -442,6 +446,8 @@ void TSShape::exportSequence(Stream * s, const TSShape::Sequence& seq, TSIOState
 //-------------------------------------------------
 bool TSShape::importSequences(Stream * s, const String& sequencePath, TSIOState *options)
 {
+   decompressAnimation();
+
    TSIOState loadState;
    if (options)
    {
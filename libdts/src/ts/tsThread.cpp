@@ -657,6 +657,9 @@ void TSShapeInstance::updateTransitions()
    if (mTransitionThreads.empty())
       return;
 
+   TSAnimationScratch &scratch = mCurrentRenderState->mAnimationScratch;
+   scratch.reserve(mShape->nodes.size());
+
    TSIntegerSet transitionNodes;
    updateTransitionNodeTransforms(transitionNodes);
 
@@ -666,14 +669,14 @@ void TSShapeInstance::updateTransitions()
    for (i=0; i<mShape->nodes.size(); i++)
    {
       if (mTransitionRotationNodes.test(i))
-         mNodeReferenceRotations[i].set(mCurrentRenderState->smNodeCurrentRotations[i]);
+         mNodeReferenceRotations[i].set(scratch.nodeCurrentRotations[i]);
       if (mTransitionTranslationNodes.test(i))
-         mNodeReferenceTranslations[i] = mCurrentRenderState->smNodeCurrentTranslations[i];
+         mNodeReferenceTranslations[i] = scratch.nodeCurrentTranslations[i];
    }
 
    if (animatesScale())
    {
-      // Make sure smNodeXXXScale arrays have been resized
+      // Make sure the scratch scale arrays have been allocated
       TSIntegerSet dummySet;
       handleDefaultScale(0, 0, dummySet);
 
@@ -683,7 +686,7 @@ void TSShapeInstance::updateTransitions()
          for (i=0; i<mShape->nodes.size(); i++)
          {
             if (mTransitionScaleNodes.test(i))
-               mNodeReferenceUniformScales[i] = mCurrentRenderState->smNodeCurrentUniformScales[i];
+               mNodeReferenceUniformScales[i] = scratch.nodeCurrentUniformScales[i];
          }
       }
       else if (animatesAlignedScale())
@@ -692,7 +695,7 @@ void TSShapeInstance::updateTransitions()
          for (i=0; i<mShape->nodes.size(); i++)
          {
             if (mTransitionScaleNodes.test(i))
-               mNodeReferenceScaleFactors[i] = mCurrentRenderState->smNodeCurrentAlignedScales[i];
+               mNodeReferenceScaleFactors[i] = scratch.nodeCurrentAlignedScales[i];
          }
       }
       else
@@ -703,8 +706,8 @@ void TSShapeInstance::updateTransitions()
          {
             if (mTransitionScaleNodes.test(i))
             {
-               mNodeReferenceScaleFactors[i] = mCurrentRenderState->smNodeCurrentArbitraryScales[i].mScale;
-               mNodeReferenceArbitraryScaleRots[i].set(mCurrentRenderState->smNodeCurrentArbitraryScales[i].mRotate);
+               mNodeReferenceScaleFactors[i] = scratch.nodeCurrentArbitraryScales[i].mScale;
+               mNodeReferenceArbitraryScaleRots[i].set(scratch.nodeCurrentArbitraryScales[i].mRotate);
             }
          }
       }